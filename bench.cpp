@@ -0,0 +1,783 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <new>
+#include <string>
+#include <algorithm>
+
+#include "jsonity.hpp"
+
+using namespace jsonity;
+
+//---------------------------------------------------------------------------//
+// Allocation counter
+//---------------------------------------------------------------------------//
+
+static size_t allocCount = 0;
+static size_t allocBytes = 0;
+static size_t allocTotal = 0;  // never decremented
+
+struct AllocHeader
+{
+    size_t size;
+    size_t padding;
+};
+
+void* operator new(size_t size)
+{
+    AllocHeader* header =
+        static_cast<AllocHeader*>(malloc(sizeof(AllocHeader) + size));
+    if (header == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    header->size = size;
+    ++allocCount;
+    ++allocTotal;
+    allocBytes += size;
+    return (header + 1);
+}
+
+void operator delete(void* ptr) throw()
+{
+    if (ptr == NULL)
+    {
+        return;
+    }
+    AllocHeader* header = static_cast<AllocHeader*>(ptr) - 1;
+    --allocCount;
+    allocBytes -= header->size;
+    free(header);
+}
+
+void operator delete(void* ptr, size_t) throw()
+{
+    operator delete(ptr);
+}
+
+//---------------------------------------------------------------------------//
+// Documents
+//---------------------------------------------------------------------------//
+
+static std::string makeRecords(int count)
+{
+    static const char* status[] = { "active", "pending", "disabled" };
+
+    std::string jsonStr = "[";
+    char buf[512];
+
+    for (int index = 0; index < count; ++index)
+    {
+        snprintf(buf, sizeof(buf),
+            "%s{\"id\":%d,\"code\":\"C%05d\",\"status\":\"%s\","
+            "\"score\":%d.25,\"enabled\":%s,\"tags\":[\"a\",\"b\"],"
+            "\"meta\":{},\"note\":null,"
+            "\"description\":\"record number %d of the benchmark\"}",
+            (index == 0) ? "" : ",",
+            index, index, status[index % 3], index % 100,
+            (index % 2) ? "true" : "false", index);
+        jsonStr += buf;
+    }
+
+    jsonStr += "]";
+    return jsonStr;
+}
+
+static std::string makeConfig(int count)
+{
+    std::string jsonStr = "{";
+    char buf[512];
+
+    for (int index = 0; index < count; ++index)
+    {
+        snprintf(buf, sizeof(buf),
+            "%s\"service%d\":{\"host\":\"10.0.0.%d\",\"port\":%d,"
+            "\"timeout\":1.5,\"retry\":{\"count\":3,\"backoff\":\"exp\"},"
+            "\"features\":[],\"labels\":{\"env\":\"prod\",\"zone\":\"z%d\"}}",
+            (index == 0) ? "" : ",",
+            index, index % 256, 8000 + index, index % 4);
+        jsonStr += buf;
+    }
+
+    jsonStr += "}";
+    return jsonStr;
+}
+
+static std::string makeNumbers(int count)
+{
+    std::string jsonStr = "[";
+    char buf[64];
+
+    for (int index = 0; index < count; ++index)
+    {
+        snprintf(buf, sizeof(buf), "%s%d.5",
+            (index == 0) ? "" : ",", index);
+        jsonStr += buf;
+    }
+
+    jsonStr += "]";
+    return jsonStr;
+}
+
+//---------------------------------------------------------------------------//
+// Memory benchmark
+//---------------------------------------------------------------------------//
+
+static size_t countNodes(const Json::Value& value)
+{
+    size_t count = 1;
+
+    if (value.isPacked())
+    {
+        count += value.getSize();
+    }
+    else if (value.isArray())
+    {
+        const Json::Array& arr = value.getArray();
+        for (Json::Array::const_iterator it = arr.begin();
+            it != arr.end(); ++it)
+        {
+            count += countNodes(*it);
+        }
+    }
+    else if (value.isObject())
+    {
+        const Json::Object& obj = value.getObject();
+        for (Json::Object::const_iterator it = obj.begin();
+            it != obj.end(); ++it)
+        {
+            count += countNodes(it->second);
+        }
+    }
+
+    return count;
+}
+
+static void benchMemory(const char* name, const std::string& jsonStr,
+                        bool pack = false)
+{
+    size_t bytes = allocBytes;
+    size_t count = allocCount;
+
+    Json::DecodeStyle style;
+    style.setPackNumberArrays(pack);
+
+    Json::Value* value = new Json::Value;
+    if (!Json::decode(jsonStr, *value, style))
+    {
+        printf("%-10s decode error\n", name);
+        return;
+    }
+
+    size_t nodes = countNodes(*value);
+    size_t heapBytes = allocBytes - bytes;
+    size_t heapCount = allocCount - count;
+
+    printf("%-10s %8u nodes %8.1f bytes/node %6.2f allocs/node%s\n",
+        name, (unsigned)nodes,
+        (double)heapBytes / (double)nodes,
+        (double)heapCount / (double)nodes,
+        pack ? " (packed)" : "");
+
+    delete value;
+}
+
+static void benchDocument(const char* name, const std::string& jsonStr,
+                          bool countArraySize = false)
+{
+    size_t bytes = allocBytes;
+    size_t count = allocCount;
+
+    Json::Document* doc = new Json::Document;
+    if (countArraySize)
+    {
+        Json::DecodeStyle style;
+        style.setCountArraySize(true);
+        doc->setDecodeStyle(style);
+    }
+
+    if (!doc->decode(jsonStr))
+    {
+        printf("%-10s decode error\n", name);
+        return;
+    }
+
+    size_t nodes = countNodes(doc->getValue());
+    size_t heapBytes = allocBytes - bytes;
+    size_t heapCount = allocCount - count;
+
+    printf("%-10s %8u nodes %8.1f bytes/node %6.2f allocs/node (document%s)\n",
+        name, (unsigned)nodes,
+        (double)heapBytes / (double)nodes,
+        (double)heapCount / (double)nodes,
+        countArraySize ? ", counted" : "");
+
+    delete doc;
+}
+
+static void benchCopy(const char* name, const std::string& jsonStr,
+                      bool shared)
+{
+    Json::Value value;
+    Json::decode(jsonStr, value);
+
+    if (shared)
+    {
+        value.makeShared();
+    }
+
+    size_t count = allocCount;
+    size_t bytes = allocBytes;
+
+    Json::Value copy = value;
+
+    printf("%-10s %8u allocs %10u bytes per copy%s\n",
+        name, (unsigned)(allocCount - count),
+        (unsigned)(allocBytes - bytes), shared ? " (shared)" : "");
+}
+
+//---------------------------------------------------------------------------//
+// Object layout benchmark
+//---------------------------------------------------------------------------//
+
+static std::string makeWide(int count)
+{
+    std::string jsonStr = "{";
+    char buf[64];
+
+    for (int index = 0; index < count; ++index)
+    {
+        snprintf(buf, sizeof(buf), "%s\"member%d\":%d",
+            (index == 0) ? "" : ",", index, index);
+        jsonStr += buf;
+    }
+
+    jsonStr += "}";
+    return jsonStr;
+}
+
+static double elapsed(clock_t start)
+{
+    return (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+// Small objects: decode the config document and read two members of
+// every service. Wide objects: decode one object and look up every
+// member.
+template<typename JsonType>
+static void benchObjects(const char* name)
+{
+    typedef typename JsonType::Value Value;
+
+    static const int Rounds = 20;
+    static const int WideCount = 20000;
+
+    std::string small = makeConfig(2000);
+    std::string wide = makeWide(WideCount);
+
+    Value value;
+    size_t bytes = allocBytes;
+    JsonType::decode(small.c_str(), value);
+    size_t smallBytes = allocBytes - bytes;
+
+    clock_t start = clock();
+    for (int round = 0; round < Rounds; ++round)
+    {
+        JsonType::decode(small.c_str(), value);
+    }
+    double smallDecode = elapsed(start);
+
+    char key[32];
+    int64_t sum = 0;
+
+    start = clock();
+    for (int round = 0; round < Rounds * 10; ++round)
+    {
+        for (int index = 0; index < 2000; ++index)
+        {
+            snprintf(key, sizeof(key), "service%d", index);
+            const Value& service = *value.get(key);
+            sum += service.get("port")->getNumber();
+            sum += service.get("labels")->getSize();
+        }
+    }
+    double smallFind = elapsed(start);
+
+    start = clock();
+    for (int round = 0; round < Rounds; ++round)
+    {
+        JsonType::decode(wide.c_str(), value);
+    }
+    double wideDecode = elapsed(start);
+
+    start = clock();
+    for (int round = 0; round < Rounds; ++round)
+    {
+        for (int index = 0; index < WideCount; ++index)
+        {
+            snprintf(key, sizeof(key), "member%d", index);
+            sum += value.get(key)->getNumber();
+        }
+    }
+    double wideFind = elapsed(start);
+
+    printf("%-8s small %8u bytes %7.1f ms decode %7.1f ms find, "
+        "wide %7.1f ms decode %7.1f ms find (%d)\n",
+        name, (unsigned)smallBytes, smallDecode, smallFind,
+        wideDecode, wideFind, (int)(sum & 1));
+}
+
+template<typename JsonType>
+static void benchLayoutMemory(const char* name, const std::string& jsonStr)
+{
+    typedef typename JsonType::Value Value;
+
+    size_t bytes = allocBytes;
+    size_t count = allocCount;
+
+    Value* value = new Value;
+    JsonType::decode(jsonStr.c_str(), *value);
+
+    printf("%-8s %10u bytes %8u allocs\n", name,
+        (unsigned)(allocBytes - bytes), (unsigned)(allocCount - count));
+
+    delete value;
+}
+
+// Reads three members of every record, by name and by Key.
+template<typename JsonType>
+static void benchKeys(const char* name)
+{
+    typedef typename JsonType::Value Value;
+    typedef typename JsonType::Key Key;
+
+    static const int Rounds = 100;
+
+    std::string records = makeRecords(10000);
+    Value value;
+    JsonType::decode(records.c_str(), value);
+
+    int64_t sum = 0;
+    clock_t start = clock();
+    for (int round = 0; round < Rounds; ++round)
+    {
+        for (size_t index = 0; index < value.getSize(); ++index)
+        {
+            const Value& record = value.getArray()[index];
+            sum += record.get("id")->getNumber();
+            sum += record.get("enabled")->getBoolean();
+            sum += record.get("description")->isString();
+        }
+    }
+    double byName = elapsed(start);
+
+    Key id("id");
+    Key enabled("enabled");
+    Key description("description");
+
+    start = clock();
+    for (int round = 0; round < Rounds; ++round)
+    {
+        for (size_t index = 0; index < value.getSize(); ++index)
+        {
+            const Value& record = value.getArray()[index];
+            sum += record.get(id)->getNumber();
+            sum += record.get(enabled)->getBoolean();
+            sum += record.get(description)->isString();
+        }
+    }
+    double byKey = elapsed(start);
+
+    printf("%-8s %7.1f ms by name %7.1f ms by key (%d)\n",
+        name, byName, byKey, (int)(sum & 1));
+}
+
+// Reading a member whose type does not match, with exceptions and
+// with getOr().
+static void benchProbe(const std::string& jsonStr)
+{
+    Json::Value value;
+    Json::decode(jsonStr, value);
+    const Json::Array& records = value.getArray();
+
+    int64_t sum = 0;
+    clock_t start = clock();
+    for (size_t index = 0; index < records.size(); ++index)
+    {
+        try
+        {
+            sum += records[index].get("status")->getNumber();
+        }
+        catch (const Json::TypeMismatchException&)
+        {
+            sum += 1;
+        }
+    }
+    double withThrow = elapsed(start);
+
+    start = clock();
+    for (size_t index = 0; index < records.size(); ++index)
+    {
+        sum += records[index].get("status")->getOr(1);
+    }
+    double withGetOr = elapsed(start);
+
+    printf("probe    %7.1f ms throw %7.1f ms getOr (%d)\n",
+        withThrow, withGetOr, (int)(sum & 1));
+}
+
+// Columns from a decoded Value and straight from the parser.
+static void benchColumns(const std::string& jsonStr)
+{
+    static const int Rounds = 10;
+
+    clock_t start = clock();
+    for (int round = 0; round < Rounds; ++round)
+    {
+        Json::Value value;
+        Json::decode(jsonStr, value);
+        Json::Columns columns;
+        columns.addRows(value);
+    }
+    double fromValue = elapsed(start);
+
+    size_t bytes = allocBytes;
+    size_t peak = 0;
+
+    start = clock();
+    for (int round = 0; round < Rounds; ++round)
+    {
+        Json::Columns columns;
+        Json::decode(jsonStr, columns);
+        peak = allocBytes - bytes;
+    }
+    double fromParser = elapsed(start);
+
+    printf("columns  %7.1f ms from value %7.1f ms from parser "
+        "(%u bytes)\n", fromValue, fromParser, (unsigned)peak);
+}
+
+static void benchCompare(const std::string& jsonStr)
+{
+    Json::Value value;
+    Json::decode(jsonStr, value);
+
+    Json::Value reversed = value;
+    Json::Array& arr = reversed.getArray();
+    std::reverse(arr.begin(), arr.end());
+
+    clock_t start = clock();
+    bool ordered = (value.compare(value, false) == 0);
+    double orderedTime = elapsed(start);
+
+    start = clock();
+    bool unordered = (value.compare(reversed) == 0);
+    double unorderedTime = elapsed(start);
+
+    printf("compare  %7.1f ms ordered %7.1f ms unordered (%d)\n",
+        orderedTime, unorderedTime, (int)(ordered && unordered));
+
+    size_t allocs = allocTotal;
+    start = clock();
+    Json::Value decoded;
+    Json::decode(jsonStr, decoded);
+    bool viaValue = (value.compare(decoded) == 0);
+    double viaValueTime = elapsed(start);
+    size_t viaValueAllocs = allocTotal - allocs;
+
+    allocs = allocTotal;
+    start = clock();
+    bool streamed = Json::equal(value, jsonStr);
+    double streamedTime = elapsed(start);
+    size_t streamedAllocs = allocTotal - allocs;
+
+    printf("equal    %7.1f ms decoded %7.1f ms streamed  "
+        "(%d, %u / %u allocs)\n",
+        viaValueTime, streamedTime, (int)(viaValue && streamed),
+        (unsigned)viaValueAllocs, (unsigned)streamedAllocs);
+
+    // Shared values compute their hashes once.
+    Json::Value changed = reversed;
+    changed.getArray()[0]["id"] = -1;
+    value.makeShared();
+    changed.makeShared();
+
+    start = clock();
+    bool first = (value.compare(changed) == 0);
+    double firstTime = elapsed(start);
+
+    start = clock();
+    bool again = (value.compare(changed) == 0);
+    double againTime = elapsed(start);
+
+    printf("shared   %7.1f ms first   %7.1f ms again     (%d)\n",
+        firstTime, againTime, (int)(first || again));
+}
+
+static void benchDiff(const std::string& jsonStr)
+{
+    Json::Value source;
+    Json::decode(jsonStr, source);
+
+    Json::Value target = source;
+    Json::Array& arr = target.getArray();
+    for (size_t index = 0; index < arr.size(); index += 1000)
+    {
+        arr[index]["status"] = "changed";
+    }
+    arr.erase(arr.begin() + arr.size() / 3);
+    arr.insert(arr.begin() + arr.size() / 2, arr.front());
+
+    clock_t start = clock();
+    Json::Value patch;
+    Json::diff(source, target, patch);
+    double diffTime = elapsed(start);
+
+    std::string patchStr;
+    Json::encode(patch, patchStr);
+
+    printf("diff     %7.1f ms %u ops, %u bytes of %u\n",
+        diffTime, (unsigned)patch.getSize(), (unsigned)patchStr.size(),
+        (unsigned)jsonStr.size());
+}
+
+// The same lookups through operator[] and through a Pointer.
+static void benchPointer(const std::string& jsonStr)
+{
+    static const int Rounds = 10;
+
+    Json::Value value;
+    Json::decode(jsonStr, value);
+
+    char path[64];
+    int64_t sum = 0;
+    size_t allocs = allocTotal;
+    clock_t start = clock();
+    for (int round = 0; round < Rounds; ++round)
+    {
+        for (size_t index = 0; index < value.getSize(); ++index)
+        {
+            sum += value[index]["tags"][(size_t)1].getSize();
+        }
+    }
+    double chainedTime = elapsed(start);
+    size_t chainedAllocs = allocTotal - allocs;
+
+    std::vector<Json::Pointer> pointers;
+    for (size_t index = 0; index < value.getSize(); ++index)
+    {
+        snprintf(path, sizeof(path), "/%u/tags/1", (unsigned)index);
+        pointers.push_back(Json::Pointer(path));
+    }
+
+    const Json::Value& constValue = value;
+    allocs = allocTotal;
+    start = clock();
+    for (int round = 0; round < Rounds; ++round)
+    {
+        for (size_t index = 0; index < pointers.size(); ++index)
+        {
+            sum += pointers[index].get(constValue)->getSize();
+        }
+    }
+    double pointerTime = elapsed(start);
+    size_t pointerAllocs = allocTotal - allocs;
+
+    printf("chained  %7.1f ms %u allocs, pointer %7.1f ms %u allocs (%d)\n",
+        chainedTime, (unsigned)chainedAllocs, pointerTime,
+        (unsigned)pointerAllocs, (int)(sum & 1));
+}
+
+// Every "description" through findRecursive(), which copies them,
+// through a Path, then a filter, then findRecursive() with pointers.
+static void benchPath(const std::string& jsonStr)
+{
+    Json::Value records;
+    Json::decode(jsonStr, records);
+
+    Json::Value value;
+    value["records"] = records;
+
+    size_t allocs = allocTotal;
+    clock_t start = clock();
+    std::vector<Json::Value> copies;
+    value.findRecursive("description", copies);
+    double recursiveTime = elapsed(start);
+    size_t recursiveAllocs = allocTotal - allocs;
+
+    const Json::Value& constValue = value;
+    Json::Path path("$..description");
+    std::vector<const Json::Value*> results;
+    results.reserve(copies.size());
+    allocs = allocTotal;
+    start = clock();
+    path.find(constValue, results);
+    double pathTime = elapsed(start);
+    size_t pathAllocs = allocTotal - allocs;
+
+    Json::Path filter("$.records[?@.status == 'active' && @.score > 50].id");
+    results.clear();
+    start = clock();
+    filter.find(constValue, results);
+    double filterTime = elapsed(start);
+
+    printf("path     %7.1f ms %u allocs findRecursive, "
+        "%7.1f ms %u allocs path, %7.1f ms filter (%u)\n",
+        recursiveTime, (unsigned)recursiveAllocs, pathTime,
+        (unsigned)pathAllocs, filterTime, (unsigned)results.size());
+
+    results.clear();
+    allocs = allocTotal;
+    start = clock();
+    constValue.findRecursive("description", results);
+    double pointersTime = elapsed(start);
+    size_t pointersAllocs = allocTotal - allocs;
+
+    start = clock();
+    const Json::Value* first = constValue.findFirstRecursive("description");
+    double firstTime = elapsed(start);
+
+    printf("find     %7.1f ms %u allocs pointers, %7.1f ms first (%d)\n",
+        pointersTime, (unsigned)pointersAllocs, firstTime,
+        (int)(first != NULL));
+}
+
+// Repeated lookups by scanning and through an Index.
+static void benchIndex(const std::string& jsonStr)
+{
+    static const int Rounds = 100;
+
+    Json::Value value;
+    Json::decode(jsonStr, value);
+
+    size_t found = 0;
+    std::vector<const Json::Value*> results;
+    clock_t start = clock();
+    for (int round = 0; round < Rounds; ++round)
+    {
+        results.clear();
+        static_cast<const Json::Value&>(value).findRecursive("id", results);
+        found += results.size();
+    }
+    double scanTime = elapsed(start);
+
+    start = clock();
+    Json::Index index(value, true);
+    double buildTime = elapsed(start);
+
+    start = clock();
+    for (int round = 0; round < Rounds; ++round)
+    {
+        results.clear();
+        found += index.find("id", Json::Value(round), results);
+    }
+    double lookupTime = elapsed(start);
+
+    printf("index    %7.1f ms scans, %7.1f ms build, "
+        "%7.1f ms lookups (%u)\n",
+        scanTime, buildTime, lookupTime, (unsigned)found);
+}
+
+// Records looked up by id with a scan and through a FieldIndex.
+static void benchFieldIndex(const std::string& jsonStr)
+{
+    Json::Value value;
+    Json::decode(jsonStr, value);
+    const Json::Array& arr = value.getArray();
+
+    static const int Lookups = 1000;
+
+    size_t found = 0;
+    clock_t start = clock();
+    for (int round = 0; round < Lookups; ++round)
+    {
+        Json::Value id(static_cast<int64_t>((round * 7919) % arr.size()));
+        for (size_t index = 0; index < arr.size(); ++index)
+        {
+            if (arr[index].get("id")->compare(id) == 0)
+            {
+                ++found;
+                break;
+            }
+        }
+    }
+    double scanTime = elapsed(start);
+
+    start = clock();
+    Json::FieldIndex ids(value, "id");
+    double buildTime = elapsed(start);
+
+    start = clock();
+    for (int round = 0; round < Lookups; ++round)
+    {
+        found += (ids.find(static_cast<int64_t>(
+            (round * 7919) % arr.size())) != NULL);
+    }
+    double lookupTime = elapsed(start);
+
+    printf("field    %7.1f ms scans, %7.1f ms build, "
+        "%7.3f ms lookups (%u)\n",
+        scanTime, buildTime, lookupTime, (unsigned)found);
+}
+
+int main(int, char**)
+{
+    printf("sizeof(Json::Value) = %u\n\n", (unsigned)sizeof(Json::Value));
+
+    benchMemory("records", makeRecords(10000));
+    benchMemory("config", makeConfig(2000));
+    benchMemory("numbers", makeNumbers(100000));
+    benchMemory("numbers", makeNumbers(100000), true);
+
+    printf("\n");
+
+    benchDocument("records", makeRecords(10000));
+    benchDocument("config", makeConfig(2000));
+    benchDocument("numbers", makeNumbers(100000));
+    benchDocument("records", makeRecords(10000), true);
+    benchDocument("numbers", makeNumbers(100000), true);
+
+    printf("\n");
+
+    benchCopy("records", makeRecords(10000), false);
+    benchCopy("records", makeRecords(10000), true);
+
+    printf("\n");
+
+    benchObjects<Json>("map");
+    benchObjects<sortedJson>("sorted");
+    benchObjects<hashJson>("hash");
+    benchObjects<orderedJson>("ordered");
+    benchObjects<shapeJson>("shape");
+
+    printf("\n");
+
+    benchKeys<Json>("map");
+    benchKeys<sortedJson>("sorted");
+    benchKeys<hashJson>("hash");
+    benchKeys<orderedJson>("ordered");
+    benchKeys<shapeJson>("shape");
+
+    printf("\n");
+
+    std::string records = makeRecords(10000);
+    benchLayoutMemory<Json>("map", records);
+    benchLayoutMemory<sortedJson>("sorted", records);
+    benchLayoutMemory<hashJson>("hash", records);
+    benchLayoutMemory<orderedJson>("ordered", records);
+    benchLayoutMemory<shapeJson>("shape", records);
+
+    printf("\n");
+
+    benchColumns(records);
+    benchProbe(records);
+    benchCompare(records);
+    benchDiff(records);
+    benchPointer(records);
+    benchPath(records);
+    benchIndex(records);
+    benchFieldIndex(records);
+
+    return 0;
+}
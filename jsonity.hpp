@@ -5,8 +5,12 @@
 // Include them before this file.
 
 #include <map>
+#include <set>
 #include <vector>
 #include <sstream>
+#include <algorithm>
+#include <new>
+#include <cstring>
 
 //---------------------------------------------------------------------------//
 // Platform
@@ -23,8 +27,31 @@
 #define JSONITY_SUPPORT_CXX_11
 #endif
 
+#if defined(JSONITY_SUPPORT_CXX_11) && \
+    ((__cplusplus >= 201402L) || \
+     (defined(_MSVC_LANG) && (_MSVC_LANG >= 201402L)))
+#define JSONITY_SUPPORT_CXX_14
+#endif
+
+#if defined(JSONITY_SUPPORT_CXX_11) && \
+    ((__cplusplus >= 201703L) || \
+     (defined(_MSVC_LANG) && (_MSVC_LANG >= 201703L)))
+#define JSONITY_SUPPORT_CXX_17
+#include <string_view>
+#include <optional>
+#endif
+
+#if defined(JSONITY_SUPPORT_CXX_17) && defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define JSONITY_SUPPORT_PMR
+#endif
+#endif
+
 #ifdef JSONITY_SUPPORT_CXX_11
 #include <cstdint>
+#include <atomic>
+#include <tuple>
 #else
 typedef int int32_t;
 typedef unsigned int uint32_t;
@@ -58,6 +85,12 @@ typedef uint32_t char32_t;
 #define JSONITY_ASSERT
 #endif
 
+#ifdef JSONITY_SUPPORT_CXX_11
+#define JSONITY_NOEXCEPT noexcept
+#else
+#define JSONITY_NOEXCEPT
+#endif
+
 #define JSONITY_CHAR(ch) (static_cast<char_t>(ch))
 
 #define JSONITY_THROW_TYPE_MISMATCH() \
@@ -66,6 +99,32 @@ typedef uint32_t char32_t;
 #define JSONITY_TYPE_CHECK(exp) \
     { if (!(exp)) JSONITY_THROW_TYPE_MISMATCH(); }
 
+#ifdef JSONITY_SUPPORT_CXX_11
+#define JSONITY_VALUE_IMPL_STL_CONTAINER_MOVE(type) \
+    template<typename ValueType> \
+    Value(type<ValueType>&& container) \
+        {   moveArray(container);    } \
+    template<typename ValueType> \
+    void setArray(type<ValueType>&& container) \
+        {   destroy(); moveArray(container);   } \
+    template<typename ValueType> \
+    Value& operator=(type<ValueType>&& container) \
+        {   setArray(std::move(container)); return *this;  }
+#define JSONITY_VALUE_IMPL_STL_CONTAINER_FIXED_SIZE_MOVE(type) \
+    template<typename ValueType, size_t Size> \
+    Value(type<ValueType, Size>&& container) \
+        {   moveArray(container);    } \
+    template<typename ValueType, size_t Size> \
+    void setArray(type<ValueType, Size>&& container) \
+        {   destroy(); moveArray(container);   } \
+    template<typename ValueType, size_t Size> \
+    Value& operator=(type<ValueType, Size>&& container) \
+        {   setArray(std::move(container)); return *this;  }
+#else
+#define JSONITY_VALUE_IMPL_STL_CONTAINER_MOVE(type)
+#define JSONITY_VALUE_IMPL_STL_CONTAINER_FIXED_SIZE_MOVE(type)
+#endif
+
 #define JSONITY_VALUE_IMPL_STL_CONTAINER(type) \
     template<typename ValueType> \
     Value(const type<ValueType>& container) \
@@ -75,7 +134,8 @@ typedef uint32_t char32_t;
         {   destroy(); assignArray(container);   } \
     template<typename ValueType> \
     Value& operator=(const type<ValueType>& container) \
-        {   setArray(container); return *this;  }
+        {   setArray(container); return *this;  } \
+    JSONITY_VALUE_IMPL_STL_CONTAINER_MOVE(type)
 
 #define JSONITY_VALUE_IMPL_STL_CONTAINER_FIXED_SIZE(type) \
     template<typename ValueType, size_t Size> \
@@ -86,7 +146,8 @@ typedef uint32_t char32_t;
         {   destroy(); assignArray(container);   } \
     template<typename ValueType, size_t Size> \
     Value& operator=(const type<ValueType, Size>& container) \
-        {   setArray(container); return *this;  }
+        {   setArray(container); return *this;  } \
+    JSONITY_VALUE_IMPL_STL_CONTAINER_FIXED_SIZE_MOVE(type)
 
 #define JSONITY_VALUE_OPERATOR_IOSTREAM(JsonType) \
     inline JsonType::IStream& operator>>( \
@@ -112,3557 +173,12021 @@ typedef uint32_t char32_t;
 namespace jsonity {
 
 //---------------------------------------------------------------------------//
-// JsonBase
+// MemoryResource
 //---------------------------------------------------------------------------//
 
-template<typename CharType,
-         typename CharTraitsType = std::char_traits<CharType>,
-         typename CharAllocatorType = std::allocator<CharType> >
-class JsonBase
+#ifdef JSONITY_SUPPORT_PMR
+
+typedef std::pmr::memory_resource MemoryResource;
+
+#else
+
+// Same interface as std::pmr::memory_resource.
+
+class MemoryResource
 {
 public:
-    template<typename UserValueType> class UserValue;
-    class Value;
-    class Cursor;
-    class Error;
-    class Exception;
-    class TypeMismatchException;
-    class EncodeStyle;
-    class EncodeContext;
+    static const size_t MaxAlignment = 16;
+
+    virtual ~MemoryResource() {}
 
 public:
+    void* allocate(size_t bytes, size_t alignment = MaxAlignment)
+    {
+        return do_allocate(bytes, alignment);
+    }
 
-    // basic char
-    typedef CharType char_t;
+    void deallocate(void* ptr, size_t bytes,
+                    size_t alignment = MaxAlignment)
+    {
+        do_deallocate(ptr, bytes, alignment);
+    }
 
-    // String
-    typedef std::basic_string<
-        CharType, CharTraitsType, CharAllocatorType> String;
+    bool is_equal(const MemoryResource& other) const JSONITY_NOEXCEPT
+    {
+        return do_is_equal(other);
+    }
 
-    // Array
-    typedef std::vector<Value> Array;
+private:
+    virtual void* do_allocate(size_t bytes, size_t alignment) = 0;
+    virtual void do_deallocate(void* ptr, size_t bytes,
+                               size_t alignment) = 0;
+    virtual bool do_is_equal(
+        const MemoryResource& other) const JSONITY_NOEXCEPT = 0;
+};
 
-    // Object
-    typedef std::map<String, Value> Object;
+#endif
 
-    // Stream
-    typedef std::basic_istream<
-        CharType, CharTraitsType > IStream;
-    typedef std::basic_ostream<
-        CharType, CharTraitsType > OStream;
-    typedef std::basic_istringstream<
-        CharType, CharTraitsType,
-        CharAllocatorType > IStringStream;
-    typedef std::basic_ostringstream<
-        CharType, CharTraitsType,
-        CharAllocatorType > OStringStream;
+// Tells whether an allocator type can be created from a MemoryResource,
+// and which allocator the containers of a JsonBase use.
 
-private:
+template<typename AllocatorType>
+struct ResourceAllocator
+{
+    static const bool IsResourceAware = false;
 
-    class UserValueBase
+    static AllocatorType create(MemoryResource*)
     {
-    public:
-        virtual ~UserValueBase() {}
+        return AllocatorType();
+    }
 
-    protected:
-        UserValueBase() {}
+    template<typename T, typename DefaultAllocatorType>
+    struct Rebind
+    {
+        typedef DefaultAllocatorType Type;
+    };
+};
 
-    private:
-        virtual UserValueBase* duplicate() const = 0;
-        virtual void encode(EncodeContext& ctx) const = 0;
+#ifdef JSONITY_SUPPORT_PMR
+template<typename CharType>
+struct ResourceAllocator<std::pmr::polymorphic_allocator<CharType> >
+{
+    static const bool IsResourceAware = true;
 
-        friend class Value;
+    static std::pmr::polymorphic_allocator<CharType> create(
+        MemoryResource* resource)
+    {
+        return std::pmr::polymorphic_allocator<CharType>(resource);
+    }
+
+    template<typename T, typename DefaultAllocatorType>
+    struct Rebind
+    {
+        typedef std::pmr::polymorphic_allocator<T> Type;
     };
+};
+#endif
+
+//---------------------------------------------------------------------------//
+// BasicStringRef
+//---------------------------------------------------------------------------//
 
+// Pointer and length of a name to look up, so that looking up a literal
+// or a part of a buffer needs no String.
+
+template<typename CharType, typename CharTraitsType>
+class BasicStringRef
+{
 public:
+    BasicStringRef()
+        : str_(NULL), size_(0)
+    {
+    }
 
-    //-----------------------------------------------------------------------//
-    // JsonBase::UserValue
-    //-----------------------------------------------------------------------//
+    BasicStringRef(const CharType* str)
+        : str_(str), size_(CharTraitsType::length(str))
+    {
+    }
 
-    template<typename UserValueType>
-    class UserValue : public UserValueBase
+    BasicStringRef(const CharType* str, size_t size)
+        : str_(str), size_(size)
     {
-    public:
-        virtual ~UserValue() {}
+    }
 
-    protected:
-        UserValue() {}
+    template<typename AllocatorType>
+    BasicStringRef(const std::basic_string<
+        CharType, CharTraitsType, AllocatorType>& str)
+        : str_(str.data()), size_(str.size())
+    {
+    }
 
-        // Encode
-        virtual void encode(EncodeContext& ctx) const = 0;
+#ifdef JSONITY_SUPPORT_CXX_17
+    BasicStringRef(std::basic_string_view<CharType, CharTraitsType> str)
+        : str_(str.data()), size_(str.size())
+    {
+    }
+#endif
 
-    private:
-        UserValueBase* duplicate() const
-        {
-            return new UserValueType(
-                (const UserValueType&)*this);
-        }
-    };
+public:
 
-    //-----------------------------------------------------------------------//
-    // JsonBase::Value
-    //-----------------------------------------------------------------------//
+    const CharType* data() const
+    {
+        return str_;
+    }
 
-    class Value
+    size_t size() const
     {
-    public:
-        typedef char Type;
-        static const Type NullType = 0;
-        static const Type NumberType = 1; 
-        static const Type StringType = 2; 
-        static const Type BooleanType = 3;
-        static const Type RealType = 4; 
-        static const Type ArrayType = 5;
-        static const Type ObjectType = 6;
-        static const Type UserType = 7;
-        static const Type UserPtrType = 8;
+        return size_;
+    }
 
-        Value()
+    // Same order as std::basic_string::compare.
+    int compare(const BasicStringRef& other) const
+    {
+        int result = CharTraitsType::compare(
+            str_, other.str_, (size_ < other.size_) ? size_ : other.size_);
+
+        if (result != 0)
         {
-            assignNull();
+            return result;
         }
-
-        Value(int32_t number)
+        else if (size_ < other.size_)
         {
-            assignNumber(number);
+            return -1;
         }
-
-        Value(int64_t number)
+        else if (size_ > other.size_)
         {
-            assignNumber(number);
+            return 1;
         }
 
-        Value(const char_t* str)
+        return 0;
+    }
+
+    // FNV-1a
+    size_t hash() const
+    {
+        uint32_t hash = 2166136261U;
+        for (size_t index = 0; index < size_; ++index)
         {
-            assignString(str);
+            hash ^= static_cast<uint32_t>(str_[index]);
+            hash *= 16777619U;
         }
+        return hash;
+    }
 
-        Value(const String& str)
+    template<typename AllocatorType>
+    operator std::basic_string<CharType, CharTraitsType, AllocatorType>()
+        const
+    {
+        return std::basic_string<CharType, CharTraitsType, AllocatorType>(
+            str_, size_);
+    }
+
+    friend bool operator==(const BasicStringRef& lhs,
+                           const BasicStringRef& rhs)
+    {
+        return ((lhs.size_ == rhs.size_) &&
+                (CharTraitsType::compare(lhs.str_, rhs.str_, lhs.size_) == 0));
+    }
+
+    friend bool operator!=(const BasicStringRef& lhs,
+                           const BasicStringRef& rhs)
+    {
+        return !(lhs == rhs);
+    }
+
+    friend bool operator<(const BasicStringRef& lhs,
+                          const BasicStringRef& rhs)
+    {
+        return (lhs.compare(rhs) < 0);
+    }
+
+private:
+    const CharType* str_;
+    size_t size_;
+};
+
+// Transparent comparator for object names, std::map looks up a
+// BasicStringRef without converting it from C++14.
+
+template<typename CharType, typename CharTraitsType>
+struct BasicNameLess
+{
+    typedef void is_transparent;
+
+    bool operator()(const BasicStringRef<CharType, CharTraitsType>& lhs,
+                    const BasicStringRef<CharType, CharTraitsType>& rhs) const
+    {
+        return (lhs.compare(rhs) < 0);
+    }
+};
+
+//---------------------------------------------------------------------------//
+// Object layouts
+//---------------------------------------------------------------------------//
+
+template<typename AllocatorType, typename T>
+struct RebindAllocator
+{
+#ifdef JSONITY_SUPPORT_CXX_11
+    typedef typename std::allocator_traits<AllocatorType>::
+        template rebind_alloc<T> Type;
+#else
+    typedef typename AllocatorType::template rebind<T>::other Type;
+#endif
+};
+
+// The part of the std::map interface used by JsonBase, over a vector
+// kept sorted by key. Lookups are binary searches and iteration walks
+// contiguous memory.
+
+template<typename KeyType, typename MappedType, typename CompareType,
+         typename AllocatorType>
+class SortedVectorMap
+{
+public:
+    typedef KeyType key_type;
+    typedef MappedType mapped_type;
+    typedef std::pair<KeyType, MappedType> value_type;
+    typedef CompareType key_compare;
+    typedef AllocatorType allocator_type;
+
+private:
+    typedef std::vector<value_type,
+        typename RebindAllocator<AllocatorType, value_type>::Type> Entries;
+    typedef BasicStringRef<typename KeyType::value_type,
+        typename KeyType::traits_type> KeyRef;
+
+public:
+    typedef typename Entries::iterator iterator;
+    typedef typename Entries::const_iterator const_iterator;
+    typedef typename Entries::size_type size_type;
+    typedef typename Entries::difference_type difference_type;
+    typedef value_type& reference;
+    typedef const value_type& const_reference;
+
+    explicit SortedVectorMap(const key_compare& = key_compare(),
+                             const allocator_type& alloc = allocator_type())
+        : entries_(typename Entries::allocator_type(alloc))
+    {
+    }
+
+    template<typename IteratorType>
+    SortedVectorMap(IteratorType first, IteratorType last)
+    {
+        insert(first, last);
+    }
+
+public:
+
+    iterator begin() { return entries_.begin(); }
+    const_iterator begin() const { return entries_.begin(); }
+    iterator end() { return entries_.end(); }
+    const_iterator end() const { return entries_.end(); }
+
+    bool empty() const { return entries_.empty(); }
+    size_type size() const { return entries_.size(); }
+    size_type max_size() const { return entries_.max_size(); }
+
+    void clear()
+    {
+        entries_.clear();
+    }
+
+    template<typename NameType>
+    iterator find(const NameType& name)
+    {
+        KeyRef key(name);
+        iterator it = lowerBound(key);
+        return (((it != end()) && (KeyRef(it->first) == key)) ? it : end());
+    }
+
+    // Looks up the hint position first. The hash is not used, it is
+    // there to match InsertionOrderMap.
+    iterator find(const KeyRef& key, size_t, size_t& hint)
+    {
+        if ((hint < entries_.size()) && (KeyRef(entries_[hint].first) == key))
         {
-            assignString(str.c_str(), str.size());
+            return (entries_.begin() + hint);
         }
 
-        Value(bool boolean)
+        iterator it = find(key);
+        if (it != end())
         {
-            assignBoolean(boolean);
+            hint = static_cast<size_t>(it - entries_.begin());
         }
+        return it;
+    }
 
-        Value(double real)
+    template<typename NameType>
+    const_iterator find(const NameType& name) const
+    {
+        return const_cast<SortedVectorMap*>(this)->find(name);
+    }
+
+    template<typename NameType>
+    size_type count(const NameType& name) const
+    {
+        return ((find(name) != end()) ? 1 : 0);
+    }
+
+    mapped_type& operator[](const key_type& key)
+    {
+        iterator it = lowerBound(key);
+        if ((it == end()) || (KeyRef(it->first) != KeyRef(key)))
         {
-            assignReal(real);
+            it = entries_.insert(it, value_type(key, mapped_type()));
         }
+        return it->second;
+    }
 
-        template<typename KeyType, typename ValueType>
-        Value(const std::map<KeyType, ValueType>& map)
+    std::pair<iterator, bool> insert(const value_type& value)
+    {
+        iterator it = lowerBound(value.first);
+        if ((it != end()) && (KeyRef(it->first) == KeyRef(value.first)))
         {
-            assignObject(map);
+            return std::make_pair(it, false);
         }
+        return std::make_pair(entries_.insert(it, value), true);
+    }
 
-        Value(const UserValueBase& userValue)
+#ifdef JSONITY_SUPPORT_CXX_11
+    mapped_type& operator[](key_type&& key)
+    {
+        iterator it = lowerBound(key);
+        if ((it == end()) || (KeyRef(it->first) != KeyRef(key)))
         {
-            assignUserValue(userValue);
+            it = entries_.insert(
+                it, value_type(std::move(key), mapped_type()));
         }
+        return it->second;
+    }
 
-        Value(UserValueBase* userValue)
+    std::pair<iterator, bool> insert(value_type&& value)
+    {
+        iterator it = lowerBound(value.first);
+        if ((it != end()) && (KeyRef(it->first) == KeyRef(value.first)))
         {
-            assignUserValuePtr(userValue);
+            return std::make_pair(it, false);
         }
+        return std::make_pair(entries_.insert(it, std::move(value)), true);
+    }
+#endif
 
-        Value(const Value& other)
+    // Appending in key order, as when copying another object,
+    // needs no search.
+    iterator insert(iterator hint, const value_type& value)
+    {
+        if ((hint == end()) &&
+            (empty() || (KeyRef(entries_.back().first) < value.first)))
         {
-            type_ = NullType;
-            assignValue(other);
+            entries_.push_back(value);
+            return (entries_.end() - 1);
         }
+        return insert(value).first;
+    }
 
-#ifdef JSONITY_SUPPORT_CXX_11
-        Value(Value&& other)
+    template<typename IteratorType>
+    void insert(IteratorType first, IteratorType last)
+    {
+        for (; first != last; ++first)
         {
-            type_ = NullType;
-            move(std::move(other));
+            insert(end(), value_type(first->first, first->second));
         }
-#endif
+    }
 
-        ~Value()
+    iterator erase(iterator it)
+    {
+        return entries_.erase(it);
+    }
+
+    template<typename NameType>
+    size_type erase(const NameType& name)
+    {
+        iterator it = find(name);
+        if (it == end())
         {
-            destroy();
+            return 0;
         }
+        entries_.erase(it);
+        return 1;
+    }
 
-        void destroy()
-        {
-            if (isString())
-            {
-                delete data_.str_;
-                data_.str_ = NULL;
-            }
-            else if (isArray())
-            {
-                delete data_.arr_;
-                data_.arr_ = NULL;
-            }
-            else if (isObject())
-            {
-                delete data_.obj_;
-                data_.obj_ = NULL;
-            }
-            else if (isUserValue())
-            {
-                delete data_.user_;
-                data_.user_ = NULL;
-            }
+    void swap(SortedVectorMap& other)
+    {
+        entries_.swap(other.entries_);
+    }
 
-            type_ = NullType;
-        }
+    // For unordered input, push_back() everything then sort() once.
 
-    public:
+    void push_back(const value_type& value)
+    {
+        entries_.push_back(value);
+    }
 
-        JSONITY_VALUE_IMPL_STL_CONTAINER(std::vector);
-#if defined(_LIST_) || defined(_GLIBCXX_LIST) || defined(_LIBCPP_LIST)
-        JSONITY_VALUE_IMPL_STL_CONTAINER(std::list);
-#endif
-#if defined(_DEQUE_) || defined(_GLIBCXX_DEQUE) || defined(_LIBCPP_DEQUE)
-        JSONITY_VALUE_IMPL_STL_CONTAINER(std::deque);
-#endif
-#if defined(_SET_) || defined(_GLIBCXX_SET) || defined(_LIBCPP_SET)
-        JSONITY_VALUE_IMPL_STL_CONTAINER(std::set);
-        JSONITY_VALUE_IMPL_STL_CONTAINER(std::multiset);
-#endif
-#if defined(_ARRAY_) || defined(_GLIBCXX_ARRAY) || defined(_LIBCPP_ARRAY)
-        JSONITY_VALUE_IMPL_STL_CONTAINER_FIXED_SIZE(std::array);
-#endif
-#if defined(_FORWARD_LIST_) || defined(_GLIBCXX_FORWARD_LIST) || \
-    defined(_LIBCPP_FORWARD_LIST)
-        JSONITY_VALUE_IMPL_STL_CONTAINER(std::forward_list);
-#endif
-#if defined(_UNORDERED_SET_) || defined(_GLIBCXX_UNORDERED_SET) || \
-    defined(_LIBCPP_UNORDERED_SET)
-        JSONITY_VALUE_IMPL_STL_CONTAINER(std::unordered_set);
-        JSONITY_VALUE_IMPL_STL_CONTAINER(std::unordered_multiset);
+#ifdef JSONITY_SUPPORT_CXX_11
+    void push_back(value_type&& value)
+    {
+        entries_.push_back(std::move(value));
+    }
 #endif
 
-    public:
+    // Keeps the first of equal keys, returns false if there were any.
+    bool sort()
+    {
+        size_type index = 1;
+        while ((index < entries_.size()) &&
+               (KeyRef(entries_[index - 1].first) < entries_[index].first))
+        {
+            ++index;
+        }
 
-        // Type
+        if (index >= entries_.size())
+        {
+            return true;
+        }
 
-        Type getType() const
+        std::stable_sort(entries_.begin(), entries_.end(), EntryLess());
+        iterator it = std::unique(
+            entries_.begin(), entries_.end(), EntryEqual());
+
+        bool unique = (it == entries_.end());
+        entries_.erase(it, entries_.end());
+
+        return unique;
+    }
+
+    allocator_type get_allocator() const
+    {
+        return allocator_type(entries_.get_allocator());
+    }
+
+private:
+
+    struct KeyLess
+    {
+        bool operator()(const value_type& entry, const KeyRef& key) const
         {
-            return type_;
+            return (KeyRef(entry.first) < key);
         }
+    };
 
-        bool isNull() const
+    struct EntryLess
+    {
+        bool operator()(const value_type& lhs, const value_type& rhs) const
         {
-            return (getType() == NullType);
+            return (KeyRef(lhs.first) < rhs.first);
         }
+    };
 
-        bool isNumber() const
+    struct EntryEqual
+    {
+        bool operator()(const value_type& lhs, const value_type& rhs) const
         {
-            return (getType() == NumberType);
+            return (KeyRef(lhs.first) == rhs.first);
         }
+    };
 
-        bool isString() const
+    iterator lowerBound(const KeyRef& key)
+    {
+        return std::lower_bound(
+            entries_.begin(), entries_.end(), key, KeyLess());
+    }
+
+    Entries entries_;
+};
+
+// The part of the std::map interface used by JsonBase, over a vector
+// kept in insertion order. Objects wider than LinearSize get an open
+// addressing table of entry positions for O(1) lookups, smaller ones
+// compare the keys one by one. Without Indexed the table starts at a
+// larger size, so that small objects stay a plain vector.
+
+template<typename KeyType, typename MappedType, typename CompareType,
+         typename AllocatorType, bool Indexed>
+class InsertionOrderMap
+{
+public:
+    typedef KeyType key_type;
+    typedef MappedType mapped_type;
+    typedef std::pair<KeyType, MappedType> value_type;
+    typedef CompareType key_compare;
+    typedef AllocatorType allocator_type;
+
+private:
+    typedef std::vector<value_type,
+        typename RebindAllocator<AllocatorType, value_type>::Type> Entries;
+    typedef BasicStringRef<typename KeyType::value_type,
+        typename KeyType::traits_type> KeyRef;
+    typedef std::vector<uint32_t,
+        typename RebindAllocator<AllocatorType, uint32_t>::Type> Index;
+
+public:
+    typedef typename Entries::iterator iterator;
+    typedef typename Entries::const_iterator const_iterator;
+    typedef typename Entries::size_type size_type;
+    typedef typename Entries::difference_type difference_type;
+    typedef value_type& reference;
+    typedef const value_type& const_reference;
+
+    static const size_type LinearSize = (Indexed ? 8 : 32);
+
+    explicit InsertionOrderMap(const key_compare& = key_compare(),
+                               const allocator_type& alloc = allocator_type())
+        : entries_(typename Entries::allocator_type(alloc)),
+          index_(typename Index::allocator_type(alloc))
+    {
+    }
+
+    template<typename IteratorType>
+    InsertionOrderMap(IteratorType first, IteratorType last)
+    {
+        insert(first, last);
+    }
+
+public:
+
+    iterator begin() { return entries_.begin(); }
+    const_iterator begin() const { return entries_.begin(); }
+    iterator end() { return entries_.end(); }
+    const_iterator end() const { return entries_.end(); }
+
+    bool empty() const { return entries_.empty(); }
+    size_type size() const { return entries_.size(); }
+    size_type max_size() const { return entries_.max_size(); }
+
+    void clear()
+    {
+        entries_.clear();
+        index_.clear();
+    }
+
+    template<typename NameType>
+    iterator find(const NameType& name)
+    {
+        KeyRef key(name);
+        return find(key, index_.empty() ? 0 : key.hash());
+    }
+
+    // Looks up the hint position first, then the name by its
+    // precomputed hash. The hint is updated to where it was found.
+    iterator find(const KeyRef& key, size_t hash, size_t& hint)
+    {
+        if ((hint < entries_.size()) && (KeyRef(entries_[hint].first) == key))
         {
-            return (getType() == StringType);
+            return (entries_.begin() + hint);
         }
 
-        bool isBoolean() const
+        iterator it = find(key, hash);
+        if (it != end())
         {
-            return (getType() == BooleanType);
+            hint = static_cast<size_t>(it - entries_.begin());
         }
+        return it;
+    }
 
-        bool isReal() const
+    template<typename NameType>
+    const_iterator find(const NameType& name) const
+    {
+        return const_cast<InsertionOrderMap*>(this)->find(name);
+    }
+
+    template<typename NameType>
+    size_type count(const NameType& name) const
+    {
+        return ((find(name) != end()) ? 1 : 0);
+    }
+
+    mapped_type& operator[](const key_type& key)
+    {
+        iterator it = find(key);
+        if (it == end())
         {
-            return (getType() == RealType);
+            entries_.push_back(value_type(key, mapped_type()));
+            addIndex();
+            return entries_.back().second;
         }
+        return it->second;
+    }
 
-        bool isArray() const
+    std::pair<iterator, bool> insert(const value_type& value)
+    {
+        iterator it = find(value.first);
+        if (it != end())
         {
-            return (getType() == ArrayType);
+            return std::make_pair(it, false);
         }
+        entries_.push_back(value);
+        addIndex();
+        return std::make_pair(entries_.end() - 1, true);
+    }
 
-        bool isObject() const
+#ifdef JSONITY_SUPPORT_CXX_11
+    mapped_type& operator[](key_type&& key)
+    {
+        iterator it = find(key);
+        if (it == end())
         {
-            return (getType() == ObjectType);
+            entries_.push_back(value_type(std::move(key), mapped_type()));
+            addIndex();
+            return entries_.back().second;
         }
+        return it->second;
+    }
 
-        bool isUserValue() const
+    std::pair<iterator, bool> insert(value_type&& value)
+    {
+        iterator it = find(value.first);
+        if (it != end())
         {
-            return (getType() == UserType);
+            return std::make_pair(it, false);
         }
+        entries_.push_back(std::move(value));
+        addIndex();
+        return std::make_pair(entries_.end() - 1, true);
+    }
+#endif
 
-        bool isUserValuePtr() const
+    iterator insert(iterator, const value_type& value)
+    {
+        return insert(value).first;
+    }
+
+    template<typename IteratorType>
+    void insert(IteratorType first, IteratorType last)
+    {
+        for (; first != last; ++first)
         {
-            return (getType() == UserPtrType);
+            insert(value_type(first->first, first->second));
         }
+    }
 
-    public:
+    // Keeps the insertion order, so erasing is O(n).
+    iterator erase(iterator it)
+    {
+        size_t pos = static_cast<size_t>(it - entries_.begin());
+        if (entries_.size() <= (LinearSize + 1))
+        {
+            index_.clear();
+        }
+        else if (!index_.empty())
+        {
+            removeIndex(pos);
+        }
+        entries_.erase(it);
+        return (entries_.begin() + pos);
+    }
 
-        // Getter
+    template<typename NameType>
+    size_type erase(const NameType& name)
+    {
+        iterator it = find(name);
+        if (it == end())
+        {
+            return 0;
+        }
+        erase(it);
+        return 1;
+    }
 
-        int64_t getNumber() const
+    void swap(InsertionOrderMap& other)
+    {
+        entries_.swap(other.entries_);
+        index_.swap(other.index_);
+    }
+
+    allocator_type get_allocator() const
+    {
+        return allocator_type(entries_.get_allocator());
+    }
+
+private:
+
+    iterator find(const KeyRef& key, size_t hash)
+    {
+        if (index_.empty())
         {
-            if (isNumber())
-            {
-                return data_.n_;
-            }
-            else if (isReal())
+            for (iterator it = entries_.begin(); it != entries_.end(); ++it)
             {
-                return static_cast<int64_t>(data_.d_);
+                if (KeyRef(it->first) == key)
+                {
+                    return it;
+                }
             }
-            else if (isBoolean())
+            return end();
+        }
+
+        size_t mask = index_.size() - 1;
+        for (size_t pos = hash & mask;; pos = (pos + 1) & mask)
+        {
+            uint32_t slot = index_[pos];
+            if (slot == 0)
             {
-                return (getBoolean() ? 1 : 0);
+                return end();
             }
-            else
+            if (KeyRef(entries_[slot - 1].first) == key)
             {
-                JSONITY_THROW_TYPE_MISMATCH();
+                return (entries_.begin() + (slot - 1));
             }
         }
+    }
 
-        String& getString()
+    void placeIndex(size_t entry)
+    {
+        size_t mask = index_.size() - 1;
+        size_t pos = KeyRef(entries_[entry].first).hash() & mask;
+        while (index_[pos] != 0)
         {
-            JSONITY_TYPE_CHECK(isString());
-            return *data_.str_;
+            pos = (pos + 1) & mask;
         }
+        index_[pos] = static_cast<uint32_t>(entry + 1);
+    }
 
-        const String& getString() const
+    // Empties the slot of entry by moving later slots of its probe
+    // sequence back, then renumbers the entries after it.
+    void removeIndex(size_t entry)
+    {
+        size_t mask = index_.size() - 1;
+        size_t pos = KeyRef(entries_[entry].first).hash() & mask;
+        while (index_[pos] != (entry + 1))
         {
-            JSONITY_TYPE_CHECK(isString());
-            return *data_.str_;
+            pos = (pos + 1) & mask;
         }
 
-        bool getBoolean() const
+        for (size_t next = (pos + 1) & mask; index_[next] != 0;
+            next = (next + 1) & mask)
         {
-            if (isBoolean())
-            {
-                return data_.b_;
-            }
-            else if (isNumber())
-            {
-                return (getNumber() != 0);
-            }
-            else if (isReal())
-            {
-                return (getReal() != 0.0);
-            }
-            else
+            size_t home =
+                KeyRef(entries_[index_[next] - 1].first).hash() & mask;
+            if (((next - home) & mask) >= ((next - pos) & mask))
             {
-                JSONITY_THROW_TYPE_MISMATCH();
+                index_[pos] = index_[next];
+                pos = next;
             }
         }
+        index_[pos] = 0;
 
-        double getReal() const
+        for (size_t slot = 0; slot < index_.size(); ++slot)
         {
-            if (isReal())
-            {
-                return data_.d_;
-            }
-            else if (isNumber())
-            {
-                return static_cast<double>(data_.n_);
-            }
-            else if (isBoolean())
-            {
-                return (getBoolean() ? 1.0 : 0.0);
-            }
-            else
+            if (index_[slot] > (entry + 1))
             {
-                JSONITY_THROW_TYPE_MISMATCH();
+                --index_[slot];
             }
         }
+    }
 
-        Array& getArray()
+    // The table is kept at most half full.
+    void rebuildIndex()
+    {
+        if (entries_.size() <= LinearSize)
         {
-            JSONITY_TYPE_CHECK(isArray());
-            return *data_.arr_;
+            index_.clear();
+            return;
         }
 
-        const Array& getArray() const
+        size_t size = 16;
+        while (size < (entries_.size() * 2))
         {
-            JSONITY_TYPE_CHECK(isArray());
-            return *data_.arr_;
+            size <<= 1;
         }
 
-        Object& getObject()
+        index_.assign(size, 0);
+        for (size_t entry = 0; entry < entries_.size(); ++entry)
         {
-            JSONITY_TYPE_CHECK(isObject());
-            return *data_.obj_;
+            placeIndex(entry);
         }
+    }
 
-        const Object& getObject() const
+    void addIndex()
+    {
+        if (entries_.size() <= LinearSize)
         {
-            JSONITY_TYPE_CHECK(isObject());
-            return *data_.obj_;
+            return;
         }
 
-        template<typename UserValueType>
-        UserValueType& getUserValue()
+        if ((entries_.size() * 2) > index_.size())
         {
-            JSONITY_TYPE_CHECK(isUserValue() || isUserValuePtr());
+            rebuildIndex();
+        }
+        else
+        {
+            placeIndex(entries_.size() - 1);
+        }
+    }
 
-            UserValueType* userValue =
-                dynamic_cast<UserValueType*>(data_.user_);
+    Entries entries_;
+    Index index_;
+};
 
-            JSONITY_TYPE_CHECK(userValue != NULL);
+// The member names of an object, shared by every object with the same
+// names in the same order. A shape is changed only while it is owned
+// by a single object, otherwise the object copies it first.
 
-            return *userValue;
-        }
+template<typename KeyType, typename CompareType, typename AllocatorType>
+class ObjectShape
+{
+public:
+    typedef BasicStringRef<typename KeyType::value_type,
+        typename KeyType::traits_type> KeyRef;
 
-        template<typename UserValueType>
-        const UserValueType& getUserValue() const
-        {
-            JSONITY_TYPE_CHECK(isUserValue() || isUserValuePtr());
+    // The mapped values are not used, the names are looked up by
+    // their position.
+    typedef InsertionOrderMap<
+        KeyType, bool, CompareType, AllocatorType, true> Names;
 
-            UserValueType* userValue =
-                dynamic_cast<UserValueType*>(data_.user_);
+    static const size_t npos = static_cast<size_t>(-1);
 
-            JSONITY_TYPE_CHECK(userValue != NULL);
+private:
+    typedef typename RebindAllocator<
+        AllocatorType, ObjectShape>::Type ShapeAllocator;
 
-            return *userValue;
-        }
+#ifdef JSONITY_SUPPORT_CXX_11
+    typedef std::atomic<size_t> RefCount;
+#else
+    typedef size_t RefCount;
+#endif
 
-        template<typename UserValueType>
-        UserValueType* getUserValuePtr()
+    explicit ObjectShape(const AllocatorType& alloc)
+        : refCount_(1), hash_(0), names_(CompareType(), alloc)
+    {
+    }
+
+public:
+
+    static ObjectShape* create(const AllocatorType& alloc)
+    {
+        ShapeAllocator shapeAlloc(alloc);
+        ObjectShape* shape = shapeAlloc.allocate(1);
+        return new (shape) ObjectShape(alloc);
+    }
+
+    // A new shape with the first size names of other.
+    static ObjectShape* create(const ObjectShape& other, size_t size,
+                               const AllocatorType& alloc)
+    {
+        ObjectShape* shape = create(alloc);
+        typename Names::const_iterator it = other.names_.begin();
+        for (size_t pos = 0; pos < size; ++pos, ++it)
         {
-            JSONITY_TYPE_CHECK(isUserValue() || isUserValuePtr());
-            return dynamic_cast<UserValueType*>(data_.user_);
+            shape->add(it->first);
         }
+        return shape;
+    }
 
-        template<typename UserValueType>
-        const UserValueType* getUserValue() const
+    ObjectShape* retain()
+    {
+        ++refCount_;
+        return this;
+    }
+
+    static void release(ObjectShape* shape)
+    {
+        if ((shape != NULL) && (--shape->refCount_ == 0))
         {
-            JSONITY_TYPE_CHECK(isUserValue() || isUserValuePtr());
-            return dynamic_cast<UserValueType*>(data_.user_);
+            ShapeAllocator shapeAlloc(shape->names_.get_allocator());
+            shape->~ObjectShape();
+            shapeAlloc.deallocate(shape, 1);
         }
+    }
 
-    public:
+    bool isShared() const
+    {
+        return (refCount_ > 1);
+    }
 
-        // Setter
+    size_t size() const
+    {
+        return names_.size();
+    }
 
-        void setNumber(int32_t number)
-        {
-            destroy();
-            assignNumber(number);
-        }
+    const KeyType& getName(size_t pos) const
+    {
+        return (names_.begin() + pos)->first;
+    }
 
-        void setNumber(int64_t number)
-        {
-            destroy();
-            assignNumber(number);
-        }
+    // Combined hash of the names in order, to find equal shapes.
+    size_t hash() const
+    {
+        return hash_;
+    }
 
-        void setString(const char_t* str)
+    bool equal(const ObjectShape& other) const
+    {
+        if ((size() != other.size()) || (hash_ != other.hash_))
         {
-            destroy();
-            assignString(str);
+            return false;
         }
 
-        void setString(const String& str)
+        for (size_t pos = 0; pos < size(); ++pos)
         {
-            destroy();
-            assignString(str.c_str(), str.length());
+            if (KeyRef(getName(pos)) != KeyRef(other.getName(pos)))
+            {
+                return false;
+            }
         }
+        return true;
+    }
 
-        void setBoolean(bool boolean)
-        {
-            destroy();
-            assignBoolean(boolean);
-        }
+    size_t find(const KeyRef& key) const
+    {
+        typename Names::const_iterator it = names_.find(key);
+        return ((it != names_.end()) ? (it - names_.begin()) : npos);
+    }
 
-        void setReal(double real)
-        {
-            destroy();
-            assignReal(real);
-        }
+    size_t find(const KeyRef& key, size_t hash, size_t& hint)
+    {
+        typename Names::iterator it = names_.find(key, hash, hint);
+        return ((it != names_.end()) ? (it - names_.begin()) : npos);
+    }
 
-        template<typename KeyType, typename ValueType>
-        void setObject(const std::map<KeyType, ValueType>& map)
+    void add(const KeyType& name)
+    {
+        names_.insert(std::make_pair(name, false));
+        hash_ = (hash_ * 31) + KeyRef(name).hash();
+    }
+
+#ifdef JSONITY_SUPPORT_CXX_11
+    void add(KeyType&& name)
+    {
+        size_t hash = KeyRef(name).hash();
+        names_.insert(std::make_pair(std::move(name), false));
+        hash_ = (hash_ * 31) + hash;
+    }
+#endif
+
+    void erase(size_t pos)
+    {
+        names_.erase(names_.begin() + pos);
+
+        hash_ = 0;
+        for (size_t index = 0; index < size(); ++index)
         {
-            destroy();
-            assignObject(map);
+            hash_ = (hash_ * 31) + KeyRef(getName(index)).hash();
         }
+    }
 
-        void setUserValue(const UserValueBase& userValue)
+private:
+    RefCount refCount_;
+    size_t hash_;
+    Names names_;
+};
+
+// Shapes found while decoding, so that objects with the same names
+// end up with one shape.
+
+template<typename ShapeType>
+class ObjectShapeCache
+{
+public:
+    ObjectShapeCache()
+        : size_(0)
+    {
+    }
+
+    ~ObjectShapeCache()
+    {
+        for (size_t pos = 0; pos < table_.size(); ++pos)
         {
-            destroy();
-            assignUserValue(userValue);
+            ShapeType::release(table_[pos]);
         }
+    }
 
-        void setUserValue(UserValueBase* userValue)
+public:
+
+    // Returns the cached shape equal to shape, or keeps shape.
+    ShapeType* share(ShapeType* shape)
+    {
+        if ((size_ * 2) >= table_.size())
         {
-            destroy();
-            assignUserValuePtr(userValue);
+            grow();
         }
 
-        void setValue(const Value& value)
+        size_t mask = table_.size() - 1;
+        for (size_t pos = shape->hash() & mask;; pos = (pos + 1) & mask)
         {
-            if (this == &value)
+            if (table_[pos] == NULL)
             {
-                return;
+                table_[pos] = shape->retain();
+                ++size_;
+                return shape;
+            }
+            if (table_[pos]->equal(*shape))
+            {
+                return table_[pos];
             }
-            destroy();
-            assignValue(value);
         }
+    }
 
-    public:
+private:
+    void grow()
+    {
+        std::vector<ShapeType*> table;
+        table.swap(table_);
+        table_.assign(table.empty() ? 16 : (table.size() * 2), NULL);
 
-        void clear()
+        size_t mask = table_.size() - 1;
+        for (size_t index = 0; index < table.size(); ++index)
         {
-            if (isArray())
-            {
-                getArray().clear();
-            }
-            else if (isObject())
-            {
-                getObject().clear();
-            }
-            else if (isString())
-            {
-                getString().clear();
-            }
-            else if (isNumber())
-            {
-                setNumber(0);
-            }
-            else if (isBoolean())
-            {
-                setBoolean(false);
-            }
-            else if (isReal())
+            if (table[index] != NULL)
             {
-                setReal(0.0);
+                size_t pos = table[index]->hash() & mask;
+                while (table_[pos] != NULL)
+                {
+                    pos = (pos + 1) & mask;
+                }
+                table_[pos] = table[index];
             }
         }
+    }
 
-        bool isEmpty() const
+    ObjectShapeCache(const ObjectShapeCache&);
+    ObjectShapeCache& operator=(const ObjectShapeCache&);
+
+    std::vector<ShapeType*> table_;
+    size_t size_;
+};
+
+// The part of the std::map interface used by JsonBase, over a shared
+// ObjectShape for the names and a vector of the values. Iterators
+// yield a pair of references, members are in insertion order.
+
+template<typename KeyType, typename MappedType, typename CompareType,
+         typename AllocatorType>
+class ShapedMap
+{
+public:
+    typedef KeyType key_type;
+    typedef MappedType mapped_type;
+    typedef std::pair<KeyType, MappedType> value_type;
+    typedef CompareType key_compare;
+    typedef AllocatorType allocator_type;
+    typedef ObjectShape<KeyType, CompareType, AllocatorType> Shape;
+    typedef ObjectShapeCache<Shape> ShapeCache;
+
+private:
+    typedef std::vector<MappedType,
+        typename RebindAllocator<AllocatorType, MappedType>::Type> Values;
+    typedef typename Shape::KeyRef KeyRef;
+
+    template<typename MapType, typename ValueType>
+    class Iterator
+    {
+    public:
+        struct Member
         {
-            if (isArray())
-            {
-                return getArray().empty();
-            }
-            else if (isObject())
-            {
-                return getObject().empty();
-            }
-            else if (isString())
-            {
-                return getString().empty();
-            }
-            else if (isNumber())
+            Member(const KeyType& name, ValueType& value)
+                : first(name), second(value)
             {
-                return (getNumber() == 0);
-            }
-            else if (isBoolean())
-            {
-                return (getBoolean() == false);
-            }
-            else if (isReal())
-            {
-                return (getReal() == 0.0);
             }
 
-            return true;
-        }
+            const KeyType& first;
+            ValueType& second;
+        };
 
-        size_t getSize() const
+        struct Pointer
         {
-            if (isArray())
-            {
-                return getArray().size();
-            }
-            else if (isObject())
-            {
-                return getObject().size();
-            }
-            else if (isString())
-            {
-                return getString().size();
-            }
-            else
+            Member* operator->()
             {
-                JSONITY_THROW_TYPE_MISMATCH();
+                return &member_;
             }
-        }
 
-    public:
+            Member member_;
+        };
 
-        // Convert
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const KeyType, ValueType> value_type;
+        typedef ptrdiff_t difference_type;
+        typedef Member reference;
+        typedef Pointer pointer;
 
-        int64_t toNumber() const
+        Iterator()
+            : map_(NULL), pos_(0)
         {
-            if (isString())
-            {
-                int64_t number = 0;
-                stringToInt(getString(), number);
-                return number;
-            }
-            else if (isNumber() || isReal() || isBoolean())
-            {
-                return getNumber();
-            }
-            else
-            {
-                JSONITY_THROW_TYPE_MISMATCH();
-            }
         }
 
-        String toString() const
+        Iterator(MapType* map, size_t pos)
+            : map_(map), pos_(pos)
         {
-            if (isNumber())
-            {
-                OStringStream oss;
-                intToStream(getNumber(), oss);
-                return oss.str();
-            }
-            else if (isReal())
-            {
-                OStringStream oss;
-                doubleToStream(getReal(), oss);
-                return oss.str();
-            }
-            else if (isBoolean())
-            {
-                return String(1, (getBoolean() ?
-                    JSONITY_CHAR('1') : JSONITY_CHAR('0')));
-            }
-            else if (isString())
-            {
-                return getString();
-            }
-            else
-            {
-                JSONITY_THROW_TYPE_MISMATCH();
-            }
         }
 
-    public:
-
-        // Array operation
-        
-        Value& operator[](int index)
+        // iterator to const_iterator
+        template<typename OtherMapType, typename OtherValueType>
+        Iterator(const Iterator<OtherMapType, OtherValueType>& other)
+            : map_(other.map_), pos_(other.pos_)
         {
-            JSONITY_TYPE_CHECK(isArray());
-            JSONITY_ASSERT(index >= 0);
-            JSONITY_ASSERT(getSize() > static_cast<size_t>(index));
-        
-            return getArray()[static_cast<size_t>(index)];
         }
 
-        Value& addNewValue()
+        Member operator*() const
         {
-            JSONITY_TYPE_CHECK(isArray());
-#ifdef JSONITY_SUPPORT_CXX_11
-            getArray().emplace_back(Value());
-#else
-            getArray().push_back(Value());
-#endif
-            return getArray().back();
+            return Member(map_->shape_->getName(pos_), map_->values_[pos_]);
         }
 
-    public:
-
-        // Object operation
+        Pointer operator->() const
+        {
+            Pointer pointer = { **this };
+            return pointer;
+        }
 
-        bool hasName(const String& name) const
+        Iterator& operator++()
         {
-            JSONITY_TYPE_CHECK(isObject());
-            return (getObject().find(name) != getObject().end());
+            ++pos_;
+            return *this;
         }
 
-        bool find(const String& name, Value& value) const
+        Iterator operator++(int)
         {
-            JSONITY_TYPE_CHECK(isObject());
+            Iterator it = *this;
+            ++pos_;
+            return it;
+        }
 
-            typename Object::const_iterator it =
-                getObject().find(name);
-            if (it != getObject().end())
-            {
-                value = it->second;
-                return true;
-            }
+        Iterator& operator--()
+        {
+            --pos_;
+            return *this;
+        }
 
-            return false;
+        Iterator operator--(int)
+        {
+            Iterator it = *this;
+            --pos_;
+            return it;
         }
 
-        template<typename ContainerType>
-        size_t findRecursive(const String& name,
-                             ContainerType& container) const
+        bool operator==(const Iterator& other) const
         {
-            JSONITY_TYPE_CHECK(isObject());
+            return (pos_ == other.pos_);
+        }
 
-            for (typename Object::const_iterator itObj =
-                    getObject().begin();
-                itObj != getObject().end(); ++itObj)
-            {
-                if (itObj->first == name)
-                {
-                    container.push_back(itObj->second);
-                }
-                else if (itObj->second.isArray())
-                {
-                    for (typename Array::const_iterator itArr =
-                            itObj->second.getArray().begin();
-                        itArr != itObj->second.getArray().end(); ++itArr)
-                    {
-                        if (itArr->isObject())
-                        {
-                            itArr->findRecursive(name, container);
-                        }
-                    }
-                }
-                else if (itObj->second.isObject())
-                {
-                    itObj->second.findRecursive(name, container);
-                }
-            }
-
-            return container.size();
+        bool operator!=(const Iterator& other) const
+        {
+            return (pos_ != other.pos_);
         }
 
-        Value& operator[](const char_t* name)
+    private:
+        MapType* map_;
+        size_t pos_;
+
+        template<typename, typename> friend class Iterator;
+        friend class ShapedMap;
+    };
+
+public:
+    typedef Iterator<ShapedMap, MappedType> iterator;
+    typedef Iterator<const ShapedMap, const MappedType> const_iterator;
+    typedef typename Values::size_type size_type;
+    typedef typename Values::difference_type difference_type;
+    typedef typename iterator::reference reference;
+    typedef typename const_iterator::reference const_reference;
+
+    explicit ShapedMap(const key_compare& = key_compare(),
+                       const allocator_type& alloc = allocator_type())
+        : shape_(NULL), values_(typename Values::allocator_type(alloc))
+    {
+    }
+
+    template<typename IteratorType>
+    ShapedMap(IteratorType first, IteratorType last)
+        : shape_(NULL)
+    {
+        insert(first, last);
+    }
+
+    // Shares the shape, unless it comes from another allocator.
+    ShapedMap(const ShapedMap& other)
+        : shape_(NULL), values_(other.values_)
+    {
+        copyShape(other);
+    }
+
+    ShapedMap(const ShapedMap& other, const allocator_type& alloc)
+        : shape_(NULL), values_(typename Values::allocator_type(alloc))
+    {
+        values_.insert(values_.end(), other.values_.begin(),
+            other.values_.end());
+        copyShape(other);
+    }
+
+    ShapedMap& operator=(const ShapedMap& other)
+    {
+        if (this != &other)
         {
-            if (isNull())
-            {
-                assignObject(Object());
-            }
+            values_ = other.values_;
+            copyShape(other);
+        }
+        return *this;
+    }
 
-            if (isObject())
+#ifdef JSONITY_SUPPORT_CXX_11
+    ShapedMap(ShapedMap&& other)
+        : shape_(other.shape_), values_(std::move(other.values_))
+    {
+        other.shape_ = NULL;
+        other.values_.clear();
+    }
+
+    ShapedMap& operator=(ShapedMap&& other)
+    {
+        if (this != &other)
+        {
+            if (get_allocator() == other.get_allocator())
             {
-                return getObject()[name];
+                swap(other);
+                other.clear();
             }
             else
             {
-                JSONITY_THROW_TYPE_MISMATCH();
+                *this = static_cast<const ShapedMap&>(other);
             }
         }
+        return *this;
+    }
+#endif
 
-        Value& operator[](const String& name)
-        {
-            return operator[](name.c_str());
-        }
+    ~ShapedMap()
+    {
+        Shape::release(shape_);
+    }
 
-    public:
+public:
 
-        // Compare
+    iterator begin() { return iterator(this, 0); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    iterator end() { return iterator(this, values_.size()); }
+    const_iterator end() const { return const_iterator(this, values_.size()); }
 
-        int32_t compare(int32_t number,
-                        bool ignoreOrder = true) const
-        {
-            ((void)ignoreOrder);
+    bool empty() const { return values_.empty(); }
+    size_type size() const { return values_.size(); }
+    size_type max_size() const { return values_.max_size(); }
 
-            if (isNumber() || isBoolean())
-            {
-                return static_cast<int32_t>(
-                    getNumber() - number);
-            }
-            else if (isReal())
-            {
-                return compare((double)number);
-            }
-            else
-            {
-                JSONITY_THROW_TYPE_MISMATCH();
-            }
+    void clear()
+    {
+        Shape::release(shape_);
+        shape_ = NULL;
+        values_.clear();
+    }
+
+    template<typename NameType>
+    iterator find(const NameType& name)
+    {
+        size_t pos = ((shape_ != NULL) ? shape_->find(KeyRef(name)) : npos());
+        return ((pos != npos()) ? iterator(this, pos) : end());
+    }
+
+    // Looks up the hint position first, as InsertionOrderMap does.
+    iterator find(const KeyRef& key, size_t hash, size_t& hint)
+    {
+        size_t pos = ((shape_ != NULL) ?
+            shape_->find(key, hash, hint) : npos());
+        return ((pos != npos()) ? iterator(this, pos) : end());
+    }
+
+    template<typename NameType>
+    const_iterator find(const NameType& name) const
+    {
+        return const_cast<ShapedMap*>(this)->find(name);
+    }
+
+    template<typename NameType>
+    size_type count(const NameType& name) const
+    {
+        return ((find(name) != end()) ? 1 : 0);
+    }
+
+    mapped_type& operator[](const key_type& key)
+    {
+        iterator it = find(key);
+        if (it == end())
+        {
+            ownShape()->add(key);
+            values_.push_back(mapped_type());
+            return values_.back();
         }
+        return it->second;
+    }
 
-        int32_t compare(int64_t number,
-                        bool ignoreOrder = true) const
+    std::pair<iterator, bool> insert(const value_type& value)
+    {
+        iterator it = find(value.first);
+        if (it != end())
         {
-            ((void)ignoreOrder);
+            return std::make_pair(it, false);
+        }
+        ownShape()->add(value.first);
+        values_.push_back(value.second);
+        return std::make_pair(iterator(this, values_.size() - 1), true);
+    }
 
-            if (isNumber() || isBoolean())
-            {
-                return static_cast<int32_t>(
-                    getNumber() - number);
-            }
-            else if (isReal())
-            {
-                return compare((double)number);
-            }
-            else
-            {
-                JSONITY_THROW_TYPE_MISMATCH();
-            }
+#ifdef JSONITY_SUPPORT_CXX_11
+    mapped_type& operator[](key_type&& key)
+    {
+        iterator it = find(key);
+        if (it == end())
+        {
+            ownShape()->add(std::move(key));
+            values_.push_back(mapped_type());
+            return values_.back();
         }
+        return it->second;
+    }
 
-        int32_t compare(const char_t* str,
-                        bool ignoreOrder = true) const
+    std::pair<iterator, bool> insert(value_type&& value)
+    {
+        iterator it = find(value.first);
+        if (it != end())
         {
-            JSONITY_TYPE_CHECK(isString());
-            ((void)ignoreOrder);
-            return getString().compare(str);
+            return std::make_pair(it, false);
         }
+        ownShape()->add(std::move(value.first));
+        values_.push_back(std::move(value.second));
+        return std::make_pair(iterator(this, values_.size() - 1), true);
+    }
+#endif
 
-        int32_t compare(const String& str,
-                        bool ignoreOrder = true) const
+    iterator insert(iterator, const value_type& value)
+    {
+        return insert(value).first;
+    }
+
+    template<typename IteratorType>
+    void insert(IteratorType first, IteratorType last)
+    {
+        for (; first != last; ++first)
         {
-            JSONITY_TYPE_CHECK(isString());
-            ((void)ignoreOrder);
-            return getString().compare(str);
+            insert(value_type(first->first, first->second));
         }
+    }
 
-        int32_t compare(bool boolean,
-                        bool ignoreOrder = true) const
+    iterator erase(iterator it)
+    {
+        ownShape()->erase(it.pos_);
+        values_.erase(values_.begin() + it.pos_);
+        return iterator(this, it.pos_);
+    }
+
+    template<typename NameType>
+    size_type erase(const NameType& name)
+    {
+        iterator it = find(name);
+        if (it == end())
         {
-            ((void)ignoreOrder);
+            return 0;
+        }
+        erase(it);
+        return 1;
+    }
 
-            if (isBoolean() || isNumber() || isReal())
-            {
-                return (getBoolean() - boolean);
-            }
-            else
+    void swap(ShapedMap& other)
+    {
+        std::swap(shape_, other.shape_);
+        values_.swap(other.values_);
+    }
+
+    allocator_type get_allocator() const
+    {
+        return allocator_type(values_.get_allocator());
+    }
+
+    // Replaces the shape by an equal one from the cache.
+    void shareShape(ShapeCache& cache)
+    {
+        if (shape_ != NULL)
+        {
+            Shape* shape = cache.share(shape_);
+            if (shape != shape_)
             {
-                JSONITY_THROW_TYPE_MISMATCH();
+                Shape::release(shape_);
+                shape_ = shape->retain();
             }
         }
+    }
 
-        int32_t compare(double real,
-                        bool ignoreOrder = true) const
-        {
-            ((void)ignoreOrder);
+    const Shape* getShape() const
+    {
+        return shape_;
+    }
 
-            if (isReal() || isNumber() || isBoolean())
-            {
-                if (getReal() < real)
-                {
-                    return -1;
-                }
-                else if (getReal() > real)
-                {
-                    return 1;
-                }
-                else
-                {
-                    return 0;
-                }
-            }
-            else
-            {
-                JSONITY_THROW_TYPE_MISMATCH();
-            }
+private:
+    static size_t npos()
+    {
+        return Shape::npos;
+    }
+
+    // The shape of this object, copied first if it is shared.
+    Shape* ownShape()
+    {
+        if (shape_ == NULL)
+        {
+            shape_ = Shape::create(get_allocator());
+        }
+        else if (shape_->isShared())
+        {
+            Shape* shape = Shape::create(
+                *shape_, values_.size(), get_allocator());
+            Shape::release(shape_);
+            shape_ = shape;
         }
+        return shape_;
+    }
 
-        template<typename ConatainerType>
-        int32_t compare(const ConatainerType& container,
-                        bool ignoreOrder = true) const
+    void copyShape(const ShapedMap& other)
+    {
+        Shape::release(shape_);
+        shape_ = NULL;
+
+        if (other.shape_ != NULL)
         {
-            JSONITY_TYPE_CHECK(isArray());
+            shape_ = (get_allocator() == other.get_allocator()) ?
+                other.shape_->retain() :
+                Shape::create(
+                    *other.shape_, other.values_.size(), get_allocator());
+        }
+    }
 
-            if (getSize() < container.size())
-            {
-                return -1;
-            }
-            else if (getSize() > container.size())
-            {
-                return 1;
-            }
-   
-            typename ConatainerType::const_iterator itOther =
-                container.begin();
+    Shape* shape_;
+    Values values_;
+};
 
-            if (ignoreOrder)
-            {
-                Array arr = getArray(); // copy
+// Object layout policies, the last template argument of JsonBase.
 
-                for (; itOther != container.end(); ++itOther)
-                {
-                    typename Array::iterator itArr =
-                        arr.begin();
+struct MapObjectPolicy
+{
+    template<typename KeyType, typename ValueType,
+             typename CompareType, typename AllocatorType>
+    struct Rebind
+    {
+        typedef std::map<KeyType, ValueType,
+            CompareType, AllocatorType> Type;
+    };
+};
 
-                    for (; itArr != arr.end(); ++itArr)
-                    {
-                        if (itArr->compare(*itOther, ignoreOrder) == 0)
-                        {
-                            break;
-                        }
-                    }
+struct SortedObjectPolicy
+{
+    template<typename KeyType, typename ValueType,
+             typename CompareType, typename AllocatorType>
+    struct Rebind
+    {
+        typedef SortedVectorMap<
+            KeyType, ValueType, CompareType, AllocatorType> Type;
+    };
+};
 
-                    if (itArr == arr.end())
-                    {
-                        return -1;
-                    }
+// Members are kept in insertion order.
+struct HashObjectPolicy
+{
+    template<typename KeyType, typename ValueType,
+             typename CompareType, typename AllocatorType>
+    struct Rebind
+    {
+        typedef InsertionOrderMap<
+            KeyType, ValueType, CompareType, AllocatorType, true> Type;
+    };
+};
 
-                    arr.erase(itArr);
-                }
-            }
-            else
-            {
-                typename Array::const_iterator itArr =
-                    getArray().begin(); 
+// Like HashObjectPolicy, with the table only for objects wider than 32
+// members.
+struct OrderedObjectPolicy
+{
+    template<typename KeyType, typename ValueType,
+             typename CompareType, typename AllocatorType>
+    struct Rebind
+    {
+        typedef InsertionOrderMap<
+            KeyType, ValueType, CompareType, AllocatorType, false> Type;
+    };
+};
 
-                for (; itOther != container.end(); ++itOther)
-                {
-                    int32_t result =
-                        itArr->compare(*itOther, ignoreOrder);
-                    if (result != 0)
-                    {
-                        return result;
-                    }
-                    ++itArr;
-                }
-            }
+// Objects with the same names in the same order share them, each
+// object keeps only its values. Members are kept in insertion order.
+struct ShapeObjectPolicy
+{
+    template<typename KeyType, typename ValueType,
+             typename CompareType, typename AllocatorType>
+    struct Rebind
+    {
+        typedef ShapedMap<
+            KeyType, ValueType, CompareType, AllocatorType> Type;
+    };
+};
 
-            return 0;
-        }
+// Decoders keep a ShapeCache for the objects they create.
 
-        template<typename KeyType, typename ValueType>
-        int32_t compare(const std::map<KeyType, ValueType>& map,
-                        bool ignoreOrder = true) const
-        {
-            JSONITY_TYPE_CHECK(isObject());
+struct NoShapeCache
+{
+};
 
-            if (getSize() < map.size())
-            {
-                return -static_cast<int32_t>(map.size() - getSize());
-            }
-            else if (getSize() > map.size())
-            {
-                return static_cast<int32_t>(getSize() - map.size());
-            }
+template<typename ObjectType>
+struct ShapeCacheOf
+{
+    typedef NoShapeCache Type;
+};
 
-            for (typename std::map<KeyType, ValueType>::
-                    const_iterator itOther = map.begin();
-                itOther != map.end(); ++itOther)
-            {
-                Value name(itOther->first);
+template<typename KeyType, typename MappedType, typename CompareType,
+         typename AllocatorType>
+struct ShapeCacheOf<
+    ShapedMap<KeyType, MappedType, CompareType, AllocatorType> >
+{
+    typedef ObjectShapeCache<
+        ObjectShape<KeyType, CompareType, AllocatorType> > Type;
+};
 
-                typename Object::const_iterator it;
+// The iterator of a container, or its const_iterator if it is const.
 
-                if (name.isString())
-                {
-                    it = getObject().find(name.getString());
-                }
-                else
-                {
-                    it = getObject().find(name.toString());
-                }
+template<typename ContainerType>
+struct IteratorOf
+{
+    typedef typename ContainerType::iterator Type;
+};
 
-                if (it == getObject().end())
-                {
-                    return -1;
-                }
+template<typename ContainerType>
+struct IteratorOf<const ContainerType>
+{
+    typedef typename ContainerType::const_iterator Type;
+};
 
-                int32_t result =
-                    it->second.compare(itOther->second, ignoreOrder);
-                if (result != 0)
-                {
-                    return result;
-                }
-            }
+//---------------------------------------------------------------------------//
+// JsonBase
+//---------------------------------------------------------------------------//
 
-            return 0;
-        }
+template<typename CharType,
+         typename CharTraitsType = std::char_traits<CharType>,
+         typename CharAllocatorType = std::allocator<CharType>,
+         typename ObjectPolicyType = MapObjectPolicy>
+class JsonBase
+{
+public:
+    template<typename UserValueType> class UserValue;
+    class Value;
+    class Cursor;
+    class Error;
+    class Exception;
+    class TypeMismatchException;
+    class EncodeStyle;
+    class DecodeStyle;
+    class Key;
+    class Pointer;
+    class Path;
+    class Index;
+    class FieldIndex;
+    class Columns;
+    class EncodeContext;
+    class Arena;
+    template<typename T> class Allocator;
+    template<typename T> class Span;
+    class Document;
 
-        int32_t compare(const Value& value,
-                        bool ignoreOrder = true) const
-        {
-            if (isNull() && value.isNull())
-            {
-                return 0;
-            }
-            else if (isNumber() &&
-                (value.isNumber() || value.isBoolean()))
-            {
-                return compare(value.getNumber());
-            }
-            else if (isNumber() && value.isReal())
-            {
-                return compare(value.getReal());
-            }
-            else if (isString() && value.isString())
-            {
-                return compare(value.getString());
-            }
-            else if (isBoolean() &&
-                (value.isBoolean() || value.isNumber() || value.isReal()))
-            {
-                return compare(value.getBoolean());
-            }
-            else if (isReal() &&
-                (value.isReal() || value.isNumber() || value.isBoolean()))
-            {
-                return compare(value.getReal());
-            }
-            else if (isArray() && value.isArray())
-            {
-                return compare(value.getArray(), ignoreOrder);
-            }
-            else if (isObject() && value.isObject())
-            {
-                return compare(value.getObject(), ignoreOrder);
-            }
-            else
-            {
-                JSONITY_THROW_TYPE_MISMATCH();
-            }
-        }
+public:
+
+    // basic char
+    typedef CharType char_t;
+
+    // String
+    typedef std::basic_string<
+        CharType, CharTraitsType, CharAllocatorType> String;
+
+    // Array
+    typedef std::vector<Value,
+        typename ResourceAllocator<CharAllocatorType>::template Rebind<
+            Value, Allocator<Value> >::Type> Array;
+
+    // Packed arrays
+    typedef std::vector<int64_t> NumberArray;
+    typedef std::vector<double> RealArray;
 
+    // StringRef
+    typedef BasicStringRef<CharType, CharTraitsType> StringRef;
+
+    // Object
+    typedef typename ObjectPolicyType::template Rebind<String, Value,
+        BasicNameLess<CharType, CharTraitsType>,
+        typename ResourceAllocator<CharAllocatorType>::template Rebind<
+            std::pair<const String, Value>,
+            Allocator<std::pair<const String, Value> > >::Type>::Type Object;
+
+    // Stream
+    typedef std::basic_istream<
+        CharType, CharTraitsType > IStream;
+    typedef std::basic_ostream<
+        CharType, CharTraitsType > OStream;
+    typedef std::basic_istringstream<
+        CharType, CharTraitsType,
+        CharAllocatorType > IStringStream;
+    typedef std::basic_ostringstream<
+        CharType, CharTraitsType,
+        CharAllocatorType > OStringStream;
+
+private:
+
+    class DecodeContext;
+
+    class UserValueBase
+    {
     public:
+        virtual ~UserValueBase() {}
 
-        // Assignment operator
+    protected:
+        UserValueBase() {}
 
-        Value& operator=(int32_t number)
+    private:
+        virtual UserValueBase* duplicate() const = 0;
+        virtual void encode(EncodeContext& ctx) const = 0;
+
+        friend class Value;
+    };
+
+public:
+
+    //-----------------------------------------------------------------------//
+    // JsonBase::UserValue
+    //-----------------------------------------------------------------------//
+
+    template<typename UserValueType>
+    class UserValue : public UserValueBase
+    {
+    public:
+        virtual ~UserValue() {}
+
+    protected:
+        UserValue() {}
+
+        // Encode
+        virtual void encode(EncodeContext& ctx) const = 0;
+
+    private:
+        UserValueBase* duplicate() const
         {
-            setNumber(number);
-            return *this;
+            return new UserValueType(
+                (const UserValueType&)*this);
         }
+    };
 
-        Value& operator=(int64_t number)
+    //-----------------------------------------------------------------------//
+    // JsonBase::Arena
+    //-----------------------------------------------------------------------//
+
+    // Monotonic MemoryResource, deallocate does nothing and the memory
+    // comes back when the arena is released.
+
+    class Arena : public MemoryResource
+    {
+    public:
+        static const size_t DefaultBlockSize = 64 * 1024;
+        static const size_t Alignment = 16;
+
+        explicit Arena(size_t blockSize = DefaultBlockSize)
         {
-            setNumber(number);
-            return *this;
+            head_ = NULL;
+            cur_ = NULL;
+            end_ = NULL;
+            blockSize_ = blockSize;
+            size_ = 0;
         }
 
-        Value& operator=(const char_t* str)
+        ~Arena()
         {
-            setString(str);
-            return *this;
+            release();
         }
 
-        Value& operator=(const String& str)
+    public:
+
+        void release()
         {
-            setString(str);
-            return *this;
+            while (head_ != NULL)
+            {
+                Block* next = head_->next_;
+                ::operator delete(head_);
+                head_ = next;
+            }
+
+            cur_ = NULL;
+            end_ = NULL;
+            size_ = 0;
         }
 
-        Value& operator=(bool boolean)
+        size_t getSize() const
         {
-            setBoolean(boolean);
-            return *this;
+            return size_;
         }
 
-        Value& operator=(double real)
+    private:
+
+        struct Block
         {
-            setReal(real);
-            return *this;
-        }
+            Block* next_;
+        };
 
-        template<typename KeyType, typename ValueType>
-        Value& operator=(const std::map<KeyType, ValueType>& map)
+        static const size_t HeaderSize =
+            (sizeof(Block) + (Alignment - 1)) & ~(Alignment - 1);
+
+        virtual void* do_allocate(size_t size, size_t alignment)
         {
-            setObject(map);
-            return *this;
+            size = (size + (Alignment - 1)) & ~(Alignment - 1);
+
+            if (alignment > Alignment)
+            {
+                // Blocks are only aligned to Alignment.
+                size += alignment;
+            }
+
+            char* ptr;
+
+            if (size > (blockSize_ / 4))
+            {
+                // Large allocations get a block of their own so the
+                // rest of the current block is not wasted.
+                ptr = addBlock(size, false);
+            }
+            else
+            {
+                if (static_cast<size_t>(end_ - cur_) < size)
+                {
+                    addBlock(blockSize_, true);
+                }
+
+                ptr = cur_;
+                cur_ += size;
+            }
+
+            if (alignment > Alignment)
+            {
+                size_t offset = reinterpret_cast<size_t>(ptr) &
+                                (alignment - 1);
+                if (offset != 0)
+                {
+                    ptr += (alignment - offset);
+                }
+            }
+
+            return ptr;
         }
 
-        Value& operator=(const UserValueBase& userValue)
+        virtual void do_deallocate(void*, size_t, size_t)
         {
-            setUserValue(userValue);
-            return *this;
         }
 
-        Value& operator=(UserValueBase* userValue)
+        virtual bool do_is_equal(
+            const MemoryResource& other) const JSONITY_NOEXCEPT
         {
-            setUserValue(userValue);
-            return *this;
+            return (this == &other);
         }
 
-        Value& operator=(const UserValueBase* userValue)
+        char* addBlock(size_t size, bool current)
         {
-            setUserPtrValue(userValue);
-            return *this;
+            Block* block = static_cast<Block*>(
+                ::operator new(HeaderSize + size));
+
+            block->next_ = head_;
+            head_ = block;
+            size_ += HeaderSize + size;
+
+            char* ptr = reinterpret_cast<char*>(block) + HeaderSize;
+
+            if (current)
+            {
+                cur_ = ptr;
+                end_ = ptr + size;
+            }
+
+            return ptr;
         }
 
-        Value& operator=(const Value& other)
+        Block* head_;
+        char* cur_;
+        char* end_;
+        size_t blockSize_;
+        size_t size_;
+
+        Arena(const Arena&);
+        Arena& operator=(const Arena&);
+
+    }; // class JsonBase::Arena
+
+    //-----------------------------------------------------------------------//
+    // JsonBase::Span
+    //-----------------------------------------------------------------------//
+
+    // Contiguous elements owned by something else, as the numbers of
+    // a packed array.
+    template<typename T>
+    class Span
+    {
+    public:
+        typedef T element_type;
+        typedef T* iterator;
+
+        Span()
+            : data_(NULL), size_(0)
         {
-            setValue(other);
-            return *this;
         }
 
-#ifdef JSONITY_SUPPORT_CXX_11
-        Value& operator=(Value&& other)
+        Span(T* data, size_t size)
+            : data_(data), size_(size)
         {
-            move(std::move(other));
-            return *this;
         }
-#endif
 
     public:
-
-        // Cast operator
-
-        operator int32_t() const
+        T* data() const
         {
-            return static_cast<int32_t>(getNumber());
+            return data_;
         }
 
-        operator int64_t() const
+        size_t size() const
         {
-            return getNumber();
+            return size_;
         }
 
-        operator const char_t*() const
+        bool empty() const
         {
-            return getString().c_str();
+            return (size_ == 0);
         }
 
-        operator String&()
+        T* begin() const
         {
-            return getString();
+            return data_;
         }
 
-        operator bool() const
+        T* end() const
         {
-            return getBoolean();
+            return (data_ + size_);
         }
 
-        operator double() const
+        T& operator[](size_t index) const
         {
-            return getReal();
+            JSONITY_ASSERT(index < size_);
+            return data_[index];
         }
 
-        operator Array&()
-        {
-            return getArray();
-        }
-
-        operator Object&()
-        {
-            return getArray();
-        }
-
-    public:
-
-        bool operator==(int32_t number) const
-        {
-            return (compare(number) == 0);
-        }
-
-        bool operator==(int64_t number) const
-        {
-            return (compare(number) == 0);
-        }
+    private:
+        T* data_;
+        size_t size_;
 
-        bool operator==(const char_t* str) const
-        {
-            return (compare(str) == 0);
-        }
+    }; // class JsonBase::Span
 
-        bool operator==(const String& str) const
-        {
-            return (compare(str) == 0);
-        }
+    //-----------------------------------------------------------------------//
+    // JsonBase::Allocator
+    //-----------------------------------------------------------------------//
 
-        bool operator==(bool boolean) const
-        {
-            return (compare(boolean) == 0);
-        }
+    // Allocates from a MemoryResource when it has one, from the heap
+    // otherwise. Copies of a container always go back to the heap.
 
-        bool operator==(double real) const
-        {
-            return (compare(real) == 0);
-        }
+    template<typename T>
+    class Allocator
+    {
+    public:
+        typedef T value_type;
+        typedef T* pointer;
+        typedef const T* const_pointer;
+        typedef T& reference;
+        typedef const T& const_reference;
+        typedef size_t size_type;
+        typedef ptrdiff_t difference_type;
+
+        template<typename U>
+        struct rebind
+        {
+            typedef Allocator<U> other;
+        };
 
-        template<typename ContainerType>
-        bool operator==(const ContainerType& container) const
+        Allocator()
+            : resource_(NULL)
         {
-            return (compare(container) == 0);
         }
 
-        template<typename KetType, typename ValueType>
-        bool operator==(const std::map<KetType, ValueType>& map) const
+        explicit Allocator(MemoryResource* resource)
+            : resource_(resource)
         {
-            return (compare(map) == 0);
         }
 
-        bool operator==(const Value& value) const
+        template<typename U>
+        Allocator(const Allocator<U>& other)
+            : resource_(other.resource())
         {
-            return (compare(value) == 0);
         }
 
     public:
 
-        bool operator!=(int32_t number) const
-        {
-            return !operator==(number);
-        }
-
-        bool operator!=(int64_t number) const
+        T* allocate(size_t count, const void* = NULL)
         {
-            return !operator==(number);
+            if (resource_ != NULL)
+            {
+                return static_cast<T*>(
+                    resource_->allocate(count * sizeof(T)));
+            }
+            return static_cast<T*>(
+                ::operator new(count * sizeof(T)));
         }
 
-        bool operator!=(const char_t* str) const
+        void deallocate(T* ptr, size_t count)
         {
-            return !operator==(str);
+            if (resource_ != NULL)
+            {
+                resource_->deallocate(ptr, count * sizeof(T));
+            }
+            else
+            {
+                ::operator delete(ptr);
+            }
         }
 
-        bool operator!=(const String& str) const
+        void construct(T* ptr, const T& value)
         {
-            return !operator==(str);
+            new (ptr) T(value);
         }
 
-        bool operator!=(bool boolean) const
+#ifdef JSONITY_SUPPORT_CXX_11
+        template<typename U, typename... Args>
+        void construct(U* ptr, Args&&... args)
         {
-            return !operator==(boolean);
+            new (ptr) U(std::forward<Args>(args)...);
         }
+#endif
 
-        bool operator!=(double real) const
+        template<typename U>
+        void destroy(U* ptr)
         {
-            return !operator==(real);
+            ptr->~U();
         }
 
-        template<typename ContainerType>
-        bool operator!=(const ContainerType& container) const
+        size_t max_size() const
         {
-            return !operator==(container);
+            return (static_cast<size_t>(-1) / sizeof(T));
         }
 
-        template<typename KeyName, typename ValueType>
-        bool operator!=(const std::map<KeyName, ValueType>& map) const
+        T* address(T& value) const
         {
-            return !operator==(map);
+            return &value;
         }
 
-        bool operator!=(const Value& value) const
+        const T* address(const T& value) const
         {
-            return !operator==(value);
+            return &value;
         }
 
-    public:
-
-        bool operator<(int32_t number) const
+        Allocator select_on_container_copy_construction() const
         {
-            return (compare(number) < 0);
+            return Allocator();
         }
 
-        bool operator<(int64_t number) const
+        // Same name as std::pmr::polymorphic_allocator::resource().
+        MemoryResource* resource() const
         {
-            return (compare(number) < 0);
+            return resource_;
         }
 
-        bool operator<(const char_t* str) const
+        template<typename U>
+        bool operator==(const Allocator<U>& other) const
         {
-            return (compare(str) < 0);
+            return (resource_ == other.resource());
         }
 
-        bool operator<(const String& str) const
+        template<typename U>
+        bool operator!=(const Allocator<U>& other) const
         {
-            return (compare(str) < 0);
+            return (resource_ != other.resource());
         }
 
-        bool operator<(bool boolean) const
-        {
-            return (compare(boolean) < 0);
-        }
+    private:
+        MemoryResource* resource_;
 
-        bool operator<(double real) const
-        {
-            return (compare(real) < 0);
-        }
+    }; // class JsonBase::Allocator
 
-        bool operator<(const Value& other) const
-        {
-            return (compare(other) < 0);
-        }
+    //-----------------------------------------------------------------------//
+    // JsonBase::Value
+    //-----------------------------------------------------------------------//
 
+    class Value
+    {
     public:
+        typedef char Type;
+        static const Type NullType = 0;
+        static const Type NumberType = 1; 
+        static const Type StringType = 2; 
+        static const Type BooleanType = 3;
+        static const Type RealType = 4; 
+        static const Type ArrayType = 5;
+        static const Type ObjectType = 6;
+        static const Type UserType = 7;
+        static const Type UserPtrType = 8;
 
-        bool operator>(int32_t number) const
+        // What a walk() visitor returns.
+        static const int32_t WalkContinue = 0;
+        static const int32_t WalkPrune = 1;     // not into this value
+        static const int32_t WalkStop = 2;
+
+        Value()
         {
-            return (compare(number) > 0);
+            assignNull();
         }
 
-        bool operator>(int64_t number) const
+        Value(int32_t number)
         {
-            return (compare(number) > 0);
+            assignNumber(number);
         }
 
-        bool operator>(const char_t* str) const
+        Value(int64_t number)
         {
-            return (compare(str) > 0);
+            assignNumber(number);
         }
 
-        bool operator>(const String& str) const
+        Value(const char_t* str)
         {
-            return (compare(str) > 0);
+            assignString(str);
         }
 
-        bool operator>(bool boolean) const
+        Value(const String& str)
         {
-            return (compare(boolean) > 0);
+            assignString(str.c_str(), str.size());
         }
 
-        bool operator>(double real) const
+        Value(bool boolean)
         {
-            return (compare(real) > 0);
+            assignBoolean(boolean);
         }
 
-        bool operator>(const Value& other) const
+        Value(double real)
         {
-            return (compare(other) > 0);
+            assignReal(real);
         }
 
-    private:
-
-        const UserValueBase& getUserValueBase() const
+        template<typename KeyType, typename ValueType>
+        Value(const std::map<KeyType, ValueType>& map)
         {
-            JSONITY_TYPE_CHECK(isUserValue());
-            return *data_.user_;
+            assignObject(map);
         }
 
-        const UserValueBase* getUserValueBasePtr() const
+        Value(const Array& arr)
         {
-            JSONITY_TYPE_CHECK(isUserValuePtr());
-            return data_.user_;
+            assignArray(arr);
         }
 
-        void encodeUserValue(EncodeContext& ctx) const
+        Value(const Object& obj)
         {
-            JSONITY_ASSERT(
-                isUserValue() || isUserValuePtr());
-            data_.user_->encode(ctx);
+            assignObject(obj);
         }
 
-    private:
-
-        void assignNull()
+        Value(const UserValueBase& userValue)
         {
-            type_ = NullType;
+            assignUserValue(userValue);
         }
 
-        void assignNumber(int64_t number)
+        Value(UserValueBase* userValue)
         {
-            type_ = NumberType;
-            data_.n_ = number;
+            assignUserValuePtr(userValue);
         }
 
-        void assignString(const char_t* str, size_t length)
+        Value(const Value& other)
         {
-            type_ = StringType;
-            data_.str_ = new String;
-
-            if (length > 0)
-            {
-                data_.str_->assign(str, length);
-            }
+            setType(NullType);
+            assignValue(other);
         }
 
-        void assignString(const char_t* str)
+        // Deep copy whose strings and containers are allocated from
+        // the resource, which must outlive the Value.
+        Value(const Value& other, MemoryResource* resource)
         {
-            type_ = StringType;
-            data_.str_ = new String(str);
+            setType(NullType);
+            assignValue(other, resource);
         }
 
-        void assignBoolean(bool boolean)
+#ifdef JSONITY_SUPPORT_CXX_11
+        Value(Value&& other) JSONITY_NOEXCEPT
         {
-            type_ = BooleanType;
-            data_.b_ = boolean;
+            setType(NullType);
+            move(std::move(other));
         }
 
-        void assignReal(double real)
+        Value(String&& str)
         {
-            type_ = RealType;
-            data_.d_ = real;
+            assignString(std::move(str));
         }
 
-        template<typename ContainerType>
-        void assignArray(const ContainerType& container)
+        Value(Array&& arr)
         {
-            type_ = ArrayType;
-            data_.arr_ = new Array;
-
-            std::copy(container.begin(), container.end(),
-                std::inserter(getArray(), getArray().end()));
+            assignArray(std::move(arr));
         }
 
-        template<typename KeyType, typename ValueType>
-        void assignObject(const std::map<KeyType, ValueType>& map)
+        Value(Object&& obj)
         {
-            type_ = ObjectType;
-            data_.obj_ = new Object;
-
-            for (typename std::map<KeyType, ValueType>::const_iterator it =
-                    map.begin();
-                it != map.end(); ++it)
-            {
-                Value name(it->first);
-
-                if (name.isString())
-                {
-                    getObject()[name.getString()] = it->second;
-                }
-                else
-                {
-                    getObject()[name.toString()] = it->second;
-                }
-            }
+            assignObject(std::move(obj));
         }
 
-        void assignUserValue(const UserValueBase& userValue)
+        template<typename KeyType, typename ValueType>
+        Value(std::map<KeyType, ValueType>&& map)
         {
-            type_ = UserType;
-            data_.user_ = userValue.duplicate();
+            moveObject(map);
         }
+#endif
 
-        void assignUserValuePtr(const UserValueBase* userValue)
+        ~Value()
         {
-            type_ = UserPtrType;
-            data_.user_ = const_cast<UserValueBase*>(userValue);
+            destroy();
         }
 
-        void assignValue(const Value& value)
+        void destroy()
         {
-            if (value.isNumber())
-            {
-                assignNumber(value.getNumber());
-            }
-            else if (value.isString())
+            if (isResourceValue())
             {
-                assignString(value.getString().c_str());
+                destroyResourceValue();
             }
-            else if (value.isBoolean())
+            else if (isShared())
             {
-                assignBoolean(value.getBoolean());
+                releaseShared();
             }
-            else if (value.isReal())
+            else if (isString())
             {
-                assignReal(value.getReal());
+                delete data().str_;
+                data().str_ = NULL;
             }
-            else if (value.isArray())
+            else if (isPackedNumbers())
             {
-                assignArray(value.getArray());
+                delete data().numbers_;
+                data().numbers_ = NULL;
             }
-            else if (value.isObject())
+            else if (isPackedReals())
             {
-                assignObject(value.getObject());
+                delete data().reals_;
+                data().reals_ = NULL;
             }
-            else if (value.isUserValue())
+            else if (isArray())
             {
-                assignUserValue(value.getUserValueBase());
+                delete data().arr_;
+                data().arr_ = NULL;
             }
-            else if (value.isUserValuePtr())
+            else if (isObject())
             {
-                assignUserValuePtr(value.getUserValueBasePtr());
+                delete data().obj_;
+                data().obj_ = NULL;
             }
-            else
+            else if (isUserValue())
             {
-                assignNull();
+                delete data().user_;
+                data().user_ = NULL;
             }
-        }
 
-#ifdef JSONITY_SUPPORT_CXX_11
-        void move(Value&& other)
-        {
-            destroy();
-            type_ = other.type_;
-            data_ = other.data_;
-            other.type_ = NullType;
+            setType(NullType);
         }
-#endif
-
-    private:
-        Type type_;
-        union Data {
-            int64_t n_;
-            String* str_;
-            bool b_;
-            double d_;
-            Array* arr_;
-            Object* obj_;
-            UserValueBase* user_;
-        } data_;
-
-        friend class JsonBase;
-
-    }; // class JsonBasic::Value
 
-public:
+    public:
 
-    //-----------------------------------------------------------------------//
-    // JsonBasic::Cursor
-    //-----------------------------------------------------------------------//
+        JSONITY_VALUE_IMPL_STL_CONTAINER(std::vector);
+#if defined(_LIST_) || defined(_GLIBCXX_LIST) || defined(_LIBCPP_LIST)
+        JSONITY_VALUE_IMPL_STL_CONTAINER(std::list);
+#endif
+#if defined(_DEQUE_) || defined(_GLIBCXX_DEQUE) || defined(_LIBCPP_DEQUE)
+        JSONITY_VALUE_IMPL_STL_CONTAINER(std::deque);
+#endif
+#if defined(_SET_) || defined(_GLIBCXX_SET) || defined(_LIBCPP_SET)
+        JSONITY_VALUE_IMPL_STL_CONTAINER(std::set);
+        JSONITY_VALUE_IMPL_STL_CONTAINER(std::multiset);
+#endif
+#if defined(_ARRAY_) || defined(_GLIBCXX_ARRAY) || defined(_LIBCPP_ARRAY)
+        JSONITY_VALUE_IMPL_STL_CONTAINER_FIXED_SIZE(std::array);
+#endif
+#if defined(_FORWARD_LIST_) || defined(_GLIBCXX_FORWARD_LIST) || \
+    defined(_LIBCPP_FORWARD_LIST)
+        JSONITY_VALUE_IMPL_STL_CONTAINER(std::forward_list);
+#endif
+#if defined(_UNORDERED_SET_) || defined(_GLIBCXX_UNORDERED_SET) || \
+    defined(_LIBCPP_UNORDERED_SET)
+        JSONITY_VALUE_IMPL_STL_CONTAINER(std::unordered_set);
+        JSONITY_VALUE_IMPL_STL_CONTAINER(std::unordered_multiset);
+#endif
 
-    class Cursor
-    {
     public:
-        Cursor()
+
+        // Type
+
+        Type getType() const
         {
-            pos_ = 0;
-            row_ = 0;
-            col_ = 0;
+            return layout_.type_;
         }
 
-    public:
-        uint32_t getPos() const
+        bool isNull() const
         {
-            return pos_;
+            return (getType() == NullType);
         }
 
-        uint32_t getRow() const
+        bool isNumber() const
         {
-            return row_;
+            return (getType() == NumberType);
         }
 
-        uint32_t getCol() const
+        bool isString() const
         {
-            return col_;
+            return (getType() == StringType);
         }
 
-    private:
-        void nextRow()
+        bool isBoolean() const
         {
-            ++row_;
-            col_ = 0;
+            return (getType() == BooleanType);
         }
 
-        void nextCol()
+        bool isReal() const
         {
-            ++col_;
+            return (getType() == RealType);
         }
 
-        void setPos(uint32_t pos)
+        bool isArray() const
         {
-            pos_ = pos;
+            return (getType() == ArrayType);
         }
 
-        uint32_t pos_;
-        uint32_t row_;
-        uint32_t col_;
-
-        friend class JsonBase;
-
-    }; // class JsonBasic::Cursor
-
-    //-----------------------------------------------------------------------//
-    // JsonBasic::Error
-    //-----------------------------------------------------------------------//
-
-    class Error
-    {
-    public:
-        Error()
+        bool isObject() const
         {
-            proc_ = 0;
-            errorCode_ = 0;
-            codeLine_ = 0;
+            return (getType() == ObjectType);
         }
 
-        // Process
-        static const int32_t ObjectProc = 1; 
-        static const int32_t ArrayProc = 2; 
-        static const int32_t NumberProc = 3; 
-        static const int32_t StringProc = 4; 
-        static const int32_t TrueProc = 5;
-        static const int32_t FalseProc = 6; 
-        static const int32_t RealProc = 7;
-        static const int32_t NullProc = 8;
-        static const int32_t CodePointProc = 9;
-        static const int32_t UnknownProc = 10;
+        bool isUserValue() const
+        {
+            return (getType() == UserType);
+        }
 
-        // Error code
-        static const int32_t UnexpectedEOF = 101;
-        static const int32_t UnexpectedToken = 102;
-        static const int32_t UnexpectedComma = 103;
-        static const int32_t UnexpectedColon = 104;
-        static const int32_t UnexpectedEscapeToken = 105;
-        static const int32_t ExpectedLCB = 106;     // '{'
-        static const int32_t ExpectedLSB = 107;     // '['
-        static const int32_t ExpectedQuot = 108;    // '"'
-        static const int32_t ExpectedComma = 109;   // ','
-        static const int32_t ExpectedColon = 110;   // ':'
-        static const int32_t NameAlreadyExists = 111;
-        static const int32_t InvalidHex = 112;
-        static const int32_t InvalidSurrogatePair = 113;
-        static const int32_t SyntaxError = 114;
-        static const int32_t NotSupported = 115;
+        bool isUserValuePtr() const
+        {
+            return (getType() == UserPtrType);
+        }
 
     public:
 
-        bool isEmpty() const
+        // Getter
+
+        int64_t getNumber() const
         {
-            return (proc_ == 0);
+            if (isNumber())
+            {
+                return data().n_;
+            }
+            else if (isReal())
+            {
+                return static_cast<int64_t>(data().d_);
+            }
+            else if (isBoolean())
+            {
+                return (getBoolean() ? 1 : 0);
+            }
+            else
+            {
+                JSONITY_THROW_TYPE_MISMATCH();
+            }
         }
 
-        const Cursor& getCursor() const
+        String& getString()
         {
-            return cur_;
+            JSONITY_TYPE_CHECK(isString());
+            detach();
+            return *data().str_;
         }
 
-        int32_t getProcess() const
+        const String& getString() const
         {
-            return proc_;
+            JSONITY_TYPE_CHECK(isString());
+            return *data().str_;
         }
 
-        int32_t getErrorCode() const
+        const char_t* getCString() const
         {
-            return errorCode_;
+            JSONITY_TYPE_CHECK(isString());
+            return data().str_->c_str();
         }
 
-        int32_t getCodeLine() const
+        bool getBoolean() const
         {
-            return codeLine_;
+            if (isBoolean())
+            {
+                return data().b_;
+            }
+            else if (isNumber())
+            {
+                return (getNumber() != 0);
+            }
+            else if (isReal())
+            {
+                return (getReal() != 0.0);
+            }
+            else
+            {
+                JSONITY_THROW_TYPE_MISMATCH();
+            }
         }
 
-    private:
-        void setError(const Cursor& cur, int32_t proc,
-                      int32_t errorCode, int32_t codeLine)
+        double getReal() const
         {
-            cur_ = cur;
-            proc_ = proc;
-            errorCode_ = errorCode;
-            codeLine_ = codeLine;
+            if (isReal())
+            {
+                return data().d_;
+            }
+            else if (isNumber())
+            {
+                return static_cast<double>(data().n_);
+            }
+            else if (isBoolean())
+            {
+                return (getBoolean() ? 1.0 : 0.0);
+            }
+            else
+            {
+                JSONITY_THROW_TYPE_MISMATCH();
+            }
         }
 
-        Cursor cur_;
-        int32_t proc_;
-        int32_t errorCode_;
-        int32_t codeLine_;
-
-        friend class JsonBase;
-
-    }; // class JsonBasic::Error
-
-    //-----------------------------------------------------------------------//
-    // JsonBasic::Exception
-    //-----------------------------------------------------------------------//
-
-    class Exception : public std::exception
-    {
-    public:
-        Exception(int32_t codeLine, const std::string& message)
-            : codeLine_(codeLine), message_(message)
+        Array& getArray()
         {
+            JSONITY_TYPE_CHECK(isArray());
+            detach();
+            unpack();
+            if (data().arr_ == NULL)
+            {
+                data().arr_ = new Array;
+            }
+            return *data().arr_;
         }
 
-        virtual ~Exception() throw()
+        // Throws for a packed array, see isPacked().
+        const Array& getArray() const
         {
+            JSONITY_TYPE_CHECK(isArray() && !isPacked());
+            if (data().arr_ == NULL)
+            {
+                static const Array emptyArray;
+                return emptyArray;
+            }
+            return *data().arr_;
         }
 
-    public:
-        virtual const char* what() const throw()
+        Object& getObject()
         {
-            return message_.c_str();
+            JSONITY_TYPE_CHECK(isObject());
+            detach();
+            if (data().obj_ == NULL)
+            {
+                data().obj_ = new Object;
+            }
+            return *data().obj_;
         }
 
-        int32_t getCodeLine() const
+        const Object& getObject() const
         {
-            return codeLine_;
+            JSONITY_TYPE_CHECK(isObject());
+            if (data().obj_ == NULL)
+            {
+                static const Object emptyObject;
+                return emptyObject;
+            }
+            return *data().obj_;
         }
 
-    private:
-        int32_t codeLine_;
-        std::string message_;
+        template<typename UserValueType>
+        UserValueType& getUserValue()
+        {
+            JSONITY_TYPE_CHECK(isUserValue() || isUserValuePtr());
 
-    }; // clsss JsonBasic::Exception
+            UserValueType* userValue =
+                dynamic_cast<UserValueType*>(data().user_);
 
-    class TypeMismatchException : public Exception
-    {
-    public:
-        TypeMismatchException(int32_t codeLine)
-            : Exception(codeLine, "Json::TypeMismatchException")
-        {
+            JSONITY_TYPE_CHECK(userValue != NULL);
+
+            return *userValue;
         }
 
-    }; // clsss JsonBasic::TypeMismatchException
+        template<typename UserValueType>
+        const UserValueType& getUserValue() const
+        {
+            JSONITY_TYPE_CHECK(isUserValue() || isUserValuePtr());
 
-    //-----------------------------------------------------------------------//
-    // JsonBasic::EncodeStyle
-    //-----------------------------------------------------------------------//
+            UserValueType* userValue =
+                dynamic_cast<UserValueType*>(data().user_);
 
-    class EncodeStyle
-    {
-    public:
-        EncodeStyle()
-        {
-            style_ = 0;
-            separator_ = JSONITY_CHAR(' ');
-            setPrettyStyle();
-        }
+            JSONITY_TYPE_CHECK(userValue != NULL);
 
-        static const uint32_t IndentStyle = 0x01;
-        static const uint32_t NewLineStyle = 0x02;
-        static const uint32_t QuatStyle = 0x04;
-        static const uint32_t EscapeCtrlCharStyle = 0x08;
-        static const uint32_t PrintNewLineStyle = 0x10;
-        static const uint32_t CRLFStyle = 0x100;
+            return *userValue;
+        }
 
-    public:
-        void setPrettyStyle()
+        template<typename UserValueType>
+        UserValueType* getUserValuePtr()
         {
-            setIndent(true);
-            setNewLine(true);
-            setEscapeCtrlChar(false);
-            setQuat(false);
-            setPrintNewLine(false);
+            JSONITY_TYPE_CHECK(isUserValue() || isUserValuePtr());
+            return dynamic_cast<UserValueType*>(data().user_);
         }
 
-        void setIndent(bool enable,
-                       char_t indentChar = JSONITY_CHAR(' '),
-                       size_t indentCharCount = 4)
+        template<typename UserValueType>
+        const UserValueType* getUserValue() const
         {
-            if (enable)
-            {
-                style_ |= IndentStyle;
-            }
-            else
-            {
-                style_ &= ~IndentStyle;
-            }
-
-            indentChar_ = indentChar;
-            indentCharCount_ = indentCharCount;
+            JSONITY_TYPE_CHECK(isUserValue() || isUserValuePtr());
+            return dynamic_cast<UserValueType*>(data().user_);
         }
 
-        void setNewLine(bool enable,
-#ifdef JSONITY_OS_WINDOWS
-                        bool CRLF = true)
-#else
-                        bool CRLF = false)
-#endif
-        {
-            if (enable)
-            {
-                style_ |= NewLineStyle;
-            }
-            else
-            {
-                style_ &= ~NewLineStyle;
-            }
+    public:
 
-            if (CRLF)
-            {
-                style_ |= CRLFStyle;
-            }
-            else
-            {
-                style_ &= ~CRLFStyle;
-            }
-        }
+        // Setter
 
-        void setEscapeCtrlChar(bool enable)
+        void setNumber(int32_t number)
         {
-            if (enable)
-            {
-                style_ |= EscapeCtrlCharStyle;
-            }
-            else
-            {
-                style_ &= ~EscapeCtrlCharStyle;
-            }
+            destroy();
+            assignNumber(number);
         }
 
-        void setQuat(bool enable)
+        void setNumber(int64_t number)
         {
-            if (enable)
-            {
-                style_ |= QuatStyle;
-            }
-            else
-            {
-                style_ &= ~QuatStyle;
-            }
+            destroy();
+            assignNumber(number);
         }
 
-        void setPrintNewLine(bool enable)
+        void setString(const char_t* str)
         {
-            if (enable)
-            {
-                style_ |= PrintNewLineStyle;
-            }
-            else
-            {
-                style_ &= ~PrintNewLineStyle;
-            }
+            destroy();
+            assignString(str);
         }
 
-    private:
-        char_t getIndentChar() const
+        void setString(const String& str)
         {
-            return indentChar_;
+            destroy();
+            assignString(str.c_str(), str.length());
         }
 
-        size_t getIndentCharCount() const
+#ifdef JSONITY_SUPPORT_CXX_11
+        void setString(String&& str)
         {
-            return indentCharCount_;
+            destroy();
+            assignString(std::move(str));
         }
+#endif
 
-        char_t getSeparatorChar() const
+        void setBoolean(bool boolean)
         {
-            return separator_;
+            destroy();
+            assignBoolean(boolean);
         }
 
-        bool isCRLF() const
+        void setReal(double real)
         {
-            return ((style_ & CRLFStyle) == CRLFStyle);
+            destroy();
+            assignReal(real);
         }
 
-        bool isEnableIndent() const
+        template<typename KeyType, typename ValueType>
+        void setObject(const std::map<KeyType, ValueType>& map)
         {
-            return ((style_ & IndentStyle) == IndentStyle);
+            destroy();
+            assignObject(map);
         }
 
-        bool isEnableNewLine() const
+        void setArray(const Array& arr)
         {
-            return ((style_ & NewLineStyle) ==
-                NewLineStyle);
+            destroy();
+            assignArray(arr);
         }
 
-        bool isEnableEscape() const
+        void setObject(const Object& obj)
         {
-            return ((style_ & EscapeCtrlCharStyle) ==
-                EscapeCtrlCharStyle);
+            destroy();
+            assignObject(obj);
         }
 
-        bool isEnableQuat() const
+#ifdef JSONITY_SUPPORT_CXX_11
+        // The moved container is owned as it is, including its allocator.
+
+        void setArray(Array&& arr)
         {
-            return ((style_ & QuatStyle) == QuatStyle);
+            destroy();
+            assignArray(std::move(arr));
         }
 
-        bool isEnablePrintNewLine() const
+        void setObject(Object&& obj)
         {
-            return ((style_ & PrintNewLineStyle) ==
-                PrintNewLineStyle);
+            destroy();
+            assignObject(std::move(obj));
         }
 
-        char_t separator_;
-        char_t indentChar_;
-        size_t indentCharCount_;
-        uint32_t style_;
-
-        friend class JsonBase;
-
-    }; // JsonBasic::EncodeStyle
-
-public:
-
-    //-----------------------------------------------------------------------//
-    // JsonBasic::EncodeContext
-    //-----------------------------------------------------------------------//
-
-    class EncodeContext
-    {
-    public:
-        EncodeContext(OStream& os, const EncodeStyle* style = NULL)
-            : os_(os)
+        template<typename KeyType, typename ValueType>
+        void setObject(std::map<KeyType, ValueType>&& map)
         {
-            indent_ = 0;
-            style_ = style;
+            destroy();
+            moveObject(map);
         }
+#endif
 
-		virtual ~EncodeContext() {}
-
-    public:
-
-        OStream& getOutputStream()
+        void setUserValue(const UserValueBase& userValue)
         {
-            return os_;
+            destroy();
+            assignUserValue(userValue);
         }
 
-    protected:
+        void setUserValue(UserValueBase* userValue)
+        {
+            destroy();
+            assignUserValuePtr(userValue);
+        }
 
-        virtual void increaseIndent()
+        void setValue(const Value& value)
         {
-            ++indent_;
+            if (this == &value)
+            {
+                return;
+            }
+            destroy();
+            assignValue(value);
         }
 
-        virtual void decreaseIndent()
+        void setValue(const Value& value, MemoryResource* resource)
         {
-            --indent_;
+            if (this == &value)
+            {
+                return;
+            }
+            destroy();
+            assignValue(value, resource);
         }
 
-        virtual void writeIndent()
+        // Moves the strings and containers of this value and everything
+        // below it to reference counted storage. Copies then share it,
+        // and non-const access copies only the level it goes through.
+        void makeShared()
         {
-            if (style_->isEnableIndent())
+            if (isShared())
             {
-                String indentStr;
-                indentStr.assign(
-                    style_->getIndentCharCount() * indent_,
-                    style_->getIndentChar());
+                return;
+            }
 
-                writeString(indentStr.c_str(), indentStr.size());
+            if (isString())
+            {
+                String* str = allocateShared<String>();
+                str->assign(getCString(), getStringLength());
+
+                destroy();
+                setType(StringType);
+                data().str_ = str;
+                layout_.flags_ = SharedFlag;
             }
+            else if (isArray())
+            {
+                unpack();
+                Array* arr = allocateShared<Array>();
 
-            if (style_->isEnableNewLine())
+                if (data().arr_ != NULL)
+                {
+                    Array& src = *data().arr_;
+                    arr->resize(src.size());
+
+                    for (size_t index = 0; index < src.size(); ++index)
+                    {
+                        (*arr)[index].swapLayout(src[index]);
+                        (*arr)[index].makeShared();
+                    }
+                }
+
+                destroy();
+                setType(ArrayType);
+                data().arr_ = arr;
+                layout_.flags_ = SharedFlag;
+            }
+            else if (isObject())
             {
-                if (style_->isEnableQuat())
+                Object* obj = allocateShared<Object>();
+
+                if (data().obj_ != NULL)
                 {
-                    writeChar(JSONITY_CHAR('"'));
+                    for (typename Object::iterator it = data().obj_->begin();
+                        it != data().obj_->end(); ++it)
+                    {
+                        typename Object::iterator dest = obj->insert(
+                            obj->end(),
+                            typename Object::value_type(it->first, Value()));
+                        dest->second.swapLayout(it->second);
+                        dest->second.makeShared();
+                    }
                 }
+
+                destroy();
+                setType(ObjectType);
+                data().obj_ = obj;
+                layout_.flags_ = SharedFlag;
             }
         }
 
-        virtual void writeNewLine()
+        bool isShared() const
         {
-            if (style_->isEnablePrintNewLine())
+            return ((layout_.flags_ & SharedFlag) != 0);
+        }
+
+    public:
+
+        void clear()
+        {
+            if (isShared())
             {
-                static const char_t str[] =
-                {
-                    JSONITY_CHAR('\\'),
-                    JSONITY_CHAR('r'),
-                    JSONITY_CHAR('\\'),
-                    JSONITY_CHAR('n'),
-                };
+                // Drops the reference rather than copying what is cleared.
+                Type type = getType();
+                destroy();
 
-                if (style_->isCRLF())
+                if (type == StringType)
                 {
-                    writeString(str, 4);
+                    assignString(NULL, 0);
+                }
+                else if (type == ArrayType)
+                {
+                    assignEmptyArray(NULL);
                 }
                 else
                 {
-                    writeString(&str[2], 2);
+                    assignEmptyObject(NULL);
                 }
             }
-
-            if (style_->isEnableNewLine())
+            else if (isPackedNumbers())
             {
-                if (style_->isEnableQuat())
+                data().numbers_->clear();
+            }
+            else if (isPackedReals())
+            {
+                data().reals_->clear();
+            }
+            else if (isArray())
+            {
+                if (data().arr_ != NULL)
                 {
-                    writeChar(JSONITY_CHAR('"'));
+                    data().arr_->clear();
                 }
-
-                static const char_t str[] =
+            }
+            else if (isObject())
+            {
+                if (data().obj_ != NULL)
                 {
-                    JSONITY_CHAR('\r'),
-                    JSONITY_CHAR('\n'),
-                };
+                    data().obj_->clear();
+                }
+            }
+            else if (isString())
+            {
+                getString().clear();
+            }
+            else if (isNumber())
+            {
+                setNumber(0);
+            }
+            else if (isBoolean())
+            {
+                setBoolean(false);
+            }
+            else if (isReal())
+            {
+                setReal(0.0);
+            }
+        }
 
-                if (style_->isCRLF())
+        // Strings and arrays, std::map has no capacity to reserve.
+        void reserve(size_t size)
+        {
+            if (isString())
+            {
+                getString().reserve(size);
+            }
+            else if (isPackedNumbers())
+            {
+                data().numbers_->reserve(size);
+            }
+            else if (isPackedReals())
+            {
+                data().reals_->reserve(size);
+            }
+            else if (isArray())
+            {
+                getArray().reserve(size);
+            }
+            else
+            {
+                JSONITY_TYPE_CHECK(isObject());
+            }
+        }
+
+        // Frees the spare capacity of a string or an array, and the
+        // container of an empty array or object. Shared values and
+        // values from a MemoryResource are left as they are.
+        void shrinkToFit()
+        {
+            if (isShared() || isResourceValue())
+            {
+                return;
+            }
+
+            if (isString())
+            {
+                String* str = data().str_;
+
+#ifdef JSONITY_SUPPORT_CXX_11
+                str->shrink_to_fit();
+#else
+                String(*str).swap(*str);
+#endif
+            }
+            else if (isPackedNumbers())
+            {
+                NumberArray(*data().numbers_).swap(*data().numbers_);
+            }
+            else if (isPackedReals())
+            {
+                RealArray(*data().reals_).swap(*data().reals_);
+            }
+            else if (isArray() && (data().arr_ != NULL))
+            {
+                Array* arr = data().arr_;
+
+                if (arr->empty())
                 {
-                    writeString(str, 2);
+                    delete arr;
+                    data().arr_ = NULL;
                 }
                 else
                 {
-                    writeString(&str[1], 1);
+#ifdef JSONITY_SUPPORT_CXX_11
+                    arr->shrink_to_fit();
+#else
+                    Array(*arr).swap(*arr);
+#endif
+                }
+            }
+            else if (isObject() && (data().obj_ != NULL))
+            {
+                if (data().obj_->empty())
+                {
+                    delete data().obj_;
+                    data().obj_ = NULL;
                 }
             }
         }
 
-        virtual void writeSeparator()
+        // shrinkToFit() on this value and everything below it.
+        void compact()
         {
-            writeChar(style_->getSeparatorChar());
-        }
+            if (isShared())
+            {
+                return;
+            }
 
-        virtual void writeEscape()
-        {
-            if (style_->isEnableEscape())
+            if (isArray() && !isPacked() && (data().arr_ != NULL))
             {
-                writeChar(JSONITY_CHAR('\\'));
+                for (typename Array::iterator it = data().arr_->begin();
+                    it != data().arr_->end(); ++it)
+                {
+                    it->compact();
+                }
+            }
+            else if (isObject() && (data().obj_ != NULL))
+            {
+                for (typename Object::iterator it = data().obj_->begin();
+                    it != data().obj_->end(); ++it)
+                {
+                    it->second.compact();
+                }
             }
+
+            shrinkToFit();
         }
 
-    private:
-        void writeString(const char_t* str, size_t size)
+        bool isEmpty() const
         {
-            getOutputStream().write(str, size);
+            if (isPacked())
+            {
+                return (getPackedSize() == 0);
+            }
+            else if (isArray())
+            {
+                return getArray().empty();
+            }
+            else if (isObject())
+            {
+                return getObject().empty();
+            }
+            else if (isString())
+            {
+                return (getStringLength() == 0);
+            }
+            else if (isNumber())
+            {
+                return (getNumber() == 0);
+            }
+            else if (isBoolean())
+            {
+                return (getBoolean() == false);
+            }
+            else if (isReal())
+            {
+                return (getReal() == 0.0);
+            }
+
+            return true;
         }
 
-        void writeChar(char_t ch)
+        size_t getSize() const
         {
-            writeString(&ch, 1);
+            if (isPacked())
+            {
+                return getPackedSize();
+            }
+            else if (isArray())
+            {
+                return getArray().size();
+            }
+            else if (isObject())
+            {
+                return getObject().size();
+            }
+            else if (isString())
+            {
+                return getStringLength();
+            }
+            else
+            {
+                JSONITY_THROW_TYPE_MISMATCH();
+            }
         }
 
-    private:
-        OStream& os_;
-        size_t indent_;
-        const EncodeStyle* style_;
+    public:
 
-        EncodeContext(const EncodeContext&);
-        EncodeContext& operator=(const EncodeContext&);
+        // Convert
 
-        friend class JsonBase;
+        int64_t toNumber() const
+        {
+            if (isString())
+            {
+                int64_t number = 0;
+                stringToInt(String(getCString(), getStringLength()), number);
+                return number;
+            }
+            else if (isNumber() || isReal() || isBoolean())
+            {
+                return getNumber();
+            }
+            else
+            {
+                JSONITY_THROW_TYPE_MISMATCH();
+            }
+        }
 
-    }; // JsonBasic::EncodeContext
+        String toString() const
+        {
+            if (isNumber())
+            {
+                OStringStream oss;
+                intToStream(getNumber(), oss);
+                return oss.str();
+            }
+            else if (isReal())
+            {
+                OStringStream oss;
+                doubleToStream(getReal(), oss);
+                return oss.str();
+            }
+            else if (isBoolean())
+            {
+                return String(1, (getBoolean() ?
+                    JSONITY_CHAR('1') : JSONITY_CHAR('0')));
+            }
+            else if (isString())
+            {
+                return String(getCString(), getStringLength());
+            }
+            else
+            {
+                JSONITY_THROW_TYPE_MISMATCH();
+            }
+        }
 
-    class UnreadableEncodeContext : public EncodeContext
-    {
-    public:
-        UnreadableEncodeContext(OStream& os)
-            : EncodeContext(os) {}
     public:
-        void increaseIndent() {}
-        void decreaseIndent() {}
-        void writeIndent() {}
-        void writeNewLine() {}
-        void writeSeparator() {}
-        void writeEscape() {}
-    };
-
-public:
-
-    //-----------------------------------------------------------------------//
-    // JsonBase public methods
-    //-----------------------------------------------------------------------//
-
-    // Decode
 
-    static bool decode(IStream& is, Value& value,
-                       Error* error = NULL)
-    {
-        StreamDecodeContext ctx(is);
+        // Getter without exceptions, numbers and booleans convert as
+        // with getNumber(), getReal() and getBoolean().
 
-        if (!decodeValue(ctx, value))
+        bool tryGetNumber(int64_t& number) const
         {
-            if (error != NULL)
+            if (isNumber() || isReal() || isBoolean())
             {
-                ctx.getError(*error);
+                number = getNumber();
+                return true;
             }
-
             return false;
         }
 
-        return true;
-    }
-
-    static bool decode(const char_t* jsonStr, Value& value,
-                       Error* error = NULL)
-    {
-        StringDecodeContext ctx(jsonStr);
+        bool tryGetReal(double& real) const
+        {
+            if (isNumber() || isReal() || isBoolean())
+            {
+                real = getReal();
+                return true;
+            }
+            return false;
+        }
 
-        if (!decodeValue(ctx, value))
+        bool tryGetBoolean(bool& boolean) const
         {
-            if (error != NULL)
+            if (isNumber() || isReal() || isBoolean())
             {
-                ctx.getError(*error);
+                boolean = getBoolean();
+                return true;
             }
+            return false;
+        }
 
+        bool tryGetString(StringRef& str) const
+        {
+            if (isString())
+            {
+                str = StringRef(getCString(), getStringLength());
+                return true;
+            }
             return false;
         }
 
-        return true;
-    }
+        // The const pointer getters never allocate: they are NULL for
+        // a packed array, read it with getNumbers(), getReals() or
+        // tryGet(index, element). The non-const ones unpack it first,
+        // like getArray(), and so may allocate.
+        String* tryGetString()
+        {
+            return (isString() ? &getString() : NULL);
+        }
 
-    static bool decode(const String& jsonStr, Value& value,
-                       Error* error = NULL)
-    {
-        return decode(jsonStr.c_str(), value, error);
-    }
-
-
-    // Encode
-
-    static void encode(const Value& value, OStream& os,
-                       const EncodeStyle* style = NULL)
-    {
-        if (style == NULL)
+        const String* tryGetString() const
         {
-            UnreadableEncodeContext ctx(os);
-            encodeValue(ctx, value);
+            return (isString() ? data().str_ : NULL);
         }
-        else
+
+        Array* tryGetArray()
         {
-            EncodeContext ctx(os, style);
-            ctx.writeIndent();
-            encodeValue(ctx, value);
-            ctx.writeNewLine();
+            return (isArray() ? &getArray() : NULL);
         }
-    }
-
-    static void encode(const Value& value, String& jsonStr,
-                       const EncodeStyle* style = NULL)
-    {
-        OStringStream oss;
-        encode(value, oss, style);
-        jsonStr = oss.str();
-    }
-
-
-    // Equal
 
-    static bool equal(const Value& value, const char_t* jsonStr,
-                      bool ignoreOrder = true, Error* error = NULL)
-    {
-        Value jsonValue;
-     
-        if (!decode(jsonStr, jsonValue, error))
+        const Array* tryGetArray() const
         {
-            return false;
+            return ((isArray() && !isPacked()) ? &getArray() : NULL);
         }
 
-        return (value.compare(jsonValue, ignoreOrder) == 0);
-    }
-
-    static bool equal(const Value& value, const String& jsonStr,
-                      bool ignoreOrder = true, Error* error = NULL)
-    {
-        return equal(value, jsonStr.c_str(), ignoreOrder, error);
-    }
-
+        Object* tryGetObject()
+        {
+            return (isObject() ? &getObject() : NULL);
+        }
 
-    // Null value
-    static const Value& null()
-    {
-        static const Value nullValue;
-        return nullValue;
-    }
+        const Object* tryGetObject() const
+        {
+            return (isObject() ? &getObject() : NULL);
+        }
 
-public:
+        // The member, or NULL if this is not an object or has no
+        // such member.
+        const Value* tryGet(const StringRef& name) const
+        {
+            return (isObject() ? get(name) : NULL);
+        }
 
-    // Encoder
+        Value* tryGet(const StringRef& name)
+        {
+            return (isObject() ? get(name) : NULL);
+        }
 
-    static void encodeNull(EncodeContext& ctx)
-    {
-        static const char_t str[] =
+        const Value* tryGet(const Key& key) const
         {
-            JSONITY_CHAR('n'),
-            JSONITY_CHAR('u'),
-            JSONITY_CHAR('l'),
-            JSONITY_CHAR('l'),
-        };
+            return (isObject() ? get(key) : NULL);
+        }
 
-        ctx.writeString(str, 4);
-    }
+        const Value* tryGet(Key& key) const
+        {
+            return (isObject() ? get(key) : NULL);
+        }
 
-    static void encodeNumber(EncodeContext& ctx, int64_t number)
-    {
-        intToStream(number, ctx.getOutputStream());
-    }
+        Value* tryGet(const Key& key)
+        {
+            return (isObject() ? get(key) : NULL);
+        }
 
-    static void encodeString(EncodeContext& ctx, const String& str)
-    {
-        ctx.writeEscape();
-        ctx.writeChar(JSONITY_CHAR('\"'));
+        Value* tryGet(Key& key)
+        {
+            return (isObject() ? get(key) : NULL);
+        }
 
-        const char_t* cur = str.c_str();
-        const char_t* head = cur;
+        // The element, or NULL if this is not an array or index is
+        // out of range. The const overload is NULL for a packed array,
+        // whose elements have no Value, copy them with the overload
+        // below.
+        const Value* tryGet(size_t index) const
+        {
+            return ((isArray() && !isPacked() && (index < getSize())) ?
+                &getArray()[index] : NULL);
+        }
 
-        while ((*cur) != JSONITY_CHAR('\0'))
+        Value* tryGet(size_t index)
         {
-            char_t escapePairCh = JSONITY_CHAR('\0');
+            return ((isArray() && (index < getSize())) ?
+                &getArray()[index] : NULL);
+        }
 
-            if ((*cur) == JSONITY_CHAR('"'))
-            {
-                escapePairCh = JSONITY_CHAR('\"');
-            }
-            else if ((*cur) == JSONITY_CHAR('\\'))
-            {
-                escapePairCh = JSONITY_CHAR('\\');
-            }
-            else if ((*cur) == JSONITY_CHAR('/'))
-            {
-                escapePairCh = JSONITY_CHAR('/');
-            }
-            else if ((*cur) == JSONITY_CHAR('\b'))
-            {
-                escapePairCh = JSONITY_CHAR('b');
-            }
-            else if ((*cur) == JSONITY_CHAR('\f'))
-            {
-                escapePairCh = JSONITY_CHAR('f');
-            }
-            else if ((*cur) == JSONITY_CHAR('\n'))
-            {
-                escapePairCh = JSONITY_CHAR('n');
-            }
-            else if ((*cur) == JSONITY_CHAR('\r'))
+        // Copies the element to element, of a packed array too. false if
+        // this is not an array or index is out of range.
+        bool tryGet(size_t index, Value& element) const
+        {
+            if (!isArray() || (index >= getSize()))
             {
-                escapePairCh = JSONITY_CHAR('r');
+                return false;
             }
-            else if ((*cur) == JSONITY_CHAR('\t'))
+            else if (isPacked())
             {
-                escapePairCh = JSONITY_CHAR('t');
+                element = getPackedValue(index);
             }
-            else if (((uint32_t)(*cur) < JSONITY_CHAR(0x20)) ||
-                     ((uint32_t)(*cur) == JSONITY_CHAR(0x7f)))
+            else
             {
-                escapePairCh = JSONITY_CHAR('u');
+                element = getArray()[index];
             }
+            return true;
+        }
 
-            if (escapePairCh != JSONITY_CHAR('\0'))
-            {
-                size_t size = static_cast<size_t>(cur - head);
-                if (size > 0)
-                {
-                    ctx.writeString(head, size);
-                }
+        int64_t getOr(int64_t number) const
+        {
+            tryGetNumber(number);
+            return number;
+        }
 
-                ctx.writeEscape();
+        int32_t getOr(int32_t number) const
+        {
+            int64_t result;
+            return (tryGetNumber(result) ?
+                static_cast<int32_t>(result) : number);
+        }
 
-                char_t escapeStr[2];
-                escapeStr[0] = JSONITY_CHAR('\\');
-                escapeStr[1] = escapePairCh;
+        double getOr(double real) const
+        {
+            tryGetReal(real);
+            return real;
+        }
 
-                ctx.writeString(escapeStr, 2);
+        bool getOr(bool boolean) const
+        {
+            tryGetBoolean(boolean);
+            return boolean;
+        }
 
-                if (escapePairCh == JSONITY_CHAR('u'))
-                {
-                    char_t hexStr[4];
-                    hexStr[0] = JSONITY_CHAR('0');
-                    hexStr[1] = JSONITY_CHAR('0');
-                    encodeHex((uint32_t)(((*cur) & 0xf0) >> 4), hexStr[2]);
-                    encodeHex((uint32_t)(((*cur) & 0x0f)), hexStr[3]);
+        const char_t* getOr(const char_t* str) const
+        {
+            return (isString() ? getCString() : str);
+        }
 
-                    ctx.writeString(hexStr, 4);
-                }
+#ifdef JSONITY_SUPPORT_CXX_17
+        std::optional<int64_t> tryGetNumber() const
+        {
+            int64_t number;
+            return (tryGetNumber(number) ?
+                std::optional<int64_t>(number) : std::nullopt);
+        }
 
-                ++cur;
-                head = cur;
-            }
-            else
-            {
-                ++cur;
-            }
+        std::optional<double> tryGetReal() const
+        {
+            double real;
+            return (tryGetReal(real) ?
+                std::optional<double>(real) : std::nullopt);
         }
 
-        size_t size = static_cast<size_t>(cur - head);
-        if (size > 0)
+        std::optional<bool> tryGetBoolean() const
         {
-            ctx.getOutputStream().write(head, size);
+            bool boolean;
+            return (tryGetBoolean(boolean) ?
+                std::optional<bool>(boolean) : std::nullopt);
         }
+#endif
 
-        ctx.writeEscape();
-        ctx.writeChar(JSONITY_CHAR('\"'));
-    }
+    public:
 
-    static void encodeBoolean(EncodeContext& ctx, bool boolean)
-    {
-        if (boolean)
+        // Array operation
+        
+        Value& operator[](int index)
         {
-            static const char_t str[] =
-            {
-                JSONITY_CHAR('t'),
-                JSONITY_CHAR('r'),
-                JSONITY_CHAR('u'),
-                JSONITY_CHAR('e')
-            };
+            JSONITY_TYPE_CHECK(isArray());
+            JSONITY_ASSERT(index >= 0);
+            JSONITY_ASSERT(getSize() > static_cast<size_t>(index));
+        
+            return getArray()[static_cast<size_t>(index)];
+        }
 
-            ctx.writeString(str, 4);
+        Value& addNewValue()
+        {
+            JSONITY_TYPE_CHECK(isArray());
+#ifdef JSONITY_SUPPORT_CXX_11
+            getArray().emplace_back(Value());
+#else
+            getArray().push_back(Value());
+#endif
+            return getArray().back();
         }
-        else
+
+        // Appends [first, last), pass std::move_iterator to move them.
+        template<typename IteratorType>
+        void addValues(IteratorType first, IteratorType last)
         {
-            static const char_t str[] =
+            JSONITY_TYPE_CHECK(isArray());
+            Array& arr = getArray();
+            for (; first != last; ++first)
             {
-                JSONITY_CHAR('f'),
-                JSONITY_CHAR('a'),
-                JSONITY_CHAR('l'),
-                JSONITY_CHAR('s'),
-                JSONITY_CHAR('e')
-            };
-
-            ctx.writeString(str, 5);
+                arr.push_back(Value(*first));
+            }
         }
-    }
-
-    static void encodeReal(EncodeContext& ctx, double real)
-    {
-        doubleToStream(real, ctx.getOutputStream());
-    }
 
-    static void encodeArray(EncodeContext& ctx, const Array& arr)
-    {
-        ctx.writeChar(JSONITY_CHAR('['));
+#ifdef JSONITY_SUPPORT_CXX_11
+        template<typename... Args>
+        Value& emplaceBack(Args&&... args)
+        {
+            JSONITY_TYPE_CHECK(isArray());
+            Array& arr = getArray();
+            arr.emplace_back(std::forward<Args>(args)...);
+            return arr.back();
+        }
 
-        if (!arr.empty())
+        // Sets the member, constructing the Value in place when
+        // the name is new.
+        template<typename... Args>
+        Value& emplace(String name, Args&&... args)
         {
-            ctx.writeNewLine();
-            ctx.increaseIndent();
+            JSONITY_TYPE_CHECK(isObject());
+            return emplaceMember(getObject(), std::move(name),
+                std::forward<Args>(args)...);
+        }
+#endif
 
-            for (typename Array::const_iterator it = arr.begin();
-                it != arr.end();)
-            {
-                ctx.writeIndent();
+    public:
 
-                encodeValue(ctx, *it);
-                ++it;
+        // Packed arrays
 
-                if (it != arr.end())
-                {
-                    ctx.writeChar(JSONITY_CHAR(','));
-                    ctx.writeNewLine();
-                }
-            }
+        // An array of only integers or only reals can keep them in one
+        // contiguous vector, see DecodeStyle::setPackNumberArrays().
+        // getArray() unpacks it into an Array. The const overload throws
+        // instead, read a packed array through getNumbers() and
+        // getReals(). compare(), hash(), walk() and encoding read it
+        // in place.
+        bool isPacked() const
+        {
+            return (isArray() && ((layout_.flags_ &
+                (PackedNumberFlag | PackedRealFlag)) != 0));
+        }
 
-            ctx.writeNewLine();
-            ctx.decreaseIndent();
-            ctx.writeIndent();
+        bool isPackedNumbers() const
+        {
+            return (isArray() &&
+                ((layout_.flags_ & PackedNumberFlag) != 0));
         }
 
-        ctx.writeChar(JSONITY_CHAR(']'));
-    }
-
-    static void encodeArray(EncodeContext& ctx, const Value& value)
-    {
-        encodeArray(ctx, value.getArray());
-    }
+        bool isPackedReals() const
+        {
+            return (isArray() &&
+                ((layout_.flags_ & PackedRealFlag) != 0));
+        }
 
-    static void encodeObject(EncodeContext& ctx, const Object& obj)
-    {
-        ctx.writeChar(JSONITY_CHAR('{'));
+        Span<const int64_t> getNumbers() const
+        {
+            JSONITY_TYPE_CHECK(isPackedNumbers());
+            const NumberArray& numbers = *data().numbers_;
+            return Span<const int64_t>(
+                numbers.empty() ? NULL : &numbers[0], numbers.size());
+        }
 
-        if (!obj.empty())
+        Span<int64_t> getNumbers()
         {
-            ctx.writeNewLine();
-            ctx.increaseIndent();
+            JSONITY_TYPE_CHECK(isPackedNumbers());
+            NumberArray& numbers = *data().numbers_;
+            return Span<int64_t>(
+                numbers.empty() ? NULL : &numbers[0], numbers.size());
+        }
 
-            for (typename Object::const_iterator it = obj.begin();
-                it != obj.end();)
-            {
-                ctx.writeIndent();
+        Span<const double> getReals() const
+        {
+            JSONITY_TYPE_CHECK(isPackedReals());
+            const RealArray& reals = *data().reals_;
+            return Span<const double>(
+                reals.empty() ? NULL : &reals[0], reals.size());
+        }
 
-                encodeString(ctx, it->first);
+        Span<double> getReals()
+        {
+            JSONITY_TYPE_CHECK(isPackedReals());
+            RealArray& reals = *data().reals_;
+            return Span<double>(
+                reals.empty() ? NULL : &reals[0], reals.size());
+        }
 
-                ctx.writeChar(JSONITY_CHAR(':'));
-                ctx.writeSeparator();
+        // Packs a non-empty array of only integers or only reals,
+        // returns false if it cannot be packed.
+        bool pack()
+        {
+            JSONITY_TYPE_CHECK(isArray());
 
-                encodeValue(ctx, it->second);
+            if (isPacked())
+            {
+                return true;
+            }
+            if (isShared() || isResourceValue() || isEmpty())
+            {
+                return false;
+            }
 
-                ++it;
+            const Array& arr = *data().arr_;
+            Type type = arr.front().getType();
+            if ((type != NumberType) && (type != RealType))
+            {
+                return false;
+            }
+            for (typename Array::const_iterator it = arr.begin();
+                it != arr.end(); ++it)
+            {
+                if (it->getType() != type)
+                {
+                    return false;
+                }
+            }
 
-                if (it != obj.end())
+            Value packed;
+            packed.setType(ArrayType);
+            if (type == NumberType)
+            {
+                packed.data().numbers_ = new NumberArray(arr.size());
+                packed.layout_.flags_ = PackedNumberFlag;
+                for (size_t index = 0; index < arr.size(); ++index)
                 {
-                    ctx.writeChar(JSONITY_CHAR(','));
-                    ctx.writeNewLine();
+                    (*packed.data().numbers_)[index] = arr[index].getNumber();
+                }
+            }
+            else
+            {
+                packed.data().reals_ = new RealArray(arr.size());
+                packed.layout_.flags_ = PackedRealFlag;
+                for (size_t index = 0; index < arr.size(); ++index)
+                {
+                    (*packed.data().reals_)[index] = arr[index].getReal();
                 }
             }
 
-            ctx.writeNewLine();
-            ctx.decreaseIndent();
-            ctx.writeIndent();
+            swapLayout(packed);
+            return true;
         }
 
-        ctx.writeChar(JSONITY_CHAR('}'));
-    }
+        // Turns a packed array into an Array of Values.
+        void unpack()
+        {
+            if (!isPacked())
+            {
+                return;
+            }
 
-    static void encodeObject(EncodeContext& ctx, const Value& value)
-    {
-        encodeObject(ctx, value.getObject());
-    }
+            size_t size = getPackedSize();
+            Array* arr = new Array;
+            arr->reserve(size);
+            for (size_t index = 0; index < size; ++index)
+            {
+                arr->push_back(getPackedValue(index));
+            }
 
-    static void encodeValue(EncodeContext& ctx, const Value& value)
-    {
-        if (value.isNull())
+            destroy();
+            setType(ArrayType);
+            data().arr_ = arr;
+        }
+
+    public:
+
+        // Object operation
+
+        bool hasName(const StringRef& name) const
         {
-            encodeNull(ctx);
+            JSONITY_TYPE_CHECK(isObject());
+            return (getObject().find(name) != getObject().end());
         }
-        else if (value.isNumber())
+
+        // Returns NULL if the member does not exist, nothing is inserted.
+        const Value* get(const StringRef& name) const
         {
-            encodeNumber(ctx, value.getNumber());
+            JSONITY_TYPE_CHECK(isObject());
+
+            typename Object::const_iterator it =
+                getObject().find(name);
+            return ((it != getObject().end()) ? &it->second : NULL);
         }
-        else if (value.isString())
+
+        Value* get(const StringRef& name)
         {
-            encodeString(ctx, value.getString());
+            JSONITY_TYPE_CHECK(isObject());
+
+            typename Object::iterator it = getObject().find(name);
+            return ((it != getObject().end()) ? &it->second : NULL);
         }
-        else if (value.isBoolean())
+
+        bool hasName(const Key& key) const
         {
-            encodeBoolean(ctx, value.getBoolean());
+            return (get(key) != NULL);
         }
-        else if (value.isReal())
+
+        bool hasName(Key& key) const
         {
-            encodeReal(ctx, value.getReal());
+            return (get(key) != NULL);
         }
-        else if (value.isArray())
+
+        const Value* get(const Key& key) const
         {
-            encodeArray(ctx, value.getArray());
+            return findKey(key);
         }
-        else if (value.isObject())
+
+        const Value* get(Key& key) const
         {
-            encodeObject(ctx, value.getObject());
+            return findKey(key);
         }
-        else if (value.isUserValue())
+
+        Value* get(const Key& key)
         {
-            value.encodeUserValue(ctx);
+            return findKey(key);
         }
-        else if (value.isUserValuePtr())
+
+        Value* get(Key& key)
         {
-            value.encodeUserValue(ctx);
+            return findKey(key);
         }
-    }
 
-private:
+        bool find(const StringRef& name, Value& value) const
+        {
+            JSONITY_TYPE_CHECK(isObject());
 
-    class DecodeContext
-    {
-    public:
-        DecodeContext()
+            typename Object::const_iterator it =
+                getObject().find(name);
+            if (it != getObject().end())
+            {
+                value = it->second;
+                return true;
+            }
+
+            return false;
+        }
+
+        // Copies the members named name anywhere in this object into
+        // container. A match is not searched further.
+        template<typename ContainerType>
+        size_t findRecursive(const StringRef& name,
+                             ContainerType& container) const
         {
-            proc_ = 0;
-            errorCode_ = 0;
-            codeLine_ = 0;
+            JSONITY_TYPE_CHECK(isObject());
+
+            NameCopier<ContainerType> copier(name, container);
+            walkValue(NULL, *this, copier);
+
+            return container.size();
         }
 
-        virtual ~DecodeContext() {}
+        // Adds pointers to at most limit matches instead of copies,
+        // returns how many.
+        size_t findRecursive(const StringRef& name,
+                             std::vector<const Value*>& results,
+                             size_t limit = static_cast<size_t>(-1)) const
+        {
+            NameFinder<const Value> finder(name, results, limit);
+            if (limit > 0)
+            {
+                walkValue(NULL, *this, finder);
+            }
+            return finder.count_;
+        }
 
-    public:
-        virtual char_t getCurrentChar() const = 0;
-        virtual void nextChar() = 0;
-        virtual void nextLine() = 0;
-        virtual size_t getCurrentPos() const = 0;
-        virtual void savePos() = 0;
-        virtual size_t readFromSavePos(String& str) const = 0;
+        size_t findRecursive(const StringRef& name,
+                             std::vector<Value*>& results,
+                             size_t limit = static_cast<size_t>(-1))
+        {
+            NameFinder<Value> finder(name, results, limit);
+            if (limit > 0)
+            {
+                walkValue(NULL, *this, finder);
+            }
+            return finder.count_;
+        }
 
-    public:
-        bool isEOF() const
+        // The first match in document order, or NULL.
+        const Value* findFirstRecursive(const StringRef& name) const
         {
-            return (getCurrentChar() == JSONITY_CHAR('\0'));
+            std::vector<const Value*> results;
+            return ((findRecursive(name, results, 1) > 0) ?
+                results[0] : NULL);
         }
 
-        void skipWhiteSpace()
+        Value* findFirstRecursive(const StringRef& name)
         {
-            while (!isEOF())
+            std::vector<Value*> results;
+            return ((findRecursive(name, results, 1) > 0) ?
+                results[0] : NULL);
+        }
+
+        // Calls visitor(name, value) for this value and every value in
+        // it, depth first in document order. name points to the member
+        // name, it is NULL for array elements and this value. Returns
+        // false if the visitor returned WalkStop. Elements of a packed
+        // array are passed as temporaries.
+        template<typename VisitorType>
+        bool walk(VisitorType visitor) const
+        {
+            return walkValue(NULL, *this, visitor);
+        }
+
+        // Shared values are detached on the way, so that the visitor can
+        // change them. It must not add or remove members or elements.
+        template<typename VisitorType>
+        bool walk(VisitorType visitor)
+        {
+            return walkValue(NULL, *this, visitor);
+        }
+
+        // The name is copied into a String only when it is inserted.
+        Value& operator[](const StringRef& name)
+        {
+            if (isNull())
             {
-                if ((getCurrentChar() == JSONITY_CHAR(' ')) ||
-                    (getCurrentChar() == JSONITY_CHAR('\r')) ||
-                    (getCurrentChar() == JSONITY_CHAR('\t')))
-                {
-                    nextChar();
-                    continue;
-                }
-                else if (getCurrentChar() == JSONITY_CHAR('\n'))
+                assignObject(Object());
+            }
+
+            if (isObject())
+            {
+                Object& obj = getObject();
+
+                typename Object::iterator it = obj.find(name);
+                if (it != obj.end())
                 {
-                    nextLine();
-                    continue;
+                    return it->second;
                 }
-                break;
+
+                return obj.insert(std::make_pair(
+                    String(name.data(), name.size()),
+                    Value())).first->second;
+            }
+            else
+            {
+                JSONITY_THROW_TYPE_MISMATCH();
             }
         }
 
-        void setError(int32_t proc, int32_t errorCode,
-                      int32_t codeLine)
+        Value& operator[](const Key& key)
         {
-            proc_ = proc;
-            errorCode_ = errorCode;
-            codeLine_ = codeLine;
-            cur_.setPos(static_cast<uint32_t>(getCurrentPos()));
+            return findOrAddKey(key);
         }
 
-        void getError(Error& error) const
+        Value& operator[](Key& key)
         {
-            error.setError(cur_, proc_, errorCode_, codeLine_);
+            return findOrAddKey(key);
         }
 
-    protected:
-        Cursor cur_;
-        int32_t proc_;
-        int32_t errorCode_;
-        int32_t codeLine_;
-    };
+        Value& operator[](const char_t* name)
+        {
+            return operator[](StringRef(name));
+        }
+
+        Value& operator[](const String& name)
+        {
+            return operator[](StringRef(name));
+        }
 
-    class StringDecodeContext : public DecodeContext
-    {
     public:
-        StringDecodeContext(const char_t* str)
-            : headAddr_(str), curAddr_(str), saveAddr_(NULL)
+
+        // Compare
+
+        int32_t compare(int32_t number,
+                        bool ignoreOrder = true) const
         {
+            ((void)ignoreOrder);
+
+            if (isNumber() || isBoolean())
+            {
+                int64_t self = getNumber();
+                return ((self < number) ? -1 : (self > number));
+            }
+            else if (isReal())
+            {
+                return compare((double)number);
+            }
+            else
+            {
+                JSONITY_THROW_TYPE_MISMATCH();
+            }
+        }
+
+        int32_t compare(int64_t number,
+                        bool ignoreOrder = true) const
+        {
+            ((void)ignoreOrder);
+
+            if (isNumber() || isBoolean())
+            {
+                int64_t self = getNumber();
+                return ((self < number) ? -1 : (self > number));
+            }
+            else if (isReal())
+            {
+                return compare((double)number);
+            }
+            else
+            {
+                JSONITY_THROW_TYPE_MISMATCH();
+            }
+        }
+
+        int32_t compare(const char_t* str,
+                        bool ignoreOrder = true) const
+        {
+            JSONITY_TYPE_CHECK(isString());
+            ((void)ignoreOrder);
+            return compareString(str, CharTraitsType::length(str));
+        }
+
+        int32_t compare(const String& str,
+                        bool ignoreOrder = true) const
+        {
+            JSONITY_TYPE_CHECK(isString());
+            ((void)ignoreOrder);
+            return compareString(str.c_str(), str.size());
+        }
+
+        int32_t compare(bool boolean,
+                        bool ignoreOrder = true) const
+        {
+            ((void)ignoreOrder);
+
+            if (isBoolean() || isNumber() || isReal())
+            {
+                bool self = getBoolean();
+                return ((self < boolean) ? -1 : (self > boolean));
+            }
+            else
+            {
+                JSONITY_THROW_TYPE_MISMATCH();
+            }
+        }
+
+        int32_t compare(double real,
+                        bool ignoreOrder = true) const
+        {
+            ((void)ignoreOrder);
+
+            if (isReal() || isNumber() || isBoolean())
+            {
+                if (getReal() < real)
+                {
+                    return -1;
+                }
+                else if (getReal() > real)
+                {
+                    return 1;
+                }
+                else
+                {
+                    return 0;
+                }
+            }
+            else
+            {
+                JSONITY_THROW_TYPE_MISMATCH();
+            }
+        }
+
+        template<typename ConatainerType>
+        int32_t compare(const ConatainerType& container,
+                        bool ignoreOrder = true) const
+        {
+            JSONITY_TYPE_CHECK(isArray());
+
+            if (getSize() < container.size())
+            {
+                return -1;
+            }
+            else if (getSize() > container.size())
+            {
+                return 1;
+            }
+   
+            typename ConatainerType::const_iterator itOther =
+                container.begin();
+            Value element;
+
+            if (ignoreOrder)
+            {
+                size_t size = getSize();
+                std::vector<bool> matched(size, false);
+
+                for (; itOther != container.end(); ++itOther)
+                {
+                    size_t index = 0;
+
+                    for (; index < size; ++index)
+                    {
+                        if (!matched[index] &&
+                            getElement(index, element).compare(
+                                *itOther, ignoreOrder) == 0)
+                        {
+                            break;
+                        }
+                    }
+
+                    if (index == size)
+                    {
+                        return -1;
+                    }
+
+                    matched[index] = true;
+                }
+            }
+            else
+            {
+                for (size_t index = 0; itOther != container.end();
+                    ++itOther, ++index)
+                {
+                    int32_t result = getElement(index, element).compare(
+                        *itOther, ignoreOrder);
+                    if (result != 0)
+                    {
+                        return result;
+                    }
+                }
+            }
+
+            return 0;
+        }
+
+        int32_t compare(const Array& other,
+                        bool ignoreOrder = true) const
+        {
+            JSONITY_TYPE_CHECK(isArray());
+            return compareElements(other, other.size(), ignoreOrder);
+        }
+
+        template<typename KeyType, typename ValueType>
+        int32_t compare(const std::map<KeyType, ValueType>& map,
+                        bool ignoreOrder = true) const
+        {
+            JSONITY_TYPE_CHECK(isObject());
+
+            if (getSize() < map.size())
+            {
+                return -1;
+            }
+            else if (getSize() > map.size())
+            {
+                return 1;
+            }
+
+            for (typename std::map<KeyType, ValueType>::
+                    const_iterator itOther = map.begin();
+                itOther != map.end(); ++itOther)
+            {
+                Value name(itOther->first);
+
+                typename Object::const_iterator it;
+
+                if (name.isString())
+                {
+                    it = getObject().find(name.getString());
+                }
+                else
+                {
+                    it = getObject().find(name.toString());
+                }
+
+                if (it == getObject().end())
+                {
+                    return -1;
+                }
+
+                int32_t result =
+                    it->second.compare(itOther->second, ignoreOrder);
+                if (result != 0)
+                {
+                    return result;
+                }
+            }
+
+            return 0;
+        }
+
+        int32_t compare(const Object& obj,
+                        bool ignoreOrder = true) const
+        {
+            JSONITY_TYPE_CHECK(isObject());
+
+            if (getSize() < obj.size())
+            {
+                return -1;
+            }
+            else if (getSize() > obj.size())
+            {
+                return 1;
+            }
+
+            return compareMembers(getObject(), obj, ignoreOrder);
+        }
+
+        int32_t compare(const Value& value,
+                        bool ignoreOrder = true) const
+        {
+            if (isNull() && value.isNull())
+            {
+                return 0;
+            }
+            // Booleans compare with numbers as 0 and 1, either way round.
+            else if ((isNumber() || isBoolean()) &&
+                (value.isNumber() || value.isBoolean()))
+            {
+                return compare(value.getNumber());
+            }
+            else if ((isNumber() || isBoolean()) && value.isReal())
+            {
+                return compare(value.getReal());
+            }
+            else if (isString() && value.isString())
+            {
+                return compareString(
+                    value.getCString(), value.getStringLength());
+            }
+            else if (isReal() &&
+                (value.isReal() || value.isNumber() || value.isBoolean()))
+            {
+                return compare(value.getReal());
+            }
+            else if (isShared() && value.isShared() &&
+                (getType() == value.getType()))
+            {
+                return compareShared(value, ignoreOrder);
+            }
+            else if (isArray() && value.isArray())
+            {
+                return compareElements(value, value.getSize(), ignoreOrder);
+            }
+            else if (isObject() && value.isObject())
+            {
+                return compare(value.getObject(), ignoreOrder);
+            }
+            else
+            {
+                JSONITY_THROW_TYPE_MISMATCH();
+            }
+        }
+
+        // Structural hash, equal values hash equally. Object members
+        // and, with ignoreOrder, array elements hash independently of
+        // their order. Shared values, see makeShared(), keep the hash
+        // with ignoreOrder so that it is computed once.
+        uint64_t hash(bool ignoreOrder = true) const
+        {
+            if (!ignoreOrder || !isShared())
+            {
+                return computeHash(ignoreOrder);
+            }
+
+            SharedHeader* header = getSharedHeader();
+            uint64_t cached = header->hash_;
+            if (cached == 0)
+            {
+                cached = computeHash(ignoreOrder);
+                cached = (cached == 0) ? 1 : cached;
+                header->hash_ = cached;
+            }
+            return cached;
+        }
+
+    public:
+
+        // Assignment operator
+
+        Value& operator=(int32_t number)
+        {
+            setNumber(number);
+            return *this;
+        }
+
+        Value& operator=(int64_t number)
+        {
+            setNumber(number);
+            return *this;
+        }
+
+        Value& operator=(const char_t* str)
+        {
+            setString(str);
+            return *this;
+        }
+
+        Value& operator=(const String& str)
+        {
+            setString(str);
+            return *this;
+        }
+
+        Value& operator=(bool boolean)
+        {
+            setBoolean(boolean);
+            return *this;
+        }
+
+        Value& operator=(double real)
+        {
+            setReal(real);
+            return *this;
+        }
+
+        template<typename KeyType, typename ValueType>
+        Value& operator=(const std::map<KeyType, ValueType>& map)
+        {
+            setObject(map);
+            return *this;
+        }
+
+        Value& operator=(const Array& arr)
+        {
+            setArray(arr);
+            return *this;
+        }
+
+        Value& operator=(const Object& obj)
+        {
+            setObject(obj);
+            return *this;
+        }
+
+        Value& operator=(const UserValueBase& userValue)
+        {
+            setUserValue(userValue);
+            return *this;
+        }
+
+        Value& operator=(UserValueBase* userValue)
+        {
+            setUserValue(userValue);
+            return *this;
+        }
+
+        Value& operator=(const UserValueBase* userValue)
+        {
+            setUserPtrValue(userValue);
+            return *this;
+        }
+
+        Value& operator=(const Value& other)
+        {
+            setValue(other);
+            return *this;
+        }
+
+#ifdef JSONITY_SUPPORT_CXX_11
+        Value& operator=(Value&& other)
+        {
+            move(std::move(other));
+            return *this;
+        }
+
+        Value& operator=(String&& str)
+        {
+            setString(std::move(str));
+            return *this;
+        }
+
+        Value& operator=(Array&& arr)
+        {
+            setArray(std::move(arr));
+            return *this;
+        }
+
+        Value& operator=(Object&& obj)
+        {
+            setObject(std::move(obj));
+            return *this;
+        }
+
+        template<typename KeyType, typename ValueType>
+        Value& operator=(std::map<KeyType, ValueType>&& map)
+        {
+            setObject(std::move(map));
+            return *this;
+        }
+#endif
+
+    public:
+
+        // Cast operator
+
+        operator int32_t() const
+        {
+            return static_cast<int32_t>(getNumber());
+        }
+
+        operator int64_t() const
+        {
+            return getNumber();
+        }
+
+        operator const char_t*() const
+        {
+            return getCString();
+        }
+
+        operator String&()
+        {
+            return getString();
+        }
+
+        operator bool() const
+        {
+            return getBoolean();
+        }
+
+        operator double() const
+        {
+            return getReal();
+        }
+
+        operator Array&()
+        {
+            return getArray();
+        }
+
+        operator Object&()
+        {
+            return getArray();
+        }
+
+    public:
+
+        bool operator==(int32_t number) const
+        {
+            return (compare(number) == 0);
+        }
+
+        bool operator==(int64_t number) const
+        {
+            return (compare(number) == 0);
+        }
+
+        bool operator==(const char_t* str) const
+        {
+            return (compare(str) == 0);
+        }
+
+        bool operator==(const String& str) const
+        {
+            return (compare(str) == 0);
+        }
+
+        bool operator==(bool boolean) const
+        {
+            return (compare(boolean) == 0);
+        }
+
+        bool operator==(double real) const
+        {
+            return (compare(real) == 0);
+        }
+
+        template<typename ContainerType>
+        bool operator==(const ContainerType& container) const
+        {
+            return (compare(container) == 0);
+        }
+
+        template<typename KetType, typename ValueType>
+        bool operator==(const std::map<KetType, ValueType>& map) const
+        {
+            return (compare(map) == 0);
+        }
+
+        bool operator==(const Value& value) const
+        {
+            return (compare(value) == 0);
+        }
+
+    public:
+
+        bool operator!=(int32_t number) const
+        {
+            return !operator==(number);
+        }
+
+        bool operator!=(int64_t number) const
+        {
+            return !operator==(number);
+        }
+
+        bool operator!=(const char_t* str) const
+        {
+            return !operator==(str);
+        }
+
+        bool operator!=(const String& str) const
+        {
+            return !operator==(str);
+        }
+
+        bool operator!=(bool boolean) const
+        {
+            return !operator==(boolean);
+        }
+
+        bool operator!=(double real) const
+        {
+            return !operator==(real);
+        }
+
+        template<typename ContainerType>
+        bool operator!=(const ContainerType& container) const
+        {
+            return !operator==(container);
+        }
+
+        template<typename KeyName, typename ValueType>
+        bool operator!=(const std::map<KeyName, ValueType>& map) const
+        {
+            return !operator==(map);
+        }
+
+        bool operator!=(const Value& value) const
+        {
+            return !operator==(value);
+        }
+
+    public:
+
+        bool operator<(int32_t number) const
+        {
+            return (compare(number) < 0);
+        }
+
+        bool operator<(int64_t number) const
+        {
+            return (compare(number) < 0);
+        }
+
+        bool operator<(const char_t* str) const
+        {
+            return (compare(str) < 0);
+        }
+
+        bool operator<(const String& str) const
+        {
+            return (compare(str) < 0);
+        }
+
+        bool operator<(bool boolean) const
+        {
+            return (compare(boolean) < 0);
+        }
+
+        bool operator<(double real) const
+        {
+            return (compare(real) < 0);
+        }
+
+        bool operator<(const Value& other) const
+        {
+            return (compare(other) < 0);
+        }
+
+    public:
+
+        bool operator>(int32_t number) const
+        {
+            return (compare(number) > 0);
+        }
+
+        bool operator>(int64_t number) const
+        {
+            return (compare(number) > 0);
+        }
+
+        bool operator>(const char_t* str) const
+        {
+            return (compare(str) > 0);
+        }
+
+        bool operator>(const String& str) const
+        {
+            return (compare(str) > 0);
+        }
+
+        bool operator>(bool boolean) const
+        {
+            return (compare(boolean) > 0);
+        }
+
+        bool operator>(double real) const
+        {
+            return (compare(real) > 0);
+        }
+
+        bool operator>(const Value& other) const
+        {
+            return (compare(other) > 0);
+        }
+
+    private:
+
+        // KeyType is Key or const Key, see Key.
+
+        template<typename KeyType>
+        const Value* findKey(KeyType& key) const
+        {
+            JSONITY_TYPE_CHECK(isObject());
+
+            Object& obj = const_cast<Object&>(getObject());
+            typename Object::iterator it = findMember(obj, key);
+            return ((it != obj.end()) ? &it->second : NULL);
+        }
+
+        template<typename KeyType>
+        Value* findKey(KeyType& key)
+        {
+            JSONITY_TYPE_CHECK(isObject());
+
+            Object& obj = getObject();
+            typename Object::iterator it = findMember(obj, key);
+            return ((it != obj.end()) ? &it->second : NULL);
+        }
+
+        template<typename KeyType>
+        Value& findOrAddKey(KeyType& key)
+        {
+            if (isObject())
+            {
+                Object& obj = getObject();
+
+                typename Object::iterator it = findMember(obj, key);
+                if (it != obj.end())
+                {
+                    return it->second;
+                }
+            }
+
+            return operator[](StringRef(key.getName()));
+        }
+
+        template<typename ValueType, typename VisitorType>
+        static bool walkValue(const String* name, ValueType& value,
+                              VisitorType& visitor)
+        {
+            int32_t result = visitor(name, value);
+            if (result != WalkContinue)
+            {
+                return (result != WalkStop);
+            }
+
+            if (value.isObject())
+            {
+                const Object& obj = value.getObject();
+                for (typename Object::const_iterator it = obj.begin();
+                    it != obj.end(); ++it)
+                {
+                    if (!walkValue(&it->first,
+                            const_cast<ValueType&>(it->second), visitor))
+                    {
+                        return false;
+                    }
+                }
+            }
+            else if (value.isArray())
+            {
+                return walkElements(value, visitor);
+            }
+            return true;
+        }
+
+        // A const packed array is read in place, its elements are passed
+        // as temporaries.
+        template<typename VisitorType>
+        static bool walkElements(const Value& value, VisitorType& visitor)
+        {
+            if (value.isPacked())
+            {
+                size_t size = value.getPackedSize();
+                for (size_t index = 0; index < size; ++index)
+                {
+                    const Value element = value.getPackedValue(index);
+                    if (!walkValue(NULL, element, visitor))
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            const Array& arr = value.getArray();
+            for (size_t index = 0; index < arr.size(); ++index)
+            {
+                if (!walkValue(NULL, arr[index], visitor))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        template<typename VisitorType>
+        static bool walkElements(Value& value, VisitorType& visitor)
+        {
+            Array& arr = value.getArray();
+            for (size_t index = 0; index < arr.size(); ++index)
+            {
+                if (!walkValue(NULL, arr[index], visitor))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Packed arrays hold numbers only, they are not unpacked.
+
+        template<typename ContainerType>
+        struct NameCopier
+        {
+            NameCopier(const StringRef& name, ContainerType& container)
+                : name_(name), container_(container)
+            {
+            }
+
+            int32_t operator()(const String* name, const Value& value)
+            {
+                if ((name != NULL) && (StringRef(*name) == name_))
+                {
+                    container_.push_back(value);
+                    return WalkPrune;
+                }
+                else if (value.isPacked())
+                {
+                    return WalkPrune;
+                }
+                return WalkContinue;
+            }
+
+            StringRef name_;
+            ContainerType& container_;
+        };
+
+        template<typename ValueType>
+        struct NameFinder
+        {
+            NameFinder(const StringRef& name,
+                       std::vector<ValueType*>& results, size_t limit)
+                : name_(name), results_(results), limit_(limit), count_(0)
+            {
+            }
+
+            int32_t operator()(const String* name, ValueType& value)
+            {
+                if ((name != NULL) && (StringRef(*name) == name_))
+                {
+                    results_.push_back(&value);
+                    if (++count_ == limit_)
+                    {
+                        return WalkStop;
+                    }
+                    return WalkPrune;
+                }
+                else if (value.isPacked())
+                {
+                    return WalkPrune;
+                }
+                return WalkContinue;
+            }
+
+            StringRef name_;
+            std::vector<ValueType*>& results_;
+            size_t limit_;
+            size_t count_;
+        };
+
+        const UserValueBase& getUserValueBase() const
+        {
+            JSONITY_TYPE_CHECK(isUserValue());
+            return *data().user_;
+        }
+
+        const UserValueBase* getUserValueBasePtr() const
+        {
+            JSONITY_TYPE_CHECK(isUserValuePtr());
+            return data().user_;
+        }
+
+        void encodeUserValue(EncodeContext& ctx) const
+        {
+            JSONITY_ASSERT(
+                isUserValue() || isUserValuePtr());
+            data().user_->encode(ctx);
+        }
+
+    private:
+
+        void assignNull()
+        {
+            setType(NullType);
+        }
+
+        void assignNumber(int64_t number)
+        {
+            setType(NumberType);
+            data().n_ = number;
+        }
+
+        void assignString(const char_t* str, size_t length)
+        {
+            setType(StringType);
+            data().str_ = new String(str, length);
+        }
+
+        void assignString(const char_t* str)
+        {
+            assignString(str, CharTraitsType::length(str));
+        }
+
+        void assignBoolean(bool boolean)
+        {
+            setType(BooleanType);
+            data().b_ = boolean;
+        }
+
+        void assignReal(double real)
+        {
+            setType(RealType);
+            data().d_ = real;
+        }
+
+        // Empty arrays and objects have no container until
+        // something is added to them.
+
+        void assignArray(const Array& arr)
+        {
+            setType(ArrayType);
+            data().arr_ = (arr.empty() ?
+                NULL : new Array(arr.begin(), arr.end()));
+        }
+
+        void assignObject(const Object& obj)
+        {
+            setType(ObjectType);
+            data().obj_ = (obj.empty() ? NULL : copyObject(obj));
+        }
+
+        template<typename ContainerType>
+        void assignArray(const ContainerType& container)
+        {
+            setType(ArrayType);
+            data().arr_ = NULL;
+
+            if (container.begin() == container.end())
+            {
+                return;
+            }
+
+            data().arr_ = new Array;
+
+            std::copy(container.begin(), container.end(),
+                std::inserter(getArray(), getArray().end()));
+        }
+
+#ifdef JSONITY_SUPPORT_CXX_11
+        void assignString(String&& str)
+        {
+            setType(StringType);
+            data().str_ = new String(std::move(str));
+        }
+
+        void assignArray(Array&& arr)
+        {
+            setType(ArrayType);
+            data().arr_ = (arr.empty() ?
+                NULL : new Array(std::move(arr)));
+        }
+
+        void assignObject(Object&& obj)
+        {
+            setType(ObjectType);
+            data().obj_ = (obj.empty() ?
+                NULL : new Object(std::move(obj)));
+        }
+
+        template<typename ContainerType>
+        void moveArray(ContainerType& container)
+        {
+            setType(ArrayType);
+            data().arr_ = NULL;
+
+            if (container.begin() == container.end())
+            {
+                return;
+            }
+
+            data().arr_ = new Array;
+            data().arr_->reserve(
+                std::distance(container.begin(), container.end()));
+
+            for (auto it = container.begin(); it != container.end(); ++it)
+            {
+                data().arr_->emplace_back(std::move(*it));
+            }
+        }
+
+        template<typename KeyType, typename ValueType>
+        void moveObject(std::map<KeyType, ValueType>& map)
+        {
+            setType(ObjectType);
+            data().obj_ = NULL;
+
+            if (map.empty())
+            {
+                return;
+            }
+
+            data().obj_ = new Object;
+
+            for (auto it = map.begin(); it != map.end(); ++it)
+            {
+                Value name(it->first);
+
+                if (name.isString())
+                {
+                    getObject()[std::move(name.getString())] =
+                        std::move(it->second);
+                }
+                else
+                {
+                    getObject()[name.toString()] = std::move(it->second);
+                }
+            }
+        }
+#endif
+
+        template<typename KeyType, typename ValueType>
+        void assignObject(const std::map<KeyType, ValueType>& map)
+        {
+            setType(ObjectType);
+            data().obj_ = NULL;
+
+            if (map.empty())
+            {
+                return;
+            }
+
+            data().obj_ = new Object;
+
+            for (typename std::map<KeyType, ValueType>::const_iterator it =
+                    map.begin();
+                it != map.end(); ++it)
+            {
+                Value name(it->first);
+
+                if (name.isString())
+                {
+                    getObject()[name.getString()] = it->second;
+                }
+                else
+                {
+                    getObject()[name.toString()] = it->second;
+                }
+            }
+        }
+
+        void assignUserValue(const UserValueBase& userValue)
+        {
+            setType(UserType);
+            data().user_ = userValue.duplicate();
+        }
+
+        void assignUserValuePtr(const UserValueBase* userValue)
+        {
+            setType(UserPtrType);
+            data().user_ = const_cast<UserValueBase*>(userValue);
+        }
+
+        void assignValue(const Value& value)
+        {
+            if (value.isShared())
+            {
+                ++value.getSharedHeader()->refCount_;
+                layout_ = value.layout_;
+            }
+            else if (value.isNumber())
+            {
+                assignNumber(value.getNumber());
+            }
+            else if (value.isString())
+            {
+                assignString(value.getCString(), value.getStringLength());
+            }
+            else if (value.isBoolean())
+            {
+                assignBoolean(value.getBoolean());
+            }
+            else if (value.isReal())
+            {
+                assignReal(value.getReal());
+            }
+            else if (value.isPackedNumbers())
+            {
+                setType(ArrayType);
+                data().numbers_ = new NumberArray(*value.data().numbers_);
+                layout_.flags_ = PackedNumberFlag;
+            }
+            else if (value.isPackedReals())
+            {
+                setType(ArrayType);
+                data().reals_ = new RealArray(*value.data().reals_);
+                layout_.flags_ = PackedRealFlag;
+            }
+            else if (value.isArray())
+            {
+                assignArray(value.getArray());
+            }
+            else if (value.isObject())
+            {
+                assignObject(value.getObject());
+            }
+            else if (value.isUserValue())
+            {
+                assignUserValue(value.getUserValueBase());
+            }
+            else if (value.isUserValuePtr())
+            {
+                assignUserValuePtr(value.getUserValueBasePtr());
+            }
+            else
+            {
+                assignNull();
+            }
+        }
+
+#ifdef JSONITY_SUPPORT_CXX_11
+        void move(Value&& other)
+        {
+            if (this == &other)
+            {
+                return;
+            }
+            destroy();
+            layout_ = other.layout_;
+            other.setType(NullType);
+        }
+#endif
+
+    private:
+
+#ifdef JSONITY_SUPPORT_CXX_11
+        // emplace() into a std::map builds the Value in its node.
+        template<typename CompareType, typename AllocatorType,
+                 typename... Args>
+        static Value& emplaceMember(
+            std::map<String, Value, CompareType, AllocatorType>& obj,
+            String&& name, Args&&... args)
+        {
+            typename Object::iterator it = obj.lower_bound(name);
+            if ((it != obj.end()) && !obj.key_comp()(name, it->first))
+            {
+                it->second = Value(std::forward<Args>(args)...);
+                return it->second;
+            }
+
+            it = obj.emplace_hint(it, std::piecewise_construct,
+                std::forward_as_tuple(std::move(name)),
+                std::forward_as_tuple(std::forward<Args>(args)...));
+            return it->second;
+        }
+
+        // The vector backed layouts move their entries when they grow,
+        // the Value is built once and moved in.
+        template<typename ObjectType, typename... Args>
+        static Value& emplaceMember(ObjectType& obj, String&& name,
+                                    Args&&... args)
+        {
+            typename Object::iterator it = obj.find(name);
+            if (it != obj.end())
+            {
+                it->second = Value(std::forward<Args>(args)...);
+                return it->second;
+            }
+
+            return obj.insert(std::make_pair(std::move(name),
+                Value(std::forward<Args>(args)...))).first->second;
+        }
+#endif
+
+    private:
+
+        // MemoryResource storage
+
+        bool isResourceValue() const
+        {
+            return ((layout_.flags_ & ResourceFlag) != 0);
+        }
+
+        // A string from a resource is preceded by the resource that
+        // has to take it back.
+        static const size_t ResourceHeaderSize = 16;
+
+        void assignString(const char_t* str, size_t length,
+                          MemoryResource* resource)
+        {
+            if (resource == NULL)
+            {
+                assignString(str, length);
+                return;
+            }
+
+            char* block = static_cast<char*>(
+                resource->allocate(ResourceHeaderSize + sizeof(String)));
+            *reinterpret_cast<MemoryResource**>(block) = resource;
+
+            setType(StringType);
+            data().str_ = new (block + ResourceHeaderSize)
+                String(str, length,
+                    ResourceAllocator<CharAllocatorType>::create(resource));
+            layout_.flags_ = ResourceFlag;
+        }
+
+        void assignEmptyArray(MemoryResource* resource)
+        {
+            setType(ArrayType);
+            data().arr_ = NULL;
+
+            if (resource != NULL)
+            {
+                data().arr_ = new (resource->allocate(sizeof(Array)))
+                    Array(typename Array::allocator_type(resource));
+                layout_.flags_ = ResourceFlag;
+            }
+        }
+
+        void assignEmptyObject(MemoryResource* resource)
+        {
+            setType(ObjectType);
+            data().obj_ = NULL;
+
+            if (resource != NULL)
+            {
+                data().obj_ = new (resource->allocate(sizeof(Object)))
+                    Object(typename Object::key_compare(),
+                        typename Object::allocator_type(resource));
+                layout_.flags_ = ResourceFlag;
+            }
+        }
+
+        void assignValue(const Value& value, MemoryResource* resource)
+        {
+            if (resource == NULL)
+            {
+                assignValue(value);
+            }
+            else if (value.isString())
+            {
+                assignString(value.getCString(), value.getStringLength(),
+                             resource);
+            }
+            else if (value.isPacked())
+            {
+                size_t size = value.getPackedSize();
+
+                assignEmptyArray(resource);
+                data().arr_->reserve(size);
+
+                for (size_t index = 0; index < size; ++index)
+                {
+                    data().arr_->push_back(value.getPackedValue(index));
+                }
+            }
+            else if (value.isArray())
+            {
+                const Array& arr = value.getArray();
+
+                assignEmptyArray(resource);
+                data().arr_->reserve(arr.size());
+
+                for (typename Array::const_iterator it = arr.begin();
+                    it != arr.end(); ++it)
+                {
+                    data().arr_->push_back(Value());
+                    data().arr_->back().assignValue(*it, resource);
+                }
+            }
+            else if (value.isObject())
+            {
+                const Object& obj = value.getObject();
+
+                assignEmptyObject(resource);
+
+                for (typename Object::const_iterator it = obj.begin();
+                    it != obj.end(); ++it)
+                {
+                    typename Object::iterator dest = data().obj_->insert(
+                        data().obj_->end(),
+                        typename Object::value_type(it->first, Value()));
+                    dest->second.assignValue(it->second, resource);
+                }
+            }
+            else
+            {
+                assignValue(value);
+            }
+        }
+
+        // Gives the memory back to the resource it came from.
+        void destroyResourceValue()
+        {
+            if (isString())
+            {
+                char* block = reinterpret_cast<char*>(data().str_) -
+                              ResourceHeaderSize;
+                MemoryResource* resource =
+                    *reinterpret_cast<MemoryResource**>(block);
+
+                data().str_->~String();
+                resource->deallocate(
+                    block, ResourceHeaderSize + sizeof(String));
+            }
+            else if (isArray())
+            {
+                MemoryResource* resource =
+                    data().arr_->get_allocator().resource();
+
+                data().arr_->~Array();
+                resource->deallocate(data().arr_, sizeof(Array));
+            }
+            else if (isObject())
+            {
+                MemoryResource* resource =
+                    data().obj_->get_allocator().resource();
+
+                data().obj_->~Object();
+                resource->deallocate(data().obj_, sizeof(Object));
+            }
+        }
+
+        // Forgets the content without destroying it.
+        void release()
+        {
+            setType(NullType);
+        }
+
+        // Shared storage
+
+#ifdef JSONITY_SUPPORT_CXX_11
+        typedef std::atomic<size_t> RefCount;
+        typedef std::atomic<uint64_t> HashCache;
+#else
+        typedef size_t RefCount;
+        typedef uint64_t HashCache;
+#endif
+
+        // A shared string or container is preceded by its reference count
+        // and by its hash(), zero until computed.
+        struct SharedHeader
+        {
+            RefCount refCount_;
+            HashCache hash_;
+        };
+
+        static const size_t SharedHeaderSize = 16;
+
+        template<typename T>
+        static T* allocateShared()
+        {
+            char* block = static_cast<char*>(
+                ::operator new(SharedHeaderSize + sizeof(T)));
+            SharedHeader* header = new (block) SharedHeader;
+            header->refCount_ = 1;
+            header->hash_ = 0;
+
+            return new (block + SharedHeaderSize) T();
+        }
+
+        template<typename T>
+        static void freeShared(T* ptr)
+        {
+            char* block = reinterpret_cast<char*>(ptr) - SharedHeaderSize;
+
+            ptr->~T();
+            reinterpret_cast<SharedHeader*>(block)->~SharedHeader();
+            ::operator delete(block);
+        }
+
+        SharedHeader* getSharedHeader() const
+        {
+            JSONITY_ASSERT(isShared());
+
+            char* ptr;
+            if (isString())
+            {
+                ptr = reinterpret_cast<char*>(data().str_);
+            }
+            else if (isArray())
+            {
+                ptr = reinterpret_cast<char*>(data().arr_);
+            }
+            else
+            {
+                ptr = reinterpret_cast<char*>(data().obj_);
+            }
+
+            return reinterpret_cast<SharedHeader*>(ptr - SharedHeaderSize);
+        }
+
+        void releaseShared()
+        {
+            if (--getSharedHeader()->refCount_ != 0)
+            {
+                return;
+            }
+
+            if (isString())
+            {
+                freeShared(data().str_);
+            }
+            else if (isArray())
+            {
+                freeShared(data().arr_);
+            }
+            else
+            {
+                freeShared(data().obj_);
+            }
+        }
+
+        template<typename T>
+        T* copyShared(T* shared)
+        {
+            T* ptr = new T;
+
+            if (getSharedHeader()->refCount_ == 1)
+            {
+                ptr->swap(*shared);
+            }
+            else
+            {
+                *ptr = *shared;
+            }
+
+            releaseShared();
+            return ptr;
+        }
+
+        // Gives this value its own string or container, the elements
+        // are copied and so stay shared.
+        void detach()
+        {
+            if (!isShared())
+            {
+                return;
+            }
+
+            if (isString())
+            {
+                String* str = copyShared(data().str_);
+                setType(StringType);
+                data().str_ = str;
+            }
+            else if (isArray())
+            {
+                Array* arr = copyShared(data().arr_);
+                setType(ArrayType);
+                data().arr_ = arr;
+            }
+            else
+            {
+                Object* obj = copyShared(data().obj_);
+                setType(ObjectType);
+                data().obj_ = obj;
+            }
+        }
+
+        void swapLayout(Value& other)
+        {
+            Layout layout = layout_;
+            layout_ = other.layout_;
+            other.layout_ = layout;
+        }
+
+        // Packed array storage
+
+        size_t getPackedSize() const
+        {
+            return (isPackedNumbers() ?
+                data().numbers_->size() : data().reals_->size());
+        }
+
+        Value getPackedValue(size_t index) const
+        {
+            if (isPackedNumbers())
+            {
+                return Value((*data().numbers_)[index]);
+            }
+            return Value((*data().reals_)[index]);
+        }
+
+        // An element of an array, packed or not. A packed element is
+        // copied into element.
+        const Value& getElement(size_t index, Value& element) const
+        {
+            if (isPacked())
+            {
+                element = getPackedValue(index);
+                return element;
+            }
+            return (*data().arr_)[index];
+        }
+
+        static const Value& getElement(const Array& arr, size_t index,
+                                       Value&)
+        {
+            return arr[index];
+        }
+
+        static const Value& getElement(const Value& arr, size_t index,
+                                       Value& element)
+        {
+            return arr.getElement(index, element);
+        }
+
+        // Compares with an Array or an array Value. Unordered matching
+        // buckets the elements by structural hash instead of searching
+        // the whole array for every element.
+        template<typename ArrayType>
+        int32_t compareElements(const ArrayType& other, size_t otherSize,
+                                bool ignoreOrder) const
+        {
+            size_t size = getSize();
+            if (size < otherSize)
+            {
+                return -1;
+            }
+            else if (size > otherSize)
+            {
+                return 1;
+            }
+
+            Value element;
+            Value otherElement;
+
+            if (!ignoreOrder)
+            {
+                for (size_t index = 0; index < size; ++index)
+                {
+                    int32_t result = getElement(index, element).compare(
+                        getElement(other, index, otherElement), ignoreOrder);
+                    if (result != 0)
+                    {
+                        return result;
+                    }
+                }
+                return 0;
+            }
+
+            typedef std::vector<std::pair<uint64_t, size_t> > HashArray;
+            HashArray hashes;
+            hashes.reserve(size);
+
+            for (size_t index = 0; index < size; ++index)
+            {
+                hashes.push_back(std::make_pair(
+                    getElement(index, element).hash(ignoreOrder), index));
+            }
+            std::sort(hashes.begin(), hashes.end());
+
+            // Matched entries are moved to the front of their run.
+            std::vector<size_t> matched(hashes.size(), 0);
+
+            for (size_t index = 0; index < otherSize; ++index)
+            {
+                const Value& otherValue =
+                    getElement(other, index, otherElement);
+                uint64_t hash = otherValue.hash(ignoreOrder);
+
+                typename HashArray::iterator first = std::lower_bound(
+                    hashes.begin(), hashes.end(),
+                    std::make_pair(hash, static_cast<size_t>(0)));
+
+                if (first == hashes.end() || first->first != hash)
+                {
+                    return -1;
+                }
+
+                size_t& count = matched[first - hashes.begin()];
+                typename HashArray::iterator it = first + count;
+
+                for (; it != hashes.end() && it->first == hash; ++it)
+                {
+                    if (getElement(it->second, element).compare(
+                            otherValue, ignoreOrder) == 0)
+                    {
+                        break;
+                    }
+                }
+
+                if (it == hashes.end() || it->first != hash)
+                {
+                    return -1;
+                }
+
+                std::iter_swap(first + count, it);
+                ++count;
+            }
+
+            return 0;
+        }
+
+        // Appends a decoded element to an empty or packed array,
+        // returns false if the element does not fit the packing.
+        bool addPacked(const Value& element, size_t reserve)
+        {
+            if (element.isNumber() &&
+                (isPackedNumbers() || (!isPacked() && isEmpty())))
+            {
+                if (!isPacked())
+                {
+                    destroy();
+                    setType(ArrayType);
+                    data().numbers_ = new NumberArray;
+                    data().numbers_->reserve(reserve);
+                    layout_.flags_ = PackedNumberFlag;
+                }
+                data().numbers_->push_back(element.getNumber());
+                return true;
+            }
+            else if (element.isReal() &&
+                (isPackedReals() || (!isPacked() && isEmpty())))
+            {
+                if (!isPacked())
+                {
+                    destroy();
+                    setType(ArrayType);
+                    data().reals_ = new RealArray;
+                    data().reals_->reserve(reserve);
+                    layout_.flags_ = PackedRealFlag;
+                }
+                data().reals_->push_back(element.getReal());
+                return true;
+            }
+
+            return false;
+        }
+
+        // String storage
+
+        size_t getStringLength() const
+        {
+            return data().str_->size();
+        }
+
+        int32_t compareString(const char_t* str, size_t length) const
+        {
+            size_t size = getStringLength();
+            int result = CharTraitsType::compare(
+                getCString(), str, ((size < length) ? size : length));
+
+            if (result != 0)
+            {
+                return result;
+            }
+            else if (size < length)
+            {
+                return -1;
+            }
+            else if (size > length)
+            {
+                return 1;
+            }
+
+            return 0;
+        }
+
+        // Copies of one shared value are equal without looking inside.
+        // Json::equal() also stops at differing hashes, compare() cannot
+        // since the hashes do not order values.
+        int32_t compareShared(const Value& value, bool ignoreOrder) const
+        {
+            if (getSharedHeader() == value.getSharedHeader())
+            {
+                return 0;
+            }
+            else if (isArray())
+            {
+                return compareElements(value, value.getSize(), ignoreOrder);
+            }
+            return compare(value.getObject(), ignoreOrder);
+        }
+
+        // Numbers, reals and booleans hash by numeric value, object
+        // members by name.
+        uint64_t computeHash(bool ignoreOrder) const
+        {
+            if (isNull())
+            {
+                return 0x9e3779b97f4a7c15ULL;
+            }
+            else if (isNumber() || isReal() || isBoolean())
+            {
+                double real = getReal();
+                uint64_t bits = 0;
+                if (real != 0.0)  // -0.0 == 0.0
+                {
+                    std::memcpy(&bits, &real, sizeof(bits));
+                }
+                return mixHash(bits);
+            }
+            else if (isString())
+            {
+                return hashString(getCString(), getStringLength());
+            }
+            else if (isArray())
+            {
+                size_t size = getSize();
+                uint64_t hash = mixHash(0xa5a5a5a5ULL + size);
+                Value packed;
+
+                for (size_t index = 0; index < size; ++index)
+                {
+                    uint64_t element =
+                        getElement(index, packed).hash(ignoreOrder);
+                    if (ignoreOrder)
+                    {
+                        hash += mixHash(element);
+                    }
+                    else
+                    {
+                        hash = mixHash(hash ^ element);
+                    }
+                }
+                return hash;
+            }
+            else
+            {
+                const Object& obj = getObject();
+                uint64_t hash = mixHash(0x5a5a5a5aULL + obj.size());
+
+                for (typename Object::const_iterator it = obj.begin();
+                    it != obj.end(); ++it)
+                {
+                    hash += mixHash(
+                        hashString(it->first.data(), it->first.size()) ^
+                        mixHash(it->second.hash(ignoreOrder)));
+                }
+                return hash;
+            }
+        }
+
+        // FNV-1a
+        static uint64_t hashString(const char_t* str, size_t length)
+        {
+            uint64_t hash = 14695981039346656037ULL;
+            for (size_t index = 0; index < length; ++index)
+            {
+                hash ^= static_cast<uint64_t>(str[index]);
+                hash *= 1099511628211ULL;
+            }
+            return hash;
+        }
+
+        // splitmix64 finalizer
+        static uint64_t mixHash(uint64_t hash)
+        {
+            hash ^= hash >> 30;
+            hash *= 0xbf58476d1ce4e5b9ULL;
+            hash ^= hash >> 27;
+            hash *= 0x94d049bb133111ebULL;
+            hash ^= hash >> 31;
+            return hash;
+        }
+
+    private:
+
+        union Data {
+            int64_t n_;
+            String* str_;
+            bool b_;
+            double d_;
+            Array* arr_;
+            Object* obj_;
+            UserValueBase* user_;
+            NumberArray* numbers_;
+            RealArray* reals_;
+        };
+
+        // How the payload is stored, next to the type.
+        static const unsigned char ResourceFlag = 0x40;
+        static const unsigned char SharedFlag = 0x20;
+        static const unsigned char PackedNumberFlag = 0x10;
+        static const unsigned char PackedRealFlag = 0x08;
+
+        struct Layout
+        {
+            Type type_;
+            unsigned char flags_;
+            Data data_;
+        } layout_;
+
+        Data& data()
+        {
+            return layout_.data_;
+        }
+
+        const Data& data() const
+        {
+            return layout_.data_;
+        }
+
+        void setType(Type type)
+        {
+            layout_.type_ = type;
+            layout_.flags_ = 0;
+        }
+
+        friend class JsonBase;
+
+    }; // class JsonBasic::Value
+
+#ifdef JSONITY_SUPPORT_CXX_11
+    static_assert(sizeof(Value) <= 16, "Json::Value must stay compact");
+#endif
+
+public:
+
+    //-----------------------------------------------------------------------//
+    // JsonBasic::Cursor
+    //-----------------------------------------------------------------------//
+
+    class Cursor
+    {
+    public:
+        Cursor()
+        {
+            pos_ = 0;
+            row_ = 0;
+            col_ = 0;
+        }
+
+    public:
+        uint32_t getPos() const
+        {
+            return pos_;
+        }
+
+        uint32_t getRow() const
+        {
+            return row_;
+        }
+
+        uint32_t getCol() const
+        {
+            return col_;
+        }
+
+    private:
+        void nextRow()
+        {
+            ++row_;
+            col_ = 0;
+        }
+
+        void nextCol()
+        {
+            ++col_;
+        }
+
+        void setPos(uint32_t pos)
+        {
+            pos_ = pos;
+        }
+
+        uint32_t pos_;
+        uint32_t row_;
+        uint32_t col_;
+
+        friend class JsonBase;
+
+    }; // class JsonBasic::Cursor
+
+    //-----------------------------------------------------------------------//
+    // JsonBasic::Error
+    //-----------------------------------------------------------------------//
+
+    class Error
+    {
+    public:
+        Error()
+        {
+            proc_ = 0;
+            errorCode_ = 0;
+            codeLine_ = 0;
+        }
+
+        // Process
+        static const int32_t ObjectProc = 1; 
+        static const int32_t ArrayProc = 2; 
+        static const int32_t NumberProc = 3; 
+        static const int32_t StringProc = 4; 
+        static const int32_t TrueProc = 5;
+        static const int32_t FalseProc = 6; 
+        static const int32_t RealProc = 7;
+        static const int32_t NullProc = 8;
+        static const int32_t CodePointProc = 9;
+        static const int32_t UnknownProc = 10;
+        static const int32_t PatchProc = 11;    // position: operation index
+        static const int32_t PathProc = 12;     // position: in the path
+
+        // Error code
+        static const int32_t UnexpectedEOF = 101;
+        static const int32_t UnexpectedToken = 102;
+        static const int32_t UnexpectedComma = 103;
+        static const int32_t UnexpectedColon = 104;
+        static const int32_t UnexpectedEscapeToken = 105;
+        static const int32_t ExpectedLCB = 106;     // '{'
+        static const int32_t ExpectedLSB = 107;     // '['
+        static const int32_t ExpectedQuot = 108;    // '"'
+        static const int32_t ExpectedComma = 109;   // ','
+        static const int32_t ExpectedColon = 110;   // ':'
+        static const int32_t NameAlreadyExists = 111;
+        static const int32_t InvalidHex = 112;
+        static const int32_t InvalidSurrogatePair = 113;
+        static const int32_t SyntaxError = 114;
+        static const int32_t NotSupported = 115;
+        static const int32_t InvalidPatch = 116;
+        static const int32_t PathNotFound = 117;
+        static const int32_t TestFailed = 118;
+
+    public:
+
+        bool isEmpty() const
+        {
+            return (proc_ == 0);
+        }
+
+        const Cursor& getCursor() const
+        {
+            return cur_;
+        }
+
+        int32_t getProcess() const
+        {
+            return proc_;
+        }
+
+        int32_t getErrorCode() const
+        {
+            return errorCode_;
+        }
+
+        int32_t getCodeLine() const
+        {
+            return codeLine_;
+        }
+
+    private:
+        void setError(const Cursor& cur, int32_t proc,
+                      int32_t errorCode, int32_t codeLine)
+        {
+            cur_ = cur;
+            proc_ = proc;
+            errorCode_ = errorCode;
+            codeLine_ = codeLine;
+        }
+
+        Cursor cur_;
+        int32_t proc_;
+        int32_t errorCode_;
+        int32_t codeLine_;
+
+        friend class JsonBase;
+
+    }; // class JsonBasic::Error
+
+    //-----------------------------------------------------------------------//
+    // JsonBasic::Exception
+    //-----------------------------------------------------------------------//
+
+    class Exception : public std::exception
+    {
+    public:
+        Exception(int32_t codeLine, const std::string& message)
+            : codeLine_(codeLine), message_(message)
+        {
+        }
+
+        virtual ~Exception() throw()
+        {
+        }
+
+    public:
+        virtual const char* what() const throw()
+        {
+            return message_.c_str();
+        }
+
+        int32_t getCodeLine() const
+        {
+            return codeLine_;
+        }
+
+    private:
+        int32_t codeLine_;
+        std::string message_;
+
+    }; // clsss JsonBasic::Exception
+
+    class TypeMismatchException : public Exception
+    {
+    public:
+        TypeMismatchException(int32_t codeLine)
+            : Exception(codeLine, "Json::TypeMismatchException")
+        {
+        }
+
+    }; // clsss JsonBasic::TypeMismatchException
+
+    //-----------------------------------------------------------------------//
+    // JsonBasic::EncodeStyle
+    //-----------------------------------------------------------------------//
+
+    class EncodeStyle
+    {
+    public:
+        EncodeStyle()
+        {
+            style_ = 0;
+            separator_ = JSONITY_CHAR(' ');
+            setPrettyStyle();
+        }
+
+        static const uint32_t IndentStyle = 0x01;
+        static const uint32_t NewLineStyle = 0x02;
+        static const uint32_t QuatStyle = 0x04;
+        static const uint32_t EscapeCtrlCharStyle = 0x08;
+        static const uint32_t PrintNewLineStyle = 0x10;
+        static const uint32_t CRLFStyle = 0x100;
+
+    public:
+        void setPrettyStyle()
+        {
+            setIndent(true);
+            setNewLine(true);
+            setEscapeCtrlChar(false);
+            setQuat(false);
+            setPrintNewLine(false);
+        }
+
+        void setIndent(bool enable,
+                       char_t indentChar = JSONITY_CHAR(' '),
+                       size_t indentCharCount = 4)
+        {
+            if (enable)
+            {
+                style_ |= IndentStyle;
+            }
+            else
+            {
+                style_ &= ~IndentStyle;
+            }
+
+            indentChar_ = indentChar;
+            indentCharCount_ = indentCharCount;
+        }
+
+        void setNewLine(bool enable,
+#ifdef JSONITY_OS_WINDOWS
+                        bool CRLF = true)
+#else
+                        bool CRLF = false)
+#endif
+        {
+            if (enable)
+            {
+                style_ |= NewLineStyle;
+            }
+            else
+            {
+                style_ &= ~NewLineStyle;
+            }
+
+            if (CRLF)
+            {
+                style_ |= CRLFStyle;
+            }
+            else
+            {
+                style_ &= ~CRLFStyle;
+            }
+        }
+
+        void setEscapeCtrlChar(bool enable)
+        {
+            if (enable)
+            {
+                style_ |= EscapeCtrlCharStyle;
+            }
+            else
+            {
+                style_ &= ~EscapeCtrlCharStyle;
+            }
+        }
+
+        void setQuat(bool enable)
+        {
+            if (enable)
+            {
+                style_ |= QuatStyle;
+            }
+            else
+            {
+                style_ &= ~QuatStyle;
+            }
+        }
+
+        void setPrintNewLine(bool enable)
+        {
+            if (enable)
+            {
+                style_ |= PrintNewLineStyle;
+            }
+            else
+            {
+                style_ &= ~PrintNewLineStyle;
+            }
+        }
+
+    private:
+        char_t getIndentChar() const
+        {
+            return indentChar_;
+        }
+
+        size_t getIndentCharCount() const
+        {
+            return indentCharCount_;
+        }
+
+        char_t getSeparatorChar() const
+        {
+            return separator_;
+        }
+
+        bool isCRLF() const
+        {
+            return ((style_ & CRLFStyle) == CRLFStyle);
+        }
+
+        bool isEnableIndent() const
+        {
+            return ((style_ & IndentStyle) == IndentStyle);
+        }
+
+        bool isEnableNewLine() const
+        {
+            return ((style_ & NewLineStyle) ==
+                NewLineStyle);
+        }
+
+        bool isEnableEscape() const
+        {
+            return ((style_ & EscapeCtrlCharStyle) ==
+                EscapeCtrlCharStyle);
+        }
+
+        bool isEnableQuat() const
+        {
+            return ((style_ & QuatStyle) == QuatStyle);
+        }
+
+        bool isEnablePrintNewLine() const
+        {
+            return ((style_ & PrintNewLineStyle) ==
+                PrintNewLineStyle);
+        }
+
+        char_t separator_;
+        char_t indentChar_;
+        size_t indentCharCount_;
+        uint32_t style_;
+
+        friend class JsonBase;
+
+    }; // JsonBasic::EncodeStyle
+
+    //-----------------------------------------------------------------------//
+    // JsonBasic::DecodeStyle
+    //-----------------------------------------------------------------------//
+
+    class DecodeStyle
+    {
+    public:
+        DecodeStyle()
+        {
+            style_ = 0;
+        }
+
+        static const uint32_t CountArraySizeStyle = 0x01;
+        static const uint32_t PackNumberArraysStyle = 0x02;
+
+    public:
+        // Scans each array before decoding it so that it is allocated
+        // once at its exact size. Only when decoding from a string,
+        // streams are not read twice.
+        void setCountArraySize(bool enable)
+        {
+            if (enable)
+            {
+                style_ |= CountArraySizeStyle;
+            }
+            else
+            {
+                style_ &= ~CountArraySizeStyle;
+            }
+        }
+
+        // Arrays of only integers or only reals are decoded packed,
+        // see Value::isPacked(). Not for values from a MemoryResource.
+        void setPackNumberArrays(bool enable)
+        {
+            if (enable)
+            {
+                style_ |= PackNumberArraysStyle;
+            }
+            else
+            {
+                style_ &= ~PackNumberArraysStyle;
+            }
+        }
+
+    private:
+        bool isEnableCountArraySize() const
+        {
+            return ((style_ & CountArraySizeStyle) == CountArraySizeStyle);
+        }
+
+        bool isEnablePackNumberArrays() const
+        {
+            return ((style_ & PackNumberArraysStyle) ==
+                PackNumberArraysStyle);
+        }
+
+        uint32_t style_;
+
+        friend class JsonBase;
+
+    }; // JsonBasic::DecodeStyle
+
+    //-----------------------------------------------------------------------//
+    // JsonBasic::Key
+    //-----------------------------------------------------------------------//
+
+    // A member name prepared once for repeated lookups. It keeps the hash
+    // of the name and the position where it was last found, which is
+    // tried first on the next lookup. Only lookups through a non-const
+    // Key move that position, so threads can share a const Key. The
+    // std::map layout looks a Key up by its name alone, the hash and the
+    // position help the sorted, hash, ordered and shape layouts.
+    class Key
+    {
+    public:
+        explicit Key(const StringRef& name)
+            : name_(name.data(), name.size()), hash_(name.hash()), hint_(0)
+        {
+        }
+
+    public:
+        const String& getName() const
+        {
+            return name_;
+        }
+
+        size_t getHash() const
+        {
+            return hash_;
+        }
+
+    private:
+        String name_;
+        size_t hash_;
+        size_t hint_;
+
+        friend class JsonBase;
+
+    }; // JsonBasic::Key
+
+    //-----------------------------------------------------------------------//
+    // JsonBasic::Pointer
+    //-----------------------------------------------------------------------//
+
+    // An RFC 6901 JSON Pointer, split and unescaped once. get() only looks
+    // values up, it never inserts and does not allocate, and a Pointer is
+    // not changed by it, so threads can share one. "" is the whole value.
+    class Pointer
+    {
+    public:
+        Pointer()
+            : valid_(true)
+        {
+        }
+
+        // isValid() is false if path is neither "" nor starts with '/',
+        // or has a '~' not followed by '0' or '1'.
+        explicit Pointer(const StringRef& path)
+            : path_(path.data(), path.size())
+        {
+            valid_ = parse(path);
+        }
+
+    public:
+        bool isValid() const
+        {
+            return valid_;
+        }
+
+        const String& getPath() const
+        {
+            return path_;
+        }
+
+        // The number of unescaped tokens.
+        size_t getSize() const
+        {
+            return tokens_.size();
+        }
+
+        const String& getToken(size_t index) const
+        {
+            return tokens_[index].key_.getName();
+        }
+
+        // NULL if the pointer is not valid or leads nowhere. A token
+        // indexes an array only if it is digits without leading zeros,
+        // "-" is never found. Elements of a packed array have no Value,
+        // the const overload does not find them, copy them with the
+        // overload taking a Value.
+        const Value* get(const Value& root) const
+        {
+            return resolve(root, tokens_.size());
+        }
+
+        Value* get(Value& root) const
+        {
+            return resolve(root, tokens_.size());
+        }
+
+        // Copies what the pointer leads to into value, an element of a
+        // packed array too. false if it leads nowhere.
+        bool get(const Value& root, Value& value) const
+        {
+            Value element;
+            const Value* found = find(root, element);
+            if (found == NULL)
+            {
+                return false;
+            }
+            value = *found;
+            return true;
+        }
+
+    private:
+        struct Token
+        {
+            explicit Token(const String& name)
+                : key_(StringRef(name)), index_(parseIndex(name))
+            {
+            }
+
+            Key key_;
+            size_t index_;  // npos if not an array index
+        };
+
+        bool parse(const StringRef& path)
+        {
+            if (path.size() == 0)
+            {
+                return true;
+            }
+            else if (path.data()[0] != JSONITY_CHAR('/'))
+            {
+                return false;
+            }
+
+            String name;
+            for (size_t index = 1; index <= path.size(); ++index)
+            {
+                if ((index == path.size()) ||
+                    (path.data()[index] == JSONITY_CHAR('/')))
+                {
+                    tokens_.push_back(Token(name));
+                    name.clear();
+                }
+                else if (path.data()[index] != JSONITY_CHAR('~'))
+                {
+                    name += path.data()[index];
+                }
+                else if ((++index < path.size()) &&
+                    (path.data()[index] == JSONITY_CHAR('0')))
+                {
+                    name += JSONITY_CHAR('~');
+                }
+                else if ((index < path.size()) &&
+                    (path.data()[index] == JSONITY_CHAR('1')))
+                {
+                    name += JSONITY_CHAR('/');
+                }
+                else
+                {
+                    tokens_.clear();
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        static size_t parseIndex(const String& name)
+        {
+            if (name.empty() || (name.size() > 18) ||
+                ((name[0] == JSONITY_CHAR('0')) && (name.size() > 1)))
+            {
+                return String::npos;
+            }
+
+            size_t index = 0;
+            for (size_t pos = 0; pos < name.size(); ++pos)
+            {
+                if ((name[pos] < JSONITY_CHAR('0')) ||
+                    (name[pos] > JSONITY_CHAR('9')))
+                {
+                    return String::npos;
+                }
+                index = index * 10 + static_cast<size_t>(
+                    name[pos] - JSONITY_CHAR('0'));
+            }
+            return index;
+        }
+
+        // The value the first count tokens lead to.
+        template<typename ValueType>
+        ValueType* resolve(ValueType& root, size_t count) const
+        {
+            ValueType* value = (valid_ ? &root : NULL);
+
+            for (size_t index = 0; (index < count) && (value != NULL); ++index)
+            {
+                value = resolveToken(value, tokens_[index]);
+            }
+            return value;
+        }
+
+        // Like get(), but an element of a packed array is copied to
+        // element and that is returned.
+        const Value* find(const Value& root, Value& element) const
+        {
+            if (tokens_.empty())
+            {
+                return resolve(root, 0);
+            }
+
+            const Value* parent = resolve(root, tokens_.size() - 1);
+            if ((parent != NULL) && parent->isPacked())
+            {
+                return (parent->tryGet(tokens_.back().index_, element) ?
+                    &element : NULL);
+            }
+            return ((parent != NULL) ?
+                resolveToken(parent, tokens_.back()) : NULL);
+        }
+
+        // The hint is not kept, lookups leave the Pointer unchanged.
+
+        static const Value* resolveToken(const Value* value,
+                                         const Token& token)
+        {
+            if (value->isObject())
+            {
+                Object& obj = const_cast<Object&>(value->getObject());
+                size_t hint = 0;
+                typename Object::iterator it =
+                    findMember(obj, token.key_, hint);
+                return ((it != obj.end()) ? &it->second : NULL);
+            }
+            return value->tryGet(token.index_);
+        }
+
+        static Value* resolveToken(Value* value, const Token& token)
+        {
+            if (value->isObject())
+            {
+                Object& obj = value->getObject();
+                size_t hint = 0;
+                typename Object::iterator it =
+                    findMember(obj, token.key_, hint);
+                return ((it != obj.end()) ? &it->second : NULL);
+            }
+            return value->tryGet(token.index_);
+        }
+
+        String path_;
+        std::vector<Token> tokens_;
+        bool valid_;
+
+        friend class JsonBase;
+
+    }; // JsonBasic::Pointer
+
+    //-----------------------------------------------------------------------//
+    // JsonBasic::Path
+    //-----------------------------------------------------------------------//
+
+    // A JSONPath query (RFC 9535) compiled once and evaluated against any
+    // number of values: $, .name, ['name'], .*, [*], .., [index],
+    // [start:end:step], unions like [0,'a'] and filters like
+    // [?(@.price < 10 && !@.isbn)] comparing @ or $ queries and literals.
+    // Function extensions such as length() are not supported.
+    //
+    // Matches are passed by reference in document order, nothing is
+    // copied. The non-const overloads detach the shared values they pass
+    // through like getObject() and getArray(), a visitor may change the
+    // matches but must not add or remove members or elements. The const
+    // overloads read packed arrays in place: their elements go to a
+    // visitor as temporaries, find() and findFirst() copy them to Values
+    // and leave them out of pointer results.
+    class Path
+    {
+    public:
+        // "$", the whole value.
+        Path()
+            : expr_(1, JSONITY_CHAR('$')), valid_(true)
+        {
+            queries_.push_back(Query());
+        }
+
+        // isValid() is false on a syntax error, whose position in expr
+        // is set to error.
+        explicit Path(const StringRef& expr, Error* error = NULL)
+            : expr_(expr.data(), expr.size())
+        {
+            valid_ = compile(error);
+        }
+
+    public:
+        bool isValid() const
+        {
+            return valid_;
+        }
+
+        const String& getExpression() const
+        {
+            return expr_;
+        }
+
+        // Calls visitor(value) for each match until it returns false.
+        // Returns the number of matches passed to the visitor.
+        template<typename VisitorType>
+        size_t visit(const Value& root, VisitorType visitor) const
+        {
+            return evaluate(root, visitor);
+        }
+
+        template<typename VisitorType>
+        size_t visit(Value& root, VisitorType visitor) const
+        {
+            return evaluate(root, visitor);
+        }
+
+        // Adds at most limit matches to results, returns how many.
+        size_t find(const Value& root, std::vector<const Value*>& results,
+                    size_t limit = static_cast<size_t>(-1)) const
+        {
+            Collector<const Value> collector(results, limit);
+            if (limit > 0)
+            {
+                selectRoot(root, collector);
+            }
+            return collector.count_;
+        }
+
+        size_t find(Value& root, std::vector<Value*>& results,
+                    size_t limit = static_cast<size_t>(-1)) const
+        {
+            Collector<Value> collector(results, limit);
+            if (limit > 0)
+            {
+                selectRoot(root, collector);
+            }
+            return collector.count_;
+        }
+
+        // Copies at most limit matches to results, elements of packed
+        // arrays too, returns how many.
+        size_t find(const Value& root, std::vector<Value>& results,
+                    size_t limit = static_cast<size_t>(-1)) const
+        {
+            Copier copier(results, limit);
+            if (limit > 0)
+            {
+                selectRoot(root, copier);
+            }
+            return copier.count_;
+        }
+
+        // The first match or NULL.
+        const Value* findFirst(const Value& root) const
+        {
+            First<const Value> first;
+            selectRoot(root, first);
+            return first.value_;
+        }
+
+        Value* findFirst(Value& root) const
+        {
+            First<Value> first;
+            selectRoot(root, first);
+            return first.value_;
+        }
+
+        // Copies the first match to value, false if there is none.
+        bool findFirst(const Value& root, Value& value) const
+        {
+            Operand first;
+            selectRoot(root, first);
+            if (first.value_ == NULL)
+            {
+                return false;
+            }
+            value = *first.value_;
+            return true;
+        }
+
+    private:
+        static const int32_t NameSelector = 1;
+        static const int32_t WildcardSelector = 2;
+        static const int32_t IndexSelector = 3;
+        static const int32_t SliceSelector = 4;
+        static const int32_t FilterSelector = 5;
+
+        struct Selector
+        {
+            explicit Selector(int32_t type)
+                : type_(type), key_(StringRef()), start_(0), end_(0),
+                  step_(1), hasStart_(false), hasEnd_(false), filter_(0)
+            {
+            }
+
+            int32_t type_;
+            Key key_;
+            int64_t start_;     // index, or start of a slice
+            int64_t end_;
+            int64_t step_;
+            bool hasStart_;
+            bool hasEnd_;
+            size_t filter_;     // root of the filter in nodes_
+        };
+
+        struct Segment
+        {
+            Segment()
+                : descendant_(false)
+            {
+            }
+
+            bool descendant_;   // ..
+            std::vector<Selector> selectors_;
+        };
+
+        typedef std::vector<Segment> Query;
+
+        // Filter expressions
+
+        static const int32_t OrNode = 1;
+        static const int32_t AndNode = 2;
+        static const int32_t NotNode = 3;
+        static const int32_t CompareNode = 4;
+        static const int32_t QueryNode = 5;
+        static const int32_t LiteralNode = 6;
+
+        static const int32_t EqualOp = 1;
+        static const int32_t NotEqualOp = 2;
+        static const int32_t LessOp = 3;
+        static const int32_t LessEqualOp = 4;
+        static const int32_t GreaterOp = 5;
+        static const int32_t GreaterEqualOp = 6;
+
+        struct Node
+        {
+            explicit Node(int32_t type)
+                : type_(type), op_(0), lhs_(0), rhs_(0),
+                  absolute_(false), query_(0)
+            {
+            }
+
+            int32_t type_;
+            int32_t op_;
+            size_t lhs_;
+            size_t rhs_;
+            bool absolute_;     // $ rather than @
+            size_t query_;
+            Value literal_;
+        };
+
+        // Visitors
+
+        template<typename ValueType, typename VisitorType>
+        struct Counter
+        {
+            explicit Counter(VisitorType& visitor)
+                : visitor_(visitor), count_(0)
+            {
+            }
+
+            bool operator()(ValueType& value)
+            {
+                ++count_;
+                return visitor_(value);
+            }
+
+            bool packed(const Value& element)
+            {
+                ++count_;
+                return visitor_(element);
+            }
+
+            VisitorType& visitor_;
+            size_t count_;
+        };
+
+        template<typename ValueType>
+        struct Collector
+        {
+            Collector(std::vector<ValueType*>& results, size_t limit)
+                : results_(results), limit_(limit), count_(0)
+            {
+            }
+
+            bool operator()(ValueType& value)
+            {
+                results_.push_back(&value);
+                return (++count_ < limit_);
+            }
+
+            bool packed(const Value&)
+            {
+                return true;
+            }
+
+            std::vector<ValueType*>& results_;
+            size_t limit_;
+            size_t count_;
+        };
+
+        struct Copier
+        {
+            Copier(std::vector<Value>& results, size_t limit)
+                : results_(results), limit_(limit), count_(0)
+            {
+            }
+
+            bool operator()(const Value& value)
+            {
+                results_.push_back(value);
+                return (++count_ < limit_);
+            }
+
+            bool packed(const Value& element)
+            {
+                return operator()(element);
+            }
+
+            std::vector<Value>& results_;
+            size_t limit_;
+            size_t count_;
+        };
+
+        template<typename ValueType>
+        struct First
+        {
+            First()
+                : value_(NULL)
+            {
+            }
+
+            bool operator()(ValueType& value)
+            {
+                value_ = &value;
+                return false;
+            }
+
+            bool packed(const Value&)
+            {
+                return true;
+            }
+
+            ValueType* value_;
+        };
+
+        // The first match of a filter query, a packed element is copied.
+        struct Operand
+        {
+            Operand()
+                : value_(NULL)
+            {
+            }
+
+            bool operator()(const Value& value)
+            {
+                value_ = &value;
+                return false;
+            }
+
+            bool packed(const Value& element)
+            {
+                element_ = element;
+                value_ = &element_;
+                return false;
+            }
+
+            const Value* value_;
+            Value element_;
+        };
+
+        // Evaluation
+
+        template<typename ValueType, typename VisitorType>
+        size_t evaluate(ValueType& root, VisitorType& visitor) const
+        {
+            Counter<ValueType, VisitorType> counter(visitor);
+            selectRoot(root, counter);
+            return counter.count_;
+        }
+
+        template<typename ValueType, typename HandlerType>
+        void selectRoot(ValueType& root, HandlerType& handler) const
+        {
+            if (valid_)
+            {
+                select(queries_[0], 0, &root, root, handler);
+            }
+        }
+
+        // Returns false once the handler asks to stop.
+        template<typename ValueType, typename HandlerType>
+        bool select(const Query& query, size_t segment, ValueType* value,
+                    const Value& root, HandlerType& handler) const
+        {
+            if (segment == query.size())
+            {
+                return handler(*value);
+            }
+            else if (!value->isObject() && !value->isArray())
+            {
+                return true;
+            }
+
+            const Segment& seg = query[segment];
+            for (size_t index = 0; index < seg.selectors_.size(); ++index)
+            {
+                if (!selectOne(query, segment, seg.selectors_[index],
+                        value, root, handler))
+                {
+                    return false;
+                }
+            }
+
+            return (!seg.descendant_ ||
+                selectChildren(query, segment, value, root, NULL, handler));
+        }
+
+        template<typename ValueType, typename HandlerType>
+        bool selectOne(const Query& query, size_t segment,
+                       const Selector& selector, ValueType* value,
+                       const Value& root, HandlerType& handler) const
+        {
+            if (selector.type_ == NameSelector)
+            {
+                if (value->isObject())
+                {
+                    Object& obj = const_cast<Object&>(
+                        static_cast<const Object&>(value->getObject()));
+                    size_t hint = 0;
+                    typename Object::iterator it =
+                        findMember(obj, selector.key_, hint);
+                    if (it != obj.end())
+                    {
+                        return select(query, segment + 1,
+                            const_cast<ValueType*>(&it->second),
+                            root, handler);
+                    }
+                }
+                return true;
+            }
+            else if (selector.type_ == WildcardSelector)
+            {
+                return selectChildren(
+                    query, segment + 1, value, root, NULL, handler);
+            }
+            else if (selector.type_ == FilterSelector)
+            {
+                return selectChildren(
+                    query, segment + 1, value, root, &selector, handler);
+            }
+            else if (!value->isArray())
+            {
+                return true;
+            }
+
+            int64_t size = static_cast<int64_t>(getArraySize(value));
+
+            if (selector.type_ == IndexSelector)
+            {
+                int64_t index = ((selector.start_ < 0) ?
+                    (selector.start_ + size) : selector.start_);
+                return (((index < 0) || (index >= size)) ||
+                    selectElement(query, segment + 1, value,
+                        (size_t)index, NULL, root, handler));
+            }
+
+            // RFC 9535 section 2.3.4.2.2
+            int64_t step = selector.step_;
+            int64_t start = ((selector.start_ < 0) ?
+                (selector.start_ + size) : selector.start_);
+            int64_t end = ((selector.end_ < 0) ?
+                (selector.end_ + size) : selector.end_);
+
+            if (!selector.hasStart_)
+            {
+                start = ((step > 0) ? 0 : (size - 1));
+            }
+            if (!selector.hasEnd_)
+            {
+                end = ((step > 0) ? size : -1);
+            }
+
+            if (step > 0)
+            {
+                end = std::min(std::max(end, (int64_t)0), size);
+                for (int64_t index = std::min(std::max(start, (int64_t)0),
+                        size); index < end; index += step)
+                {
+                    if (!selectElement(query, segment + 1, value,
+                        (size_t)index, NULL, root, handler))
+                    {
+                        return false;
+                    }
+                }
+            }
+            else if (step < 0)
+            {
+                end = std::min(std::max(end, (int64_t)-1), size - 1);
+                for (int64_t index = std::min(std::max(start, (int64_t)-1),
+                        size - 1); index > end; index += step)
+                {
+                    if (!selectElement(query, segment + 1, value,
+                        (size_t)index, NULL, root, handler))
+                    {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        // Members or elements that pass the filter, if any.
+        template<typename ValueType, typename HandlerType>
+        bool selectChildren(const Query& query, size_t segment,
+                            ValueType* value, const Value& root,
+                            const Selector* filter,
+                            HandlerType& handler) const
+        {
+            if (value->isObject())
+            {
+                const Object& obj = value->getObject();
+                for (typename Object::const_iterator it = obj.begin();
+                    it != obj.end(); ++it)
+                {
+                    if (((filter == NULL) ||
+                            test(filter->filter_, it->second, root)) &&
+                        !select(query, segment,
+                            const_cast<ValueType*>(&it->second),
+                            root, handler))
+                    {
+                        return false;
+                    }
+                }
+            }
+            else if (value->isArray())
+            {
+                size_t size = getArraySize(value);
+                for (size_t index = 0; index < size; ++index)
+                {
+                    if (!selectElement(query, segment, value, index,
+                            filter, root, handler))
+                    {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        // The non-const overloads unpack a packed array, see
+        // Value::getArray().
+        static size_t getArraySize(const Value* value)
+        {
+            return value->getSize();
+        }
+
+        static size_t getArraySize(Value* value)
+        {
+            return value->getArray().size();
+        }
+
+        // The element at index if it passes the filter, if any. A packed
+        // element has no Value, it is only passed to handler.packed().
+        template<typename HandlerType>
+        bool selectElement(const Query& query, size_t segment,
+                           const Value* value, size_t index,
+                           const Selector* filter, const Value& root,
+                           HandlerType& handler) const
+        {
+            Value packed;
+            const Value& element = value->getElement(index, packed);
+            if ((filter != NULL) && !test(filter->filter_, element, root))
+            {
+                return true;
+            }
+            else if (value->isPacked())
+            {
+                return ((segment != query.size()) || handler.packed(element));
+            }
+            return select(query, segment, &element, root, handler);
+        }
+
+        template<typename HandlerType>
+        bool selectElement(const Query& query, size_t segment,
+                           Value* value, size_t index,
+                           const Selector* filter, const Value& root,
+                           HandlerType& handler) const
+        {
+            Value& element = value->getArray()[index];
+            return (((filter != NULL) &&
+                    !test(filter->filter_, element, root)) ||
+                select(query, segment, &element, root, handler));
+        }
+
+        bool test(size_t node, const Value& current, const Value& root) const
+        {
+            const Node& expr = nodes_[node];
+
+            if (expr.type_ == OrNode)
+            {
+                return (test(expr.lhs_, current, root) ||
+                    test(expr.rhs_, current, root));
+            }
+            else if (expr.type_ == AndNode)
+            {
+                return (test(expr.lhs_, current, root) &&
+                    test(expr.rhs_, current, root));
+            }
+            else if (expr.type_ == NotNode)
+            {
+                return !test(expr.lhs_, current, root);
+            }
+            else if (expr.type_ == CompareNode)
+            {
+                Operand lhs;
+                Operand rhs;
+                return compareOperands(expr.op_,
+                    getOperand(expr.lhs_, current, root, lhs),
+                    getOperand(expr.rhs_, current, root, rhs));
+            }
+
+            Operand operand;
+            return (getOperand(node, current, root, operand) != NULL);
+        }
+
+        // The literal or the first match of the query, NULL if none.
+        const Value* getOperand(size_t node, const Value& current,
+                                const Value& root, Operand& first) const
+        {
+            const Node& operand = nodes_[node];
+            if (operand.type_ == LiteralNode)
+            {
+                return &operand.literal_;
+            }
+
+            select(queries_[operand.query_], 0,
+                (operand.absolute_ ? &root : &current), root, first);
+            return first.value_;
+        }
+
+        // A missing operand only equals another missing one, numbers
+        // compare by value and strings by code units, any other pair
+        // is only equal or not.
+        static bool compareOperands(int32_t op, const Value* lhs,
+                                    const Value* rhs)
+        {
+            if (op == NotEqualOp)
+            {
+                return !compareOperands(EqualOp, lhs, rhs);
+            }
+            else if (op == GreaterOp)
+            {
+                return compareOperands(LessOp, rhs, lhs);
+            }
+            else if (op == GreaterEqualOp)
+            {
+                return compareOperands(LessEqualOp, rhs, lhs);
+            }
+            else if (op == LessEqualOp)
+            {
+                return (compareOperands(LessOp, lhs, rhs) ||
+                    compareOperands(EqualOp, lhs, rhs));
+            }
+            else if ((lhs == NULL) || (rhs == NULL))
+            {
+                return ((op == EqualOp) && (lhs == rhs));
+            }
+            else if (op == EqualOp)
+            {
+                return isIdentical(*lhs, *rhs, true);
+            }
+            else if (lhs->isNumber() && rhs->isNumber())
+            {
+                return (lhs->getNumber() < rhs->getNumber());
+            }
+            else if ((lhs->isNumber() || lhs->isReal()) &&
+                (rhs->isNumber() || rhs->isReal()))
+            {
+                return (lhs->getReal() < rhs->getReal());
+            }
+            else if (lhs->isString() && rhs->isString())
+            {
+                return (lhs->compare(*rhs) < 0);
+            }
+            return false;
+        }
+
+        // Compilation
+
+        bool compile(Error* error)
+        {
+            StringDecodeContext ctx(expr_.c_str());
+            Query query;
+
+            ctx.skipWhiteSpace();
+            if (ctx.getCurrentChar() != JSONITY_CHAR('$'))
+            {
+                return setError(ctx, error, Error::SyntaxError, __LINE__);
+            }
+            ctx.nextChar();
+
+            if (!parseSegments(ctx, query))
+            {
+                return setError(ctx, error, 0, 0);
+            }
+
+            ctx.skipWhiteSpace();
+            if (ctx.getCurrentPos() != expr_.size())
+            {
+                return setError(ctx, error, Error::UnexpectedToken,
+                                __LINE__);
+            }
+
+            queries_.insert(queries_.begin(), query);
+            for (size_t index = 0; index < nodes_.size(); ++index)
+            {
+                ++nodes_[index].query_;
+            }
+            return true;
+        }
+
+        // errorCode 0 keeps the error already in ctx.
+        bool setError(DecodeContext& ctx, Error* error, int32_t errorCode,
+                      int32_t codeLine)
+        {
+            if (errorCode != 0)
+            {
+                ctx.setError(Error::PathProc, errorCode, codeLine);
+            }
+            if (error != NULL)
+            {
+                ctx.getError(*error);
+            }
+            queries_.clear();
+            nodes_.clear();
+            return false;
+        }
+
+        bool parseSegments(DecodeContext& ctx, Query& query)
+        {
+            for (;;)
+            {
+                ctx.skipWhiteSpace();
+
+                Segment segment;
+                if (ctx.getCurrentChar() == JSONITY_CHAR('['))
+                {
+                    if (!parseBracket(ctx, segment))
+                    {
+                        return false;
+                    }
+                }
+                else if (ctx.getCurrentChar() == JSONITY_CHAR('.'))
+                {
+                    ctx.nextChar();
+                    if (ctx.getCurrentChar() == JSONITY_CHAR('.'))
+                    {
+                        segment.descendant_ = true;
+                        ctx.nextChar();
+                    }
+
+                    if (ctx.getCurrentChar() == JSONITY_CHAR('*'))
+                    {
+                        segment.selectors_.push_back(
+                            Selector(WildcardSelector));
+                        ctx.nextChar();
+                    }
+                    else if (segment.descendant_ &&
+                        (ctx.getCurrentChar() == JSONITY_CHAR('[')))
+                    {
+                        if (!parseBracket(ctx, segment))
+                        {
+                            return false;
+                        }
+                    }
+                    else if (isNameChar(ctx.getCurrentChar(), true))
+                    {
+                        ctx.savePos();
+                        while (isNameChar(ctx.getCurrentChar(), false))
+                        {
+                            ctx.nextChar();
+                        }
+
+                        String name;
+                        ctx.readFromSavePos(name);
+                        addName(segment, name);
+                    }
+                    else
+                    {
+                        ctx.setError(Error::PathProc,
+                            Error::UnexpectedToken, __LINE__);
+                        return false;
+                    }
+                }
+                else
+                {
+                    return true;
+                }
+
+                query.push_back(segment);
+            }
+        }
+
+        bool parseBracket(DecodeContext& ctx, Segment& segment)
+        {
+            JSONITY_ASSERT(ctx.getCurrentChar() == JSONITY_CHAR('['));
+            ctx.nextChar();
+
+            for (;;)
+            {
+                ctx.skipWhiteSpace();
+                char_t ch = ctx.getCurrentChar();
+
+                if ((ch == JSONITY_CHAR('\'')) || (ch == JSONITY_CHAR('"')))
+                {
+                    String name;
+                    if (!parseString(ctx, name))
+                    {
+                        return false;
+                    }
+                    addName(segment, name);
+                }
+                else if (ch == JSONITY_CHAR('*'))
+                {
+                    segment.selectors_.push_back(Selector(WildcardSelector));
+                    ctx.nextChar();
+                }
+                else if (ch == JSONITY_CHAR('?'))
+                {
+                    ctx.nextChar();
+                    segment.selectors_.push_back(Selector(FilterSelector));
+                    if (!parseOr(ctx, segment.selectors_.back().filter_))
+                    {
+                        return false;
+                    }
+                }
+                else if (!parseIndex(ctx, segment))
+                {
+                    return false;
+                }
+
+                ctx.skipWhiteSpace();
+                if (ctx.getCurrentChar() == JSONITY_CHAR(']'))
+                {
+                    ctx.nextChar();
+                    return true;
+                }
+                else if (ctx.getCurrentChar() != JSONITY_CHAR(','))
+                {
+                    ctx.setError(Error::PathProc, Error::ExpectedComma,
+                        __LINE__);
+                    return false;
+                }
+                ctx.nextChar();
+            }
+        }
+
+        // An index, or a slice if there is a ':'.
+        bool parseIndex(DecodeContext& ctx, Segment& segment)
+        {
+            Selector selector(IndexSelector);
+
+            if (!parseInteger(ctx, selector.start_, selector.hasStart_))
+            {
+                return false;
+            }
+
+            ctx.skipWhiteSpace();
+            if (ctx.getCurrentChar() == JSONITY_CHAR(':'))
+            {
+                selector.type_ = SliceSelector;
+                ctx.nextChar();
+                if (!parseInteger(ctx, selector.end_, selector.hasEnd_))
+                {
+                    return false;
+                }
+
+                ctx.skipWhiteSpace();
+                if (ctx.getCurrentChar() == JSONITY_CHAR(':'))
+                {
+                    bool hasStep = false;
+                    ctx.nextChar();
+                    if (!parseInteger(ctx, selector.step_, hasStep))
+                    {
+                        return false;
+                    }
+                    selector.step_ = (hasStep ? selector.step_ : 1);
+                }
+            }
+            else if (!selector.hasStart_)
+            {
+                ctx.setError(Error::PathProc, Error::UnexpectedToken,
+                    __LINE__);
+                return false;
+            }
+
+            segment.selectors_.push_back(selector);
+            return true;
+        }
+
+        // Nothing is read if there is no integer.
+        static bool parseInteger(DecodeContext& ctx, int64_t& number,
+                                 bool& found)
+        {
+            ctx.skipWhiteSpace();
+            found = (isDigit(ctx.getCurrentChar()) ||
+                (ctx.getCurrentChar() == JSONITY_CHAR('-')));
+            if (!found)
+            {
+                return true;
+            }
+
+            Value value;
+            if (!decodeNumber(ctx, value))
+            {
+                return false;
+            }
+            else if (!value.isNumber())
+            {
+                ctx.setError(Error::PathProc, Error::SyntaxError, __LINE__);
+                return false;
+            }
+
+            number = value.getNumber();
+            return true;
+        }
+
+        // A string in single or double quotes, with JSON escapes and \'.
+        static bool parseString(DecodeContext& ctx, String& str)
+        {
+            char_t quote = ctx.getCurrentChar();
+            ctx.nextChar();
+
+            while (ctx.getCurrentChar() != quote)
+            {
+                if (ctx.isEOF())
+                {
+                    ctx.setError(Error::PathProc, Error::UnexpectedEOF,
+                        __LINE__);
+                    return false;
+                }
+                else if (ctx.getCurrentChar() != JSONITY_CHAR('\\'))
+                {
+                    str += ctx.getCurrentChar();
+                    ctx.nextChar();
+                    continue;
+                }
+
+                ctx.nextChar();
+                if (ctx.getCurrentChar() == JSONITY_CHAR('\''))
+                {
+                    str += JSONITY_CHAR('\'');
+                    ctx.nextChar();
+                }
+                else if (!decodeEscapeChar(ctx, str))
+                {
+                    return false;
+                }
+            }
+
+            ctx.nextChar();
+            return true;
+        }
+
+        // logical-or: and ('||' and)*
+        bool parseOr(DecodeContext& ctx, size_t& node)
+        {
+            if (!parseAnd(ctx, node))
+            {
+                return false;
+            }
+
+            while (parseOperator(ctx, JSONITY_CHAR('|'), JSONITY_CHAR('|')))
+            {
+                Node expr(OrNode);
+                expr.lhs_ = node;
+                if (!parseAnd(ctx, expr.rhs_))
+                {
+                    return false;
+                }
+                node = addNode(expr);
+            }
+            return true;
+        }
+
+        bool parseAnd(DecodeContext& ctx, size_t& node)
+        {
+            if (!parseUnary(ctx, node))
+            {
+                return false;
+            }
+
+            while (parseOperator(ctx, JSONITY_CHAR('&'), JSONITY_CHAR('&')))
+            {
+                Node expr(AndNode);
+                expr.lhs_ = node;
+                if (!parseUnary(ctx, expr.rhs_))
+                {
+                    return false;
+                }
+                node = addNode(expr);
+            }
+            return true;
+        }
+
+        // '!' unary, '(' or ')', a comparison or an existence test.
+        bool parseUnary(DecodeContext& ctx, size_t& node)
+        {
+            ctx.skipWhiteSpace();
+
+            if (ctx.getCurrentChar() == JSONITY_CHAR('!'))
+            {
+                ctx.nextChar();
+                Node expr(NotNode);
+                if (!parseUnary(ctx, expr.lhs_))
+                {
+                    return false;
+                }
+                node = addNode(expr);
+                return true;
+            }
+            else if (ctx.getCurrentChar() == JSONITY_CHAR('('))
+            {
+                ctx.nextChar();
+                if (!parseOr(ctx, node))
+                {
+                    return false;
+                }
+
+                ctx.skipWhiteSpace();
+                if (ctx.getCurrentChar() != JSONITY_CHAR(')'))
+                {
+                    ctx.setError(Error::PathProc, Error::UnexpectedToken,
+                        __LINE__);
+                    return false;
+                }
+                ctx.nextChar();
+                return true;
+            }
+
+            if (!parseOperand(ctx, node))
+            {
+                return false;
+            }
+
+            Node expr(CompareNode);
+            expr.lhs_ = node;
+            if (parseOperator(ctx, JSONITY_CHAR('='), JSONITY_CHAR('=')))
+            {
+                expr.op_ = EqualOp;
+            }
+            else if (parseOperator(ctx, JSONITY_CHAR('!'), JSONITY_CHAR('=')))
+            {
+                expr.op_ = NotEqualOp;
+            }
+            else if (parseOperator(ctx, JSONITY_CHAR('<'), JSONITY_CHAR('=')))
+            {
+                expr.op_ = LessEqualOp;
+            }
+            else if (parseOperator(ctx, JSONITY_CHAR('>'), JSONITY_CHAR('=')))
+            {
+                expr.op_ = GreaterEqualOp;
+            }
+            else if (parseOperator(ctx, JSONITY_CHAR('<'), JSONITY_CHAR('\0')))
+            {
+                expr.op_ = LessOp;
+            }
+            else if (parseOperator(ctx, JSONITY_CHAR('>'), JSONITY_CHAR('\0')))
+            {
+                expr.op_ = GreaterOp;
+            }
+            else if (nodes_[node].type_ == QueryNode)
+            {
+                return true;
+            }
+            else
+            {
+                // A literal is not a test.
+                ctx.setError(Error::PathProc, Error::SyntaxError, __LINE__);
+                return false;
+            }
+
+            if (!isComparable(expr.lhs_) || !parseOperand(ctx, expr.rhs_) ||
+                !isComparable(expr.rhs_))
+            {
+                ctx.setError(Error::PathProc, Error::SyntaxError, __LINE__);
+                return false;
+            }
+            node = addNode(expr);
+            return true;
+        }
+
+        // A literal, or a query starting with @ or $.
+        bool parseOperand(DecodeContext& ctx, size_t& node)
+        {
+            ctx.skipWhiteSpace();
+            char_t ch = ctx.getCurrentChar();
+
+            if ((ch == JSONITY_CHAR('@')) || (ch == JSONITY_CHAR('$')))
+            {
+                Node expr(QueryNode);
+                expr.absolute_ = (ch == JSONITY_CHAR('$'));
+                ctx.nextChar();
+
+                Query query;
+                if (!parseSegments(ctx, query))
+                {
+                    return false;
+                }
+
+                // Shifted by one when the path itself is inserted first.
+                expr.query_ = queries_.size();
+                queries_.push_back(query);
+                node = addNode(expr);
+                return true;
+            }
+
+            Node expr(LiteralNode);
+            bool result = false;
+            if ((ch == JSONITY_CHAR('\'')) || (ch == JSONITY_CHAR('"')))
+            {
+                String str;
+                result = parseString(ctx, str);
+                expr.literal_ = str;
+            }
+            else if (isDigit(ch) || (ch == JSONITY_CHAR('-')))
+            {
+                result = decodeNumber(ctx, expr.literal_);
+            }
+            else if (ch == JSONITY_CHAR('t'))
+            {
+                result = decodeTrue(ctx, expr.literal_);
+            }
+            else if (ch == JSONITY_CHAR('f'))
+            {
+                result = decodeFalse(ctx, expr.literal_);
+            }
+            else if (ch == JSONITY_CHAR('n'))
+            {
+                result = decodeNull(ctx, expr.literal_);
+            }
+            else
+            {
+                ctx.setError(Error::PathProc, Error::UnexpectedToken,
+                    __LINE__);
+            }
+
+            node = addNode(expr);
+            return result;
+        }
+
+        // Reads first followed by second, or first alone if second is
+        // '\0' and no '=' follows.
+        static bool parseOperator(DecodeContext& ctx, char_t first,
+                                  char_t second)
+        {
+            ctx.skipWhiteSpace();
+            if (ctx.getCurrentChar() != first)
+            {
+                return false;
+            }
+
+            size_t pos = ctx.getCurrentPos();
+            Cursor cur = ctx.getCursor();
+            ctx.nextChar();
+
+            if ((second == JSONITY_CHAR('\0')) ?
+                (ctx.getCurrentChar() != JSONITY_CHAR('=')) :
+                (ctx.getCurrentChar() == second))
+            {
+                if (second != JSONITY_CHAR('\0'))
+                {
+                    ctx.nextChar();
+                }
+                return true;
+            }
+
+            ctx.rewind(pos, cur);
+            return false;
+        }
+
+        // Literals and queries that match at most one value.
+        bool isComparable(size_t node) const
+        {
+            if (nodes_[node].type_ == LiteralNode)
+            {
+                return true;
+            }
+
+            const Query& query = queries_[nodes_[node].query_];
+            for (size_t index = 0; index < query.size(); ++index)
+            {
+                if (query[index].descendant_ ||
+                    (query[index].selectors_.size() != 1) ||
+                    ((query[index].selectors_[0].type_ != NameSelector) &&
+                     (query[index].selectors_[0].type_ != IndexSelector)))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        size_t addNode(const Node& node)
+        {
+            nodes_.push_back(node);
+            return (nodes_.size() - 1);
+        }
+
+        static void addName(Segment& segment, const String& name)
+        {
+            segment.selectors_.push_back(Selector(NameSelector));
+            segment.selectors_.back().key_ = Key(StringRef(name));
+        }
+
+        static bool isNameChar(char_t ch, bool first)
+        {
+            return (((uint32_t)ch > 0x7f) ||
+                ((ch >= JSONITY_CHAR('a')) && (ch <= JSONITY_CHAR('z'))) ||
+                ((ch >= JSONITY_CHAR('A')) && (ch <= JSONITY_CHAR('Z'))) ||
+                (ch == JSONITY_CHAR('_')) || (!first && isDigit(ch)));
+        }
+
+        String expr_;
+        std::vector<Query> queries_;    // queries_[0] is the path itself
+        std::vector<Node> nodes_;
+        bool valid_;
+
+        friend class JsonBase;
+
+    }; // JsonBasic::Path
+
+    //-----------------------------------------------------------------------//
+    // JsonBasic::Index
+    //-----------------------------------------------------------------------//
+
+    // Where member names, and optionally their scalar values, occur in a
+    // value, so that a lookup costs the number of matches instead of a
+    // walk over the value. Matches come in the string order of their
+    // JSON Pointers.
+    //
+    // add(), remove() and applyPatch() change the value and update the
+    // entries of what they add, remove or replace, and renumber those of
+    // the later elements of an array they insert into or remove from.
+    // After any other change the index is stale until build() is called.
+    class Index
+    {
+    public:
+        explicit Index(Value& root, bool indexValues = false)
+            : root_(&root), indexValues_(indexValues)
+        {
+            build();
+        }
+
+    public:
+        void build()
+        {
+            entries_.clear();
+            names_.clear();
+            values_.clear();
+
+            String path;
+            addEntries(path, *root_);
+        }
+
+        const Value& getRoot() const
+        {
+            return *root_;
+        }
+
+        // The number of members indexed.
+        size_t getSize() const
+        {
+            return entries_.size();
+        }
+
+        // Members named name.
+        size_t find(const StringRef& name,
+                    std::vector<const Value*>& results) const
+        {
+            typename NameMap::const_iterator it = names_.find(name);
+            if (it == names_.end())
+            {
+                return 0;
+            }
+
+            for (typename PathSet::const_iterator itPath = it->second.begin();
+                itPath != it->second.end(); ++itPath)
+            {
+                results.push_back(getMember(**itPath));
+            }
+            return it->second.size();
+        }
+
+        // Members named name whose value equals value, numbers of either
+        // type compare by value. Only scalars are indexed, and only if
+        // indexValues was set.
+        size_t find(const StringRef& name, const Value& value,
+                    std::vector<const Value*>& results) const
+        {
+            std::vector<const String*> paths;
+            findValues(name, value, paths);
+
+            for (size_t index = 0; index < paths.size(); ++index)
+            {
+                results.push_back(getMember(*paths[index]));
+            }
+            return paths.size();
+        }
+
+        size_t findPaths(const StringRef& name,
+                         std::vector<String>& paths) const
+        {
+            typename NameMap::const_iterator it = names_.find(name);
+            if (it == names_.end())
+            {
+                return 0;
+            }
+
+            for (typename PathSet::const_iterator itPath = it->second.begin();
+                itPath != it->second.end(); ++itPath)
+            {
+                paths.push_back(**itPath);
+            }
+            return it->second.size();
+        }
+
+        size_t findPaths(const StringRef& name, const Value& value,
+                         std::vector<String>& paths) const
+        {
+            std::vector<const String*> found;
+            findValues(name, value, found);
+
+            for (size_t index = 0; index < found.size(); ++index)
+            {
+                paths.push_back(*found[index]);
+            }
+            return found.size();
+        }
+
+        // Adds or replaces a member, or inserts an element, as the RFC 6902
+        // add operation does. Returns false if path leads nowhere.
+        bool add(const StringRef& path, const Value& value)
+        {
+            String str(path.data(), path.size());
+            Value element(value);
+            PatchUndoLog undo;
+            if (addValue(*root_, str, element, &undo) != 0)
+            {
+                return false;
+            }
+
+            update(undo.back(), false);
+            return true;
+        }
+
+        bool remove(const StringRef& path)
+        {
+            String str(path.data(), path.size());
+            Value removed;
+            if (removeValue(*root_, str, &removed, NULL) != 0)
+            {
+                return false;
+            }
+
+            removeEntries(str);
+            return true;
+        }
+
+        // JsonBase::applyPatch(). The index follows each operation, and
+        // the undoing of them if one fails.
+        bool applyPatch(const Value& patch, Error* error = NULL)
+        {
+            if (!patch.isArray() || patch.isPacked())
+            {
+                setPatchError(error, 0, Error::InvalidPatch, __LINE__);
+                return false;
+            }
+
+            const Array& ops = patch.getArray();
+            PatchUndoLog undo;
+
+            for (size_t index = 0; index < ops.size(); ++index)
+            {
+                size_t done = undo.size();
+                int32_t result = applyOperation(*root_, ops[index], undo);
+                if (result != 0)
+                {
+                    for (size_t pos = undo.size(); pos-- > 0;)
+                    {
+                        undoOperation(*root_, undo[pos]);
+                        if (pos < done)
+                        {
+                            update(undo[pos], true);
+                        }
+                    }
+
+                    setPatchError(error, index, result, __LINE__);
+                    return false;
+                }
+
+                for (; done < undo.size(); ++done)
+                {
+                    update(undo[done], false);
+                }
+            }
+            return true;
+        }
+
+    private:
+        struct PathLess
+        {
+            bool operator()(const String* lhs, const String* rhs) const
+            {
+                return (*lhs < *rhs);
+            }
+        };
+
+        // Points to keys of entries_.
+        typedef std::set<const String*, PathLess> PathSet;
+
+        struct Entry
+        {
+            Entry()
+                : hash_(0), hasValue_(false)
+            {
+            }
+
+            String name_;
+            uint64_t hash_;     // of name and value, if hasValue_
+            bool hasValue_;
+        };
+
+        typedef std::map<String, Entry> EntryMap;
+        typedef std::map<String, PathSet,
+            BasicNameLess<CharType, CharTraitsType> > NameMap;
+        typedef std::map<uint64_t, PathSet> ValueMap;
+
+        const Value* getMember(const String& path) const
+        {
+            return Pointer(path).get(static_cast<const Value&>(*root_));
+        }
+
+        void findValues(const StringRef& name, const Value& value,
+                        std::vector<const String*>& paths) const
+        {
+            if (!indexValues_ || !isScalar(value))
+            {
+                return;
+            }
+
+            typename ValueMap::const_iterator it =
+                values_.find(hashMember(name, value));
+            if (it == values_.end())
+            {
+                return;
+            }
+
+            for (typename PathSet::const_iterator itPath = it->second.begin();
+                itPath != it->second.end(); ++itPath)
+            {
+                const Value* member = getMember(**itPath);
+                if ((StringRef(entries_.find(**itPath)->second.name_) ==
+                        name) && isIdentical(*member, value, true))
+                {
+                    paths.push_back(*itPath);
+                }
+            }
+        }
+
+        // Follows the change an entry of a patch undo log reverses, or
+        // the reversal if undone.
+        template<typename UndoType>
+        void update(const UndoType& change, bool undone)
+        {
+            if (change.op_ == PatchReplace)
+            {
+                replaceEntries(change.path_);
+            }
+            else if (change.op_ == PatchMove)
+            {
+                removeEntries(undone ? change.path_ : change.from_);
+                insertEntries(undone ? change.from_ : change.path_);
+            }
+            else if ((change.op_ == PatchRemove) != undone)
+            {
+                insertEntries(change.path_);
+            }
+            else
+            {
+                removeEntries(change.path_);
+            }
+        }
+
+        // The value at path was inserted into an array, or added to an
+        // object. The later elements of an array move up from the back.
+        void insertEntries(const String& path)
+        {
+            String parentPath = getParentPath(path);
+            size_t index = 0;
+            const Value* parent = getArrayParent(path, parentPath, index);
+            if (parent != NULL)
+            {
+                for (size_t pos = parent->getSize(); --pos > index;)
+                {
+                    moveEntries(parentPath, pos - 1, pos);
+                }
+            }
+            replaceEntries(path);
+        }
+
+        // The value at path was removed. The later elements of an array
+        // move down from the front, up to one past its end since a move
+        // may have inserted into the same array.
+        void removeEntries(const String& path)
+        {
+            eraseEntries(path);
+
+            String parentPath = getParentPath(path);
+            size_t index = 0;
+            const Value* parent = getArrayParent(path, parentPath, index);
+            if (parent != NULL)
+            {
+                for (size_t pos = index + 1; pos <= parent->getSize(); ++pos)
+                {
+                    moveEntries(parentPath, pos, pos - 1);
+                }
+            }
+        }
+
+        void replaceEntries(const String& path)
+        {
+            if (path.empty())
+            {
+                build();
+                return;
+            }
+
+            eraseEntries(path);
+
+            const Value& root = *root_;
+            Pointer pointer(path);
+            const Value* value = pointer.get(root);
+            if (value == NULL)
+            {
+                return;
+            }
+
+            String str(path);
+            if (Pointer(getParentPath(path)).get(root)->isObject())
+            {
+                addEntry(str, pointer.getToken(pointer.getSize() - 1),
+                    *value);
+            }
+            addEntries(str, *value);
+        }
+
+        // The array the value at path is an element of, NULL if its
+        // parent is not one.
+        const Value* getArrayParent(const String& path,
+                                    const String& parentPath,
+                                    size_t& index) const
+        {
+            const Value* parent =
+                Pointer(parentPath).get(static_cast<const Value&>(*root_));
+            if ((parent == NULL) || !parent->isArray() || parent->isPacked())
+            {
+                return NULL;
+            }
+
+            index = Pointer::parseIndex(path.substr(parentPath.size() + 1));
+            return ((index != String::npos) ? parent : NULL);
+        }
+
+        // The entry at path and the ones inside it.
+        void eraseEntries(const String& path)
+        {
+            typename EntryMap::iterator it = entries_.find(path);
+            if (it != entries_.end())
+            {
+                eraseEntry(it);
+            }
+
+            it = entries_.lower_bound(path + JSONITY_CHAR('/'));
+            while ((it != entries_.end()) && isUnder(it->first, path))
+            {
+                eraseEntry(it++);
+            }
+        }
+
+        // Renumbers the entries inside element from of the array at
+        // parentPath to element to, which has none.
+        void moveEntries(const String& parentPath, size_t from, size_t to)
+        {
+            String fromPath(parentPath);
+            appendPointerIndex(fromPath, from);
+            String toPath(parentPath);
+            appendPointerIndex(toPath, to);
+
+            std::vector<std::pair<String, Entry> > moved;
+            typename EntryMap::iterator it =
+                entries_.lower_bound(fromPath + JSONITY_CHAR('/'));
+            while ((it != entries_.end()) && isUnder(it->first, fromPath))
+            {
+                moved.push_back(std::make_pair(
+                    toPath + it->first.substr(fromPath.size()), it->second));
+                eraseEntry(it++);
+            }
+
+            for (size_t index = 0; index < moved.size(); ++index)
+            {
+                insertEntry(moved[index].first, moved[index].second);
+            }
+        }
+
+        void addEntries(String& path, const Value& value)
+        {
+            size_t size = path.size();
+
+            if (value.isObject())
+            {
+                const Object& obj = value.getObject();
+                for (typename Object::const_iterator it = obj.begin();
+                    it != obj.end(); ++it)
+                {
+                    appendPointerName(path, it->first);
+                    addEntry(path, it->first, it->second);
+                    addEntries(path, it->second);
+                    path.resize(size);
+                }
+            }
+            else if (value.isArray() && !value.isPacked())
+            {
+                const Array& arr = value.getArray();
+                for (size_t index = 0; index < arr.size(); ++index)
+                {
+                    appendPointerIndex(path, index);
+                    addEntries(path, arr[index]);
+                    path.resize(size);
+                }
+            }
+        }
+
+        void addEntry(const String& path, const String& name,
+                      const Value& value)
+        {
+            Entry entry;
+            entry.name_ = name;
+
+            if (indexValues_ && isScalar(value))
+            {
+                entry.hash_ = hashMember(StringRef(name), value);
+                entry.hasValue_ = true;
+            }
+            insertEntry(path, entry);
+        }
+
+        void insertEntry(const String& path, const Entry& entry)
+        {
+            typename EntryMap::iterator it = entries_.insert(
+                std::make_pair(path, entry)).first;
+            names_[entry.name_].insert(&it->first);
+
+            if (entry.hasValue_)
+            {
+                values_[entry.hash_].insert(&it->first);
+            }
+        }
+
+        void eraseEntry(typename EntryMap::iterator it)
+        {
+            const Entry& entry = it->second;
+
+            typename NameMap::iterator itName = names_.find(entry.name_);
+            itName->second.erase(&it->first);
+            if (itName->second.empty())
+            {
+                names_.erase(itName);
+            }
+
+            if (entry.hasValue_)
+            {
+                typename ValueMap::iterator itValue =
+                    values_.find(entry.hash_);
+                itValue->second.erase(&it->first);
+                if (itValue->second.empty())
+                {
+                    values_.erase(itValue);
+                }
+            }
+
+            entries_.erase(it);
+        }
+
+        static bool isScalar(const Value& value)
+        {
+            return (!value.isObject() && !value.isArray() &&
+                !value.isUserValue() && !value.isUserValuePtr());
+        }
+
+        static uint64_t hashMember(const StringRef& name, const Value& value)
+        {
+            return Value::mixHash(
+                Value::hashString(name.data(), name.size()) ^ value.hash());
+        }
+
+        // path is parent or inside it.
+        static bool isUnder(const String& path, const String& parent)
+        {
+            return ((path == parent) ||
+                ((path.size() > parent.size()) &&
+                 (path.compare(0, parent.size(), parent) == 0) &&
+                 (path[parent.size()] == JSONITY_CHAR('/'))));
+        }
+
+        static String getParentPath(const String& path)
+        {
+            size_t pos = path.rfind(JSONITY_CHAR('/'));
+            return ((pos == String::npos) ? String() : path.substr(0, pos));
+        }
+
+        Value* root_;
+        bool indexValues_;
+        EntryMap entries_;
+        NameMap names_;
+        ValueMap values_;
+
+    }; // JsonBasic::Index
+
+    //-----------------------------------------------------------------------//
+    // JsonBasic::FieldIndex
+    //-----------------------------------------------------------------------//
+
+    // A hash table over an array of objects, keyed by a member of each
+    // element or by the value a Pointer leads to in it. Elements without
+    // the key are left out. Keys compare like the patch test operation,
+    // so 1 finds 1.0. The table keeps element positions: it is valid
+    // until the array or its keys change, isStale() only notices a
+    // resized or moved array. The elements of a packed array are
+    // copied into the table, find() returns the copies.
+    class FieldIndex
+    {
+    public:
+        FieldIndex(const Value& array, const StringRef& name)
+            : array_(&array)
+        {
+            JSONITY_TYPE_CHECK(array.isArray());
+
+            std::vector<const Value*> keys(array.getSize());
+
+            // Numbers have no members, a packed array has no keys.
+            if (!array.isPacked())
+            {
+                const Array& arr = array.getArray();
+                const Key key(name);
+                size_t hint = 0;
+
+                for (size_t index = 0; index < arr.size(); ++index)
+                {
+                    if (arr[index].isObject())
+                    {
+                        Object& obj =
+                            const_cast<Object&>(arr[index].getObject());
+                        typename Object::iterator it =
+                            findMember(obj, key, hint);
+                        keys[index] =
+                            ((it != obj.end()) ? &it->second : NULL);
+                    }
+                }
+            }
+            build(keys);
+        }
+
+        FieldIndex(const Value& array, const Pointer& pointer)
+            : array_(&array)
+        {
+            JSONITY_TYPE_CHECK(array.isArray());
+
+            std::vector<const Value*> keys(array.getSize());
+
+            if (array.isPacked())
+            {
+                copies_.resize(keys.size());
+                for (size_t index = 0; index < keys.size(); ++index)
+                {
+                    array.tryGet(index, copies_[index]);
+                    keys[index] = pointer.get(copies_[index]);
+                }
+            }
+            else
+            {
+                const Array& arr = array.getArray();
+                for (size_t index = 0; index < arr.size(); ++index)
+                {
+                    keys[index] = pointer.get(arr[index]);
+                }
+            }
+            build(keys);
+        }
+
+    public:
+        // The number of elements indexed.
+        size_t getSize() const
+        {
+            return size_;
+        }
+
+        // The first element with key, or NULL.
+        const Value* find(const Value& key) const
+        {
+            size_t index = findIndex(key);
+            return ((index != npos) ? getElement(index) : NULL);
+        }
+
+        // The position of the first element with key, or npos.
+        size_t findIndex(const Value& key) const
+        {
+            uint64_t hash = key.hash();
+            size_t mask = slots_.size() - 1;
+
+            for (size_t slot = static_cast<size_t>(hash) & mask;
+                slots_[slot].index_ != npos; slot = (slot + 1) & mask)
+            {
+                if (isMatch(slots_[slot], key, hash))
+                {
+                    return slots_[slot].index_;
+                }
+            }
+            return npos;
+        }
+
+        // All elements with key, in array order.
+        size_t find(const Value& key,
+                    std::vector<const Value*>& results) const
+        {
+            uint64_t hash = key.hash();
+            size_t mask = slots_.size() - 1;
+            size_t count = 0;
+
+            for (size_t slot = static_cast<size_t>(hash) & mask;
+                slots_[slot].index_ != npos; slot = (slot + 1) & mask)
+            {
+                if (isMatch(slots_[slot], key, hash))
+                {
+                    results.push_back(getElement(slots_[slot].index_));
+                    ++count;
+                }
+            }
+            return count;
+        }
+
+        bool isStale() const
+        {
+            return (!array_->isArray() ||
+                (array_->isPacked() != packed_) ||
+                (array_->getSize() != arraySize_) ||
+                (getStorage() != elements_));
+        }
+
+        static const size_t npos = static_cast<size_t>(-1);
+
+    private:
+        // An empty slot has npos.
+        struct Slot
+        {
+            uint64_t hash_;
+            size_t index_;
+        };
+
+        void build(const std::vector<const Value*>& keys)
+        {
+            packed_ = array_->isPacked();
+            arraySize_ = keys.size();
+            elements_ = getStorage();
+            size_ = 0;
+
+            size_t capacity = 8;
+            while (capacity < keys.size() * 2)
+            {
+                capacity *= 2;
+            }
+            Slot empty = { 0, npos };
+            slots_.assign(capacity, empty);
+            keys_ = keys;
+
+            // Later equal keys land further along the probe sequence,
+            // so lookups meet them in array order.
+            for (size_t index = 0; index < keys.size(); ++index)
+            {
+                if (keys[index] == NULL)
+                {
+                    continue;
+                }
+
+                uint64_t hash = keys[index]->hash();
+                size_t slot = static_cast<size_t>(hash) & (capacity - 1);
+                while (slots_[slot].index_ != npos)
+                {
+                    slot = (slot + 1) & (capacity - 1);
+                }
+                slots_[slot].hash_ = hash;
+                slots_[slot].index_ = index;
+                ++size_;
+            }
+        }
+
+        bool isMatch(const Slot& slot, const Value& key, uint64_t hash) const
+        {
+            return ((slot.hash_ == hash) &&
+                isIdentical(*keys_[slot.index_], key, true));
+        }
+
+        const Value* getElement(size_t index) const
+        {
+            return (packed_ ? &copies_[index] : &array_->getArray()[index]);
+        }
+
+        // Where the elements of the array are kept, NULL if it is empty.
+        const void* getStorage() const
+        {
+            if (array_->getSize() == 0)
+            {
+                return NULL;
+            }
+            else if (array_->isPackedNumbers())
+            {
+                return array_->getNumbers().data();
+            }
+            else if (array_->isPackedReals())
+            {
+                return array_->getReals().data();
+            }
+            return &array_->getArray()[0];
+        }
+
+        const Value* array_;
+        const void* elements_;
+        size_t arraySize_;
+        std::vector<Slot> slots_;
+        std::vector<const Value*> keys_;
+        std::vector<Value> copies_;    // of a packed array
+        bool packed_;
+        size_t size_;
+
+    }; // JsonBasic::FieldIndex
+
+    //-----------------------------------------------------------------------//
+    // JsonBasic::Columns
+    //-----------------------------------------------------------------------//
+
+    // An array of objects turned into one column per member name. The
+    // type of a column follows its values: integers become reals when
+    // a real shows up, any other mix keeps Values. Missing members and
+    // nulls are marked in the null bitmap.
+    class Columns
+    {
+    public:
+        typedef typename Value::Type Type;
+
+        class Column
+        {
+        public:
+            // Arrays, objects and mixed types.
+            static const Type MixedType = 16;
+
+            explicit Column(const String& name)
+                : name_(name), type_(Value::NullType), size_(0)
+            {
+            }
+
+        public:
+            const String& getName() const
+            {
+                return name_;
+            }
+
+            // NullType while every value so far is null.
+            Type getType() const
+            {
+                return type_;
+            }
+
+            size_t getSize() const
+            {
+                return size_;
+            }
+
+            bool isNull(size_t row) const
+            {
+                JSONITY_ASSERT(row < size_);
+                return (((row / 64) < nulls_.size()) &&
+                        ((nulls_[row / 64] & (uint64_t(1) << (row % 64))) != 0));
+            }
+
+            // One bit per row, set for nulls, shorter than the column
+            // when the last rows have values.
+            const std::vector<uint64_t>& getNulls() const
+            {
+                return nulls_;
+            }
+
+            const NumberArray& getNumbers() const
+            {
+                JSONITY_TYPE_CHECK(type_ == Value::NumberType);
+                return numbers_;
+            }
+
+            const RealArray& getReals() const
+            {
+                JSONITY_TYPE_CHECK(type_ == Value::RealType);
+                return reals_;
+            }
+
+            // 0 or 1 per row.
+            const std::vector<uint8_t>& getBooleans() const
+            {
+                JSONITY_TYPE_CHECK(type_ == Value::BooleanType);
+                return booleans_;
+            }
+
+            const std::vector<String>& getStrings() const
+            {
+                JSONITY_TYPE_CHECK(type_ == Value::StringType);
+                return strings_;
+            }
+
+            const std::vector<Value>& getValues() const
+            {
+                JSONITY_TYPE_CHECK(type_ == MixedType);
+                return values_;
+            }
+
+        private:
+            void add(const Value& value)
+            {
+                if (value.isNull())
+                {
+                    addNull();
+                    return;
+                }
+
+                Type type = value.getType();
+                if ((type == Value::ArrayType) || (type == Value::ObjectType))
+                {
+                    type = MixedType;
+                }
+
+                if (type_ == Value::NullType)
+                {
+                    setType(type);
+                }
+                else if ((type_ == Value::NumberType) &&
+                         (type == Value::RealType))
+                {
+                    reals_.assign(numbers_.begin(), numbers_.end());
+                    NumberArray().swap(numbers_);
+                    type_ = Value::RealType;
+                }
+                else if ((type_ == Value::RealType) &&
+                         (type == Value::NumberType))
+                {
+                    // added as a real below
+                }
+                else if ((type_ != type) && (type_ != MixedType))
+                {
+                    setType(MixedType);
+                }
+
+                switch (type_)
+                {
+                case Value::NumberType:
+                    numbers_.push_back(value.getNumber());
+                    break;
+                case Value::RealType:
+                    reals_.push_back(value.getReal());
+                    break;
+                case Value::BooleanType:
+                    booleans_.push_back(value.getBoolean() ? 1 : 0);
+                    break;
+                case Value::StringType:
+                    strings_.push_back(
+                        String(value.getCString(), value.getStringLength()));
+                    break;
+                default:
+                    values_.push_back(value);
+                    break;
+                }
+
+                ++size_;
+            }
+
+            void addNull()
+            {
+                switch (type_)
+                {
+                case Value::NullType:
+                    break;
+                case Value::NumberType:
+                    numbers_.push_back(0);
+                    break;
+                case Value::RealType:
+                    reals_.push_back(0.0);
+                    break;
+                case Value::BooleanType:
+                    booleans_.push_back(0);
+                    break;
+                case Value::StringType:
+                    strings_.push_back(String());
+                    break;
+                default:
+                    values_.push_back(Value());
+                    break;
+                }
+
+                if (nulls_.size() <= (size_ / 64))
+                {
+                    nulls_.resize((size_ / 64) + 1, 0);
+                }
+                nulls_[size_ / 64] |= (uint64_t(1) << (size_ % 64));
+
+                ++size_;
+            }
+
+            // Moves the rows so far to the storage of type, rows of an
+            // all null column become defaults.
+            void setType(Type type)
+            {
+                if (type_ == Value::NullType)
+                {
+                    type_ = type;
+                    size_t size = size_;
+                    size_ = 0;
+                    nulls_.clear();
+                    for (size_t row = 0; row < size; ++row)
+                    {
+                        addNull();
+                    }
+                    return;
+                }
+
+                JSONITY_ASSERT(type == MixedType);
+                values_.reserve(size_);
+
+                for (size_t row = 0; row < size_; ++row)
+                {
+                    if (isNull(row))
+                    {
+                        values_.push_back(Value());
+                    }
+                    else if (type_ == Value::NumberType)
+                    {
+                        values_.push_back(Value(numbers_[row]));
+                    }
+                    else if (type_ == Value::RealType)
+                    {
+                        values_.push_back(Value(reals_[row]));
+                    }
+                    else if (type_ == Value::BooleanType)
+                    {
+                        values_.push_back(Value(booleans_[row] != 0));
+                    }
+                    else
+                    {
+                        values_.push_back(Value(strings_[row]));
+                    }
+                }
+
+                NumberArray().swap(numbers_);
+                RealArray().swap(reals_);
+                std::vector<uint8_t>().swap(booleans_);
+                std::vector<String>().swap(strings_);
+                type_ = MixedType;
+            }
+
+            String name_;
+            Type type_;
+            size_t size_;
+            std::vector<uint64_t> nulls_;
+            NumberArray numbers_;
+            RealArray reals_;
+            std::vector<uint8_t> booleans_;
+            std::vector<String> strings_;
+            std::vector<Value> values_;
+
+            friend class Columns;
+            friend class JsonBase;
+
+        }; // class JsonBasic::Columns::Column
+
+    public:
+        Columns()
+            : rows_(0), hint_(0)
+        {
+        }
+
+    public:
+        size_t getRowCount() const
+        {
+            return rows_;
+        }
+
+        size_t getColumnCount() const
+        {
+            return columns_.size();
+        }
+
+        // Columns are in the order their names first appeared.
+        const Column& getColumn(size_t index) const
+        {
+            JSONITY_ASSERT(index < columns_.size());
+            return columns_[index];
+        }
+
+        // Returns NULL if no row had the name.
+        const Column* findColumn(const StringRef& name) const
+        {
+            typename Names::const_iterator it = names_.find(name);
+            return ((it != names_.end()) ? &columns_[it->second] : NULL);
+        }
+
+        // Appends a row, obj has to be an object.
+        void addRow(const Value& obj)
+        {
+            JSONITY_TYPE_CHECK(obj.isObject());
+
+            const Object& members = obj.getObject();
+            for (typename Object::const_iterator it = members.begin();
+                it != members.end(); ++it)
+            {
+                addColumn(it->first).add(it->second);
+            }
+            endRow();
+        }
+
+        // Appends every element of an array of objects.
+        void addRows(const Value& arr)
+        {
+            JSONITY_TYPE_CHECK(arr.isArray());
+
+            const Array& rows = arr.getArray();
+            for (typename Array::const_iterator it = rows.begin();
+                it != rows.end(); ++it)
+            {
+                addRow(*it);
+            }
+        }
+
+        void clear()
+        {
+            columns_.clear();
+            names_.clear();
+            rows_ = 0;
+            hint_ = 0;
+        }
+
+    private:
+        typedef InsertionOrderMap<String, size_t,
+            BasicNameLess<CharType, CharTraitsType>,
+            std::allocator<std::pair<const String, size_t> >, true> Names;
+
+        // The column of name, added with nulls for the earlier rows
+        // if it is new. Rows with the same names in the same order
+        // hit the hint.
+        Column& addColumn(const StringRef& name)
+        {
+            if ((hint_ < columns_.size()) &&
+                (StringRef(columns_[hint_].name_) == name))
+            {
+                return columns_[hint_++];
+            }
+
+            typename Names::iterator it = names_.find(name);
+            if (it != names_.end())
+            {
+                hint_ = it->second + 1;
+                return columns_[it->second];
+            }
+
+            String columnName(name.data(), name.size());
+            names_.insert(std::make_pair(columnName, columns_.size()));
+            columns_.push_back(Column(columnName));
+            for (size_t row = 0; row < rows_; ++row)
+            {
+                columns_.back().addNull();
+            }
+
+            hint_ = columns_.size();
+            return columns_.back();
+        }
+
+        // A name already set in the current row.
+        bool isInRow(const Column& column) const
+        {
+            return (column.size_ > rows_);
+        }
+
+        void endRow()
+        {
+            ++rows_;
+            for (typename std::vector<Column>::iterator it =
+                    columns_.begin(); it != columns_.end(); ++it)
+            {
+                if (it->size_ < rows_)
+                {
+                    it->addNull();
+                }
+            }
+            hint_ = 0;
+        }
+
+        std::vector<Column> columns_;
+        Names names_;
+        size_t rows_;
+        size_t hint_;
+
+        friend class JsonBase;
+
+    }; // class JsonBasic::Columns
+
+public:
+
+    //-----------------------------------------------------------------------//
+    // JsonBasic::EncodeContext
+    //-----------------------------------------------------------------------//
+
+    class EncodeContext
+    {
+    public:
+        EncodeContext(OStream& os, const EncodeStyle* style = NULL)
+            : os_(os)
+        {
+            indent_ = 0;
+            style_ = style;
+        }
+
+		virtual ~EncodeContext() {}
+
+    public:
+
+        OStream& getOutputStream()
+        {
+            return os_;
+        }
+
+    protected:
+
+        virtual void increaseIndent()
+        {
+            ++indent_;
+        }
+
+        virtual void decreaseIndent()
+        {
+            --indent_;
+        }
+
+        virtual void writeIndent()
+        {
+            if (style_->isEnableIndent())
+            {
+                String indentStr;
+                indentStr.assign(
+                    style_->getIndentCharCount() * indent_,
+                    style_->getIndentChar());
+
+                writeString(indentStr.c_str(), indentStr.size());
+            }
+
+            if (style_->isEnableNewLine())
+            {
+                if (style_->isEnableQuat())
+                {
+                    writeChar(JSONITY_CHAR('"'));
+                }
+            }
+        }
+
+        virtual void writeNewLine()
+        {
+            if (style_->isEnablePrintNewLine())
+            {
+                static const char_t str[] =
+                {
+                    JSONITY_CHAR('\\'),
+                    JSONITY_CHAR('r'),
+                    JSONITY_CHAR('\\'),
+                    JSONITY_CHAR('n'),
+                };
+
+                if (style_->isCRLF())
+                {
+                    writeString(str, 4);
+                }
+                else
+                {
+                    writeString(&str[2], 2);
+                }
+            }
+
+            if (style_->isEnableNewLine())
+            {
+                if (style_->isEnableQuat())
+                {
+                    writeChar(JSONITY_CHAR('"'));
+                }
+
+                static const char_t str[] =
+                {
+                    JSONITY_CHAR('\r'),
+                    JSONITY_CHAR('\n'),
+                };
+
+                if (style_->isCRLF())
+                {
+                    writeString(str, 2);
+                }
+                else
+                {
+                    writeString(&str[1], 1);
+                }
+            }
+        }
+
+        virtual void writeSeparator()
+        {
+            writeChar(style_->getSeparatorChar());
+        }
+
+        virtual void writeEscape()
+        {
+            if (style_->isEnableEscape())
+            {
+                writeChar(JSONITY_CHAR('\\'));
+            }
+        }
+
+    private:
+        void writeString(const char_t* str, size_t size)
+        {
+            getOutputStream().write(str, size);
+        }
+
+        void writeChar(char_t ch)
+        {
+            writeString(&ch, 1);
+        }
+
+    private:
+        OStream& os_;
+        size_t indent_;
+        const EncodeStyle* style_;
+
+        EncodeContext(const EncodeContext&);
+        EncodeContext& operator=(const EncodeContext&);
+
+        friend class JsonBase;
+
+    }; // JsonBasic::EncodeContext
+
+    class UnreadableEncodeContext : public EncodeContext
+    {
+    public:
+        UnreadableEncodeContext(OStream& os)
+            : EncodeContext(os) {}
+    public:
+        void increaseIndent() {}
+        void decreaseIndent() {}
+        void writeIndent() {}
+        void writeNewLine() {}
+        void writeSeparator() {}
+        void writeEscape() {}
+    };
+
+public:
+
+    //-----------------------------------------------------------------------//
+    // JsonBase::Document
+    //-----------------------------------------------------------------------//
+
+    // A decoded Value whose nodes, strings and containers are allocated
+    // from an Arena owned by the document. Dropping an unmodified
+    // document releases the arena without walking the tree.
+    //
+    // A document may also decode into a MemoryResource given by the
+    // caller, which must outlive it. The tree is then destroyed node by
+    // node so that the resource gets every allocation back.
+    //
+    // Values moved out of a document keep pointing into its memory,
+    // copy them if they must outlive the document.
+
+    class Document
+    {
+    public:
+        explicit Document(size_t blockSize = Arena::DefaultBlockSize)
+            : arena_(blockSize)
+        {
+            resource_ = &arena_;
+            modified_ = false;
+            heapUsed_ = false;
+        }
+
+        explicit Document(MemoryResource* resource)
+        {
+            JSONITY_ASSERT(resource != NULL);
+
+            resource_ = resource;
+            modified_ = false;
+            heapUsed_ = false;
+        }
+
+        ~Document()
+        {
+            clear();
+        }
+
+    public:
+
+        bool decode(IStream& is, Error* error = NULL)
+        {
+            StreamDecodeContext ctx(is);
+            return decode(ctx, error);
+        }
+
+        bool decode(const char_t* jsonStr, Error* error = NULL)
+        {
+            StringDecodeContext ctx(jsonStr);
+            return decode(ctx, error);
+        }
+
+        bool decode(const String& jsonStr, Error* error = NULL)
+        {
+            return decode(jsonStr.c_str(), error);
+        }
+
+        const Value& getValue() const
+        {
+            return value_;
+        }
+
+        // The tree may get nodes from the heap once it is modified,
+        // so it is destroyed node by node when the document is dropped.
+        Value& getMutableValue()
+        {
+            modified_ = true;
+            return value_;
+        }
+
+        void clear()
+        {
+            if (modified_ || heapUsed_ || (resource_ != &arena_))
+            {
+                value_.destroy();
+            }
+            else
+            {
+                value_.release();
+            }
+
+            arena_.release();
+
+            modified_ = false;
+            heapUsed_ = false;
+        }
+
+        Arena& getArena()
+        {
+            return arena_;
+        }
+
+        MemoryResource* getResource() const
+        {
+            return resource_;
+        }
+
+        // Used by the following decode() calls.
+        void setDecodeStyle(const DecodeStyle& style)
+        {
+            style_ = style;
+        }
+
+    private:
+
+        bool decode(DecodeContext& ctx, Error* error)
+        {
+            clear();
+
+            ctx.setResource(resource_);
+            ctx.setStyle(style_);
+            bool result = JsonBase::decode(ctx, value_, error);
+            heapUsed_ = ctx.isHeapUsed();
+
+            return result;
+        }
+
+        Arena arena_;
+        MemoryResource* resource_;
+        DecodeStyle style_;
+        Value value_;
+        bool modified_;
+        bool heapUsed_;
+
+        Document(const Document&);
+        Document& operator=(const Document&);
+
+    }; // class JsonBase::Document
+
+public:
+
+    //-----------------------------------------------------------------------//
+    // JsonBase public methods
+    //-----------------------------------------------------------------------//
+
+    // Decode
+
+    static bool decode(IStream& is, Value& value,
+                       Error* error = NULL)
+    {
+        StreamDecodeContext ctx(is);
+        return decode(ctx, value, error);
+    }
+
+    static bool decode(const char_t* jsonStr, Value& value,
+                       Error* error = NULL)
+    {
+        StringDecodeContext ctx(jsonStr);
+        return decode(ctx, value, error);
+    }
+
+    static bool decode(const String& jsonStr, Value& value,
+                       Error* error = NULL)
+    {
+        return decode(jsonStr.c_str(), value, error);
+    }
+
+    static bool decode(IStream& is, Value& value,
+                       const DecodeStyle& style, Error* error = NULL)
+    {
+        StreamDecodeContext ctx(is);
+        ctx.setStyle(style);
+        return decode(ctx, value, error);
+    }
+
+    static bool decode(const char_t* jsonStr, Value& value,
+                       const DecodeStyle& style, Error* error = NULL)
+    {
+        StringDecodeContext ctx(jsonStr);
+        ctx.setStyle(style);
+        return decode(ctx, value, error);
+    }
+
+    static bool decode(const String& jsonStr, Value& value,
+                       const DecodeStyle& style, Error* error = NULL)
+    {
+        return decode(jsonStr.c_str(), value, style, error);
+    }
+
+    // The strings and containers of the value are allocated from the
+    // resource, which must outlive it.
+
+    static bool decode(IStream& is, Value& value,
+                       MemoryResource& resource, Error* error = NULL)
+    {
+        StreamDecodeContext ctx(is);
+        ctx.setResource(&resource);
+        return decode(ctx, value, error);
+    }
+
+    static bool decode(const char_t* jsonStr, Value& value,
+                       MemoryResource& resource, Error* error = NULL)
+    {
+        StringDecodeContext ctx(jsonStr);
+        ctx.setResource(&resource);
+        return decode(ctx, value, error);
+    }
+
+    static bool decode(const String& jsonStr, Value& value,
+                       MemoryResource& resource, Error* error = NULL)
+    {
+        return decode(jsonStr.c_str(), value, resource, error);
+    }
+
+    // An array of objects straight into columns, without building a
+    // Value for each row. The columns are cleared first.
+
+    static bool decode(IStream& is, Columns& columns,
+                       Error* error = NULL)
+    {
+        StreamDecodeContext ctx(is);
+        return decode(ctx, columns, error);
+    }
+
+    static bool decode(const char_t* jsonStr, Columns& columns,
+                       Error* error = NULL)
+    {
+        StringDecodeContext ctx(jsonStr);
+        return decode(ctx, columns, error);
+    }
+
+    static bool decode(const String& jsonStr, Columns& columns,
+                       Error* error = NULL)
+    {
+        return decode(jsonStr.c_str(), columns, error);
+    }
+
+
+    // Encode
+
+    static void encode(const Value& value, OStream& os,
+                       const EncodeStyle* style = NULL)
+    {
+        if (style == NULL)
+        {
+            UnreadableEncodeContext ctx(os);
+            encodeValue(ctx, value);
+        }
+        else
+        {
+            EncodeContext ctx(os, style);
+            ctx.writeIndent();
+            encodeValue(ctx, value);
+            ctx.writeNewLine();
+        }
+    }
+
+    static void encode(const Value& value, String& jsonStr,
+                       const EncodeStyle* style = NULL)
+    {
+        OStringStream oss;
+        encode(value, oss, style);
+        jsonStr = oss.str();
+    }
+
+
+    // Equal
+
+    // The text is checked while it is decoded, without building a Value,
+    // and only up to the first difference.
+    static bool equal(const Value& value, const char_t* jsonStr,
+                      bool ignoreOrder = true, Error* error = NULL)
+    {
+        StringDecodeContext ctx(jsonStr);
+        return equal(ctx, value, ignoreOrder, error);
+    }
+
+    static bool equal(const Value& value, const String& jsonStr,
+                      bool ignoreOrder = true, Error* error = NULL)
+    {
+        return equal(value, jsonStr.c_str(), ignoreOrder, error);
+    }
+
+    // Shared values whose kept hashes differ are not equal, in any
+    // order, see Value::hash().
+    static bool equal(const Value& value, const Value& other,
+                      bool ignoreOrder = true)
+    {
+        if (value.isShared() && other.isShared() &&
+            (value.isArray() || value.isObject()) &&
+            (value.hash() != other.hash()))
+        {
+            return false;
+        }
+        return (value.compare(other, ignoreOrder) == 0);
+    }
+
+
+    // Null value
+    static const Value& null()
+    {
+        static const Value nullValue;
+        return nullValue;
+    }
+
+    // Patch
+
+    // An RFC 6902 patch that turns source into target. Identical
+    // subtrees give no operations, arrays are matched by element.
+    static void diff(const Value& source, const Value& target, Value& patch)
+    {
+        patch = Array();
+        String path;
+        diffValues(source, target, path, patch.getArray());
+    }
+
+    // Applies an RFC 6902 patch in place. If an operation fails, the
+    // ones before it are undone and the error position is its index.
+    static bool applyPatch(Value& value, const Value& patch,
+                           Error* error = NULL)
+    {
+        return applyOperations(value, patch, error);
+    }
+
+    // RFC 7386 merge patch, null members of the patch remove members.
+    static void mergePatch(Value& value, const Value& patch)
+    {
+        mergeValues(value, patch);
+    }
+
+#ifdef JSONITY_SUPPORT_CXX_11
+    // The values of the patch are moved into value, not copied.
+
+    static bool applyPatch(Value& value, Value&& patch,
+                           Error* error = NULL)
+    {
+        return applyOperations(value, patch, error);
+    }
+
+    static void mergePatch(Value& value, Value&& patch)
+    {
+        mergeValues(value, patch);
+    }
+#endif
+
+public:
+
+    // Encoder
+
+    static void encodeNull(EncodeContext& ctx)
+    {
+        static const char_t str[] =
+        {
+            JSONITY_CHAR('n'),
+            JSONITY_CHAR('u'),
+            JSONITY_CHAR('l'),
+            JSONITY_CHAR('l'),
+        };
+
+        ctx.writeString(str, 4);
+    }
+
+    static void encodeNumber(EncodeContext& ctx, int64_t number)
+    {
+        intToStream(number, ctx.getOutputStream());
+    }
+
+    static void encodeString(EncodeContext& ctx, const String& str)
+    {
+        encodeString(ctx, str.c_str(), str.size());
+    }
+
+    static void encodeString(EncodeContext& ctx,
+                             const char_t* str, size_t length)
+    {
+        ctx.writeEscape();
+        ctx.writeChar(JSONITY_CHAR('\"'));
+
+        const char_t* cur = str;
+        const char_t* head = cur;
+        const char_t* end = str + length;
+
+        while (cur != end)
+        {
+            char_t escapePairCh = JSONITY_CHAR('\0');
+
+            if ((*cur) == JSONITY_CHAR('"'))
+            {
+                escapePairCh = JSONITY_CHAR('\"');
+            }
+            else if ((*cur) == JSONITY_CHAR('\\'))
+            {
+                escapePairCh = JSONITY_CHAR('\\');
+            }
+            else if ((*cur) == JSONITY_CHAR('/'))
+            {
+                escapePairCh = JSONITY_CHAR('/');
+            }
+            else if ((*cur) == JSONITY_CHAR('\b'))
+            {
+                escapePairCh = JSONITY_CHAR('b');
+            }
+            else if ((*cur) == JSONITY_CHAR('\f'))
+            {
+                escapePairCh = JSONITY_CHAR('f');
+            }
+            else if ((*cur) == JSONITY_CHAR('\n'))
+            {
+                escapePairCh = JSONITY_CHAR('n');
+            }
+            else if ((*cur) == JSONITY_CHAR('\r'))
+            {
+                escapePairCh = JSONITY_CHAR('r');
+            }
+            else if ((*cur) == JSONITY_CHAR('\t'))
+            {
+                escapePairCh = JSONITY_CHAR('t');
+            }
+            else if (((uint32_t)(*cur) < JSONITY_CHAR(0x20)) ||
+                     ((uint32_t)(*cur) == JSONITY_CHAR(0x7f)))
+            {
+                escapePairCh = JSONITY_CHAR('u');
+            }
+
+            if (escapePairCh != JSONITY_CHAR('\0'))
+            {
+                size_t size = static_cast<size_t>(cur - head);
+                if (size > 0)
+                {
+                    ctx.writeString(head, size);
+                }
+
+                ctx.writeEscape();
+
+                char_t escapeStr[2];
+                escapeStr[0] = JSONITY_CHAR('\\');
+                escapeStr[1] = escapePairCh;
+
+                ctx.writeString(escapeStr, 2);
+
+                if (escapePairCh == JSONITY_CHAR('u'))
+                {
+                    char_t hexStr[4];
+                    hexStr[0] = JSONITY_CHAR('0');
+                    hexStr[1] = JSONITY_CHAR('0');
+                    encodeHex((uint32_t)(((*cur) & 0xf0) >> 4), hexStr[2]);
+                    encodeHex((uint32_t)(((*cur) & 0x0f)), hexStr[3]);
+
+                    ctx.writeString(hexStr, 4);
+                }
+
+                ++cur;
+                head = cur;
+            }
+            else
+            {
+                ++cur;
+            }
+        }
+
+        size_t size = static_cast<size_t>(cur - head);
+        if (size > 0)
+        {
+            ctx.getOutputStream().write(head, size);
+        }
+
+        ctx.writeEscape();
+        ctx.writeChar(JSONITY_CHAR('\"'));
+    }
+
+    static void encodeBoolean(EncodeContext& ctx, bool boolean)
+    {
+        if (boolean)
+        {
+            static const char_t str[] =
+            {
+                JSONITY_CHAR('t'),
+                JSONITY_CHAR('r'),
+                JSONITY_CHAR('u'),
+                JSONITY_CHAR('e')
+            };
+
+            ctx.writeString(str, 4);
+        }
+        else
+        {
+            static const char_t str[] =
+            {
+                JSONITY_CHAR('f'),
+                JSONITY_CHAR('a'),
+                JSONITY_CHAR('l'),
+                JSONITY_CHAR('s'),
+                JSONITY_CHAR('e')
+            };
+
+            ctx.writeString(str, 5);
+        }
+    }
+
+    static void encodeReal(EncodeContext& ctx, double real)
+    {
+        doubleToStream(real, ctx.getOutputStream());
+    }
+
+    static void encodeElement(EncodeContext& ctx, const Value& value)
+    {
+        encodeValue(ctx, value);
+    }
+
+    static void encodeElement(EncodeContext& ctx, int64_t number)
+    {
+        encodeNumber(ctx, number);
+    }
+
+    static void encodeElement(EncodeContext& ctx, double real)
+    {
+        encodeReal(ctx, real);
+    }
+
+    template<typename ArrayType>
+    static void encodeArray(EncodeContext& ctx, const ArrayType& arr)
+    {
+        ctx.writeChar(JSONITY_CHAR('['));
+
+        if (!arr.empty())
+        {
+            ctx.writeNewLine();
+            ctx.increaseIndent();
+
+            for (typename ArrayType::const_iterator it = arr.begin();
+                it != arr.end();)
+            {
+                ctx.writeIndent();
+
+                encodeElement(ctx, *it);
+                ++it;
+
+                if (it != arr.end())
+                {
+                    ctx.writeChar(JSONITY_CHAR(','));
+                    ctx.writeNewLine();
+                }
+            }
+
+            ctx.writeNewLine();
+            ctx.decreaseIndent();
+            ctx.writeIndent();
+        }
+
+        ctx.writeChar(JSONITY_CHAR(']'));
+    }
+
+    static void encodeArray(EncodeContext& ctx, const Value& value)
+    {
+        if (value.isPackedNumbers())
+        {
+            encodeArray(ctx, *value.data().numbers_);
+        }
+        else if (value.isPackedReals())
+        {
+            encodeArray(ctx, *value.data().reals_);
+        }
+        else
+        {
+            encodeArray(ctx, value.getArray());
+        }
+    }
+
+    static void encodeObject(EncodeContext& ctx, const Object& obj)
+    {
+        ctx.writeChar(JSONITY_CHAR('{'));
+
+        if (!obj.empty())
+        {
+            ctx.writeNewLine();
+            ctx.increaseIndent();
+
+            for (typename Object::const_iterator it = obj.begin();
+                it != obj.end();)
+            {
+                ctx.writeIndent();
+
+                encodeString(ctx, it->first);
+
+                ctx.writeChar(JSONITY_CHAR(':'));
+                ctx.writeSeparator();
+
+                encodeValue(ctx, it->second);
+
+                ++it;
+
+                if (it != obj.end())
+                {
+                    ctx.writeChar(JSONITY_CHAR(','));
+                    ctx.writeNewLine();
+                }
+            }
+
+            ctx.writeNewLine();
+            ctx.decreaseIndent();
+            ctx.writeIndent();
+        }
+
+        ctx.writeChar(JSONITY_CHAR('}'));
+    }
+
+    static void encodeObject(EncodeContext& ctx, const Value& value)
+    {
+        encodeObject(ctx, value.getObject());
+    }
+
+    static void encodeValue(EncodeContext& ctx, const Value& value)
+    {
+        if (value.isNull())
+        {
+            encodeNull(ctx);
+        }
+        else if (value.isNumber())
+        {
+            encodeNumber(ctx, value.getNumber());
+        }
+        else if (value.isString())
+        {
+            encodeString(ctx,
+                value.getCString(), value.getStringLength());
+        }
+        else if (value.isBoolean())
+        {
+            encodeBoolean(ctx, value.getBoolean());
+        }
+        else if (value.isReal())
+        {
+            encodeReal(ctx, value.getReal());
+        }
+        else if (value.isArray())
+        {
+            encodeArray(ctx, value);
+        }
+        else if (value.isObject())
+        {
+            encodeObject(ctx, value.getObject());
+        }
+        else if (value.isUserValue())
+        {
+            value.encodeUserValue(ctx);
+        }
+        else if (value.isUserValuePtr())
+        {
+            value.encodeUserValue(ctx);
+        }
+    }
+
+private:
+
+    class DecodeContext
+    {
+    public:
+        DecodeContext()
+        {
+            proc_ = 0;
+            errorCode_ = 0;
+            codeLine_ = 0;
+            resource_ = NULL;
+            heapUsed_ = false;
+            countArraySize_ = false;
+            packNumberArrays_ = false;
+        }
+
+        virtual ~DecodeContext() {}
+
+    public:
+        virtual char_t getCurrentChar() const = 0;
+        virtual void nextChar() = 0;
+        virtual void nextLine() = 0;
+        virtual size_t getCurrentPos() const = 0;
+        virtual void setCurrentPos(size_t pos) = 0;
+        virtual void savePos() = 0;
+        virtual size_t readFromSavePos(String& str) const = 0;
+
+        // Number of elements of the array at the current position,
+        // 0 when it is unknown.
+        virtual size_t countArraySize() const
+        {
+            return 0;
+        }
+
+    public:
+        bool isEOF() const
+        {
+            return (getCurrentChar() == JSONITY_CHAR('\0'));
+        }
+
+        void skipWhiteSpace()
+        {
+            while (!isEOF())
+            {
+                if ((getCurrentChar() == JSONITY_CHAR(' ')) ||
+                    (getCurrentChar() == JSONITY_CHAR('\r')) ||
+                    (getCurrentChar() == JSONITY_CHAR('\t')))
+                {
+                    nextChar();
+                    continue;
+                }
+                else if (getCurrentChar() == JSONITY_CHAR('\n'))
+                {
+                    nextLine();
+                    continue;
+                }
+                break;
+            }
+        }
+
+        void setError(int32_t proc, int32_t errorCode,
+                      int32_t codeLine)
+        {
+            proc_ = proc;
+            errorCode_ = errorCode;
+            codeLine_ = codeLine;
+            cur_.setPos(static_cast<uint32_t>(getCurrentPos()));
+        }
+
+        void getError(Error& error) const
+        {
+            error.setError(cur_, proc_, errorCode_, codeLine_);
+        }
+
+        const Cursor& getCursor() const
+        {
+            return cur_;
+        }
+
+        // Goes back to a position from getCurrentPos() and getCursor().
+        void rewind(size_t pos, const Cursor& cur)
+        {
+            setCurrentPos(pos);
+            cur_ = cur;
+        }
+
+        String& getBuffer()
+        {
+            return buffer_;
+        }
+
+        MemoryResource* getResource() const
+        {
+            return resource_;
+        }
+
+        void setResource(MemoryResource* resource)
+        {
+            resource_ = resource;
+        }
+
+        void setStyle(const DecodeStyle& style)
+        {
+            countArraySize_ = style.isEnableCountArraySize();
+            packNumberArrays_ = style.isEnablePackNumberArrays();
+        }
+
+        bool isCountArraySize() const
+        {
+            return countArraySize_;
+        }
+
+        bool isPackNumberArrays() const
+        {
+            return (packNumberArrays_ && (resource_ == NULL));
+        }
+
+        typename ShapeCacheOf<Object>::Type& getShapeCache()
+        {
+            return shapeCache_;
+        }
+
+        // Set when a string from the resource needs a heap buffer.
+        bool isHeapUsed() const
+        {
+            return heapUsed_;
+        }
+
+        void checkHeapString(size_t length)
+        {
+            static const size_t capacity = String().capacity();
+
+            if ((resource_ != NULL) &&
+                !ResourceAllocator<CharAllocatorType>::IsResourceAware &&
+                (length > capacity))
+            {
+                heapUsed_ = true;
+            }
+        }
+
+    protected:
+        Cursor cur_;
+        int32_t proc_;
+        int32_t errorCode_;
+        int32_t codeLine_;
+        String buffer_;
+        MemoryResource* resource_;
+        bool heapUsed_;
+        bool countArraySize_;
+        bool packNumberArrays_;
+        typename ShapeCacheOf<Object>::Type shapeCache_;
+    };
+
+    class StringDecodeContext : public DecodeContext
+    {
+    public:
+        StringDecodeContext(const char_t* str)
+            : headAddr_(str), curAddr_(str), saveAddr_(NULL)
+        {
+        }
+
+    public:
+        char_t getCurrentChar() const
+        {
+            return *curAddr_;
+        }
+
+        void nextChar()
+        {
+            ++curAddr_;
+            DecodeContext::cur_.nextCol();
+        }
+
+        void nextLine()
+        {
+            ++curAddr_;
+            DecodeContext::cur_.nextRow();
+        }
+
+        size_t getCurrentPos() const
+        {
+            return (curAddr_ - headAddr_);
+        }
+
+        void setCurrentPos(size_t pos)
+        {
+            curAddr_ = headAddr_ + pos;
+        }
+
+        void savePos()
+        {
+            saveAddr_ = curAddr_;
+        }
+
+        size_t readFromSavePos(String& str) const
+        {
+            size_t size = curAddr_ - saveAddr_;
+            if (size == 0)
+            {
+                return 0;
+            }
+            str.append(saveAddr_, size);
+            return size;
+        }
+
+        // Counts the commas at depth 0, skipping strings.
+        size_t countArraySize() const
+        {
+            if (*curAddr_ == JSONITY_CHAR(']'))
+            {
+                return 0;
+            }
+
+            size_t count = 1;
+            size_t depth = 0;
+
+            for (const char_t* ptr = curAddr_; *ptr != JSONITY_CHAR('\0');
+                ++ptr)
+            {
+                char_t ch = *ptr;
+
+                if (ch == JSONITY_CHAR('"'))
+                {
+                    for (++ptr; (*ptr != JSONITY_CHAR('\0')) &&
+                                (*ptr != JSONITY_CHAR('"')); ++ptr)
+                    {
+                        if ((*ptr == JSONITY_CHAR('\\')) &&
+                            (ptr[1] != JSONITY_CHAR('\0')))
+                        {
+                            ++ptr;
+                        }
+                    }
+
+                    if (*ptr == JSONITY_CHAR('\0'))
+                    {
+                        break;
+                    }
+                }
+                else if ((ch == JSONITY_CHAR('[')) ||
+                         (ch == JSONITY_CHAR('{')))
+                {
+                    ++depth;
+                }
+                else if ((ch == JSONITY_CHAR(']')) ||
+                         (ch == JSONITY_CHAR('}')))
+                {
+                    if (depth == 0)
+                    {
+                        break;
+                    }
+                    --depth;
+                }
+                else if ((ch == JSONITY_CHAR(',')) && (depth == 0))
+                {
+                    ++count;
+                }
+            }
+
+            return count;
+        }
+
+    private:
+        StringDecodeContext();
+        StringDecodeContext& operator=(const StringDecodeContext&);
+
+        const char_t* headAddr_;
+        const char_t* curAddr_;
+        const char_t* saveAddr_;
+    };
+
+    class StreamDecodeContext : public DecodeContext
+    {
+    public:
+        StreamDecodeContext(IStream& is)
+            : is_(is)
+        {
+        }
+
+    public:
+        char_t getCurrentChar() const
+        {
+            return static_cast<char_t>(is_.rdbuf()->sgetc());
+        }
+
+        void nextChar()
+        {
+            is_.rdbuf()->pubseekoff(
+                1, std::ios_base::cur, std::ios_base::in);
+
+            DecodeContext::cur_.nextCol();
+        }
+
+        void nextLine()
+        {
+            is_.rdbuf()->pubseekoff(
+                1, std::ios_base::cur, std::ios_base::in);
+
+            DecodeContext::cur_.nextRow();
+        }
+
+        size_t getCurrentPos() const
+        {
+            return static_cast<size_t>(is_.rdbuf()->pubseekoff(
+                0, std::ios_base::cur, std::ios_base::in));
+        }
+
+        void setCurrentPos(size_t pos)
+        {
+            is_.rdbuf()->pubseekpos(pos, std::ios_base::in);
+        }
+
+        void savePos()
+        {
+            savePos_ = getCurrentPos();
+        }
+
+        size_t readFromSavePos(String& str) const
+        {
+            std::streamsize size = getCurrentPos() - savePos_;
+            if (size == 0)
+            {
+                return 0;
+            }
+            size_t index = str.size();
+            str.resize(static_cast<size_t>(str.size() + size));
+
+            is_.rdbuf()->pubseekpos(
+                savePos_, std::ios_base::in);
+
+            std::streamsize readSize =
+#if !defined(JSONITY_OS_WINDOWS) || (_MSC_VER >= 1600)
+                is_.rdbuf()->sgetn(&str[index], size);
+#else
+                is_.rdbuf()->_Sgetn_s(&str[index], size, size);
+#endif
+
+            is_.rdbuf()->pubseekpos(
+                savePos_ + readSize, std::ios_base::in);
+
+            return static_cast<size_t>(readSize);
+        }
+
+    private:
+        StreamDecodeContext();
+        StreamDecodeContext& operator=(const StreamDecodeContext&);
+
+        IStream& is_;
+        size_t savePos_;
+
+    }; // class JsonBase::DecodeContext
+
+private:
+
+    static bool decode(DecodeContext& ctx, Value& value, Error* error)
+    {
+        value.destroy();
+
+        if (!decodeValue(ctx, value))
+        {
+            if (error != NULL)
+            {
+                ctx.getError(*error);
+            }
+
+            return false;
+        }
+
+        return true;
+    }
+
+    static bool decode(DecodeContext& ctx, Columns& columns, Error* error)
+    {
+        columns.clear();
+
+        if (!decodeRows(ctx, columns))
+        {
+            if (error != NULL)
+            {
+                ctx.getError(*error);
+            }
+
+            return false;
+        }
+
+        return true;
+    }
+
+    static bool equal(DecodeContext& ctx, const Value& value,
+                      bool ignoreOrder, Error* error)
+    {
+        bool result = true;
+
+        if (!matchValue(ctx, value, ignoreOrder, result))
+        {
+            if (error != NULL)
+            {
+                ctx.getError(*error);
+            }
+
+            return false;
+        }
+
+        return result;
+    }
+
+    static bool decodeRows(DecodeContext& ctx, Columns& columns)
+    {
+        ctx.skipWhiteSpace();
+
+        if (ctx.getCurrentChar() != JSONITY_CHAR('['))
+        {
+            ctx.setError(
+                Error::ArrayProc, Error::ExpectedLSB,
+                __LINE__);
+            return false;
+        }
+        ctx.nextChar();
+        ctx.skipWhiteSpace();
+
+        bool separator = true;
+        bool empty = true;
+
+        while (ctx.getCurrentChar() != JSONITY_CHAR(']'))
+        {
+            if (ctx.isEOF())
+            {
+                ctx.setError(
+                    Error::ArrayProc, Error::UnexpectedEOF,
+                    __LINE__);
+                return false;
+            }
+
+            if (!separator)
+            {
+                ctx.setError(
+                    Error::ArrayProc, Error::ExpectedComma,
+                    __LINE__);
+                return false;
+            }
+
+            if (!decodeRow(ctx, columns))
+            {
+                return false;
+            }
+            empty = false;
+
+            ctx.skipWhiteSpace();
+
+            separator = false;
+            if (ctx.getCurrentChar() == JSONITY_CHAR(','))
+            {
+                ctx.nextChar();
+                ctx.skipWhiteSpace();
+                separator = true;
+            }
+        }
+
+        if (separator && !empty)
+        {
+            ctx.setError(
+                Error::ArrayProc, Error::UnexpectedComma,
+                __LINE__);
+            return false;
+        }
+
+        ctx.nextChar();
+
+        return true;
+    }
+
+    static bool decodeRow(DecodeContext& ctx, Columns& columns)
+    {
+        if (ctx.getCurrentChar() != JSONITY_CHAR('{'))
+        {
+            ctx.setError(
+                Error::ObjectProc, Error::ExpectedLCB,
+                __LINE__);
+            return false;
+        }
+        ctx.nextChar();
+        ctx.skipWhiteSpace();
+
+        bool separator = true;
+        bool empty = true;
+        String name;
+        Value value;
+
+        while (ctx.getCurrentChar() != JSONITY_CHAR('}'))
+        {
+            if (ctx.isEOF())
+            {
+                ctx.setError(
+                    Error::ObjectProc, Error::UnexpectedEOF,
+                    __LINE__);
+                return false;
+            }
+
+            if (!separator)
+            {
+                ctx.setError(
+                    Error::ObjectProc, Error::ExpectedComma,
+                    __LINE__);
+                return false;
+            }
+
+            name.clear();
+            if (!decodeString(ctx, name))
+            {
+                return false;
+            }
+
+            typename Columns::Column& column = columns.addColumn(name);
+            if (columns.isInRow(column))
+            {
+                ctx.setError(
+                    Error::ObjectProc, Error::NameAlreadyExists,
+                    __LINE__);
+                return false;
+            }
+
+            ctx.skipWhiteSpace();
+
+            if (ctx.getCurrentChar() != JSONITY_CHAR(':'))
+            {
+                ctx.setError(
+                    Error::ObjectProc, Error::ExpectedColon,
+                    __LINE__);
+                return false;
+            }
+
+            ctx.nextChar();
+            ctx.skipWhiteSpace();
+
+            value.destroy();
+            if (!decodeValue(ctx, value))
+            {
+                return false;
+            }
+            column.add(value);
+            empty = false;
+
+            ctx.skipWhiteSpace();
+
+            separator = false;
+            if (ctx.getCurrentChar() == JSONITY_CHAR(','))
+            {
+                ctx.nextChar();
+                ctx.skipWhiteSpace();
+                separator = true;
+            }
+        }
+
+        if (separator && !empty)
+        {
+            ctx.setError(
+                Error::ObjectProc, Error::UnexpectedComma,
+                __LINE__);
+            return false;
+        }
+
+        ctx.nextChar();
+        columns.endRow();
+
+        return true;
+    }
+
+    static bool decodeNull(DecodeContext& ctx, Value& value)
+    {
+        static const char_t str[] =
+        {
+            JSONITY_CHAR('n'),
+            JSONITY_CHAR('u'),
+            JSONITY_CHAR('l'),
+            JSONITY_CHAR('l'),
+            JSONITY_CHAR('\0')
+        };
+
+        JSONITY_ASSERT(
+            ctx.getCurrentChar() == str[0]);
+        ctx.nextChar();
+
+        for (size_t index = 1; index < 4; ++index)
+        {
+            if (ctx.isEOF())
+            {
+                ctx.setError(
+                    Error::NullProc, Error::UnexpectedEOF,
+                    __LINE__);
+                return false;
+            }
+
+            if (ctx.getCurrentChar() != str[index])
+            {
+                ctx.setError(
+                    Error::NullProc, Error::UnexpectedToken,
+                    __LINE__);
+                return false;
+            }
+
+            ctx.nextChar();
+        }
+
+        value.assignNull();
+
+        return true;
+    }
+
+    static bool decodeNumber(DecodeContext& ctx, Value& value)
+    {
+        JSONITY_ASSERT(
+             isDigit(ctx.getCurrentChar()) ||
+             (ctx.getCurrentChar() == JSONITY_CHAR('-')));
+
+        ctx.savePos();
+
+        if (ctx.getCurrentChar() == JSONITY_CHAR('-'))
+        {
+            ctx.nextChar();
+        }
+
+        bool real = false;
+
+        while (!ctx.isEOF())
+        {
+            char_t ch = ctx.getCurrentChar();
+
+            if (isDigit(ch))
+            {
+                ctx.nextChar();
+            }
+            else if ((ch == JSONITY_CHAR('e')) ||
+                     (ch == JSONITY_CHAR('E')) ||
+                     (ch == JSONITY_CHAR('-')) ||
+                     (ch == JSONITY_CHAR('+')) ||
+                     (ch == JSONITY_CHAR('.')))
+            {
+                real = true;
+                ctx.nextChar();
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        String str;
+        if (ctx.readFromSavePos(str) == 0)
+        {
+            ctx.setError(
+                Error::NumberProc, Error::UnexpectedToken,
+                __LINE__);
+            return false;
+        }
+
+        if (real)
+        {
+            double d = 0;
+            if (!stringToDouble(str, d))
+            {
+                ctx.setError(
+                    Error::RealProc, Error::SyntaxError,
+                    __LINE__);
+                return false;
+            }
+            value.assignReal(d);
+        }
+        else
+        {
+            int64_t n = 0;
+            if (!stringToInt(str, n))
+            {
+                ctx.setError(
+                    Error::NumberProc, Error::SyntaxError,
+                    __LINE__);
+                return false;
+            }
+            value.assignNumber(n);
+        }
+
+        return true;
+    }
+
+    static bool decodeHex4(DecodeContext& ctx, uint32_t& value)
+    {
+        value = 0;
+
+        for (size_t count = 0; count < 4; ++count)
+        {
+            if (ctx.isEOF())
+            {
+                return false;
+            }
+
+            uint32_t hexValue;
+
+            if (!decodeHex(ctx.getCurrentChar(), hexValue))
+            {
+                return false;
+            }
+
+            value <<= 4;
+            value += hexValue;
+
+            ctx.nextChar();
+        }
+
+        return true;
+    }
+
+    static bool decodeCodePoint(DecodeContext& ctx, String& str)
+    {
+        JSONITY_ASSERT(ctx.getCurrentChar() == JSONITY_CHAR('u'));
+        ctx.nextChar();
+
+        uint32_t codePoint1;
+
+        if (!decodeHex4(ctx, codePoint1))
+        {
+            ctx.setError(
+                Error::CodePointProc, Error::InvalidHex,
+                __LINE__);
+            return false;
+        }
+
+        if ((codePoint1 >= 0xd800) && (codePoint1 <= 0xdbff))
+        {
+            if (ctx.getCurrentChar() == JSONITY_CHAR('\\'))
+            {
+                ctx.nextChar();
+
+                if (ctx.isEOF())
+                {
+                    ctx.setError(
+                        Error::CodePointProc, Error::UnexpectedEOF,
+                        __LINE__);
+                    return false;
+                }
+
+                if (ctx.getCurrentChar() != JSONITY_CHAR('u'))
+                {
+                    ctx.setError(
+                        Error::CodePointProc, Error::UnexpectedToken,
+                        __LINE__);
+                    return false;
+                }
+
+                ctx.nextChar();
+
+                uint32_t codePoint2;
+
+                if (!decodeHex4(ctx, codePoint2))
+                {
+                    ctx.setError(
+                        Error::CodePointProc, Error::InvalidHex,
+                        __LINE__);
+                    return false;
+                }
+
+                if ((codePoint2 < 0xdc00) || (codePoint2 > 0xdfff))
+                {
+                    ctx.setError(
+                        Error::CodePointProc, Error::InvalidSurrogatePair,
+                        __LINE__);
+                    return false;
+                }
+
+                codePoint1 =
+                    (((codePoint1 - 0xd800) << 10) |
+                     ((codePoint2 - 0xdc00) & 0x3ff))
+                    + 0x10000;
+            }
+        }
+
+        char_t chars[4];
+        size_t size = 0;
+
+        size_t chSize = sizeof(char_t);     // TODO
+
+        if (chSize == 1)
+        {
+            if (codePoint1 <= 0x7f)
+            {
+                chars[size++] =
+                    static_cast<char_t>(codePoint1 & 0xff);
+            }
+            else if (codePoint1 <= 0x7ff)
+            {
+                chars[size++] =
+                    static_cast<char_t>(0xc0 | ((codePoint1 >> 6) & 0xff));
+                chars[size++] =
+                    static_cast<char_t>(0x80 | ((codePoint1 & 0x3f)));
+            }
+            else if (codePoint1 <= 0xffff)
+            {
+                chars[size++] =
+                    static_cast<char_t>(0xe0 | ((codePoint1 >> 12) & 0xff));
+                chars[size++] =
+                    static_cast<char_t>(0x80 | ((codePoint1 >> 6) & 0x3f));
+                chars[size++] =
+                    static_cast<char_t>(0x80 | (codePoint1 & 0x3f));
+            }
+            else if (codePoint1 <= 0x10ffff)
+            {
+                chars[size++] =
+                    static_cast<char_t>(0xf0 | ((codePoint1 >> 18) & 0xff));
+                chars[size++] =
+                    static_cast<char_t>(0x80 | ((codePoint1 >> 12) & 0x3f));
+                chars[size++] =
+                    static_cast<char_t>(0x80 | ((codePoint1 >> 6) & 0x3f));
+                chars[size++] =
+                    static_cast<char_t>(0x80 | (codePoint1 & 0x3f));
+            }
+            else
+            {
+                ctx.setError(
+                    Error::CodePointProc, Error::InvalidSurrogatePair,
+                    __LINE__);
+                return false;
+            }
+        }
+        else if (chSize == 2)
+        {
+            if (codePoint1 <= 0xffff)
+            {
+                chars[size++] =
+                    static_cast<char_t>(codePoint1);
+            }
+            else if (codePoint1 <= 0x10ffff)
+            {
+                chars[size++] =
+                    static_cast<char_t>(
+                        0xd800 + ((codePoint1 - 0x10000) >> 10));
+                chars[size++] =
+                    static_cast<char_t>(
+                        0xdc00 + ((codePoint1 - 0x10000) & 0x3ff));
+            }
+            else
+            {
+                ctx.setError(
+                    Error::CodePointProc, Error::InvalidSurrogatePair,
+                    __LINE__);
+                return false;
+            }
+        }
+        else if (chSize >= 4)
+        {
+            if (codePoint1 <= 0x10ffff)
+            {
+                chars[size++] =
+                    static_cast<char_t>(codePoint1);
+            }
+            else
+            {
+                ctx.setError(
+                    Error::CodePointProc, Error::InvalidSurrogatePair,
+                    __LINE__);
+                return false;
+            }
+        }
+        else
+        {
+            ctx.setError(
+                Error::CodePointProc, Error::NotSupported,
+                __LINE__);
+            return false;
+        }
+
+        str.append(chars, size);
+
+        return true;
+    }
+
+    static bool decodeEscapeChar(DecodeContext& ctx, String& str)
+    {
+        char_t ch = ctx.getCurrentChar();
+
+        if (ch == JSONITY_CHAR('"'))
+        {
+            str.push_back(JSONITY_CHAR('\"'));
+        }
+        else if (ch == JSONITY_CHAR('\\'))
+        {
+            str.push_back(JSONITY_CHAR('\\'));
+        }
+        else if (ch == JSONITY_CHAR('/'))
+        {
+            str.push_back(JSONITY_CHAR('/'));
+        }
+        else if (ch == JSONITY_CHAR('b'))
+        {
+            str.push_back(JSONITY_CHAR('\b'));
+        }
+        else if (ch == JSONITY_CHAR('f'))
+        {
+            str.push_back(JSONITY_CHAR('\f'));
+        }
+        else if (ch == JSONITY_CHAR('n'))
+        {
+            str.push_back(JSONITY_CHAR('\n'));
+        }
+        else if (ch == JSONITY_CHAR('r'))
+        {
+            str.push_back(JSONITY_CHAR('\r'));
+        }
+        else if (ch == JSONITY_CHAR('t'))
+        {
+            str.push_back(JSONITY_CHAR('\t'));
+        }
+        else if (ch == JSONITY_CHAR('u'))
+        {
+            return decodeCodePoint(ctx, str);
+        }
+        else
+        {
+            ctx.setError(
+                Error::StringProc, Error::UnexpectedEscapeToken,
+                __LINE__);
+            return false;
+        }
+
+        ctx.nextChar();
+
+        return true;
+    }
+
+    static bool decodeString(DecodeContext& ctx, Value& value)
+    {
+        String& str = ctx.getBuffer();
+        str.clear();
+
+        if (!decodeString(ctx, str))
+        {
+            return false;
+        }
+
+        value.destroy();
+        value.assignString(str.c_str(), str.size(), ctx.getResource());
+        ctx.checkHeapString(str.size());
+
+        return true;
+    }
+
+    static bool decodeString(DecodeContext& ctx, String& str)
+    {
+        JSONITY_ASSERT(
+            ctx.getCurrentChar() == JSONITY_CHAR('"'));
+        ctx.nextChar();
+
+        bool escape = false;
+        ctx.savePos();
+
+        for (;;)
+        {
+            char_t ch = ctx.getCurrentChar();
+
+            if (!escape && (ch == JSONITY_CHAR('"')))
+            {
+                break;
+            }
+
+            if (ctx.isEOF())
+            {
+                ctx.setError(
+                    Error::StringProc, Error::UnexpectedEOF,
+                    __LINE__);
+                return false;
+            }
+
+            if (!escape)
+            {
+                if (ch == JSONITY_CHAR('\\'))
+                {
+                    ctx.readFromSavePos(str);
+                    escape = true;
+                }
+
+                ctx.nextChar();
+            }
+            else
+            {
+                if (!decodeEscapeChar(ctx, str))
+                {
+                    return false;
+                }
+
+                escape = false;
+                ctx.savePos();
+            }
+        }
+
+        ctx.readFromSavePos(str);
+        ctx.nextChar();
+
+        return true;
+    }
+
+    static bool decodeTrue(DecodeContext& ctx, Value& value)
+    {
+        static const char_t str[] =
+        {
+            JSONITY_CHAR('t'),
+            JSONITY_CHAR('r'),
+            JSONITY_CHAR('u'),
+            JSONITY_CHAR('e'),
+            JSONITY_CHAR('\0')
+        };
+
+        JSONITY_ASSERT(
+            ctx.getCurrentChar() == str[0]);
+        ctx.nextChar();
+
+        for (size_t index = 1; index < 4; ++index)
+        {
+            if (ctx.isEOF())
+            {
+                ctx.setError(
+                    Error::TrueProc, Error::UnexpectedEOF,
+                    __LINE__);
+                return false;
+            }
+
+            if (ctx.getCurrentChar() != str[index])
+            {
+                ctx.setError(
+                    Error::TrueProc, Error::UnexpectedToken,
+                    __LINE__);
+                return false;
+            }
+
+            ctx.nextChar();
+        }
+
+        value.assignBoolean(true);
+
+        return true;
+    }
+
+    static bool decodeFalse(DecodeContext& ctx, Value& value)
+    {
+        static const char_t str[] =
+        {
+            JSONITY_CHAR('f'),
+            JSONITY_CHAR('a'),
+            JSONITY_CHAR('l'),
+            JSONITY_CHAR('s'),
+            JSONITY_CHAR('e'),
+            JSONITY_CHAR('\0')
+        };
+
+        JSONITY_ASSERT(
+            ctx.getCurrentChar() == str[0]);
+        ctx.nextChar();
+
+        for (size_t index = 1; index < 5; ++index)
+        {
+            if (ctx.isEOF())
+            {
+                ctx.setError(
+                    Error::FalseProc, Error::UnexpectedEOF,
+                    __LINE__);
+                return false;
+            }
+
+            if (ctx.getCurrentChar() != str[index])
+            {
+                ctx.setError(
+                    Error::FalseProc, Error::UnexpectedToken,
+                    __LINE__);
+                return false;
+            }
+
+            ctx.nextChar();
+        }
+
+        value.assignBoolean(false);
+
+        return true;
+    }
+
+    static bool decodeArray(DecodeContext& ctx, Value& value)
+    {
+        JSONITY_ASSERT(
+            ctx.getCurrentChar() == JSONITY_CHAR('['));
+        ctx.nextChar();
+        ctx.skipWhiteSpace();
+
+        value.assignEmptyArray(ctx.getResource());
+
+        bool pack = ctx.isPackNumberArrays();
+        size_t count = 0;
+
+        if (ctx.isCountArraySize())
+        {
+            count = ctx.countArraySize();
+            if ((count > 0) && !pack)
+            {
+                value.getArray().reserve(count);
+            }
+        }
+
+        bool separator = true;
+
+        while (ctx.getCurrentChar() != JSONITY_CHAR(']'))
+        {
+            if (ctx.isEOF())
+            {
+                ctx.setError(
+                    Error::ArrayProc, Error::UnexpectedEOF,
+                    __LINE__);
+                return false;
+            }
+
+            if (!separator)
+            {
+                ctx.setError(
+                    Error::ArrayProc, Error::ExpectedComma,
+                    __LINE__);
+                return false;
+            }
+
+            if (pack)
+            {
+                // Unpacked at the first element that does not fit.
+                Value element;
+                if (!decodeValue(ctx, element))
+                {
+                    return false;
+                }
+                if (!value.addPacked(element, count))
+                {
+                    pack = false;
+                    Array& arr = value.getArray();
+                    arr.reserve(count);
+                    arr.push_back(Value());
+                    arr.back().swapLayout(element);
+                }
+            }
+            else if (!decodeValue(ctx, value.addNewValue()))
+            {
+                value.getArray().pop_back();
+                return false;
+            }
+
+            ctx.skipWhiteSpace();
+
+            separator = false;
+            if (ctx.getCurrentChar() == JSONITY_CHAR(','))
+            {
+                ctx.nextChar();
+                separator = true;
+            }
+        }
+
+        if (separator && !value.isEmpty())
+        {
+            ctx.setError(
+                Error::ArrayProc, Error::UnexpectedComma,
+                __LINE__);
+            return false;
+        }
+
+        ctx.nextChar();
+
+        return true;
+    }
+
+    // A heap copy of obj, which may use the allocator of a resource.
+
+    template<typename ObjectType>
+    static ObjectType* copyObject(const ObjectType& obj)
+    {
+        return new ObjectType(obj.begin(), obj.end());
+    }
+
+    // Keeps sharing the shape when the allocators are equal.
+    template<typename KeyType, typename MappedType, typename CompareType,
+             typename AllocatorType>
+    static ShapedMap<KeyType, MappedType, CompareType, AllocatorType>*
+    copyObject(
+        const ShapedMap<KeyType, MappedType, CompareType, AllocatorType>& obj)
+    {
+        return new ShapedMap<KeyType, MappedType, CompareType,
+            AllocatorType>(obj, AllocatorType());
+    }
+
+    // A const Key tries its hint without moving it.
+
+    template<typename ObjectType>
+    static typename ObjectType::iterator findMember(
+        ObjectType& obj, const Key& key)
+    {
+        size_t hint = key.hint_;
+        return findMember(obj, key, hint);
+    }
+
+    template<typename ObjectType>
+    static typename ObjectType::iterator findMember(
+        ObjectType& obj, Key& key)
+    {
+        return findMember(obj, key, key.hint_);
+    }
+
+    // std::map does not use the hash and the hint of a Key.
+
+    template<typename KeyType, typename MappedType, typename CompareType,
+             typename AllocatorType>
+    static typename std::map<KeyType, MappedType,
+        CompareType, AllocatorType>::iterator findMember(
+        std::map<KeyType, MappedType, CompareType, AllocatorType>& obj,
+        const Key& key)
+    {
+        return obj.find(key.name_);
+    }
+
+    template<typename ObjectType>
+    static typename ObjectType::iterator findMember(
+        ObjectType& obj, const Key& key, size_t&)
+    {
+        return obj.find(key.name_);
+    }
+
+    template<typename KeyType, typename MappedType, typename CompareType,
+             typename AllocatorType>
+    static typename SortedVectorMap<KeyType, MappedType,
+        CompareType, AllocatorType>::iterator findMember(
+        SortedVectorMap<KeyType, MappedType, CompareType, AllocatorType>& obj,
+        const Key& key, size_t& hint)
+    {
+        return obj.find(StringRef(key.name_), key.hash_, hint);
+    }
+
+    template<typename KeyType, typename MappedType, typename CompareType,
+             typename AllocatorType>
+    static typename ShapedMap<KeyType, MappedType,
+        CompareType, AllocatorType>::iterator findMember(
+        ShapedMap<KeyType, MappedType, CompareType, AllocatorType>& obj,
+        const Key& key, size_t& hint)
+    {
+        return obj.find(StringRef(key.name_), key.hash_, hint);
+    }
+
+    template<typename KeyType, typename MappedType, typename CompareType,
+             typename AllocatorType, bool Indexed>
+    static typename InsertionOrderMap<KeyType, MappedType,
+        CompareType, AllocatorType, Indexed>::iterator findMember(
+        InsertionOrderMap<KeyType, MappedType,
+            CompareType, AllocatorType, Indexed>& obj,
+        const Key& key, size_t& hint)
+    {
+        return obj.find(StringRef(key.name_), key.hash_, hint);
+    }
+
+    // Sorted objects are compared in one pass over both members,
+    // the sizes are already known to be equal.
+
+    template<typename ObjectType>
+    static int32_t compareMembers(const ObjectType& obj,
+        const ObjectType& other, bool ignoreOrder)
+    {
+        typename ObjectType::const_iterator it = obj.begin();
+        typename ObjectType::const_iterator itOther = other.begin();
+
+        for (; it != obj.end(); ++it, ++itOther)
+        {
+            int result = it->first.compare(itOther->first);
+            if (result != 0)
+            {
+                return (result < 0) ? -1 : 1;
+            }
+
+            int32_t valueResult =
+                it->second.compare(itOther->second, ignoreOrder);
+            if (valueResult != 0)
+            {
+                return valueResult;
+            }
+        }
+
+        return 0;
+    }
+
+    template<typename KeyType, typename MappedType, typename CompareType,
+             typename AllocatorType, bool Indexed>
+    static int32_t compareMembers(
+        const InsertionOrderMap<KeyType, MappedType,
+            CompareType, AllocatorType, Indexed>& obj,
+        const InsertionOrderMap<KeyType, MappedType,
+            CompareType, AllocatorType, Indexed>& other,
+        bool ignoreOrder)
+    {
+        return compareUnsortedMembers(obj, other, ignoreOrder);
+    }
+
+    template<typename KeyType, typename MappedType, typename CompareType,
+             typename AllocatorType>
+    static int32_t compareMembers(
+        const ShapedMap<KeyType, MappedType,
+            CompareType, AllocatorType>& obj,
+        const ShapedMap<KeyType, MappedType,
+            CompareType, AllocatorType>& other,
+        bool ignoreOrder)
+    {
+        return compareUnsortedMembers(obj, other, ignoreOrder);
+    }
+
+    // Insertion ordered objects usually list their members in the same
+    // order, the rest is looked up by name once the orders differ.
+    template<typename ObjectType>
+    static int32_t compareUnsortedMembers(const ObjectType& obj,
+        const ObjectType& other, bool ignoreOrder)
+    {
+        typename ObjectType::const_iterator it = obj.begin();
+        typename ObjectType::const_iterator itOther = other.begin();
+
+        for (; itOther != other.end(); ++it, ++itOther)
+        {
+            if (it->first != itOther->first)
+            {
+                break;
+            }
+
+            int32_t result =
+                it->second.compare(itOther->second, ignoreOrder);
+            if (result != 0)
+            {
+                return result;
+            }
+        }
+
+        for (; itOther != other.end(); ++itOther)
+        {
+            it = obj.find(itOther->first);
+
+            if (it == obj.end())
+            {
+                return -1;
+            }
+
+            int32_t result =
+                it->second.compare(itOther->second, ignoreOrder);
+            if (result != 0)
+            {
+                return result;
+            }
+        }
+
+        return 0;
+    }
+
+    // Members go through these so that a sorted vector can append
+    // them while decoding and be sorted once at the end, and shaped
+    // objects can share the shape of an earlier object.
+
+    template<typename ObjectType>
+    static std::pair<typename ObjectType::iterator, bool> addMember(
+        ObjectType& obj, String& name)
+    {
+#ifdef JSONITY_SUPPORT_CXX_11
+        return obj.insert(std::make_pair(std::move(name), Value()));
+#else
+        return obj.insert(std::make_pair(name, Value()));
+#endif
+    }
+
+    template<typename KeyType, typename MappedType, typename CompareType,
+             typename AllocatorType>
+    static std::pair<typename SortedVectorMap<KeyType, MappedType,
+        CompareType, AllocatorType>::iterator, bool> addMember(
+        SortedVectorMap<KeyType, MappedType, CompareType, AllocatorType>& obj,
+        String& name)
+    {
+#ifdef JSONITY_SUPPORT_CXX_11
+        obj.push_back(std::make_pair(std::move(name), Value()));
+#else
+        obj.push_back(std::make_pair(name, Value()));
+#endif
+        return std::make_pair(obj.end() - 1, true);
+    }
+
+    template<typename ObjectType>
+    static bool finishMembers(DecodeContext&, ObjectType&)
+    {
+        return true;
+    }
+
+    template<typename KeyType, typename MappedType, typename CompareType,
+             typename AllocatorType>
+    static bool finishMembers(DecodeContext&,
+        SortedVectorMap<KeyType, MappedType, CompareType, AllocatorType>& obj)
+    {
+        return obj.sort();
+    }
+
+    template<typename KeyType, typename MappedType, typename CompareType,
+             typename AllocatorType>
+    static bool finishMembers(DecodeContext& ctx,
+        ShapedMap<KeyType, MappedType, CompareType, AllocatorType>& obj)
+    {
+        obj.shareShape(ctx.getShapeCache());
+        return true;
+    }
+
+    static bool decodeObject(DecodeContext& ctx, Value& value)
+    {
+        JSONITY_ASSERT(
+            ctx.getCurrentChar() == JSONITY_CHAR('{'));
+        ctx.nextChar();
+        ctx.skipWhiteSpace();
+
+        value.assignEmptyObject(ctx.getResource());
+
+        bool result = decodeMembers(ctx, value);
+
+        if (!value.isEmpty() && !finishMembers(ctx, value.getObject()) && result)
+        {
+            ctx.setError(
+                Error::ObjectProc, Error::NameAlreadyExists,
+                __LINE__);
+            return false;
+        }
+
+        return result;
+    }
+
+    static bool decodeMembers(DecodeContext& ctx, Value& value)
+    {
+        bool separator = true;
+
+        while (ctx.getCurrentChar() != JSONITY_CHAR('}'))
+        {
+            if (ctx.isEOF())
+            {
+                ctx.setError(
+                    Error::ObjectProc, Error::UnexpectedEOF,
+                    __LINE__);
+                return false;
+            }
+
+            if (!separator)
+            {
+                ctx.setError(
+                    Error::ObjectProc, Error::ExpectedComma,
+                    __LINE__);
+                return false;
+            }
+
+            String name;
+            if (!decodeString(ctx, name))
+            {
+                return false;
+            }
+            ctx.checkHeapString(name.size());
+
+            Object& obj = value.getObject();
+            std::pair<typename Object::iterator, bool> member =
+                addMember(obj, name);
+
+            if (!member.second)
+            {
+                ctx.setError(
+                    Error::ObjectProc, Error::NameAlreadyExists,
+                    __LINE__);
+                return false;
+            }
+
+            ctx.skipWhiteSpace();
+
+            if (ctx.getCurrentChar() != JSONITY_CHAR(':'))
+            {
+                ctx.setError(
+                    Error::ObjectProc, Error::ExpectedColon,
+                    __LINE__);
+                obj.erase(member.first);
+                return false;
+            }
+
+            ctx.nextChar();
+            ctx.skipWhiteSpace();
+
+            if (!decodeValue(ctx, member.first->second))
+            {
+                obj.erase(member.first);
+                return false;
+            }
+            ctx.skipWhiteSpace();
+
+            separator = false;
+            if (ctx.getCurrentChar() == JSONITY_CHAR(','))
+            {
+                ctx.nextChar();
+                ctx.skipWhiteSpace();
+                separator = true;
+            }
+        }
+
+        if (separator && !value.isEmpty())
+        {
+            ctx.setError(
+                Error::ObjectProc, Error::UnexpectedComma,
+                __LINE__);
+            return false;
+        }
+
+        ctx.nextChar();
+
+        return true;
+    }
+
+    static bool decodeValue(DecodeContext& ctx, Value& value)
+    {
+        ctx.skipWhiteSpace();
+
+        if (ctx.isEOF())
+        {
+            ctx.setError(
+                Error::UnknownProc, Error::UnexpectedEOF,
+                __LINE__);
+            return false;
+        }
+        else
+        {
+            char_t ch = ctx.getCurrentChar();
+
+            if (ch == JSONITY_CHAR('"'))
+            {
+                return decodeString(ctx, value);
+            }
+            else if (isDigit(ch) ||
+                     (ctx.getCurrentChar() == JSONITY_CHAR('-')))
+            {
+                return decodeNumber(ctx, value);
+            }
+            else if (ch == JSONITY_CHAR('{'))
+            {
+                return decodeObject(ctx, value);
+            }
+            else if (ch == JSONITY_CHAR('['))
+            {
+                return decodeArray(ctx, value);
+            }
+            else if (ch == JSONITY_CHAR('t'))
+            {
+                return decodeTrue(ctx, value);
+            }
+            else if (ch == JSONITY_CHAR('f'))
+            {
+                return decodeFalse(ctx, value);
+            }
+            else if (ch == JSONITY_CHAR('n'))
+            {
+                return decodeNull(ctx, value);
+            }
+            else
+            {
+                ctx.setError(
+                    Error::UnknownProc, Error::UnexpectedToken,
+                    __LINE__);
+                return false;
+            }
         }
+    }
 
-    public:
-        char_t getCurrentChar() const
-        {
-            return *curAddr_;
-        }
+    // Matching for equal(). Each returns false on a syntax error and
+    // clears equal at the first difference, where it stops reading.
 
-        void nextChar()
-        {
-            ++curAddr_;
-            DecodeContext::cur_.nextCol();
-        }
+    static bool matchValue(DecodeContext& ctx, const Value& expected,
+                           bool ignoreOrder, bool& equal)
+    {
+        ctx.skipWhiteSpace();
 
-        void nextLine()
-        {
-            ++curAddr_;
-            DecodeContext::cur_.nextRow();
-        }
+        char_t ch = ctx.getCurrentChar();
 
-        size_t getCurrentPos() const
+        if (ch == JSONITY_CHAR('{'))
         {
-            return (curAddr_ - headAddr_);
+            if (!expected.isObject())
+            {
+                equal = false;
+                return true;
+            }
+            return matchObject(ctx, expected, ignoreOrder, equal);
         }
-
-        void savePos()
+        else if (ch == JSONITY_CHAR('['))
         {
-            saveAddr_ = curAddr_;
+            if (!expected.isArray())
+            {
+                equal = false;
+                return true;
+            }
+            return matchArray(ctx, expected, ignoreOrder, equal);
         }
-
-        size_t readFromSavePos(String& str) const
+        else if (ch == JSONITY_CHAR('"'))
         {
-            size_t size = curAddr_ - saveAddr_;
-            if (size == 0)
+            if (!expected.isString())
             {
-                return 0;
+                equal = false;
+                return true;
             }
-            str.append(saveAddr_, size);
-            return size;
-        }
 
-    private:
-        StringDecodeContext();
-        StringDecodeContext& operator=(const StringDecodeContext&);
+            String& str = ctx.getBuffer();
+            str.clear();
 
-        const char_t* headAddr_;
-        const char_t* curAddr_;
-        const char_t* saveAddr_;
-    };
+            if (!decodeString(ctx, str))
+            {
+                return false;
+            }
 
-    class StreamDecodeContext : public DecodeContext
-    {
-    public:
-        StreamDecodeContext(IStream& is)
-            : is_(is)
-        {
+            equal = (expected.compare(str) == 0);
+            return true;
         }
 
-    public:
-        char_t getCurrentChar() const
+        Value scalar;
+        if (!decodeValue(ctx, scalar))
         {
-            return static_cast<char_t>(is_.rdbuf()->sgetc());
+            return false;
         }
 
-        void nextChar()
+        if (expected.isNull() || scalar.isNull())
         {
-            is_.rdbuf()->pubseekoff(
-                1, std::ios_base::cur, std::ios_base::in);
-
-            DecodeContext::cur_.nextCol();
+            equal = (expected.isNull() && scalar.isNull());
         }
-
-        void nextLine()
+        else if (expected.isNumber() || expected.isReal() ||
+                 expected.isBoolean())
         {
-            is_.rdbuf()->pubseekoff(
-                1, std::ios_base::cur, std::ios_base::in);
-
-            DecodeContext::cur_.nextRow();
+            equal = (expected.compare(scalar) == 0);
         }
-
-        size_t getCurrentPos() const
+        else
         {
-            return static_cast<size_t>(is_.rdbuf()->pubseekoff(
-                0, std::ios_base::cur, std::ios_base::in));
+            equal = false;
         }
 
-        void savePos()
-        {
-            savePos_ = getCurrentPos();
-        }
+        return true;
+    }
 
-        size_t readFromSavePos(String& str) const
+    static bool matchObject(DecodeContext& ctx, const Value& expected,
+                            bool ignoreOrder, bool& equal)
+    {
+        JSONITY_ASSERT(
+            ctx.getCurrentChar() == JSONITY_CHAR('{'));
+        ctx.nextChar();
+        ctx.skipWhiteSpace();
+
+        const Object& obj = expected.getObject();
+        typename Object::const_iterator next = obj.begin();
+
+        // Members are expected in the order of obj, the others are
+        // looked up. Once out of order, the members found are marked
+        // by their position in members, which is their address order,
+        // to tell duplicate names apart from a complete match.
+        bool inOrder = true;
+        std::vector<const Value*> members;
+        std::vector<bool> found;
+
+        bool separator = true;
+        size_t count = 0;
+
+        while (ctx.getCurrentChar() != JSONITY_CHAR('}'))
         {
-            std::streamsize size = getCurrentPos() - savePos_;
-            if (size == 0)
+            if (ctx.isEOF())
             {
-                return 0;
+                ctx.setError(
+                    Error::ObjectProc, Error::UnexpectedEOF,
+                    __LINE__);
+                return false;
             }
-            size_t index = str.size();
-            str.resize(static_cast<size_t>(str.size() + size));
-
-            is_.rdbuf()->pubseekpos(
-                savePos_, std::ios_base::in);
 
-            std::streamsize readSize =
-#if !defined(JSONITY_OS_WINDOWS) || (_MSC_VER >= 1600)
-                is_.rdbuf()->sgetn(&str[index], size);
-#else
-                is_.rdbuf()->_Sgetn_s(&str[index], size, size);
-#endif
+            if (!separator)
+            {
+                ctx.setError(
+                    Error::ObjectProc, Error::ExpectedComma,
+                    __LINE__);
+                return false;
+            }
 
-            is_.rdbuf()->pubseekpos(
-                savePos_ + readSize, std::ios_base::in);
+            String& name = ctx.getBuffer();
+            name.clear();
 
-            return static_cast<size_t>(readSize);
-        }
+            if (!decodeString(ctx, name))
+            {
+                return false;
+            }
 
-    private:
-        StreamDecodeContext();
-        StreamDecodeContext& operator=(const StreamDecodeContext&);
+            const Value* member = NULL;
 
-        IStream& is_;
-        size_t savePos_;
+            if (inOrder && (next != obj.end()) && (next->first == name))
+            {
+                member = &next->second;
+                ++next;
+            }
+            else
+            {
+                if (inOrder)
+                {
+                    members.reserve(obj.size());
+                    for (typename Object::const_iterator it = obj.begin();
+                        it != obj.end(); ++it)
+                    {
+                        members.push_back(&it->second);
+                    }
+                    std::sort(members.begin(), members.end(),
+                        std::less<const Value*>());
 
-    }; // class JsonBase::DecodeContext
+                    found.assign(members.size(), false);
+                    for (typename Object::const_iterator it = obj.begin();
+                        it != next; ++it)
+                    {
+                        found[getMemberPosition(members, &it->second)] =
+                            true;
+                    }
+                    inOrder = false;
+                }
 
-private:
+                typename Object::const_iterator it = obj.find(name);
+                if (it == obj.end())
+                {
+                    equal = false;
+                    return true;
+                }
 
-    static bool decodeNull(DecodeContext& ctx, Value& value)
-    {
-        static const char_t str[] =
-        {
-            JSONITY_CHAR('n'),
-            JSONITY_CHAR('u'),
-            JSONITY_CHAR('l'),
-            JSONITY_CHAR('l'),
-            JSONITY_CHAR('\0')
-        };
+                member = &it->second;
+                std::vector<bool>::reference seen =
+                    found[getMemberPosition(members, member)];
+                if (seen)
+                {
+                    ctx.setError(
+                        Error::ObjectProc, Error::NameAlreadyExists,
+                        __LINE__);
+                    return false;
+                }
+                seen = true;
+            }
+            ++count;
 
-        JSONITY_ASSERT(
-            ctx.getCurrentChar() == str[0]);
-        ctx.nextChar();
+            ctx.skipWhiteSpace();
 
-        for (size_t index = 1; index < 4; ++index)
-        {
-            if (ctx.isEOF())
+            if (ctx.getCurrentChar() != JSONITY_CHAR(':'))
             {
                 ctx.setError(
-                    Error::NullProc, Error::UnexpectedEOF,
+                    Error::ObjectProc, Error::ExpectedColon,
                     __LINE__);
                 return false;
             }
 
-            if (ctx.getCurrentChar() != str[index])
+            ctx.nextChar();
+            ctx.skipWhiteSpace();
+
+            if (!matchValue(ctx, *member, ignoreOrder, equal))
             {
-                ctx.setError(
-                    Error::NullProc, Error::UnexpectedToken,
-                    __LINE__);
                 return false;
             }
 
-            ctx.nextChar();
+            if (!equal)
+            {
+                return true;
+            }
+            ctx.skipWhiteSpace();
+
+            separator = false;
+            if (ctx.getCurrentChar() == JSONITY_CHAR(','))
+            {
+                ctx.nextChar();
+                ctx.skipWhiteSpace();
+                separator = true;
+            }
         }
 
-        value.assignNull();
+        if (separator && (count != 0))
+        {
+            ctx.setError(
+                Error::ObjectProc, Error::UnexpectedComma,
+                __LINE__);
+            return false;
+        }
+
+        ctx.nextChar();
 
+        equal = (count == obj.size());
         return true;
     }
 
-    static bool decodeNumber(DecodeContext& ctx, Value& value)
+    static size_t getMemberPosition(
+        const std::vector<const Value*>& members, const Value* member)
+    {
+        return (std::lower_bound(members.begin(), members.end(), member,
+            std::less<const Value*>()) - members.begin());
+    }
+
+    // Elements are matched in order. Without order, the first element
+    // that differs sends the whole array through decode() and compare().
+    static bool matchArray(DecodeContext& ctx, const Value& expected,
+                           bool ignoreOrder, bool& equal)
     {
         JSONITY_ASSERT(
-             isDigit(ctx.getCurrentChar()) ||
-             (ctx.getCurrentChar() == JSONITY_CHAR('-')));
+            ctx.getCurrentChar() == JSONITY_CHAR('['));
 
-        ctx.savePos();
+        size_t pos = ctx.getCurrentPos();
+        Cursor cur = ctx.getCursor();
 
-        if (ctx.getCurrentChar() == JSONITY_CHAR('-'))
-        {
-            ctx.nextChar();
-        }
+        ctx.nextChar();
+        ctx.skipWhiteSpace();
 
-        bool real = false;
+        size_t size = expected.getSize();
+        Value packed;
+        bool separator = true;
+        size_t index = 0;
 
-        while (!ctx.isEOF())
+        while (ctx.getCurrentChar() != JSONITY_CHAR(']'))
         {
-            char_t ch = ctx.getCurrentChar();
+            if (ctx.isEOF())
+            {
+                ctx.setError(
+                    Error::ArrayProc, Error::UnexpectedEOF,
+                    __LINE__);
+                return false;
+            }
+
+            if (!separator)
+            {
+                ctx.setError(
+                    Error::ArrayProc, Error::ExpectedComma,
+                    __LINE__);
+                return false;
+            }
+
+            if (index == size)
+            {
+                equal = false;
+                return true;
+            }
+
+            if (!matchValue(ctx, expected.getElement(index, packed),
+                    ignoreOrder, equal))
+            {
+                return false;
+            }
+
+            if (!equal)
+            {
+                if (!ignoreOrder)
+                {
+                    return true;
+                }
+
+                ctx.rewind(pos, cur);
+
+                Value value;
+                if (!decodeArray(ctx, value))
+                {
+                    return false;
+                }
 
-            if (isDigit(ch))
-            {
-                ctx.nextChar();
+                equal = (expected.compare(value, ignoreOrder) == 0);
+                return true;
             }
-            else if ((ch == JSONITY_CHAR('e')) ||
-                     (ch == JSONITY_CHAR('E')) ||
-                     (ch == JSONITY_CHAR('-')) ||
-                     (ch == JSONITY_CHAR('+')) ||
-                     (ch == JSONITY_CHAR('.')))
+            ++index;
+
+            ctx.skipWhiteSpace();
+
+            separator = false;
+            if (ctx.getCurrentChar() == JSONITY_CHAR(','))
             {
-                real = true;
                 ctx.nextChar();
-            }
-            else
-            {
-                break;
+                ctx.skipWhiteSpace();
+                separator = true;
             }
         }
 
-        String str;
-        if (ctx.readFromSavePos(str) == 0)
+        if (separator && (index != 0))
         {
             ctx.setError(
-                Error::NumberProc, Error::UnexpectedToken,
+                Error::ArrayProc, Error::UnexpectedComma,
                 __LINE__);
             return false;
         }
 
-        if (real)
+        ctx.nextChar();
+
+        equal = (index == size);
+        return true;
+    }
+
+private:
+
+    static bool isDigit(char_t ch)
+    {
+        return ((((unsigned)ch) >= JSONITY_CHAR('0')) &&
+                (((unsigned)ch) <= JSONITY_CHAR('9')));
+    }
+
+    static bool decodeHex(char_t ch, uint32_t& value)
+    {
+        if (isDigit(ch))
         {
-            double d = 0;
-            if (!stringToDouble(str, d))
-            {
-                ctx.setError(
-                    Error::RealProc, Error::SyntaxError,
-                    __LINE__);
-                return false;
-            }
-            value.assignReal(d);
+            value = static_cast<uint32_t>(
+                ch - JSONITY_CHAR('0'));
+        }
+        else if ((ch >= JSONITY_CHAR('a')) &&
+                 (ch <= JSONITY_CHAR('f')))
+        {
+            value = static_cast<uint32_t>(
+                ch - JSONITY_CHAR('a') + 10);
+        }
+        else if ((ch >= JSONITY_CHAR('A')) &&
+                 (ch <= JSONITY_CHAR('F')))
+        {
+            value = static_cast<uint32_t>(
+                ch - JSONITY_CHAR('A') + 10);
         }
         else
         {
-            int64_t n = 0;
-            if (!stringToInt(str, n))
-            {
-                ctx.setError(
-                    Error::NumberProc, Error::SyntaxError,
-                    __LINE__);
-                return false;
-            }
-            value.assignNumber(n);
+            return false;
         }
 
         return true;
     }
 
-    static bool decodeHex4(DecodeContext& ctx, uint32_t& value)
+    static bool encodeHex(uint32_t value, char_t& ch)
     {
-        value = 0;
+        static const char hex[] = "0123456789ABCDEF";
 
-        for (size_t count = 0; count < 4; ++count)
+        if (value < 16)
         {
-            if (ctx.isEOF())
-            {
-                return false;
-            }
+            ch = static_cast<char_t>(hex[value]);
+            return true;
+        }
+        else
+        {
+            return false;
+        }
+    }
 
-            uint32_t hexValue;
+    static bool stringToInt(const String& src, int64_t& dest)
+    {
+        bool sign = false;
+        const char_t* endp = src.c_str();
 
-            if (!decodeHex(ctx.getCurrentChar(), hexValue))
+        if ((src.length() >= 2) &&
+            ((*endp) == JSONITY_CHAR('-')))
+        {
+            ++endp;
+            sign = true;
+        }
+        else if (src.length() == 0)
+        {
+            return false;
+        }
+
+        int64_t power = 1;
+
+        for (const char_t* pch =
+            src.c_str() + (src.length() - 1);
+            pch >= endp; --pch)
+        {
+            char_t ch = *pch;
+            if (!isDigit(ch))
             {
                 return false;
             }
+            dest += ((ch - JSONITY_CHAR('0')) * power);
+            power *= 10;
+        }
 
-            value <<= 4;
-            value += hexValue;
-
-            ctx.nextChar();
+        if (sign)
+        {
+            dest = -dest;
         }
 
         return true;
     }
 
-    static bool decodeCodePoint(DecodeContext& ctx, Value& value)
+    static bool stringToDouble(const String& src, double& dest)
     {
-        JSONITY_ASSERT(value.isString());
-        JSONITY_ASSERT(ctx.getCurrentChar() == JSONITY_CHAR('u'));
-        ctx.nextChar();
-
-        uint32_t codePoint1;
+        bool sign = false;
+        const char_t* pch = src.c_str();
 
-        if (!decodeHex4(ctx, codePoint1))
+        if ((*pch) == JSONITY_CHAR('-'))
         {
-            ctx.setError(
-                Error::CodePointProc, Error::InvalidHex,
-                __LINE__);
-            return false;
+            sign = true;
+            ++pch;
         }
 
-        if ((codePoint1 >= 0xd800) && (codePoint1 <= 0xdbff))
+        int32_t pt = -1;
+        int32_t msize = 0;
+        for (;;)
         {
-            if (ctx.getCurrentChar() == JSONITY_CHAR('\\'))
+            char_t ch = *pch;
+            if (!isDigit(ch))
             {
-                ctx.nextChar();
-
-                if (ctx.isEOF())
-                {
-                    ctx.setError(
-                        Error::CodePointProc, Error::UnexpectedEOF,
-                        __LINE__);
-                    return false;
-                }
-
-                if (ctx.getCurrentChar() != JSONITY_CHAR('u'))
-                {
-                    ctx.setError(
-                        Error::CodePointProc, Error::UnexpectedToken,
-                        __LINE__);
-                    return false;
-                }
-
-                ctx.nextChar();
-
-                uint32_t codePoint2;
-
-                if (!decodeHex4(ctx, codePoint2))
-                {
-                    ctx.setError(
-                        Error::CodePointProc, Error::InvalidHex,
-                        __LINE__);
-                    return false;
-                }
-
-                if ((codePoint2 < 0xdc00) || (codePoint2 > 0xdfff))
+                if ((ch != JSONITY_CHAR('.')) || (pt >= 0))
                 {
-                    ctx.setError(
-                        Error::CodePointProc, Error::InvalidSurrogatePair,
-                        __LINE__);
-                    return false;
+                    break;
                 }
-
-                codePoint1 =
-                    (((codePoint1 - 0xd800) << 10) |
-                     ((codePoint2 - 0xdc00) & 0x3ff))
-                    + 0x10000;
+                pt = msize;
             }
+            ++pch;
+            ++msize;
         }
 
-        char_t str[4];
-        size_t size = 0;
+        const char_t* pexp = pch;
+        pch -= msize;
+        if (pt < 0)
+        {
+            pt = msize;
+        }
+        else
+        {
+            --msize;
+        }
 
-        size_t chSize = sizeof(char_t);     // TODO
+        int32_t fexp = 0;
+        if (msize > 18)
+        {
+            fexp = pt - 18;
+            msize = 18;
+        }
+        else
+        {
+            fexp = pt - msize;
+        }
 
-        if (chSize == 1)
+        if (msize == 0)
         {
-            if (codePoint1 <= 0x7f)
-            {
-                str[size++] =
-                    static_cast<char_t>(codePoint1 & 0xff);
-            }
-            else if (codePoint1 <= 0x7ff)
-            {
-                str[size++] =
-                    static_cast<char_t>(0xc0 | ((codePoint1 >> 6) & 0xff));
-                str[size++] =
-                    static_cast<char_t>(0x80 | ((codePoint1 & 0x3f)));
-            }
-            else if (codePoint1 <= 0xffff)
-            {
-                str[size++] =
-                    static_cast<char_t>(0xe0 | ((codePoint1 >> 12) & 0xff));
-                str[size++] =
-                    static_cast<char_t>(0x80 | ((codePoint1 >> 6) & 0x3f));
-                str[size++] =
-                    static_cast<char_t>(0x80 | (codePoint1 & 0x3f));
-            }
-            else if (codePoint1 <= 0x10ffff)
+            dest = 0.0;
+            return true;
+        }
+
+        int32_t frac1 = 0;
+        for (; msize > 9; --msize)
+        {
+            char_t ch = *pch;
+            ++pch;
+            if (ch == '.')
             {
-                str[size++] =
-                    static_cast<char_t>(0xf0 | ((codePoint1 >> 18) & 0xff));
-                str[size++] =
-                    static_cast<char_t>(0x80 | ((codePoint1 >> 12) & 0x3f));
-                str[size++] =
-                    static_cast<char_t>(0x80 | ((codePoint1 >> 6) & 0x3f));
-                str[size++] =
-                    static_cast<char_t>(0x80 | (codePoint1 & 0x3f));
+                ch = *pch;
+                ++pch;
             }
-            else
+            frac1 = 10 * frac1 + (ch - JSONITY_CHAR('0'));
+        }
+        int32_t frac2 = 0;
+        for (; msize > 0; --msize)
+        {
+            char_t ch = *pch;
+            ++pch;
+            if (ch == JSONITY_CHAR('.'))
             {
-                ctx.setError(
-                    Error::CodePointProc, Error::InvalidSurrogatePair,
-                    __LINE__);
-                return false;
+                ch = *pch;
+                ++pch;
             }
+            frac2 = 10 * frac2 + (ch - JSONITY_CHAR('0'));
         }
-        else if (chSize == 2)
+        dest = (1.0e9 * frac1) + frac2;
+
+        int32_t exp = 0;
+        bool esign = false;
+        pch = pexp;
+        if (((*pch) == JSONITY_CHAR('e')) ||
+            ((*pch) == JSONITY_CHAR('E')))
         {
-            if (codePoint1 <= 0xffff)
+            ++pch;
+            if ((*pch) == JSONITY_CHAR('-'))
             {
-                str[size++] =
-                    static_cast<char_t>(codePoint1);
+                esign = true;
+                ++pch;
             }
-            else if (codePoint1 <= 0x10ffff)
+            else if ((*pch) == JSONITY_CHAR('+'))
             {
-                str[size++] =
-                    static_cast<char_t>(
-                        0xd800 + ((codePoint1 - 0x10000) >> 10));
-                str[size++] =
-                    static_cast<char_t>(
-                        0xdc00 + ((codePoint1 - 0x10000) & 0x3ff));
+                ++pch;
             }
-            else
+
+            if (!isDigit(*pch))
             {
-                ctx.setError(
-                    Error::CodePointProc, Error::InvalidSurrogatePair,
-                    __LINE__);
                 return false;
             }
-        }
-        else if (chSize >= 4)
-        {
-            if (codePoint1 <= 0x10ffff)
-            {
-                str[size++] =
-                    static_cast<char_t>(codePoint1);
-            }
-            else
+
+            while (isDigit(*pch))
             {
-                ctx.setError(
-                    Error::CodePointProc, Error::InvalidSurrogatePair,
-                    __LINE__);
-                return false;
+                exp = exp * 10 +
+                    ((*pch) - JSONITY_CHAR('0'));
+                ++pch;
             }
         }
-        else
-        {
-            ctx.setError(
-                Error::CodePointProc, Error::NotSupported,
-                __LINE__);
-            return false;
-        }
-
-        value.getString().append(str, size);
-
-        return true;
-    }
-
-    static bool decodeEscapeChar(DecodeContext& ctx, Value& value)
-    {
-        JSONITY_ASSERT(value.isString());
-
-        char_t ch = ctx.getCurrentChar();
 
-        if (ch == JSONITY_CHAR('"'))
-        {
-            value.getString().push_back(JSONITY_CHAR('\"'));
-        }
-        else if (ch == JSONITY_CHAR('\\'))
+        if (esign)
         {
-            value.getString().push_back(JSONITY_CHAR('\\'));
+            exp = fexp - exp;
         }
-        else if (ch == JSONITY_CHAR('/'))
+        else
         {
-            value.getString().push_back(JSONITY_CHAR('/'));
+            exp = fexp + exp;
         }
-        else if (ch == JSONITY_CHAR('b'))
+
+        if (exp < 0)
         {
-            value.getString().push_back(JSONITY_CHAR('\b'));
+            esign = true;
+            exp = -exp;
         }
-        else if (ch == JSONITY_CHAR('f'))
+        else
         {
-            value.getString().push_back(JSONITY_CHAR('\f'));
+            esign = false;
         }
-        else if (ch == JSONITY_CHAR('n'))
+
+        if (exp >= 512)
         {
-            value.getString().push_back(JSONITY_CHAR('\n'));
+            exp = 511;
         }
-        else if (ch == JSONITY_CHAR('r'))
+
+        double dexp = 1.0;
+
+        static const double powers[] =
         {
-            value.getString().push_back(JSONITY_CHAR('\r'));
-        }
-        else if (ch == JSONITY_CHAR('t'))
+            10.0, 100.0, 1.0e4, 1.0e8, 1.0e16,
+            1.0e32, 1.0e64, 1.0e128, 1.0e256
+        };
+
+        for (const double* power = powers;
+            exp != 0; exp >>= 1, ++power)
         {
-            value.getString().push_back(JSONITY_CHAR('\t'));
+            if (exp & 01)
+            {
+                dexp *= *power;
+            }
         }
-        else if (ch == JSONITY_CHAR('u'))
+
+        if (esign)
         {
-            return decodeCodePoint(ctx, value);
+            dest /= dexp;
         }
         else
         {
-            ctx.setError(
-                Error::StringProc, Error::UnexpectedEscapeToken,
-                __LINE__);
-            return false;
+            dest *= dexp;
         }
 
-        ctx.nextChar();
+        if (sign)
+        {
+            dest = -dest;
+        }
 
         return true;
     }
 
-    static bool decodeString(DecodeContext& ctx, Value& value)
+    static void asciiToBasicChar(
+        const char* src, char_t* dest, size_t size)
     {
-        JSONITY_ASSERT(
-            ctx.getCurrentChar() == JSONITY_CHAR('"'));
-        ctx.nextChar();
-
-        value = String();
-        bool escape = false;
-        ctx.savePos();
-
-        for (;;)
+        for (size_t counter = 0; counter < size; ++counter)
         {
-            char_t ch = ctx.getCurrentChar();
-
-            if (!escape && (ch == JSONITY_CHAR('"')))
-            {
-                break;
-            }
-
-            if (ctx.isEOF())
-            {
-                ctx.setError(
-                    Error::StringProc, Error::UnexpectedEOF,
-                    __LINE__);
-                return false;
-            }
-
-            if (!escape)
-            {
-                if (ch == JSONITY_CHAR('\\'))
-                {
-                    ctx.readFromSavePos(value.getString());
-                    escape = true;
-                }
-
-                ctx.nextChar();
-            }
-            else
-            {
-                if (!decodeEscapeChar(ctx, value))
-                {
-                    return false;
-                }
-
-                escape = false;
-                ctx.savePos();
-            }
+            (*dest) = static_cast<char_t>(*src);
+            ++src;
+            ++dest;
         }
-
-        ctx.readFromSavePos(value.getString());
-        ctx.nextChar();
-
-        return true;
     }
 
-    static bool decodeTrue(DecodeContext& ctx, Value& value)
+    static void intToStream(int64_t number, OStream& os)
     {
-        static const char_t str[] =
-        {
-            JSONITY_CHAR('t'),
-            JSONITY_CHAR('r'),
-            JSONITY_CHAR('u'),
-            JSONITY_CHAR('e'),
-            JSONITY_CHAR('\0')
-        };
-
-        JSONITY_ASSERT(
-            ctx.getCurrentChar() == str[0]);
-        ctx.nextChar();
+        char str1[256];
+        int size = JSONITY_SNPRINTF(
+            str1, sizeof(str1), JSONITY_FORM_I64, number);
 
-        for (size_t index = 1; index < 4; ++index)
+        size_t chSize = sizeof(char_t); // TODO
+        if (chSize == sizeof(char))
         {
-            if (ctx.isEOF())
-            {
-                ctx.setError(
-                    Error::TrueProc, Error::UnexpectedEOF,
-                    __LINE__);
-                return false;
-            }
-
-            if (ctx.getCurrentChar() != str[index])
-            {
-                ctx.setError(
-                    Error::TrueProc, Error::UnexpectedToken,
-                    __LINE__);
-                return false;
-            }
-
-            ctx.nextChar();
+            os.write((char_t*)str1, size);
         }
+        else
+        {
+            char_t str2[256];
+            asciiToBasicChar(str1, str2, size);
 
-        value.assignBoolean(true);
-
-        return true;
+            os.write(str2, size);
+        }
     }
 
-    static bool decodeFalse(DecodeContext& ctx, Value& value)
+    static void doubleToStream(double d, OStream& os)
     {
-        static const char_t str[] =
-        {
-            JSONITY_CHAR('f'),
-            JSONITY_CHAR('a'),
-            JSONITY_CHAR('l'),
-            JSONITY_CHAR('s'),
-            JSONITY_CHAR('e'),
-            JSONITY_CHAR('\0')
-        };
-
-        JSONITY_ASSERT(
-            ctx.getCurrentChar() == str[0]);
-        ctx.nextChar();
+        char str1[256];
+        int size = JSONITY_SNPRINTF(
+            str1, sizeof(str1), "%g", d);
 
-        for (size_t index = 1; index < 5; ++index)
+        size_t chSize = sizeof(char_t); // TODO
+        if (chSize == sizeof(char))
         {
-            if (ctx.isEOF())
-            {
-                ctx.setError(
-                    Error::FalseProc, Error::UnexpectedEOF,
-                    __LINE__);
-                return false;
-            }
-
-            if (ctx.getCurrentChar() != str[index])
-            {
-                ctx.setError(
-                    Error::FalseProc, Error::UnexpectedToken,
-                    __LINE__);
-                return false;
-            }
+            os.write((char_t*)str1, size);
+        }
+        else
+        {
+            char_t str2[256];
+            asciiToBasicChar(str1, str2, size);
 
-            ctx.nextChar();
+            os.write(str2, size);
         }
+    }
 
-        value.assignBoolean(false);
+private:
 
-        return true;
-    }
+    // Diff
 
-    static bool decodeArray(DecodeContext& ctx, Value& value)
+    // Arrays whose changed middle parts are larger than this are
+    // matched greedily instead of by longest common subsequence.
+    static const size_t MaxDiffTableSize = 1 << 20;
+
+    typedef std::vector<std::pair<uint64_t, size_t> > HashIndex;
+
+    static void diffValues(const Value& source, const Value& target,
+                           String& path, Array& ops)
     {
-        JSONITY_ASSERT(
-            ctx.getCurrentChar() == JSONITY_CHAR('['));
-        ctx.nextChar();
-        ctx.skipWhiteSpace();
+        if (isSameShared(source, target))
+        {
+            return;
+        }
 
-        value.assignArray(Array());
+        if (source.isArray() && target.isArray())
+        {
+            Array sourceCopy;
+            Array targetCopy;
+            diffArrays(getElements(source, sourceCopy),
+                getElements(target, targetCopy), path, ops);
+        }
+        else if (source.isObject() && target.isObject())
+        {
+            diffObjects(source.getObject(), target.getObject(), path, ops);
+        }
+        else if (!isIdentical(source, target))
+        {
+            addOperation(ops, "replace", path)[
+                asciiToString("value")] = target;
+        }
+    }
 
-        bool separator = true;
+    static void diffObjects(const Object& source, const Object& target,
+                            String& path, Array& ops)
+    {
+        size_t size = path.size();
 
-        while (ctx.getCurrentChar() != JSONITY_CHAR(']'))
+        for (typename Object::const_iterator it = source.begin();
+            it != source.end(); ++it)
         {
-            if (ctx.isEOF())
-            {
-                ctx.setError(
-                    Error::ArrayProc, Error::UnexpectedEOF,
-                    __LINE__);
-                return false;
-            }
+            appendPointerName(path, it->first);
 
-            if (!separator)
+            typename Object::const_iterator itTarget =
+                target.find(it->first);
+            if (itTarget == target.end())
             {
-                ctx.setError(
-                    Error::ArrayProc, Error::ExpectedComma,
-                    __LINE__);
-                return false;
+                addOperation(ops, "remove", path);
             }
-
-            if (!decodeValue(ctx, value.addNewValue()))
+            else
             {
-                value.getArray().pop_back();
-                return false;
+                diffValues(it->second, itTarget->second, path, ops);
             }
 
-            ctx.skipWhiteSpace();
+            path.resize(size);
+        }
 
-            separator = false;
-            if (ctx.getCurrentChar() == JSONITY_CHAR(','))
+        for (typename Object::const_iterator it = target.begin();
+            it != target.end(); ++it)
+        {
+            if (source.find(it->first) == source.end())
             {
-                ctx.nextChar();
-                separator = true;
+                appendPointerName(path, it->first);
+                addOperation(ops, "add", path)[
+                    asciiToString("value")] = it->second;
+                path.resize(size);
             }
         }
+    }
 
-        if (separator && !value.isEmpty())
+    // The elements of an array, copied into copy if it is packed.
+    static const Array& getElements(const Value& value, Array& copy)
+    {
+        if (!value.isPacked())
         {
-            ctx.setError(
-                Error::ArrayProc, Error::UnexpectedComma,
-                __LINE__);
-            return false;
+            return value.getArray();
         }
 
-        ctx.nextChar();
-
-        return true;
+        size_t size = value.getPackedSize();
+        copy.reserve(size);
+        for (size_t index = 0; index < size; ++index)
+        {
+            copy.push_back(value.getPackedValue(index));
+        }
+        return copy;
     }
 
-    static bool decodeObject(DecodeContext& ctx, Value& value)
+    // The common head and tail are skipped, the rest is matched by
+    // a longest common subsequence of the element hashes. Elements
+    // that take each other's place are diffed recursively.
+    static void diffArrays(const Array& source, const Array& target,
+                           String& path, Array& ops)
     {
-        JSONITY_ASSERT(
-            ctx.getCurrentChar() == JSONITY_CHAR('{'));
-        ctx.nextChar();
-        ctx.skipWhiteSpace();
+        size_t begin = 0;
+        while ((begin < source.size()) && (begin < target.size()) &&
+            isIdentical(source[begin], target[begin]))
+        {
+            ++begin;
+        }
 
-        value.assignObject(Object());
-        
-        bool separator = true;
+        size_t sourceEnd = source.size();
+        size_t targetEnd = target.size();
+        while ((sourceEnd > begin) && (targetEnd > begin) &&
+            isIdentical(source[sourceEnd - 1], target[targetEnd - 1]))
+        {
+            --sourceEnd;
+            --targetEnd;
+        }
 
-        while (ctx.getCurrentChar() != JSONITY_CHAR('}'))
+        size_t n = sourceEnd - begin;
+        size_t m = targetEnd - begin;
+        size_t size = path.size();
+
+        std::vector<uint64_t> sourceHashes(n);
+        std::vector<uint64_t> targetHashes(m);
+        for (size_t index = 0; index < n; ++index)
         {
-            if (ctx.isEOF())
+            sourceHashes[index] = source[begin + index].hash(false);
+        }
+        for (size_t index = 0; index < m; ++index)
+        {
+            targetHashes[index] = target[begin + index].hash(false);
+        }
+
+        if ((n + 1) * (m + 1) > MaxDiffTableSize)
+        {
+            diffArraysGreedy(source, target, begin,
+                sourceHashes, targetHashes, path, ops);
+            return;
+        }
+
+        // table[i * (m + 1) + j] is the subsequence length of the
+        // elements from i and j on.
+        std::vector<uint32_t> table((n + 1) * (m + 1), 0);
+        for (size_t i = n; i-- > 0;)
+        {
+            for (size_t j = m; j-- > 0;)
             {
-                ctx.setError(
-                    Error::ObjectProc, Error::UnexpectedEOF,
-                    __LINE__);
-                return false;
+                uint32_t& length = table[i * (m + 1) + j];
+                if (sourceHashes[i] == targetHashes[j])
+                {
+                    length = table[(i + 1) * (m + 1) + j + 1] + 1;
+                }
+                else
+                {
+                    length = (std::max)(table[(i + 1) * (m + 1) + j],
+                                        table[i * (m + 1) + j + 1]);
+                }
             }
+        }
 
-            if (!separator)
+        size_t i = 0;
+        size_t j = 0;
+        size_t pos = begin;
+
+        while ((i < n) || (j < m))
+        {
+            if ((i < n) && (j < m) &&
+                ((sourceHashes[i] == targetHashes[j]) ||
+                 (table[(i + 1) * (m + 1) + j + 1] ==
+                    table[i * (m + 1) + j])))
             {
-                ctx.setError(
-                    Error::ObjectProc, Error::ExpectedComma,
-                    __LINE__);
-                return false;
+                appendPointerIndex(path, pos);
+                diffValues(source[begin + i], target[begin + j], path, ops);
+                path.resize(size);
+                ++i;
+                ++j;
+                ++pos;
             }
-
-            Value name;
-            if (!decodeString(ctx, name))
+            else if ((j == m) ||
+                ((i < n) && (table[(i + 1) * (m + 1) + j] >=
+                    table[i * (m + 1) + j + 1])))
             {
-                return false;
+                appendPointerIndex(path, pos);
+                addOperation(ops, "remove", path);
+                path.resize(size);
+                ++i;
             }
-
-            if (value.hasName(name))
+            else
             {
-                ctx.setError(
-                    Error::ObjectProc, Error::NameAlreadyExists,
-                    __LINE__);
-                return false;
+                appendPointerIndex(path, pos);
+                addOperation(ops, "add", path)[
+                    asciiToString("value")] = target[begin + j];
+                path.resize(size);
+                ++j;
+                ++pos;
             }
+        }
+    }
 
-            ctx.skipWhiteSpace();
+    // Elements that do not match are removed when the target has the
+    // next one later on, added when the source has, or else diffed
+    // against each other.
+    static void diffArraysGreedy(const Array& source, const Array& target,
+                                 size_t begin,
+                                 const std::vector<uint64_t>& sourceHashes,
+                                 const std::vector<uint64_t>& targetHashes,
+                                 String& path, Array& ops)
+    {
+        HashIndex sourceIndex;
+        HashIndex targetIndex;
+        makeHashIndex(sourceHashes, sourceIndex);
+        makeHashIndex(targetHashes, targetIndex);
 
-            if (ctx.getCurrentChar() != JSONITY_CHAR(':'))
-            {
-                ctx.setError(
-                    Error::ObjectProc, Error::ExpectedColon,
-                    __LINE__);
-                return false;
-            }
+        size_t n = sourceHashes.size();
+        size_t m = targetHashes.size();
+        size_t size = path.size();
+        size_t i = 0;
+        size_t j = 0;
+        size_t pos = begin;
 
-            ctx.nextChar();
-            ctx.skipWhiteSpace();
+        while ((i < n) || (j < m))
+        {
+            bool remove = (j == m);
+            bool add = (i == n);
 
-            if (!decodeValue(ctx, value[name.getString()]))
+            if (!remove && !add && (sourceHashes[i] != targetHashes[j]))
             {
-                value.getObject().erase(name);
-                return false;
+                size_t inTarget = findHash(targetIndex, sourceHashes[i], j);
+                size_t inSource = findHash(sourceIndex, targetHashes[j], i);
+
+                if ((inTarget != String::npos) ||
+                    (inSource != String::npos))
+                {
+                    // The closer match wins, npos is the farthest.
+                    remove = ((inSource - i) < (inTarget - j));
+                    add = !remove;
+                }
             }
-            ctx.skipWhiteSpace();
 
-            separator = false;
-            if (ctx.getCurrentChar() == JSONITY_CHAR(','))
+            appendPointerIndex(path, pos);
+            if (remove)
             {
-                ctx.nextChar();
-                ctx.skipWhiteSpace();
-                separator = true;
+                addOperation(ops, "remove", path);
+                ++i;
+            }
+            else if (add)
+            {
+                addOperation(ops, "add", path)[
+                    asciiToString("value")] = target[begin + j];
+                ++j;
+                ++pos;
+            }
+            else
+            {
+                diffValues(source[begin + i], target[begin + j], path, ops);
+                ++i;
+                ++j;
+                ++pos;
             }
+            path.resize(size);
         }
+    }
 
-        if (separator && !value.isEmpty())
+    static void makeHashIndex(const std::vector<uint64_t>& hashes,
+                              HashIndex& index)
+    {
+        index.reserve(hashes.size());
+        for (size_t pos = 0; pos < hashes.size(); ++pos)
         {
-            ctx.setError(
-                Error::ObjectProc, Error::UnexpectedComma,
-                __LINE__);
-            return false;
+            index.push_back(std::make_pair(hashes[pos], pos));
         }
+        std::sort(index.begin(), index.end());
+    }
 
-        ctx.nextChar();
+    // The first position from pos on with the hash, or npos.
+    static size_t findHash(const HashIndex& index, uint64_t hash,
+                           size_t pos)
+    {
+        typename HashIndex::const_iterator it = std::lower_bound(
+            index.begin(), index.end(), std::make_pair(hash, pos));
 
-        return true;
+        if ((it == index.end()) || (it->first != hash))
+        {
+            return String::npos;
+        }
+        return it->second;
     }
 
-    static bool decodeValue(DecodeContext& ctx, Value& value)
+    // Exact equality: unlike compare(), 1 and 1.0 or true differ
+    // unless numeric is set.
+    static bool isIdentical(const Value& lhs, const Value& rhs,
+                            bool numeric = false)
     {
-        ctx.skipWhiteSpace();
+        if (numeric && (lhs.isNumber() || lhs.isReal()) &&
+            (rhs.isNumber() || rhs.isReal()) &&
+            (lhs.getType() != rhs.getType()))
+        {
+            return (lhs.getReal() == rhs.getReal());
+        }
 
-        if (ctx.isEOF())
+        if (lhs.getType() != rhs.getType())
         {
-            ctx.setError(
-                Error::UnknownProc, Error::UnexpectedEOF,
-                __LINE__);
             return false;
         }
-        else
+
+        if (isSameShared(lhs, rhs))
         {
-            char_t ch = ctx.getCurrentChar();
+            return true;
+        }
 
-            if (ch == JSONITY_CHAR('"'))
-            {
-                return decodeString(ctx, value);
-            }
-            else if (isDigit(ch) ||
-                     (ctx.getCurrentChar() == JSONITY_CHAR('-')))
-            {
-                return decodeNumber(ctx, value);
-            }
-            else if (ch == JSONITY_CHAR('{'))
-            {
-                return decodeObject(ctx, value);
-            }
-            else if (ch == JSONITY_CHAR('['))
-            {
-                return decodeArray(ctx, value);
+        switch (lhs.getType())
+        {
+        case Value::NullType:
+            return true;
+        case Value::NumberType:
+            return (lhs.getNumber() == rhs.getNumber());
+        case Value::RealType:
+            return (lhs.getReal() == rhs.getReal());
+        case Value::BooleanType:
+            return (lhs.getBoolean() == rhs.getBoolean());
+        case Value::StringType:
+            return (lhs.compare(rhs) == 0);
+        case Value::ArrayType:
+            {
+                size_t size = lhs.getSize();
+                if (size != rhs.getSize())
+                {
+                    return false;
+                }
+
+                Value element;
+                Value otherElement;
+                for (size_t index = 0; index < size; ++index)
+                {
+                    if (!isIdentical(lhs.getElement(index, element),
+                            rhs.getElement(index, otherElement), numeric))
+                    {
+                        return false;
+                    }
+                }
+                return true;
             }
-            else if (ch == JSONITY_CHAR('t'))
+        case Value::ObjectType:
             {
-                return decodeTrue(ctx, value);
+                const Object& obj = lhs.getObject();
+                const Object& other = rhs.getObject();
+                if (obj.size() != other.size())
+                {
+                    return false;
+                }
+
+                for (typename Object::const_iterator it = obj.begin();
+                    it != obj.end(); ++it)
+                {
+                    typename Object::const_iterator itOther =
+                        other.find(it->first);
+                    if ((itOther == other.end()) ||
+                        !isIdentical(it->second, itOther->second, numeric))
+                    {
+                        return false;
+                    }
+                }
+                return true;
             }
-            else if (ch == JSONITY_CHAR('f'))
+        default:
+            return false;
+        }
+    }
+
+    static bool isSameShared(const Value& lhs, const Value& rhs)
+    {
+        return (lhs.isShared() && rhs.isShared() &&
+            (lhs.getSharedHeader() == rhs.getSharedHeader()));
+    }
+
+    static Value& addOperation(Array& ops, const char* op,
+                               const String& path)
+    {
+        ops.push_back(Value());
+        Value& operation = ops.back();
+        operation[asciiToString("op")] = asciiToString(op);
+        operation[asciiToString("path")] = path;
+        return operation;
+    }
+
+    // RFC 6901 reference tokens.
+
+    static void appendPointerName(String& path, const String& name)
+    {
+        path += JSONITY_CHAR('/');
+
+        for (size_t index = 0; index < name.size(); ++index)
+        {
+            if (name[index] == JSONITY_CHAR('~'))
             {
-                return decodeFalse(ctx, value);
+                path += JSONITY_CHAR('~');
+                path += JSONITY_CHAR('0');
             }
-            else if (ch == JSONITY_CHAR('n'))
+            else if (name[index] == JSONITY_CHAR('/'))
             {
-                return decodeNull(ctx, value);
+                path += JSONITY_CHAR('~');
+                path += JSONITY_CHAR('1');
             }
             else
             {
-                ctx.setError(
-                    Error::UnknownProc, Error::UnexpectedToken,
-                    __LINE__);
-                return false;
+                path += name[index];
             }
         }
     }
 
-private:
-
-    static bool isDigit(char_t ch)
+    static void appendPointerIndex(String& path, size_t index)
     {
-        return ((((unsigned)ch) >= JSONITY_CHAR('0')) &&
-                (((unsigned)ch) <= JSONITY_CHAR('9')));
+        char_t digits[24];
+        size_t size = 0;
+
+        do
+        {
+            digits[size++] = JSONITY_CHAR('0' + (index % 10));
+            index /= 10;
+        } while (index != 0);
+
+        path += JSONITY_CHAR('/');
+        while (size > 0)
+        {
+            path += digits[--size];
+        }
     }
 
-    static bool decodeHex(char_t ch, uint32_t& value)
+    static bool equalsAscii(const StringRef& str, const char* ascii)
     {
-        if (isDigit(ch))
+        size_t index = 0;
+        for (; index < str.size(); ++index)
         {
-            value = static_cast<uint32_t>(
-                ch - JSONITY_CHAR('0'));
+            if ((ascii[index] == '\0') ||
+                (str.data()[index] != static_cast<char_t>(ascii[index])))
+            {
+                return false;
+            }
         }
-        else if ((ch >= JSONITY_CHAR('a')) &&
-                 (ch <= JSONITY_CHAR('f')))
-        {
-            value = static_cast<uint32_t>(
-                ch - JSONITY_CHAR('a') + 10);
+        return (ascii[index] == '\0');
+    }
+
+    static String asciiToString(const char* str)
+    {
+        String result;
+        for (; *str != '\0'; ++str)
+        {
+            result += static_cast<char_t>(*str);
         }
-        else if ((ch >= JSONITY_CHAR('A')) &&
-                 (ch <= JSONITY_CHAR('F')))
+        return result;
+    }
+
+private:
+
+    // Patch
+
+    static const int32_t PatchAdd = 1;
+    static const int32_t PatchRemove = 2;
+    static const int32_t PatchReplace = 3;
+    static const int32_t PatchMove = 4;
+
+    // Undoes one change: a value to add, remove or put back, or one to
+    // move back from path to from.
+    struct PatchUndo
+    {
+        PatchUndo(int32_t op, const String& path)
+            : op_(op), path_(path)
         {
-            value = static_cast<uint32_t>(
-                ch - JSONITY_CHAR('A') + 10);
         }
-        else
+
+        int32_t op_;
+        String path_;
+        String from_;
+        Value value_;
+    };
+
+    typedef std::vector<PatchUndo> PatchUndoLog;
+
+    // PatchType is const Value to copy the values of the patch, or Value
+    // to move them out of it. The non-const accessors detach a shared
+    // patch first, so its other copies keep their values.
+    template<typename PatchType>
+    static bool applyOperations(Value& value, PatchType& patch,
+                                Error* error)
+    {
+        if (!patch.isArray() || patch.isPacked())
         {
+            setPatchError(error, 0, Error::InvalidPatch, __LINE__);
             return false;
         }
 
-        return true;
+        return applyOperationList(value, patch.getArray(), error);
     }
 
-    static bool encodeHex(uint32_t value, char_t& ch)
+    template<typename ArrayType>
+    static bool applyOperationList(Value& value, ArrayType& ops,
+                                   Error* error)
     {
-        static const char hex[] = "0123456789ABCDEF";
+        PatchUndoLog undo;
 
-        if (value < 16)
-        {
-            ch = static_cast<char_t>(hex[value]);
-            return true;
-        }
-        else
+        for (size_t index = 0; index < ops.size(); ++index)
         {
-            return false;
+            int32_t result = applyOperation(value, ops[index], undo);
+            if (result != 0)
+            {
+                for (size_t pos = undo.size(); pos-- > 0;)
+                {
+                    undoOperation(value, undo[pos]);
+                }
+
+                setPatchError(error, index, result, __LINE__);
+                return false;
+            }
         }
+
+        return true;
     }
 
-    static bool stringToInt(const String& src, int64_t& dest)
+    // Returns 0 or the error code.
+    template<typename OperationType>
+    static int32_t applyOperation(Value& root, OperationType& op,
+                                  PatchUndoLog& undo)
     {
-        bool sign = false;
-        const char_t* endp = src.c_str();
+        static const String opName = asciiToString("op");
+        static const String pathName = asciiToString("path");
+        static const String fromName = asciiToString("from");
+        static const String valueName = asciiToString("value");
 
-        if ((src.length() >= 2) &&
-            ((*endp) == JSONITY_CHAR('-')))
+        StringRef name;
+        StringRef pathRef;
+        if (!op.isObject() ||
+            (op.tryGet(opName) == NULL) ||
+            !op.tryGet(opName)->tryGetString(name) ||
+            (op.tryGet(pathName) == NULL) ||
+            !op.tryGet(pathName)->tryGetString(pathRef))
         {
-            ++endp;
-            sign = true;
+            return Error::InvalidPatch;
         }
-        else if (src.length() == 0)
+
+        String path(pathRef);
+        OperationType* value = op.tryGet(valueName);
+        StringRef fromRef;
+        bool hasFrom = ((op.tryGet(fromName) != NULL) &&
+            op.tryGet(fromName)->tryGetString(fromRef));
+        String from(fromRef);
+
+        if (equalsAscii(name, "add") && (value != NULL))
         {
-            return false;
+            Value element;
+            takeValue(*value, element);
+            return addValue(root, path, element, &undo);
+        }
+        else if (equalsAscii(name, "remove"))
+        {
+            return removeValue(root, path, NULL, &undo);
+        }
+        else if (equalsAscii(name, "replace") && (value != NULL))
+        {
+            Value element;
+            takeValue(*value, element);
+            return replaceValue(root, path, element, &undo);
         }
+        else if (equalsAscii(name, "move") && hasFrom)
+        {
+            if (from == path)
+            {
+                // Nothing moves, but from must still exist.
+                Value element;
+                return ((Pointer(from).find(root, element) != NULL) ?
+                    0 : Error::PathNotFound);
+            }
+            else if ((path.size() > from.size()) &&
+                (path.compare(0, from.size(), from) == 0) &&
+                (path[from.size()] == JSONITY_CHAR('/')))
+            {
+                // Into itself.
+                return Error::InvalidPatch;
+            }
 
-        int32_t power = 1;
+            else if (path.empty())
+            {
+                // The value is replaced by a part of it.
+                return copyValue(root, from, path, undo, true);
+            }
 
-        for (const char_t* pch =
-            src.c_str() + (src.length() - 1);
-            pch >= endp; --pch)
-        {
-            char_t ch = *pch;
-            if (!isDigit(ch))
+            Value element;
+            int32_t result = removeValue(root, from, &element, NULL);
+            if (result != 0)
             {
-                return false;
+                return result;
             }
-            dest += ((ch - JSONITY_CHAR('0')) * power);
-            power *= 10;
-        }
 
-        if (sign)
+            result = addValue(root, path, element, &undo);
+            if (result != 0)
+            {
+                addValue(root, from, element, NULL);
+                return result;
+            }
+
+            // Moved back first, then what was replaced is put back.
+            if (undo.back().op_ == PatchReplace)
+            {
+                undo.back().op_ = PatchAdd;
+                undo.push_back(PatchUndo(PatchMove, path));
+            }
+            undo.back().op_ = PatchMove;
+            undo.back().from_ = from;
+            return 0;
+        }
+        else if (equalsAscii(name, "copy") && hasFrom)
         {
-            dest = -dest;
+            return copyValue(root, from, path, undo, false);
+        }
+        else if (equalsAscii(name, "test") && (value != NULL))
+        {
+            Value element;
+            const Value* target = Pointer(path).find(root, element);
+            if (target == NULL)
+            {
+                return Error::PathNotFound;
+            }
+            return (isIdentical(*target, *value, true) ?
+                0 : Error::TestFailed);
         }
 
-        return true;
+        return Error::InvalidPatch;
     }
 
-    static bool stringToDouble(const String& src, double& dest)
+    static int32_t copyValue(Value& root, const String& from,
+                             const String& path, PatchUndoLog& undo,
+                             bool remove)
     {
-        bool sign = false;
-        const char_t* pch = src.c_str();
-
-        if ((*pch) == JSONITY_CHAR('-'))
+        Value packed;
+        const Value* source = Pointer(from).find(root, packed);
+        if (source == NULL)
         {
-            sign = true;
-            ++pch;
+            return Error::PathNotFound;
         }
 
-        int32_t pt = -1;
-        int32_t msize = 0;
-        for (;;)
+        Value element(*source);
+        if (remove)
         {
-            char_t ch = *pch;
-            if (!isDigit(ch))
+            int32_t result = removeValue(root, from, NULL, &undo);
+            if (result != 0)
             {
-                if ((ch != JSONITY_CHAR('.')) || (pt >= 0))
-                {
-                    break;
-                }
-                pt = msize;
+                return result;
             }
-            ++pch;
-            ++msize;
         }
+        return addValue(root, path, element, &undo);
+    }
 
-        const char_t* pexp = pch;
-        pch -= msize;
-        if (pt < 0)
+    static void undoOperation(Value& root, PatchUndo& undo)
+    {
+        if (undo.op_ == PatchAdd)
         {
-            pt = msize;
+            addValue(root, undo.path_, undo.value_, NULL);
         }
-        else
+        else if (undo.op_ == PatchRemove)
         {
-            --msize;
+            removeValue(root, undo.path_, NULL, NULL);
         }
-
-        int32_t fexp = 0;
-        if (msize > 18)
+        else if (undo.op_ == PatchReplace)
         {
-            fexp = pt - 18;
-            msize = 18;
+            replaceValue(root, undo.path_, undo.value_, NULL);
         }
         else
         {
-            fexp = pt - msize;
+            Value element;
+            removeValue(root, undo.path_, &element, NULL);
+            addValue(root, undo.from_, element, NULL);
         }
+    }
 
-        if (msize == 0)
+    // The element is swapped in, undo gets the change to reverse it.
+    static int32_t addValue(Value& root, const String& path,
+                            Value& element, PatchUndoLog* undo)
+    {
+        Pointer pointer(path);
+        if (!pointer.isValid())
         {
-            dest = 0.0;
-            return true;
+            return Error::InvalidPatch;
         }
-
-        int32_t frac1 = 0;
-        for (; msize > 9; --msize)
+        else if (pointer.getSize() == 0)
         {
-            char_t ch = *pch;
-            ++pch;
-            if (ch == '.')
-            {
-                ch = *pch;
-                ++pch;
-            }
-            frac1 = 10 * frac1 + (ch - JSONITY_CHAR('0'));
+            return replaceValue(root, path, element, undo);
         }
-        int32_t frac2 = 0;
-        for (; msize > 0; --msize)
+
+        Value* parent = pointer.resolve(root, pointer.getSize() - 1);
+        const String& last = pointer.tokens_.back().key_.getName();
+
+        if ((parent != NULL) && parent->isObject())
         {
-            char_t ch = *pch;
-            ++pch;
-            if (ch == JSONITY_CHAR('.'))
+            if (parent->get(last) != NULL)
             {
-                ch = *pch;
-                ++pch;
+                return replaceValue(root, path, element, undo);
             }
-            frac2 = 10 * frac2 + (ch - JSONITY_CHAR('0'));
-        }
-        dest = (1.0e9 * frac1) + frac2;
 
-        int32_t exp = 0;
-        bool esign = false;
-        pch = pexp;
-        if (((*pch) == JSONITY_CHAR('e')) ||
-            ((*pch) == JSONITY_CHAR('E')))
-        {
-            ++pch;
-            if ((*pch) == JSONITY_CHAR('-'))
+            (*parent)[last].swapLayout(element);
+            if (undo != NULL)
             {
-                esign = true;
-                ++pch;
+                undo->push_back(PatchUndo(PatchRemove, path));
             }
-            else if ((*pch) == JSONITY_CHAR('+'))
+            return 0;
+        }
+        else if ((parent != NULL) && parent->isArray())
+        {
+            Array& arr = parent->getArray();
+            size_t index = pointer.tokens_.back().index_;
+
+            if (last == String(1, JSONITY_CHAR('-')))
             {
-                ++pch;
+                index = arr.size();
             }
-
-            if (!isDigit(*pch))
+            else if (index > arr.size())
             {
-                return false;
+                return Error::PathNotFound;
             }
 
-            while (isDigit(*pch))
+            arr.insert(arr.begin() + index, Value());
+            arr[index].swapLayout(element);
+            if (undo != NULL)
             {
-                exp = exp * 10 +
-                    ((*pch) - JSONITY_CHAR('0'));
-                ++pch;
+                undo->push_back(PatchUndo(PatchRemove,
+                    path.substr(0, path.rfind(JSONITY_CHAR('/')))));
+                appendPointerIndex(undo->back().path_, index);
             }
+            return 0;
         }
 
-        if (esign)
+        return Error::PathNotFound;
+    }
+
+    // The removed value goes to removed if given, or else to undo.
+    static int32_t removeValue(Value& root, const String& path,
+                               Value* removed, PatchUndoLog* undo)
+    {
+        Pointer pointer(path);
+        if (!pointer.isValid() || (pointer.getSize() == 0))
         {
-            exp = fexp - exp;
+            return Error::InvalidPatch;
         }
-        else
+
+        Value* parent = pointer.resolve(root, pointer.getSize() - 1);
+        Value* target = ((parent != NULL) ?
+            Pointer::resolveToken(parent, pointer.tokens_.back()) : NULL);
+        if (target == NULL)
         {
-            exp = fexp + exp;
+            return Error::PathNotFound;
         }
 
-        if (exp < 0)
+        if (removed != NULL)
         {
-            esign = true;
-            exp = -exp;
+            removed->swapLayout(*target);
         }
-        else
+        else if (undo != NULL)
         {
-            esign = false;
+            undo->push_back(PatchUndo(PatchAdd, path));
+            undo->back().value_.swapLayout(*target);
         }
 
-        if (exp >= 512)
+        if (parent->isObject())
         {
-            exp = 511;
+            parent->getObject().erase(pointer.tokens_.back().key_.getName());
         }
-
-        double dexp = 1.0;
-
-        static const double powers[] =
-        {
-            10.0, 100.0, 1.0e4, 1.0e8, 1.0e16,
-            1.0e32, 1.0e64, 1.0e128, 1.0e256
-        };
-
-        for (const double* power = powers;
-            exp != 0; exp >>= 1, ++power)
+        else
         {
-            if (exp & 01)
-            {
-                dexp *= *power;
-            }
+            Array& arr = parent->getArray();
+            arr.erase(arr.begin() + (target - &arr[0]));
         }
+        return 0;
+    }
 
-        if (esign)
+    static int32_t replaceValue(Value& root, const String& path,
+                                Value& element, PatchUndoLog* undo)
+    {
+        Pointer pointer(path);
+        if (!pointer.isValid())
         {
-            dest /= dexp;
+            return Error::InvalidPatch;
         }
-        else
+
+        Value* target = pointer.get(root);
+        if (target == NULL)
         {
-            dest *= dexp;
+            return Error::PathNotFound;
         }
 
-        if (sign)
+        target->swapLayout(element);
+        if (undo != NULL)
         {
-            dest = -dest;
+            undo->push_back(PatchUndo(PatchReplace, path));
+            undo->back().value_.swapLayout(element);
         }
-
-        return true;
+        return 0;
     }
 
-    static void asciiToBasicChar(
-        const char* src, char_t* dest, size_t size)
+    static void takeValue(const Value& source, Value& dest)
     {
-        for (size_t counter = 0; counter < size; ++counter)
-        {
-            (*dest) = static_cast<char_t>(*src);
-            ++src;
-            ++dest;
-        }
+        dest = source;
     }
 
-    static void intToStream(int64_t number, OStream& os)
+    static void takeValue(Value& source, Value& dest)
     {
-        char str1[256];
-        int size = JSONITY_SNPRINTF(
-            str1, sizeof(str1), JSONITY_FORM_I64, number);
+        dest.swapLayout(source);
+    }
 
-        size_t chSize = sizeof(char_t); // TODO
-        if (chSize == sizeof(char))
+    // See applyOperations() for PatchType.
+    template<typename PatchType>
+    static void mergeValues(Value& value, PatchType& patch)
+    {
+        if (!patch.isObject())
         {
-            os.write((char_t*)str1, size);
+            takeValue(patch, value);
+            return;
         }
-        else
-        {
-            char_t str2[256];
-            asciiToBasicChar(str1, str2, size);
 
-            os.write(str2, size);
+        if (!value.isObject())
+        {
+            value = Object();
         }
+
+        mergeMembers(value, patch.getObject());
     }
 
-    static void doubleToStream(double d, OStream& os)
+    template<typename ObjectType>
+    static void mergeMembers(Value& value, ObjectType& members)
     {
-        char str1[256];
-        int size = JSONITY_SNPRINTF(
-            str1, sizeof(str1), "%g", d);
-
-        size_t chSize = sizeof(char_t); // TODO
-        if (chSize == sizeof(char))
+        for (typename IteratorOf<ObjectType>::Type it = members.begin();
+            it != members.end(); ++it)
         {
-            os.write((char_t*)str1, size);
+            if (it->second.isNull())
+            {
+                value.getObject().erase(it->first);
+            }
+            else
+            {
+                mergeValues(value[StringRef(it->first)], it->second);
+            }
         }
-        else
-        {
-            char_t str2[256];
-            asciiToBasicChar(str1, str2, size);
+    }
 
-            os.write(str2, size);
+    static void setPatchError(Error* error, size_t index,
+                              int32_t errorCode, int32_t codeLine)
+    {
+        if (error != NULL)
+        {
+            Cursor cur;
+            cur.setPos(static_cast<uint32_t>(index));
+            error->setError(cur, Error::PatchProc, errorCode, codeLine);
         }
     }
 
@@ -3688,6 +12213,25 @@ JSONITY_VALUE_OPERATOR_IOSTREAM(wJson)
 // standard
 typedef u8Json  Json;
 
+// Object layouts
+typedef JsonBase<char, std::char_traits<char>,
+    std::allocator<char>, SortedObjectPolicy> sortedJson;
+typedef JsonBase<char, std::char_traits<char>,
+    std::allocator<char>, HashObjectPolicy> hashJson;
+typedef JsonBase<char, std::char_traits<char>,
+    std::allocator<char>, OrderedObjectPolicy> orderedJson;
+typedef JsonBase<char, std::char_traits<char>,
+    std::allocator<char>, ShapeObjectPolicy> shapeJson;
+
+#ifdef JSONITY_SUPPORT_PMR
+// Strings, arrays and objects are std::pmr containers, memory comes from
+// std::pmr::get_default_resource() unless a resource is given.
+// No stream operators, containers converting to both Value types
+// would make them ambiguous.
+typedef JsonBase<char, std::char_traits<char>,
+    std::pmr::polymorphic_allocator<char> > pmrJson;
+#endif
+
 } // namespace jsonity
 
 #endif//JSONITY_HPP_
@@ -1450,6 +1450,2463 @@ void test17()
 #endif
 }
 
+void test18()
+{
+    {
+        Json::Value v1("1234567890123");     // inline
+        Json::Value v2("12345678901234");    // heap
+
+        JSONITY_ASSERT(v1.getSize() == 13);
+        JSONITY_ASSERT(v2.getSize() == 14);
+        JSONITY_ASSERT(v1 == "1234567890123");
+        JSONITY_ASSERT(v2 == "12345678901234");
+        JSONITY_ASSERT(v1 < v2);
+
+        std::string s1 = v1.getCString();
+        JSONITY_ASSERT(s1 == "1234567890123");
+
+        Json::Value v3 = v1;
+        JSONITY_ASSERT(v3 == v1);
+
+        v3.getString().append("abc");
+        JSONITY_ASSERT(v3 == "1234567890123abc");
+        JSONITY_ASSERT(v1 == "1234567890123");
+
+        v1.clear();
+        JSONITY_ASSERT(v1.isString());
+        JSONITY_ASSERT(v1.isEmpty());
+        JSONITY_ASSERT(v1 == "");
+    }
+
+    {
+        std::string jsonStr =
+            "[\"ok\", \"\\u00e9t\\u00e9\", \"\\\"quoted\\\"\", "
+            "\"a long string stored on the heap\"]";
+
+        Json::Value v;
+        JSONITY_ASSERT(Json::decode(jsonStr, v));
+        JSONITY_ASSERT(v[0] == "ok");
+        JSONITY_ASSERT(v[1] == "\xc3\xa9t\xc3\xa9");
+        JSONITY_ASSERT(v[2] == "\"quoted\"");
+        JSONITY_ASSERT(v[3] == "a long string stored on the heap");
+
+        const Json::Value& cv = v;
+        std::string str = cv.getArray()[0].getCString();
+        JSONITY_ASSERT(str == "ok");
+
+        std::string out;
+        Json::encode(v, out);
+        JSONITY_ASSERT(Json::equal(v, out));
+    }
+
+    {
+        wJson::Value v1(L"abc");
+        wJson::Value v2(L"abcdefghijklmn");
+
+        JSONITY_ASSERT(v1 == L"abc");
+        JSONITY_ASSERT(v2 == L"abcdefghijklmn");
+        JSONITY_ASSERT(v1.getString() == L"abc");
+    }
+}
+
+void test19()
+{
+    {
+        Json::Value v;
+        JSONITY_ASSERT(Json::decode("{ \"arr\" : [], \"obj\" : {} }", v));
+
+        const Json::Object& obj = v.getObject();
+        const Json::Value& arrValue = obj.find("arr")->second;
+        const Json::Value& objValue = obj.find("obj")->second;
+        JSONITY_ASSERT(arrValue.isArray());
+        JSONITY_ASSERT(arrValue.isEmpty());
+        JSONITY_ASSERT(arrValue.getArray().empty());
+        JSONITY_ASSERT(objValue.isObject());
+        JSONITY_ASSERT(objValue.getSize() == 0);
+        JSONITY_ASSERT(Json::equal(v, "{ \"obj\" : {}, \"arr\" : [] }"));
+
+        Json::Value copy = v;
+        JSONITY_ASSERT(copy == v);
+
+        v["arr"].addNewValue() = 100;
+        v["obj"]["name"] = "data";
+        JSONITY_ASSERT(v["arr"].getSize() == 1);
+        JSONITY_ASSERT(v["obj"]["name"] == "data");
+        JSONITY_ASSERT(copy["arr"].getSize() == 0);
+        JSONITY_ASSERT(copy["obj"].getSize() == 0);
+
+        v["arr"].clear();
+        v["obj"].clear();
+        JSONITY_ASSERT(Json::equal(v, "{ \"arr\" : [], \"obj\" : {} }"));
+
+        std::string jsonStr;
+        Json::encode(copy, jsonStr);
+        JSONITY_ASSERT(jsonStr == "{\"arr\":[],\"obj\":{}}");
+    }
+}
+
+void test20()
+{
+    Json::Value copy;
+
+    {
+        Json::Document doc;
+        JSONITY_ASSERT(doc.decode(jstr1));
+
+        const Json::Value& v = doc.getValue();
+        JSONITY_ASSERT(v.isObject());
+        JSONITY_ASSERT(v.getSize() == 11);
+        JSONITY_ASSERT(Json::equal(v, jstr2));
+        JSONITY_ASSERT(doc.getArena().getSize() > 0);
+
+        copy = v;
+    }
+
+    JSONITY_ASSERT(Json::equal(copy, jstr2));
+
+    {
+        Json::Document doc;
+        JSONITY_ASSERT(doc.decode(
+            "{ \"a_rather_long_member_name\" : "
+                "\"a string that does not fit inline\", "
+              "\"list\" : [ 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 ] }"));
+
+        Json::Value& v = doc.getMutableValue();
+        v["list"].addNewValue() = "a heap string added after decode";
+        v["added"] = copy;
+        v["a_rather_long_member_name"] = 100;
+
+        JSONITY_ASSERT(v["list"].getSize() == 11);
+        JSONITY_ASSERT(v["added"] == copy);
+
+        JSONITY_ASSERT(doc.decode("[ \"again\" ]"));
+        JSONITY_ASSERT(Json::equal(doc.getValue(), "[ \"again\" ]"));
+
+        doc.clear();
+        JSONITY_ASSERT(doc.getValue().isNull());
+    }
+
+    {
+        Json::Document doc;
+        Json::Error err;
+        JSONITY_ASSERT(!doc.decode("[ 1, 2, ", &err));
+        JSONITY_ASSERT(err.getErrorCode() == Json::Error::UnexpectedEOF);
+    }
+}
+
+class CountingResource : public MemoryResource
+{
+public:
+    CountingResource() : count_(0), bytes_(0) {}
+
+    size_t count_;
+    size_t bytes_;
+
+private:
+    virtual void* do_allocate(size_t bytes, size_t)
+    {
+        ++count_;
+        bytes_ += bytes;
+        return ::operator new(bytes);
+    }
+
+    virtual void do_deallocate(void* ptr, size_t bytes, size_t)
+    {
+        --count_;
+        bytes_ -= bytes;
+        ::operator delete(ptr);
+    }
+
+    virtual bool do_is_equal(
+        const MemoryResource& other) const JSONITY_NOEXCEPT
+    {
+        return (this == &other);
+    }
+};
+
+void test21()
+{
+    CountingResource resource;
+
+    {
+        Json::Value v;
+        JSONITY_ASSERT(Json::decode(jstr1, v, resource));
+        JSONITY_ASSERT(Json::equal(v, jstr2));
+        JSONITY_ASSERT(resource.count_ > 0);
+
+        Json::Value copy(v);
+        Json::Value copy2(v, &resource);
+        JSONITY_ASSERT(copy == v);
+        JSONITY_ASSERT(copy2 == v);
+
+        copy2["number"] = 1;
+        v.setValue(copy, &resource);
+        JSONITY_ASSERT(Json::equal(v, jstr2));
+    }
+
+    JSONITY_ASSERT(resource.count_ == 0);
+    JSONITY_ASSERT(resource.bytes_ == 0);
+
+    {
+        Json::Document doc(&resource);
+        JSONITY_ASSERT(doc.decode("{ \"list\" : [ 1, \"two\", {} ] }"));
+        JSONITY_ASSERT(doc.getResource() == &resource);
+        JSONITY_ASSERT(resource.count_ > 0);
+    }
+
+    JSONITY_ASSERT(resource.count_ == 0);
+
+#ifdef JSONITY_SUPPORT_PMR
+    {
+        char buffer[4096];
+        std::pmr::monotonic_buffer_resource pool(buffer, sizeof(buffer));
+
+        pmrJson::Document doc(&pool);
+        JSONITY_ASSERT(doc.decode(
+            "{ \"a_rather_long_member_name\" : "
+                "\"a string that does not fit inline\" }"));
+
+        const pmrJson::Value& v = doc.getValue();
+        const pmrJson::String& str =
+            *v.getObject().find("a_rather_long_member_name")->second
+                .tryGetString();
+        JSONITY_ASSERT(str == "a string that does not fit inline");
+        JSONITY_ASSERT(str.get_allocator().resource() == &pool);
+        JSONITY_ASSERT(
+            v.getObject().begin()->first.get_allocator().resource() ==
+                &pool);
+
+        pmrJson::Value copy(v);
+        JSONITY_ASSERT(copy == v);
+    }
+
+    {
+        pmrJson::Document doc;
+        JSONITY_ASSERT(doc.decode(jstr1.c_str()));
+        JSONITY_ASSERT(pmrJson::equal(doc.getValue(), jstr2.c_str()));
+    }
+#endif
+}
+
+void test22()
+{
+    Json::Value a;
+    JSONITY_ASSERT(Json::decode(jstr1, a));
+    JSONITY_ASSERT(!a.isShared());
+
+    a.makeShared();
+    JSONITY_ASSERT(a.isShared());
+    JSONITY_ASSERT(Json::equal(a, jstr2));
+
+    const Json::Value& ca = a;
+
+    {
+        Json::Value b = a;
+        const Json::Value& cb = b;
+        JSONITY_ASSERT(b.isShared());
+        JSONITY_ASSERT(&ca.getObject() == &cb.getObject());
+
+        // writing through b copies only the top level
+        b["name1"] = 1;
+        JSONITY_ASSERT(!b.isShared());
+        JSONITY_ASSERT(&ca.getObject() != &cb.getObject());
+        JSONITY_ASSERT(cb.getObject().find("name11")->second.isShared());
+        JSONITY_ASSERT(&ca.getObject().find("name11")->second.getArray() ==
+                       &cb.getObject().find("name11")->second.getArray());
+
+        JSONITY_ASSERT(Json::equal(a, jstr2));
+        JSONITY_ASSERT(b != a);
+    }
+
+    JSONITY_ASSERT(a.isShared());
+
+    {
+        Json::Value s("a string that is shared between values");
+        s.makeShared();
+
+        Json::Value t = s;
+        const Json::Value& cs = s;
+        const Json::Value& ct = t;
+        JSONITY_ASSERT(cs.tryGetString() == ct.tryGetString());
+
+        t.getString() += "!";
+        JSONITY_ASSERT(cs.tryGetString() != ct.tryGetString());
+        JSONITY_ASSERT(s == "a string that is shared between values");
+
+        Json::Value u = s;
+        u.clear();
+        JSONITY_ASSERT(u.isString() && u.getSize() == 0);
+        JSONITY_ASSERT(s.getSize() != 0);
+    }
+
+    {
+        Json::Value arr = Json::Array();
+        arr.addNewValue() = "x";
+        arr.addNewValue() = 1;
+        arr.makeShared();
+
+        Json::Value copy = arr;
+        copy.clear();
+        JSONITY_ASSERT(copy.isArray() && copy.getSize() == 0);
+        JSONITY_ASSERT(arr.getSize() == 2);
+
+        // the last owner writes in place
+        copy = arr;
+        arr = Json::null();
+        copy.addNewValue() = true;
+        JSONITY_ASSERT(copy.getSize() == 3);
+    }
+
+    Json::Value shared;
+
+    {
+        Json::Document doc;
+        JSONITY_ASSERT(doc.decode(jstr1));
+        shared = doc.getValue();
+        shared.makeShared();
+    }
+
+    JSONITY_ASSERT(shared == a);
+}
+
+void test23()
+{
+    std::list<int> list;
+    list.push_back(1);
+    list.push_back(2);
+
+    Json::Value arr = Json::Array();
+    arr.addValues(list.begin(), list.end());
+    JSONITY_ASSERT(Json::equal(arr, "[1,2]"));
+
+#ifdef JSONITY_SUPPORT_CXX_11
+    {
+        std::string str(100, 'x');
+        const char* buf = str.data();
+
+        Json::Value v(std::move(str));
+        JSONITY_ASSERT(v.getCString() == buf);
+
+        std::string str2(100, 'y');
+        buf = str2.data();
+        v = std::move(str2);
+        JSONITY_ASSERT(v.getCString() == buf);
+
+        // Short strings take the buffer too.
+        std::string str3("abc");
+        str3.reserve(100);
+        buf = str3.data();
+        v = std::move(str3);
+        JSONITY_ASSERT(v.getCString() == buf);
+
+        v.setString(std::string("short"));
+        JSONITY_ASSERT(v == "short");
+    }
+
+    {
+        Json::Array src(3);
+        src[0] = "a string that does not fit inline";
+        const Json::Value* elements = src.data();
+
+        Json::Value v(std::move(src));
+        JSONITY_ASSERT(v.getArray().data() == elements);
+        JSONITY_ASSERT(src.empty());
+
+        Json::Object obj;
+        obj["name"] = 1;
+        v = std::move(obj);
+        JSONITY_ASSERT(Json::equal(v, "{\"name\":1}"));
+
+        v.setArray(Json::Array());
+        JSONITY_ASSERT(v.isArray() && v.isEmpty());
+    }
+
+    {
+        std::vector<Json::Value> values(2);
+        values[0] = "a string that does not fit inline";
+        const Json::String* str = &values[0].getString();
+
+        Json::Value v(std::move(values));
+        JSONITY_ASSERT(&v[0].getString() == str);
+
+        std::vector<std::string> strs(1, std::string(100, 'z'));
+        const char* buf = strs[0].data();
+        v.setArray(std::move(strs));
+        JSONITY_ASSERT(v[0].getCString() == buf);
+
+        std::map<std::string, std::vector<Json::Value> > map;
+        map["list"].push_back(Json::Value("a string that does not fit inline"));
+        str = &map["list"][0].getString();
+        v = std::move(map);
+        JSONITY_ASSERT(&v["list"][0].getString() == str);
+
+        std::vector<Json::Value> more(1, Json::Value(true));
+        v["list"].addValues(std::make_move_iterator(more.begin()),
+                            std::make_move_iterator(more.end()));
+        JSONITY_ASSERT(v["list"].getSize() == 2);
+    }
+
+    {
+        Json::Value v = Json::Array();
+        v.emplaceBack(1);
+        v.emplaceBack("two");
+        v.emplaceBack(Json::Object()).emplace("three", 3);
+        v.emplaceBack();
+        JSONITY_ASSERT(Json::equal(v, "[1,\"two\",{\"three\":3},null]"));
+
+        Json::Value obj = Json::Object();
+        obj.emplace("a", std::string(100, 'a'));
+        obj.emplace("b", Json::Array());
+        obj.emplace("a", false);
+        JSONITY_ASSERT(Json::equal(obj, "{\"a\":false,\"b\":[]}"));
+    }
+#endif
+}
+
+void test24()
+{
+    {
+        Json::Value v = Json::Array();
+        v.reserve(100);
+        JSONITY_ASSERT(v.getArray().capacity() >= 100);
+
+        v.addNewValue() = 1;
+        v.shrinkToFit();
+        JSONITY_ASSERT(v.getArray().capacity() == 1);
+
+        v.getArray().clear();
+        v.shrinkToFit();
+        JSONITY_ASSERT(v.isArray() && v.isEmpty());
+
+        Json::Value obj = Json::Object();
+        obj.reserve(10);
+        JSONITY_ASSERT(obj.isEmpty());
+    }
+
+    {
+        Json::Value v;
+        JSONITY_ASSERT(Json::decode(
+            "{ \"list\" : [ 1, [ 2, 3 ], { \"a\" : [ 4 ] }, \"x,]\\\"y\" ],"
+              "\"str\" : \"short\", \"empty\" : [] }", v));
+
+        v["str"].getString().reserve(100);
+        v["list"].addNewValue();
+        v.compact();
+
+        JSONITY_ASSERT(v["list"].getArray().capacity() == 5);
+        JSONITY_ASSERT(v["str"].getString().capacity() < 100);
+
+        // A short string keeps its String.
+        const Json::String* str = v["str"].tryGetString();
+        v["str"].shrinkToFit();
+        JSONITY_ASSERT(v["str"].tryGetString() == str);
+    }
+
+    {
+        const char* jsonStr =
+            "[ 1, [ 2, 3, [] ], { \"a\" : [ 4, 5 ] }, \"x,]\\\"y[\", "
+              "[ { }, [ ], \"]\" ], null ]";
+
+        Json::DecodeStyle style;
+        style.setCountArraySize(true);
+
+        Json::Value v;
+        JSONITY_ASSERT(Json::decode(jsonStr, v, style));
+        JSONITY_ASSERT(Json::equal(v, jsonStr));
+
+        JSONITY_ASSERT(v.getArray().capacity() == 6);
+        JSONITY_ASSERT(v[1].getArray().capacity() == 3);
+        JSONITY_ASSERT(v[2]["a"].getArray().capacity() == 2);
+        JSONITY_ASSERT(v[4].getArray().capacity() == 3);
+
+        Json::Document doc;
+        doc.setDecodeStyle(style);
+        JSONITY_ASSERT(doc.decode(jsonStr));
+        JSONITY_ASSERT(doc.getValue() == v);
+
+        Json::Error err;
+        JSONITY_ASSERT(!Json::decode("[ 1, 2, \"abc", v, style, &err));
+        JSONITY_ASSERT(!Json::decode("[ 1, 2,", v, style, &err));
+    }
+}
+
+template<typename JsonType>
+void testObjectLayout(bool ordered)
+{
+    typedef typename JsonType::Value Value;
+    typedef typename JsonType::StringRef StringRef;
+
+    Value v;
+    JSONITY_ASSERT(JsonType::decode(jstr1.c_str(), v));
+    JSONITY_ASSERT(JsonType::equal(v, jstr2.c_str()));
+
+    std::vector<Value> found;
+    JSONITY_ASSERT(v.findRecursive("sub2_2", found) == 1);
+    JSONITY_ASSERT(found[0] == "hijklmn");
+
+    std::string jsonStr;
+    JsonType::decode("{ \"b\" : 1, \"a\" : { \"d\" : 2, \"c\" : 3 } }", v);
+    JsonType::encode(v, jsonStr);
+    JSONITY_ASSERT(jsonStr == (ordered ?
+        "{\"b\":1,\"a\":{\"d\":2,\"c\":3}}" :
+        "{\"a\":{\"c\":3,\"d\":2},\"b\":1}"));
+
+    Value wide;
+    char name[16];
+    for (int index = 0; index < 100; ++index)
+    {
+        snprintf(name, sizeof(name), "key%d", index);
+        wide[StringRef(name)] = index;
+    }
+    JSONITY_ASSERT(wide.getSize() == 100);
+
+    for (int index = 0; index < 100; ++index)
+    {
+        snprintf(name, sizeof(name), "key%d", index);
+        JSONITY_ASSERT(wide.hasName(name));
+        JSONITY_ASSERT(wide[StringRef(name)] == index);
+    }
+    JSONITY_ASSERT(!wide.hasName("key100"));
+
+    wide.getObject().erase("key50");
+    JSONITY_ASSERT(!wide.hasName("key50"));
+    JSONITY_ASSERT(wide["key99"] == 99);
+
+    // Lookups keep working while the object shrinks past the table.
+    Value shrinking = wide;
+    for (int step = 3; step > 0; --step)
+    {
+        for (int index = 0; index < 100; index += step)
+        {
+            snprintf(name, sizeof(name), "key%d", index);
+            shrinking.getObject().erase(StringRef(name));
+        }
+
+        for (int index = 0; index < 100; ++index)
+        {
+            snprintf(name, sizeof(name), "key%d", index);
+            bool kept = ((index % step) != 0) && (index != 50);
+            for (int erased = step + 1; erased <= 3; ++erased)
+            {
+                kept = kept && ((index % erased) != 0);
+            }
+            JSONITY_ASSERT(shrinking.hasName(name) == kept);
+            JSONITY_ASSERT(!kept || (shrinking[StringRef(name)] == index));
+        }
+    }
+    JSONITY_ASSERT(shrinking.isEmpty());
+
+    Value copy = wide;
+    JSONITY_ASSERT(copy == wide);
+    copy["key0"] = true;
+    JSONITY_ASSERT(copy != wide);
+
+    copy.makeShared();
+    Value shared = copy;
+    shared["key1"] = false;
+    JSONITY_ASSERT(copy["key1"] == 1);
+
+    typename JsonType::Error err;
+    JSONITY_ASSERT(!JsonType::decode("{ \"a\" : 1, \"a\" : 2 }", v, &err));
+    JSONITY_ASSERT(err.getErrorCode() == JsonType::Error::NameAlreadyExists);
+    JSONITY_ASSERT(!JsonType::decode("{ \"a\" : 1, \"b\" : [ }", v, &err));
+
+    typename JsonType::Document doc;
+    JSONITY_ASSERT(doc.decode(jstr1.c_str()));
+    JSONITY_ASSERT(JsonType::equal(doc.getValue(), jstr2.c_str()));
+}
+
+void test25()
+{
+    testObjectLayout<Json>(false);
+    testObjectLayout<sortedJson>(false);
+    testObjectLayout<hashJson>(true);
+    testObjectLayout<orderedJson>(true);
+    testObjectLayout<shapeJson>(true);
+}
+
+template<typename JsonType>
+void testNameLookup()
+{
+    typedef typename JsonType::Value Value;
+    typedef typename JsonType::StringRef StringRef;
+
+    Value v;
+    JSONITY_ASSERT(JsonType::decode(jstr1.c_str(), v));
+
+    const char* buf = "name1name2nameX";
+    JSONITY_ASSERT(v.hasName(StringRef(buf, 5)));
+    JSONITY_ASSERT(v.hasName(StringRef(buf + 5, 5)));
+    JSONITY_ASSERT(!v.hasName(StringRef(buf + 10, 5)));
+    JSONITY_ASSERT(!v.hasName(StringRef(buf, 4)));
+    JSONITY_ASSERT(v.hasName(std::string("name3")));
+
+    const Value& cv = v;
+    JSONITY_ASSERT(cv.get("name1") != NULL);
+    JSONITY_ASSERT(*cv.get("name1") == 12345678);
+    JSONITY_ASSERT(cv.get("nameX") == NULL);
+    JSONITY_ASSERT(v.get(StringRef(buf + 10, 5)) == NULL);
+    JSONITY_ASSERT(!v.hasName("nameX"));
+
+    *v.get(StringRef(buf + 5, 5)) = false;
+    JSONITY_ASSERT(v["name2"] == false);
+
+    v[StringRef(buf + 10, 5)] = 9;
+    JSONITY_ASSERT(v["nameX"] == 9);
+
+#ifdef JSONITY_SUPPORT_CXX_17
+    std::string_view view(buf, 5);
+    JSONITY_ASSERT(v.get(view) != NULL);
+    JSONITY_ASSERT(v.getObject().find(view) != v.getObject().end());
+#endif
+
+    std::vector<Value> found;
+    JSONITY_ASSERT(v.findRecursive(StringRef("sub2_2xxx", 6), found) == 1);
+
+    typename JsonType::Object obj;
+    obj["abc"] = 1;
+    obj["ab"] = 2;
+    JSONITY_ASSERT(obj.find(StringRef("abcd", 2))->second == 2);
+    JSONITY_ASSERT(obj.find(StringRef("abcd", 3))->second == 1);
+    JSONITY_ASSERT(obj.find(StringRef("abcd", 4)) == obj.end());
+
+    Value num = 1;
+    bool exception = false;
+    try
+    {
+        num.get("name1");
+    }
+    catch (const typename JsonType::TypeMismatchException&)
+    {
+        exception = true;
+    }
+    JSONITY_ASSERT(exception);
+}
+
+void test26()
+{
+    testNameLookup<Json>();
+    testNameLookup<sortedJson>();
+    testNameLookup<hashJson>();
+    testNameLookup<orderedJson>();
+    testNameLookup<shapeJson>();
+
+    JSONITY_ASSERT(Json::StringRef("ab") < Json::StringRef("abc"));
+    JSONITY_ASSERT(!(Json::StringRef("abd") < Json::StringRef("abc")));
+    JSONITY_ASSERT(Json::StringRef("abcd", 2) == Json::StringRef("ab"));
+}
+
+template<typename JsonType>
+void testKey()
+{
+    typedef typename JsonType::Value Value;
+    typedef typename JsonType::Key Key;
+    typedef typename JsonType::StringRef StringRef;
+
+    Value records;
+    JSONITY_ASSERT(JsonType::decode(
+        "[ { \"id\" : 1, \"name\" : \"a\", \"tags\" : [] },"
+        "  { \"id\" : 2, \"name\" : \"b\", \"tags\" : [ 1 ] },"
+        "  { \"name\" : \"c\", \"tags\" : [ 1, 2 ], \"id\" : 3 },"
+        "  { \"name\" : \"d\" } ]", records));
+
+    const Key id("id");
+    const Key tags("tags");
+    JSONITY_ASSERT(id.getName() == "id");
+    JSONITY_ASSERT(id.getHash() == typename JsonType::StringRef("id").hash());
+
+    for (int round = 0; round < 2; ++round)
+    {
+        for (size_t index = 0; index < 3; ++index)
+        {
+            const Value& record = records[(int)index];
+            JSONITY_ASSERT(record.hasName(id));
+            JSONITY_ASSERT(*record.get(id) == (int)(index + 1));
+            JSONITY_ASSERT(record.get(tags)->getSize() == index);
+        }
+        JSONITY_ASSERT(!records[3].hasName(id));
+        JSONITY_ASSERT(records[3].get(tags) == NULL);
+    }
+
+    // A non-const Key also remembers where it found the name.
+    Key movingId("id");
+    Key movingTags("tags");
+    for (int round = 0; round < 2; ++round)
+    {
+        for (size_t index = 0; index < 3; ++index)
+        {
+            const Value& record = records[(int)index];
+            JSONITY_ASSERT(record.hasName(movingId));
+            JSONITY_ASSERT(*record.tryGet(movingId) == (int)(index + 1));
+            JSONITY_ASSERT(record.get(movingTags)->getSize() == index);
+        }
+        JSONITY_ASSERT(records[3].tryGet(movingId) == NULL);
+        JSONITY_ASSERT(records[3][movingTags].isNull());
+        records[3].getObject().erase("tags");
+    }
+
+    records[3][id] = 4;
+    JSONITY_ASSERT(records[3]["id"] == 4);
+    JSONITY_ASSERT(records[3].getSize() == 2);
+    records[0][id] = 10;
+    JSONITY_ASSERT(records[0]["id"] == 10);
+    JSONITY_ASSERT(records[0].getSize() == 3);
+
+    records[1].getObject().erase("id");
+    JSONITY_ASSERT(records[1].get(id) == NULL);
+    JSONITY_ASSERT(*records[2].get(id) == 3);
+
+    Value wide;
+    char name[16];
+    for (int index = 0; index < 50; ++index)
+    {
+        snprintf(name, sizeof(name), "key%d", index);
+        wide[StringRef(name)] = index;
+    }
+    const Key key42("key42");
+    JSONITY_ASSERT(*wide.get(key42) == 42);
+    JSONITY_ASSERT(wide[key42] == 42);
+
+    Value empty;
+    empty[id] = 1;
+    JSONITY_ASSERT(empty.isObject() && (empty["id"] == 1));
+}
+
+void test27()
+{
+    testKey<Json>();
+    testKey<sortedJson>();
+    testKey<hashJson>();
+    testKey<orderedJson>();
+    testKey<shapeJson>();
+}
+
+void test28()
+{
+    typedef shapeJson::Value Value;
+
+    Value records;
+    JSONITY_ASSERT(shapeJson::decode(
+        "[ { \"id\" : 1, \"name\" : \"a\", \"pos\" : { \"x\" : 1, \"y\" : 2 } },"
+        "  { \"id\" : 2, \"name\" : \"b\", \"pos\" : { \"x\" : 3, \"y\" : 4 } },"
+        "  { \"name\" : \"c\", \"id\" : 3 },"
+        "  { \"id\" : 4, \"name\" : \"d\", \"pos\" : { \"x\" : 5, \"y\" : 6 } } ]",
+        records));
+
+    const shapeJson::Object& obj0 = records[0].getObject();
+    const shapeJson::Object& obj1 = records[1].getObject();
+    const shapeJson::Object& obj2 = records[2].getObject();
+    const shapeJson::Object& obj3 = records[3].getObject();
+
+    JSONITY_ASSERT(obj0.getShape() == obj1.getShape());
+    JSONITY_ASSERT(obj0.getShape() == obj3.getShape());
+    JSONITY_ASSERT(obj0.getShape() != obj2.getShape());
+    JSONITY_ASSERT(records[0]["pos"].getObject().getShape() ==
+        records[3]["pos"].getObject().getShape());
+
+    JSONITY_ASSERT(records[1]["name"] == "b");
+    JSONITY_ASSERT(records[2]["id"] == 3);
+    JSONITY_ASSERT(records[3]["pos"]["y"] == 6);
+
+    std::string jsonStr;
+    shapeJson::encode(records[2], jsonStr);
+    JSONITY_ASSERT(jsonStr == "{\"name\":\"c\",\"id\":3}");
+
+    // changing the names of one object leaves the others as they are
+    records[1]["extra"] = true;
+    JSONITY_ASSERT(records[1].getObject().getShape() != obj0.getShape());
+    JSONITY_ASSERT(records[1].getSize() == 4);
+    JSONITY_ASSERT(!records[0].hasName("extra"));
+    JSONITY_ASSERT(!records[3].hasName("extra"));
+
+    records[3].getObject().erase("name");
+    JSONITY_ASSERT(records[3].getSize() == 2);
+    JSONITY_ASSERT(records[0]["name"] == "a");
+    JSONITY_ASSERT(records[3]["pos"]["x"] == 5);
+
+    // values can change without touching the shape
+    records[0]["id"] = 10;
+    JSONITY_ASSERT(records[0].getObject().getShape() ==
+        records[0].getObject().getShape());
+
+    Value copy = records[0];
+    JSONITY_ASSERT(copy.getObject().getShape() ==
+        records[0].getObject().getShape());
+    JSONITY_ASSERT(copy == records[0]);
+    copy.getObject().erase(copy.getObject().begin());
+    JSONITY_ASSERT(copy.getSize() == 2);
+    JSONITY_ASSERT(records[0].getSize() == 3);
+    JSONITY_ASSERT(records[0]["id"] == 10);
+
+    shapeJson::Document doc;
+    JSONITY_ASSERT(doc.decode(jstr1.c_str()));
+    JSONITY_ASSERT(shapeJson::equal(doc.getValue(), jstr2.c_str()));
+
+    Value empty = shapeJson::Object();
+    JSONITY_ASSERT(empty.getObject().getShape() == NULL);
+    JSONITY_ASSERT(!empty.hasName("id"));
+    empty["id"] = 1;
+    JSONITY_ASSERT(empty.getObject().getShape() != NULL);
+}
+
+void test29()
+{
+    Json::DecodeStyle style;
+    style.setPackNumberArrays(true);
+
+    Json::Value v;
+    JSONITY_ASSERT(Json::decode(
+        "{ \"ts\" : [ 1, 2, 3, -4 ], \"v\" : [ 0.5, 1.5, -2.25 ],"
+        "  \"mixed\" : [ 1, 2.5, 3 ], \"tail\" : [ 1, 2, \"x\" ],"
+        "  \"empty\" : [], \"nested\" : [ [ 1.0 ], [ 2 ] ] }",
+        v, style));
+
+    JSONITY_ASSERT(v["ts"].isArray() && v["ts"].isPackedNumbers());
+    JSONITY_ASSERT(v["v"].isPackedReals());
+    JSONITY_ASSERT(!v["mixed"].isPacked());
+    JSONITY_ASSERT(!v["tail"].isPacked());
+    JSONITY_ASSERT(!v["empty"].isPacked());
+    JSONITY_ASSERT(v["nested"][0].isPackedReals());
+
+    const Json::Value& cv = v;
+    Json::Span<const int64_t> ts = cv.get("ts")->getNumbers();
+    JSONITY_ASSERT(ts.size() == 4);
+    JSONITY_ASSERT((ts[0] == 1) && (ts[3] == -4));
+
+    Json::Span<double> reals = v["v"].getReals();
+    double sum = 0.0;
+    for (double* it = reals.begin(); it != reals.end(); ++it)
+    {
+        sum += *it;
+    }
+    JSONITY_ASSERT(sum == -0.25);
+    reals[0] = 10.0;
+
+    JSONITY_ASSERT(v["ts"].getSize() == 4);
+    JSONITY_ASSERT(!v["ts"].isEmpty());
+    JSONITY_ASSERT(v["tail"][2] == "x");
+    JSONITY_ASSERT(v["mixed"][1] == 2.5);
+
+    // encodes from the packed numbers
+    std::string jsonStr;
+    Json::encode(v["ts"], jsonStr);
+    JSONITY_ASSERT(jsonStr == "[1,2,3,-4]");
+    JSONITY_ASSERT(v["ts"].isPacked());
+
+    Json::Value copy = v["v"];
+    JSONITY_ASSERT(copy.isPackedReals());
+    JSONITY_ASSERT(copy.getReals()[0] == 10.0);
+
+    // array access unpacks
+    copy.addNewValue() = "x";
+    JSONITY_ASSERT(!copy.isPacked());
+    JSONITY_ASSERT(copy.getSize() == 4);
+    JSONITY_ASSERT(copy[0] == 10.0);
+    JSONITY_ASSERT(copy[3] == "x");
+
+    JSONITY_ASSERT(v["v"].isPacked());
+    JSONITY_ASSERT(v["v"].getSize() == 3);
+
+    JSONITY_ASSERT(Json::equal(v["ts"], "[ 1, 2, 3, -4 ]"));
+
+    Json::Value arr = Json::Array();
+    arr.addNewValue() = 1.5;
+    arr.addNewValue() = 2.5;
+    JSONITY_ASSERT(arr.pack());
+    JSONITY_ASSERT(arr.getReals().size() == 2);
+    arr.unpack();
+    JSONITY_ASSERT(!arr.isPacked() && (arr[1] == 2.5));
+    arr.addNewValue() = 3;
+    JSONITY_ASSERT(!arr.pack());
+
+    Json::Value num = 1;
+    bool exception = false;
+    try
+    {
+        num.getReals();
+    }
+    catch (const Json::TypeMismatchException&)
+    {
+        exception = true;
+    }
+    JSONITY_ASSERT(exception);
+
+    // not with a resource
+    Json::Arena arena;
+    Json::Value fromArena;
+    JSONITY_ASSERT(Json::decode("[ 1, 2 ]", fromArena, arena));
+    JSONITY_ASSERT(!fromArena.isPacked());
+
+    Json::Value shared;
+    JSONITY_ASSERT(Json::decode("[ 1, 2 ]", shared, style));
+    shared.makeShared();
+    JSONITY_ASSERT(!shared.isPacked() && (shared[1] == 2));
+
+    style.setCountArraySize(true);
+    JSONITY_ASSERT(Json::decode("[ 1, 2, 3, 4, 5 ]", v, style));
+    JSONITY_ASSERT(v.getNumbers().size() == 5);
+    JSONITY_ASSERT(Json::decode("[ 1, 2, { \"a\" : [ 3 ] } ]", v, style));
+    JSONITY_ASSERT(v[2]["a"].isPackedNumbers());
+    v.compact();
+    v.shrinkToFit();
+    JSONITY_ASSERT(v[2]["a"].getNumbers()[0] == 3);
+}
+
+void checkColumns(const Json::Columns& columns)
+{
+    typedef Json::Columns::Column Column;
+
+    JSONITY_ASSERT(columns.getRowCount() == 4);
+    JSONITY_ASSERT(columns.getColumnCount() == 6);
+    JSONITY_ASSERT(columns.getColumn(0).getName() == "ts");
+
+    const Column* ts = columns.findColumn("ts");
+    JSONITY_ASSERT(ts->getType() == Json::Value::NumberType);
+    JSONITY_ASSERT(ts->getSize() == 4);
+    JSONITY_ASSERT(ts->getNumbers()[3] == 4);
+    JSONITY_ASSERT(!ts->isNull(0) && ts->isNull(2));
+
+    // integers become reals
+    const Column* v = columns.findColumn("v");
+    JSONITY_ASSERT(v->getType() == Json::Value::RealType);
+    JSONITY_ASSERT(v->getReals()[0] == 1.0);
+    JSONITY_ASSERT(v->getReals()[1] == 2.5);
+    JSONITY_ASSERT(v->isNull(3));
+
+    const Column* ok = columns.findColumn("ok");
+    JSONITY_ASSERT(ok->getType() == Json::Value::BooleanType);
+    JSONITY_ASSERT(ok->getBooleans()[1] == 1);
+    JSONITY_ASSERT(ok->isNull(0) && !ok->isNull(1));
+
+    const Column* name = columns.findColumn("name");
+    JSONITY_ASSERT(name->getType() == Json::Value::StringType);
+    JSONITY_ASSERT(name->getStrings()[2] == "c");
+
+    const Column* any = columns.findColumn("any");
+    JSONITY_ASSERT(any->getType() == Column::MixedType);
+    JSONITY_ASSERT(any->getValues()[0] == 1);
+    JSONITY_ASSERT(any->getValues()[1] == "x");
+    JSONITY_ASSERT(any->getValues()[2].isNull() && any->isNull(2));
+    JSONITY_ASSERT(any->getValues()[3].isArray());
+
+    const Column* none = columns.findColumn("none");
+    JSONITY_ASSERT(none->getType() == Json::Value::NullType);
+    JSONITY_ASSERT(none->getSize() == 4);
+    JSONITY_ASSERT(none->isNull(3));
+
+    JSONITY_ASSERT(columns.findColumn("missing") == NULL);
+
+    bool exception = false;
+    try
+    {
+        ts->getReals();
+    }
+    catch (const Json::TypeMismatchException&)
+    {
+        exception = true;
+    }
+    JSONITY_ASSERT(exception);
+}
+
+void test30()
+{
+    const char* jsonStr =
+        "[ { \"ts\" : 1, \"v\" : 1, \"any\" : 1, \"none\" : null },"
+        "  { \"ts\" : 2, \"v\" : 2.5, \"ok\" : true, \"any\" : \"x\" },"
+        "  { \"name\" : \"c\", \"v\" : 3, \"ok\" : false, \"ts\" : null },"
+        "  { \"ts\" : 4, \"any\" : [ 1 ], \"v\" : null } ]";
+
+    Json::Columns columns;
+    JSONITY_ASSERT(Json::decode(jsonStr, columns));
+    checkColumns(columns);
+
+    Json::Value v;
+    JSONITY_ASSERT(Json::decode(jsonStr, v));
+    Json::Columns fromValue;
+    fromValue.addRows(v);
+    JSONITY_ASSERT(fromValue.getRowCount() == 4);
+    JSONITY_ASSERT(fromValue.findColumn("ts")->getNumbers()[3] == 4);
+    JSONITY_ASSERT(fromValue.findColumn("any")->getValues()[1] == "x");
+
+    std::istringstream is(jsonStr);
+    JSONITY_ASSERT(Json::decode(is, columns));
+    checkColumns(columns);
+
+    // a null bit for every row without a value
+    std::string many = "[";
+    for (int index = 0; index < 130; ++index)
+    {
+        many += (index == 0) ? "" : ",";
+        many += (index % 2) ? "{ \"a\" : 1 }" : "{}";
+    }
+    many += "]";
+    JSONITY_ASSERT(Json::decode(many, columns));
+    const Json::Columns::Column& a = columns.getColumn(0);
+    JSONITY_ASSERT(a.getSize() == 130);
+    JSONITY_ASSERT(a.isNull(0) && !a.isNull(1) && a.isNull(128));
+    JSONITY_ASSERT(a.getNulls().size() == 3);
+
+    Json::Error err;
+    JSONITY_ASSERT(!Json::decode("{ \"a\" : 1 }", columns, &err));
+    JSONITY_ASSERT(err.getErrorCode() == Json::Error::ExpectedLSB);
+    JSONITY_ASSERT(!Json::decode("[ 1 ]", columns, &err));
+    JSONITY_ASSERT(err.getErrorCode() == Json::Error::ExpectedLCB);
+    JSONITY_ASSERT(!Json::decode("[ { \"a\" : 1, \"a\" : 2 } ]", columns, &err));
+    JSONITY_ASSERT(err.getErrorCode() == Json::Error::NameAlreadyExists);
+    JSONITY_ASSERT(!Json::decode("[ { \"a\" : 1 }, ]", columns, &err));
+    JSONITY_ASSERT(err.getErrorCode() == Json::Error::UnexpectedComma);
+    JSONITY_ASSERT(Json::decode("[]", columns));
+    JSONITY_ASSERT(columns.getRowCount() == 0);
+}
+
+void test31()
+{
+    Json::Value v;
+    JSONITY_ASSERT(Json::decode(
+        "{ \"n\" : 12, \"r\" : 2.5, \"b\" : true, \"s\" : \"str\","
+        "  \"a\" : [ 1, 2 ], \"o\" : { \"x\" : 1 }, \"z\" : null }", v));
+
+    const Json::Value& cv = v;
+
+    int64_t number = 0;
+    JSONITY_ASSERT(cv.tryGet("n")->tryGetNumber(number) && (number == 12));
+    JSONITY_ASSERT(cv.tryGet("r")->tryGetNumber(number) && (number == 2));
+    JSONITY_ASSERT(!cv.tryGet("s")->tryGetNumber(number) && (number == 2));
+    JSONITY_ASSERT(!cv.tryGet("z")->tryGetNumber(number));
+
+    double real = 0.0;
+    JSONITY_ASSERT(cv.tryGet("n")->tryGetReal(real) && (real == 12.0));
+    JSONITY_ASSERT(!cv.tryGet("a")->tryGetReal(real));
+
+    bool boolean = false;
+    JSONITY_ASSERT(cv.tryGet("b")->tryGetBoolean(boolean) && boolean);
+    JSONITY_ASSERT(!cv.tryGet("o")->tryGetBoolean(boolean));
+
+    Json::StringRef str;
+    JSONITY_ASSERT(cv.tryGet("s")->tryGetString(str));
+    JSONITY_ASSERT(str == "str");
+    JSONITY_ASSERT(!cv.tryGet("n")->tryGetString(str));
+
+    JSONITY_ASSERT(*cv.tryGet("s")->tryGetString() == "str");
+    JSONITY_ASSERT(cv.tryGet("n")->tryGetString() == NULL);
+    JSONITY_ASSERT(cv.tryGet("a")->tryGetArray()->size() == 2);
+    JSONITY_ASSERT(cv.tryGet("o")->tryGetArray() == NULL);
+    JSONITY_ASSERT(cv.tryGet("o")->tryGetObject()->size() == 1);
+    JSONITY_ASSERT(cv.tryGet("a")->tryGetObject() == NULL);
+    v.tryGet("a")->tryGetArray()->push_back(3);
+    JSONITY_ASSERT(v["a"].getSize() == 3);
+
+    JSONITY_ASSERT(cv.tryGet("missing") == NULL);
+    JSONITY_ASSERT(cv.tryGet("n")->tryGet("x") == NULL);
+    JSONITY_ASSERT(cv.tryGet("a")->tryGet(2)->getOr(0) == 3);
+    JSONITY_ASSERT(cv.tryGet("a")->tryGet(3) == NULL);
+    JSONITY_ASSERT(cv.tryGet("o")->tryGet(0) == NULL);
+
+    // No Array or String to point to, nothing is allocated for one.
+    Json::DecodeStyle style;
+    style.setPackNumberArrays(true);
+    Json::Value packed;
+    JSONITY_ASSERT(Json::decode("[ 1, 2 ]", packed, style));
+    const Json::Value& cpacked = packed;
+    JSONITY_ASSERT(cpacked.tryGetArray() == NULL);
+    JSONITY_ASSERT(cpacked.tryGet(0) == NULL);
+    JSONITY_ASSERT(cpacked.isPacked() && (cpacked.getNumbers()[1] == 2));
+
+    // Elements are copied instead, packed or not.
+    Json::Value element;
+    JSONITY_ASSERT(cpacked.tryGet(1, element) && (element == 2));
+    JSONITY_ASSERT(!cpacked.tryGet(2, element) && (element == 2));
+    JSONITY_ASSERT(cv.tryGet("a")->tryGet(2, element) && (element == 3));
+    JSONITY_ASSERT(!cv.tryGet("o")->tryGet(0, element));
+    JSONITY_ASSERT(cpacked.isPacked());
+    JSONITY_ASSERT(packed.tryGetArray()->size() == 2);
+    JSONITY_ASSERT(!packed.isPacked());
+
+    const Json::Key x("x");
+    JSONITY_ASSERT(cv.tryGet("o")->tryGet(x)->getOr(0) == 1);
+    JSONITY_ASSERT(cv.tryGet("a")->tryGet(x) == NULL);
+
+    JSONITY_ASSERT(cv.tryGet("n")->getOr(0) == 12);
+    JSONITY_ASSERT(cv.tryGet("s")->getOr(-1) == -1);
+    JSONITY_ASSERT(cv.tryGet("n")->getOr((int64_t)-1) == 12);
+    JSONITY_ASSERT(cv.tryGet("r")->getOr(0.0) == 2.5);
+    JSONITY_ASSERT(cv.tryGet("z")->getOr(1.5) == 1.5);
+    JSONITY_ASSERT(cv.tryGet("b")->getOr(false));
+    JSONITY_ASSERT(cv.tryGet("a")->getOr(true));
+    JSONITY_ASSERT(std::string(cv.tryGet("s")->getOr("none")) == "str");
+    JSONITY_ASSERT(std::string(cv.tryGet("n")->getOr("none")) == "none");
+
+#ifdef JSONITY_SUPPORT_CXX_17
+    JSONITY_ASSERT(cv.tryGet("n")->tryGetNumber().value() == 12);
+    JSONITY_ASSERT(!cv.tryGet("s")->tryGetReal().has_value());
+    JSONITY_ASSERT(cv.tryGet("b")->tryGetBoolean().value());
+#endif
+}
+
+void test32()
+{
+    {
+        Json::Value v1;
+        Json::Value v2;
+        JSONITY_ASSERT(Json::decode(
+            "[ 1, \"a\", [ 2, 3 ], { \"x\" : [ 4, 5 ] }, 1, 2.0, null ]", v1));
+        JSONITY_ASSERT(Json::decode(
+            "[ null, 2, { \"x\" : [ 5, 4 ] }, 1, [ 3, 2 ], \"a\", 1 ]", v2));
+
+        JSONITY_ASSERT(v1.compare(v2) == 0);
+        JSONITY_ASSERT(v2.compare(v1) == 0);
+    }
+
+    {
+        // Duplicates must be matched one to one.
+        Json::Value v;
+        JSONITY_ASSERT(Json::decode("[ 1, 1, 2 ]", v));
+        JSONITY_ASSERT(Json::equal(v, "[ 1, 2, 1 ]"));
+        JSONITY_ASSERT(!Json::equal(v, "[ 1, 2, 2 ]"));
+        JSONITY_ASSERT(!Json::equal(v, "[ 1, 2 ]"));
+
+        JSONITY_ASSERT(Json::decode("[ \"1\", 2 ]", v));
+        JSONITY_ASSERT(!Json::equal(v, "[ 1, 2 ]"));
+
+        JSONITY_ASSERT(Json::decode("[ [], {} ]", v));
+        JSONITY_ASSERT(!Json::equal(v, "[ {}, {} ]"));
+        JSONITY_ASSERT(Json::equal(v, "[ {}, [] ]"));
+
+        JSONITY_ASSERT(Json::decode("[ -0.0, 3 ]", v));
+        JSONITY_ASSERT(Json::equal(v, "[ 3, 0 ]"));
+    }
+
+    {
+        // Booleans are 0 and 1 either way round and in either order.
+        Json::Value t;
+        Json::Value n;
+        JSONITY_ASSERT(Json::decode("[ true, false ]", t));
+        JSONITY_ASSERT(Json::decode("[ 2, 0 ]", n));
+        JSONITY_ASSERT(t.compare(n, false) < 0);
+        JSONITY_ASSERT(n.compare(t, false) > 0);
+        JSONITY_ASSERT(t.compare(n, true) != 0);
+        JSONITY_ASSERT(n.compare(t, true) != 0);
+
+        JSONITY_ASSERT(Json::decode("[ 0, 1.0 ]", n));
+        JSONITY_ASSERT(t.compare(n, true) == 0);
+        JSONITY_ASSERT(n.compare(t, true) == 0);
+        JSONITY_ASSERT(t.hash() == n.hash());
+        JSONITY_ASSERT(Json::equal(t, "[ 1, 0 ]", false));
+        JSONITY_ASSERT(!Json::equal(t, "[ 2, 0 ]", false));
+    }
+
+    {
+        const size_t size = 100000;
+        Json::Array arr1(size);
+        Json::Array arr2(size);
+
+        for (size_t index = 0; index < size; ++index)
+        {
+            arr1[index] = static_cast<int64_t>(index % 1000);
+            arr2[index] = static_cast<int64_t>((size - index - 1) % 1000);
+        }
+
+        Json::Value v1 = arr1;
+        Json::Value v2 = arr2;
+        JSONITY_ASSERT(v1.compare(v2) == 0);
+
+        v2[0] = -1;
+        JSONITY_ASSERT(v1.compare(v2) != 0);
+    }
+}
+
+template<typename JsonType>
+void testObjectCompare()
+{
+    typename JsonType::Value v1;
+    typename JsonType::Value v2;
+    typename JsonType::Value v3;
+    JSONITY_ASSERT(JsonType::decode(
+        "{ \"a\" : 1, \"b\" : { \"x\" : [ 1, 2 ], \"y\" : \"s\" }, \"c\" : null }",
+        v1));
+    JSONITY_ASSERT(JsonType::decode(
+        "{ \"c\" : null, \"b\" : { \"y\" : \"s\", \"x\" : [ 2, 1 ] }, \"a\" : 1 }",
+        v2));
+
+    JSONITY_ASSERT(v1.compare(v2) == 0);
+    JSONITY_ASSERT(JsonType::equal(v1, v2));
+    JSONITY_ASSERT(!JsonType::equal(v1, v2, false));
+
+    JSONITY_ASSERT(JsonType::decode(
+        "{ \"a\" : 1, \"b\" : { \"x\" : [ 1, 2 ], \"y\" : \"t\" }, \"c\" : null }",
+        v3));
+    JSONITY_ASSERT(!JsonType::equal(v1, v3));
+    JSONITY_ASSERT(!JsonType::equal(v2, v3));
+
+    JSONITY_ASSERT(JsonType::decode(
+        "{ \"a\" : 1, \"b\" : { \"x\" : [ 1, 2 ], \"z\" : \"s\" }, \"c\" : null }",
+        v3));
+    JSONITY_ASSERT(!JsonType::equal(v1, v3));
+    JSONITY_ASSERT(!JsonType::equal(v3, v2));
+
+    JSONITY_ASSERT(JsonType::decode("{ \"a\" : 1, \"c\" : null }", v3));
+    JSONITY_ASSERT(v1.compare(v3) > 0);
+    JSONITY_ASSERT(v3.compare(v1) < 0);
+}
+
+void test33()
+{
+    testObjectCompare<Json>();
+    testObjectCompare<sortedJson>();
+    testObjectCompare<hashJson>();
+    testObjectCompare<orderedJson>();
+    testObjectCompare<shapeJson>();
+}
+
+void test34()
+{
+    Json::Value v1;
+    Json::Value v2;
+    JSONITY_ASSERT(Json::decode(
+        "{ \"a\" : [ 1, 2, { \"x\" : 1.0 } ], \"b\" : \"s\", \"c\" : null }",
+        v1));
+    JSONITY_ASSERT(Json::decode(
+        "{ \"c\" : null, \"b\" : \"s\", \"a\" : [ { \"x\" : 1 }, 2, 1 ] }",
+        v2));
+
+    JSONITY_ASSERT(v1.hash() == v2.hash());
+    JSONITY_ASSERT(v1.hash(false) != v2.hash(false));
+    JSONITY_ASSERT(v1["a"].hash() != v1["b"].hash());
+    JSONITY_ASSERT(Json::Value().hash() != Json::Value(0).hash());
+    JSONITY_ASSERT(Json::Value(1).hash() == Json::Value(1.0).hash());
+    JSONITY_ASSERT(Json::Value("1").hash() != Json::Value(1).hash());
+
+    {
+        // The layouts agree with each other.
+        hashJson::Value hv;
+        JSONITY_ASSERT(hashJson::decode(
+            "{ \"b\" : \"s\", \"c\" : null, \"a\" : [ 2, 1, { \"x\" : 1 } ] }",
+            hv));
+        shapeJson::Value sv;
+        JSONITY_ASSERT(shapeJson::decode(
+            "{ \"a\" : [ 2, 1, { \"x\" : 1 } ], \"c\" : null, \"b\" : \"s\" }",
+            sv));
+        JSONITY_ASSERT(hv.hash() == v1.hash());
+        JSONITY_ASSERT(sv.hash() == v1.hash());
+    }
+
+    {
+        // Shared values keep their hash and use it in Json::equal().
+        Json::Value s1 = v1;
+        Json::Value s2 = v2;
+        s1.makeShared();
+        s2.makeShared();
+        JSONITY_ASSERT(s1.hash() == v1.hash());
+        JSONITY_ASSERT(s1.hash() == s2.hash());
+        JSONITY_ASSERT(s1.compare(s2) == 0);
+
+        Json::Value copy = s1;
+        JSONITY_ASSERT(copy.compare(s1, false) == 0);
+
+        copy["b"] = "t";
+        JSONITY_ASSERT(copy.hash() != s1.hash());
+        copy.makeShared();
+        JSONITY_ASSERT(!Json::equal(copy, s1));
+        JSONITY_ASSERT(!Json::equal(s2, copy));
+
+        copy["b"] = "s";
+        copy.makeShared();
+        JSONITY_ASSERT(Json::equal(copy, s2));
+    }
+
+    {
+        // Sharing does not change the order.
+        for (int64_t n = -25; n < 25; ++n)
+        {
+            Json::Value lhs = Json::Array();
+            Json::Value rhs = Json::Array();
+            lhs.addNewValue() = 1;
+            rhs.addNewValue() = n;
+            int32_t plain = lhs.compare(rhs);
+            int32_t ordered = lhs.compare(rhs, false);
+            JSONITY_ASSERT((ordered < 0) == (n > 1));
+            JSONITY_ASSERT((ordered > 0) == (n < 1));
+
+            lhs.makeShared();
+            rhs.makeShared();
+            int32_t shared = lhs.compare(rhs);
+            JSONITY_ASSERT(((plain < 0) == (shared < 0)) &&
+                ((plain > 0) == (shared > 0)));
+            shared = lhs.compare(rhs, false);
+            JSONITY_ASSERT(((ordered < 0) == (shared < 0)) &&
+                ((ordered > 0) == (shared > 0)));
+        }
+    }
+
+    {
+        // Numbers differing by a multiple of 2^32 are not equal.
+        Json::Value lhs;
+        Json::Value rhs;
+        JSONITY_ASSERT(Json::decode("[ 0 ]", lhs));
+        JSONITY_ASSERT(Json::decode("[ 4294967296 ]", rhs));
+        JSONITY_ASSERT(lhs.hash() != rhs.hash());
+        JSONITY_ASSERT(lhs.compare(rhs) != 0);
+        JSONITY_ASSERT(lhs.compare(rhs, false) < 0);
+        JSONITY_ASSERT(rhs.compare(lhs, false) > 0);
+        JSONITY_ASSERT(!Json::equal(lhs, rhs));
+        JSONITY_ASSERT(lhs[0] < (int64_t)4294967296LL);
+        JSONITY_ASSERT(rhs[0] > (int64_t)-4294967296LL);
+        JSONITY_ASSERT(rhs[0].compare((int64_t)-0x7fffffffffffffffLL) > 0);
+        JSONITY_ASSERT(lhs != rhs);
+    }
+}
+
+void test35()
+{
+    Json::Value v;
+    JSONITY_ASSERT(Json::decode(
+        "{ \"id\" : 7, \"name\" : \"a\\\"b\", \"tags\" : [ \"x\", \"y\", 3 ],"
+        "  \"sub\" : { \"ok\" : true, \"list\" : [ [ 1, 2 ], [] ] },"
+        "  \"none\" : null, \"real\" : 0.5 }", v));
+
+    Json::Error error;
+
+    // Same order, other member order, other element order.
+    JSONITY_ASSERT(Json::equal(v,
+        "{ \"id\" : 7, \"name\" : \"a\\\"b\", \"none\" : null, \"real\" : 0.5,"
+        "  \"sub\" : { \"list\" : [ [ 1, 2 ], [] ], \"ok\" : true },"
+        "  \"tags\" : [ \"x\", \"y\", 3 ] }", true, &error) && error.isEmpty());
+    JSONITY_ASSERT(Json::equal(v,
+        "{ \"tags\" : [ 3, \"y\", \"x\" ], \"real\" : 5e-1, \"none\" : null,"
+        "  \"sub\" : { \"ok\" : 1, \"list\" : [ [], [ 2, 1 ] ] },"
+        "  \"name\" : \"a\\u0022b\", \"id\" : 7.0 }", true, &error) &&
+        error.isEmpty());
+    JSONITY_ASSERT(!Json::equal(v,
+        "{ \"tags\" : [ 3, \"y\", \"x\" ], \"real\" : 0.5, \"none\" : null,"
+        "  \"sub\" : { \"ok\" : true, \"list\" : [ [ 1, 2 ], [] ] },"
+        "  \"name\" : \"a\\\"b\", \"id\" : 7 }", false, &error) &&
+        error.isEmpty());
+
+    // Differences, the rest of the text is not read.
+    JSONITY_ASSERT(!Json::equal(v, "{ \"id\" : 8, ", true, &error) &&
+        error.isEmpty());
+    JSONITY_ASSERT(!Json::equal(v, "{ \"idx\" : 7 }", true, &error) &&
+        error.isEmpty());
+    JSONITY_ASSERT(!Json::equal(v, "{ \"id\" : \"7\" }", true, &error) &&
+        error.isEmpty());
+    JSONITY_ASSERT(!Json::equal(v, "[ 7 ]", true, &error) &&
+        error.isEmpty());
+    JSONITY_ASSERT(!Json::equal(v, "{ \"id\" : 7 }", true, &error) &&
+        error.isEmpty());
+    JSONITY_ASSERT(!Json::equal(v["tags"], "[ \"x\", \"y\", 3, 4 ]",
+        true, &error) && error.isEmpty());
+    JSONITY_ASSERT(!Json::equal(v["tags"], "[ \"x\", 3, \"z\" ]",
+        true, &error) && error.isEmpty());
+    JSONITY_ASSERT(!Json::equal(v["tags"], "[ \"x\", \"y\" ]",
+        true, &error) && error.isEmpty());
+
+    // Syntax errors before any difference.
+    JSONITY_ASSERT(!Json::equal(v["tags"], "[ \"x\" \"y\", 3 ]",
+        true, &error) && !error.isEmpty());
+    JSONITY_ASSERT(!Json::equal(v["tags"], "[ \"x\", \"y\", 3, ]",
+        true, &error) && !error.isEmpty());
+    JSONITY_ASSERT(!Json::equal(v["tags"], "[ \"x\", \"y\", 3",
+        true, &error) && !error.isEmpty());
+    JSONITY_ASSERT(!Json::equal(v["sub"],
+        "{ \"list\" : [ [ 1, 2 ], [] ], \"list\" : [ [ 1, 2 ], [] ] }",
+        true, &error) &&
+        (error.getErrorCode() == Json::Error::NameAlreadyExists));
+    JSONITY_ASSERT(!Json::equal(v["sub"],
+        "{ \"list\" : [ [ 1, 2 ], [] ], \"ok\" : true,"
+        "  \"list\" : [ [ 1, 2 ], [] ] }",
+        true, &error) &&
+        (error.getErrorCode() == Json::Error::NameAlreadyExists));
+    Json::Error reordered;
+    JSONITY_ASSERT(Json::equal(v["sub"],
+        "{ \"list\" : [ [ 1, 2 ], [] ], \"ok\" : true }",
+        true, &reordered) && reordered.isEmpty());
+
+    // Scalars.
+    JSONITY_ASSERT(Json::equal(Json::Value(), " null "));
+    JSONITY_ASSERT(!Json::equal(Json::Value(), "0"));
+    JSONITY_ASSERT(Json::equal(Json::Value(true), "true"));
+    JSONITY_ASSERT(Json::equal(Json::Value(2), "2.0"));
+    JSONITY_ASSERT(!Json::equal(Json::Value(2), "null"));
+    JSONITY_ASSERT(!Json::equal(Json::Value("2"), "2"));
+}
+
+void test36()
+{
+    Json::Value source;
+    Json::Value target;
+    Json::Value patch;
+
+    JSONITY_ASSERT(Json::decode(
+        "{ \"a\" : 1, \"b\" : { \"c\" : [ 1, 2, 3 ], \"d\" : \"x\" },"
+        "  \"e/f\" : true, \"g~h\" : null }", source));
+
+    Json::diff(source, source, patch);
+    JSONITY_ASSERT(patch.isArray() && (patch.getSize() == 0));
+
+    JSONITY_ASSERT(Json::decode(
+        "{ \"a\" : 1.0, \"b\" : { \"c\" : [ 1, 2, 4, 3 ], \"d\" : \"x\" },"
+        "  \"g~h\" : null, \"i\" : [] }", target));
+
+    Json::diff(source, target, patch);
+    JSONITY_ASSERT(Json::equal(patch,
+        "[ { \"op\" : \"replace\", \"path\" : \"/a\", \"value\" : 1.0 },"
+        "  { \"op\" : \"add\", \"path\" : \"/b/c/2\", \"value\" : 4 },"
+        "  { \"op\" : \"remove\", \"path\" : \"/e~1f\" },"
+        "  { \"op\" : \"add\", \"path\" : \"/i\", \"value\" : [] } ]", false));
+
+    // Elements are matched by content, not by position.
+    JSONITY_ASSERT(Json::decode(
+        "[ { \"id\" : 1 }, { \"id\" : 2 }, { \"id\" : 3 }, { \"id\" : 4 } ]",
+        source));
+    JSONITY_ASSERT(Json::decode(
+        "[ { \"id\" : 0 }, { \"id\" : 1 }, { \"id\" : 3 },"
+        "  { \"id\" : 4, \"x\" : 1 } ]", target));
+
+    Json::diff(source, target, patch);
+    JSONITY_ASSERT(Json::equal(patch,
+        "[ { \"op\" : \"add\", \"path\" : \"/0\", \"value\" : { \"id\" : 0 } },"
+        "  { \"op\" : \"remove\", \"path\" : \"/2\" },"
+        "  { \"op\" : \"add\", \"path\" : \"/3/x\", \"value\" : 1 } ]",
+        false));
+
+    // Root and type changes replace the whole value.
+    Json::diff(source, Json::Value("text"), patch);
+    JSONITY_ASSERT(Json::equal(patch,
+        "[ { \"op\" : \"replace\", \"path\" : \"\", \"value\" : \"text\" } ]",
+        false));
+
+    // Large arrays with a change in the middle.
+    Json::Array large(100000);
+    for (size_t index = 0; index < large.size(); ++index)
+    {
+        large[index] = static_cast<int64_t>(index);
+    }
+    source = large;
+    large[50000] = "changed";
+    large.erase(large.begin() + 70000);
+    target = large;
+
+    Json::diff(source, target, patch);
+    JSONITY_ASSERT(Json::equal(patch,
+        "[ { \"op\" : \"replace\", \"path\" : \"/50000\","
+        "    \"value\" : \"changed\" },"
+        "  { \"op\" : \"remove\", \"path\" : \"/70000\" } ]", false));
+
+    // Spread out changes in a large array.
+    large.resize(0);
+    large.resize(20000);
+    for (size_t index = 0; index < large.size(); ++index)
+    {
+        large[index] = static_cast<int64_t>(index);
+    }
+    source = large;
+    large[0] = -1;
+    large.erase(large.begin() + 5000);
+    large.insert(large.begin() + 15000, Json::Value("new"));
+    large.back() = -2;
+    target = large;
+
+    Json::diff(source, target, patch);
+    JSONITY_ASSERT(Json::equal(patch,
+        "[ { \"op\" : \"replace\", \"path\" : \"/0\", \"value\" : -1 },"
+        "  { \"op\" : \"remove\", \"path\" : \"/5000\" },"
+        "  { \"op\" : \"add\", \"path\" : \"/15000\", \"value\" : \"new\" },"
+        "  { \"op\" : \"replace\", \"path\" : \"/19999\", \"value\" : -2 } ]",
+        false));
+}
+
+static bool applyPatchText(Json::Value& v, const char* patchStr,
+                           Json::Error* error = NULL)
+{
+    Json::Value patch;
+    JSONITY_ASSERT(Json::decode(patchStr, patch));
+    return Json::applyPatch(v, patch, error);
+}
+
+void test37()
+{
+    const char* doc =
+        "{ \"a\" : { \"b\" : [ 1, 2, 3 ], \"c\" : \"x\" }, \"d\" : true,"
+        "  \"e~f\" : null }";
+
+    Json::Value v;
+    Json::Value original;
+    Json::Error error;
+    JSONITY_ASSERT(Json::decode(doc, original));
+
+    v = original;
+    JSONITY_ASSERT(applyPatchText(v,
+        "[ { \"op\" : \"add\", \"path\" : \"/a/b/1\", \"value\" : 9 },"
+        "  { \"op\" : \"add\", \"path\" : \"/a/b/-\", \"value\" : 10 },"
+        "  { \"op\" : \"add\", \"path\" : \"/g\", \"value\" : { \"h\" : 1 } },"
+        "  { \"op\" : \"remove\", \"path\" : \"/e~0f\" },"
+        "  { \"op\" : \"replace\", \"path\" : \"/d\", \"value\" : false },"
+        "  { \"op\" : \"move\", \"from\" : \"/a/c\", \"path\" : \"/g/c\" },"
+        "  { \"op\" : \"copy\", \"from\" : \"/a/b/0\", \"path\" : \"/a/b/0\" },"
+        "  { \"op\" : \"test\", \"path\" : \"/a/b\","
+        "    \"value\" : [ 1.0, 1, 9, 2, 3, 10 ] } ]", &error));
+    JSONITY_ASSERT(Json::equal(v,
+        "{ \"a\" : { \"b\" : [ 1, 1, 9, 2, 3, 10 ] }, \"d\" : false,"
+        "  \"g\" : { \"h\" : 1, \"c\" : \"x\" } }", false));
+
+    // A failed operation undoes the ones before it.
+    struct
+    {
+        const char* patch;
+        int32_t errorCode;
+        uint32_t pos;
+    } failures[] =
+    {
+        { "[ { \"op\" : \"add\", \"path\" : \"/a/b/0\", \"value\" : 0 },"
+          "  { \"op\" : \"remove\", \"path\" : \"/d\" },"
+          "  { \"op\" : \"move\", \"from\" : \"/a/c\", \"path\" : \"/d\" },"
+          "  { \"op\" : \"replace\", \"path\" : \"\", \"value\" : [] },"
+          "  { \"op\" : \"test\", \"path\" : \"\", \"value\" : {} } ]",
+          Json::Error::TestFailed, 4 },
+        { "[ { \"op\" : \"move\", \"from\" : \"/a/c\", \"path\" : \"/e~0f\" },"
+          "  { \"op\" : \"move\", \"from\" : \"/a/b/0\", \"path\" : \"/a/b/2\" },"
+          "  { \"op\" : \"copy\", \"from\" : \"/a\", \"path\" : \"/a/b/-\" },"
+          "  { \"op\" : \"remove\", \"path\" : \"/a/x\" } ]",
+          Json::Error::PathNotFound, 3 },
+        { "[ { \"op\" : \"move\", \"from\" : \"/a/b\", \"path\" : \"\" },"
+          "  { \"op\" : \"add\", \"path\" : \"/4\", \"value\" : 0 } ]",
+          Json::Error::PathNotFound, 1 },
+        { "[ { \"op\" : \"move\", \"from\" : \"/a\", \"path\" : \"/a/b/x\" } ]",
+          Json::Error::InvalidPatch, 0 },
+        { "[ { \"op\" : \"move\", \"from\" : \"/d\", \"path\" : \"/d\" },"
+          "  { \"op\" : \"move\", \"from\" : \"/zz\", \"path\" : \"/zz\" } ]",
+          Json::Error::PathNotFound, 1 },
+        { "[ { \"op\" : \"add\", \"path\" : \"/a/b/01\", \"value\" : 0 } ]",
+          Json::Error::PathNotFound, 0 },
+        { "[ { \"op\" : \"add\", \"path\" : \"a\", \"value\" : 0 } ]",
+          Json::Error::InvalidPatch, 0 },
+        { "[ { \"op\" : \"add\", \"path\" : \"/a\" } ]",
+          Json::Error::InvalidPatch, 0 },
+        { "[ { \"op\" : \"update\", \"path\" : \"/a\", \"value\" : 0 } ]",
+          Json::Error::InvalidPatch, 0 },
+        { "{ \"op\" : \"remove\", \"path\" : \"/a\" }",
+          Json::Error::InvalidPatch, 0 },
+    };
+
+    for (size_t index = 0; index < sizeof(failures) / sizeof(failures[0]);
+        ++index)
+    {
+        v = original;
+        JSONITY_ASSERT(!applyPatchText(v, failures[index].patch, &error));
+        JSONITY_ASSERT(error.getProcess() == Json::Error::PatchProc);
+        JSONITY_ASSERT(error.getErrorCode() == failures[index].errorCode);
+        JSONITY_ASSERT(error.getCursor().getPos() == failures[index].pos);
+        JSONITY_ASSERT(Json::equal(v, doc, false));
+    }
+
+    // Elements of packed arrays are found without unpacking them.
+    Json::DecodeStyle style;
+    style.setPackNumberArrays(true);
+    JSONITY_ASSERT(Json::decode("{ \"xs\" : [ 1, 2, 3 ] }", v, style));
+    JSONITY_ASSERT(applyPatchText(v,
+        "[ { \"op\" : \"test\", \"path\" : \"/xs/1\", \"value\" : 2 },"
+        "  { \"op\" : \"move\", \"from\" : \"/xs/2\", \"path\" : \"/xs/2\" },"
+        "  { \"op\" : \"copy\", \"from\" : \"/xs/0\", \"path\" : \"/y\" } ]",
+        &error));
+    JSONITY_ASSERT(v["xs"].isPacked());
+    JSONITY_ASSERT(Json::equal(v, "{ \"xs\" : [ 1, 2, 3 ], \"y\" : 1 }"));
+    JSONITY_ASSERT(!applyPatchText(v,
+        "[ { \"op\" : \"test\", \"path\" : \"/xs/3\", \"value\" : 2 } ]",
+        &error) && (error.getErrorCode() == Json::Error::PathNotFound));
+
+    // diff() and applyPatch() round trip.
+    const char* pairs[][2] =
+    {
+        { "[ 1, 2, 3, 4, 5 ]", "[ 0, 2, 4, 5, 6, [ 7 ] ]" },
+        { "[ { \"id\" : 1 }, { \"id\" : 2 }, { \"id\" : 3 } ]",
+          "[ { \"id\" : 3 }, { \"id\" : 1, \"x\" : [ 1 ] } ]" },
+        { "{ \"a/b\" : [ [ 1 ], [ 2 ] ], \"~\" : 1 }",
+          "{ \"a/b\" : [ [ 2 ], [ 1, 1 ] ], \"c\" : {} }" },
+        { "{ \"a\" : 1 }", "[ \"a\", 1 ]" },
+    };
+
+    for (size_t index = 0; index < sizeof(pairs) / sizeof(pairs[0]);
+        ++index)
+    {
+        Json::Value source;
+        Json::Value target;
+        Json::Value patch;
+        JSONITY_ASSERT(Json::decode(pairs[index][0], source));
+        JSONITY_ASSERT(Json::decode(pairs[index][1], target));
+
+        Json::diff(source, target, patch);
+        JSONITY_ASSERT(Json::applyPatch(source, patch));
+        JSONITY_ASSERT(Json::equal(source, target, false));
+    }
+
+    // Merge patch, RFC 7386 appendix A.
+    JSONITY_ASSERT(Json::decode(
+        "{ \"title\" : \"Goodbye!\", \"author\" : { \"givenName\" : \"John\","
+        "  \"familyName\" : \"Doe\" }, \"tags\" : [ \"example\", \"sample\" ],"
+        "  \"content\" : \"This will be unchanged\" }", v));
+
+    Json::Value merge;
+    JSONITY_ASSERT(Json::decode(
+        "{ \"title\" : \"Hello!\", \"phoneNumber\" : \"+01-123-456-7890\","
+        "  \"author\" : { \"familyName\" : null }, \"tags\" : [ \"example\" ],"
+        "  \"new\" : { \"a\" : null, \"b\" : 1 } }", merge));
+
+    Json::Value copy = v;
+    Json::mergePatch(copy, merge);
+    JSONITY_ASSERT(Json::equal(copy,
+        "{ \"title\" : \"Hello!\", \"author\" : { \"givenName\" : \"John\" },"
+        "  \"tags\" : [ \"example\" ], \"content\" : \"This will be unchanged\","
+        "  \"phoneNumber\" : \"+01-123-456-7890\", \"new\" : { \"b\" : 1 } }",
+        false));
+    JSONITY_ASSERT(merge["tags"].getSize() == 1);
+
+#ifdef JSONITY_SUPPORT_CXX_11
+    Json::mergePatch(v, std::move(merge));
+    JSONITY_ASSERT(Json::equal(v, copy, false));
+
+    v = original;
+    Json::Value patch;
+    JSONITY_ASSERT(Json::decode(
+        "[ { \"op\" : \"add\", \"path\" : \"/big\", \"value\" : [ 1, 2 ] } ]",
+        patch));
+    JSONITY_ASSERT(Json::applyPatch(v, std::move(patch)));
+    JSONITY_ASSERT(v["big"].getSize() == 2);
+
+    // Moving out of a copy leaves the shared patch as it was.
+    JSONITY_ASSERT(Json::decode(
+        "[ { \"op\" : \"add\", \"path\" : \"/x\", \"value\" : [ 1 ] } ]",
+        patch));
+    patch.makeShared();
+    Json::Value sharedPatch = patch;
+    JSONITY_ASSERT(Json::applyPatch(v, std::move(sharedPatch)));
+    JSONITY_ASSERT(v["x"].getSize() == 1);
+    JSONITY_ASSERT(Json::equal(patch,
+        "[ { \"op\" : \"add\", \"path\" : \"/x\", \"value\" : [ 1 ] } ]"));
+
+    JSONITY_ASSERT(Json::decode("{ \"a\" : { \"b\" : [ 2 ] } }", merge));
+    merge.makeShared();
+    Json::Value sharedMerge = merge;
+    Json::mergePatch(v, std::move(sharedMerge));
+    JSONITY_ASSERT(v["a"]["b"].getSize() == 1);
+    JSONITY_ASSERT(Json::equal(merge, "{ \"a\" : { \"b\" : [ 2 ] } }"));
+#endif
+
+    Json::mergePatch(v, Json::Value(1));
+    JSONITY_ASSERT(v.isNumber());
+}
+
+template<typename JsonType>
+static void testPointer()
+{
+    typedef typename JsonType::Value Value;
+    typedef typename JsonType::Pointer Pointer;
+
+    // RFC 6901 section 5.
+    Value v;
+    JSONITY_ASSERT(JsonType::decode(
+        "{ \"foo\" : [ \"bar\", \"baz\" ], \"\" : 0, \"a/b\" : 1,"
+        "  \"c%d\" : 2, \"e^f\" : 3, \"g|h\" : 4, \"i\\\\j\" : 5,"
+        "  \"k\\\"l\" : 6, \" \" : 7, \"m~n\" : 8 }", v));
+
+    const Value& cv = v;
+    JSONITY_ASSERT(Pointer("").get(cv) == &cv);
+    JSONITY_ASSERT(Pointer("/foo").get(cv)->getSize() == 2);
+    JSONITY_ASSERT(*Pointer("/foo/0").get(cv) == "bar");
+    JSONITY_ASSERT(Pointer("/").get(cv)->getNumber() == 0);
+    JSONITY_ASSERT(Pointer("/a~1b").get(cv)->getNumber() == 1);
+    JSONITY_ASSERT(Pointer("/c%d").get(cv)->getNumber() == 2);
+    JSONITY_ASSERT(Pointer("/e^f").get(cv)->getNumber() == 3);
+    JSONITY_ASSERT(Pointer("/g|h").get(cv)->getNumber() == 4);
+    JSONITY_ASSERT(Pointer("/i\\j").get(cv)->getNumber() == 5);
+    JSONITY_ASSERT(Pointer("/k\"l").get(cv)->getNumber() == 6);
+    JSONITY_ASSERT(Pointer("/ ").get(cv)->getNumber() == 7);
+    JSONITY_ASSERT(Pointer("/m~0n").get(cv)->getNumber() == 8);
+
+    // Nothing is inserted for missing names or indexes.
+    const char* missing[] =
+    {
+        "/x", "/foo/2", "/foo/-", "/foo/01", "/foo/ 1", "/foo/0/x",
+        "/a~1b/0", "/foo/99999999999999999999",
+    };
+    for (size_t index = 0; index < sizeof(missing) / sizeof(missing[0]);
+        ++index)
+    {
+        Pointer pointer(missing[index]);
+        JSONITY_ASSERT(pointer.isValid());
+        JSONITY_ASSERT(pointer.get(v) == NULL);
+    }
+    JSONITY_ASSERT(v.getSize() == 10);
+    JSONITY_ASSERT(v["foo"].getSize() == 2);
+
+    const char* invalid[] = { "foo", "/~", "/a~2", "/~~0", "#/foo" };
+    for (size_t index = 0; index < sizeof(invalid) / sizeof(invalid[0]);
+        ++index)
+    {
+        Pointer pointer(invalid[index]);
+        JSONITY_ASSERT(!pointer.isValid());
+        JSONITY_ASSERT(pointer.getSize() == 0);
+        JSONITY_ASSERT(pointer.get(v) == NULL);
+    }
+
+    Pointer pointer("/m~0n/~1/~01");
+    JSONITY_ASSERT(pointer.getPath() == "/m~0n/~1/~01");
+    JSONITY_ASSERT(pointer.getSize() == 3);
+    JSONITY_ASSERT(pointer.getToken(0) == "m~n");
+    JSONITY_ASSERT(pointer.getToken(1) == "/");
+    JSONITY_ASSERT(pointer.getToken(2) == "~1");
+
+    // A pointer is evaluated against any number of values, the
+    // non-const overload gives a writable value.
+    Pointer second("/1/name");
+    for (int round = 0; round < 3; ++round)
+    {
+        Value other;
+        JSONITY_ASSERT(JsonType::decode(
+            "[ {}, { \"id\" : 1, \"name\" : \"a\" }, 2 ]", other));
+        Value* name = second.get(other);
+        JSONITY_ASSERT((name != NULL) && (name->getString() == "a"));
+        *name = round;
+        JSONITY_ASSERT(other[1]["name"].getNumber() == round);
+    }
+
+    Value shared(v);
+    shared.makeShared();
+    Value copy(shared);
+    *Pointer("/foo/1").get(copy) = "qux";
+    JSONITY_ASSERT(Pointer("/foo/1").get(shared)->getString() == "baz");
+    JSONITY_ASSERT(Pointer("/foo/1").get(copy)->getString() == "qux");
+}
+
+void test38()
+{
+    testPointer<Json>();
+    testPointer<sortedJson>();
+    testPointer<hashJson>();
+    testPointer<orderedJson>();
+    testPointer<shapeJson>();
+
+    Json::Pointer pointer;
+    Json::Value v(1);
+    JSONITY_ASSERT(pointer.isValid() && (pointer.get(v) == &v));
+}
+
+static const char* storeJson =
+    "{ \"store\" : {"
+    "    \"book\" : ["
+    "      { \"category\" : \"reference\", \"author\" : \"Nigel Rees\","
+    "        \"title\" : \"Sayings of the Century\", \"price\" : 8.95 },"
+    "      { \"category\" : \"fiction\", \"author\" : \"Evelyn Waugh\","
+    "        \"title\" : \"Sword of Honour\", \"price\" : 12.99 },"
+    "      { \"category\" : \"fiction\", \"author\" : \"Herman Melville\","
+    "        \"title\" : \"Moby Dick\", \"isbn\" : \"0-553-21311-3\","
+    "        \"price\" : 8 },"
+    "      { \"category\" : \"fiction\", \"author\" : \"J. R. R. Tolkien\","
+    "        \"title\" : \"The Lord of the Rings\","
+    "        \"isbn\" : \"0-395-19395-8\", \"price\" : 22.99 } ],"
+    "    \"bicycle\" : { \"color\" : \"red\", \"price\" : 399 } },"
+    "  \"limit\" : 10 }";
+
+template<typename JsonType>
+static std::string queryPath(const typename JsonType::Value& value,
+                             const char* expr)
+{
+    typename JsonType::Path path(expr);
+    JSONITY_ASSERT(path.isValid());
+
+    std::vector<const typename JsonType::Value*> results;
+    path.find(value, results);
+
+    std::string result;
+    for (size_t index = 0; index < results.size(); ++index)
+    {
+        std::string str;
+        JsonType::encode(*results[index], str);
+        result += (index > 0) ? "," : "";
+        result += str;
+    }
+    return result;
+}
+
+template<typename JsonType>
+static void testPath()
+{
+    typedef typename JsonType::Value Value;
+    typedef typename JsonType::Path Path;
+
+    Value v;
+    JSONITY_ASSERT(JsonType::decode(storeJson, v));
+
+    JSONITY_ASSERT(queryPath<JsonType>(v, "$.store.book[*].author") ==
+        "\"Nigel Rees\",\"Evelyn Waugh\",\"Herman Melville\","
+        "\"J. R. R. Tolkien\"");
+    JSONITY_ASSERT(queryPath<JsonType>(v, "$..book[?(@.price < 10)].title") ==
+        "\"Sayings of the Century\",\"Moby Dick\"");
+    JSONITY_ASSERT(queryPath<JsonType>(v, "$..book[?@.isbn].price") ==
+        "8,22.99");
+    JSONITY_ASSERT(queryPath<JsonType>(v, "$..book[?!@.isbn].price") ==
+        "8.95,12.99");
+    JSONITY_ASSERT(queryPath<JsonType>(v,
+        "$..book[?@.price <= $.limit && @.category != 'reference'].title") ==
+        "\"Moby Dick\"");
+    JSONITY_ASSERT(queryPath<JsonType>(v,
+        "$..book[?(@.price > 20 || @.author == \"Nigel Rees\")].price") ==
+        "8.95,22.99");
+    JSONITY_ASSERT(queryPath<JsonType>(v,
+        "$..book[?@.price == 8.0].title") == "\"Moby Dick\"");
+    JSONITY_ASSERT(queryPath<JsonType>(v,
+        "$..book[?@.title >= 'S'].price") == "8.95,12.99,22.99");
+    JSONITY_ASSERT(queryPath<JsonType>(v,
+        "$..book[?@.price == @.missing].price") == "");
+    JSONITY_ASSERT(queryPath<JsonType>(v,
+        "$..book[?@.missing == $.missing].price") == "8.95,12.99,8,22.99");
+    JSONITY_ASSERT(queryPath<JsonType>(v, "$.store.*.price") == "399");
+    JSONITY_ASSERT(queryPath<JsonType>(v, "$..price").size() ==
+        std::string("8.95,12.99,8,22.99,399").size());
+    JSONITY_ASSERT(queryPath<JsonType>(v, "$..book[2]['title']") ==
+        "\"Moby Dick\"");
+    JSONITY_ASSERT(queryPath<JsonType>(v, "$..book[-1].price") == "22.99");
+    JSONITY_ASSERT(queryPath<JsonType>(v, "$..book[0,-1].price") ==
+        "8.95,22.99");
+    JSONITY_ASSERT(queryPath<JsonType>(v, "$..book[:2].price") ==
+        "8.95,12.99");
+    JSONITY_ASSERT(queryPath<JsonType>(v, "$..book[1:].price") ==
+        "12.99,8,22.99");
+    JSONITY_ASSERT(queryPath<JsonType>(v, "$..book[::-2].price") ==
+        "22.99,12.99");
+    JSONITY_ASSERT(queryPath<JsonType>(v, "$..book[-3:-1:1].price") ==
+        "12.99,8");
+    JSONITY_ASSERT(queryPath<JsonType>(v, "$..book[0:4:0].price") == "");
+    JSONITY_ASSERT(queryPath<JsonType>(v, "$..book[4].price") == "");
+    JSONITY_ASSERT(queryPath<JsonType>(v, "$.limit") == "10");
+    JSONITY_ASSERT(queryPath<JsonType>(v, "$").size() > 100);
+    JSONITY_ASSERT(queryPath<JsonType>(v, "$.limit.x") == "");
+
+    // Arrays in arrays, with recursive descent.
+    Value nested;
+    JSONITY_ASSERT(JsonType::decode(
+        "[ [ { \"a\" : 1 }, [ { \"a\" : 2 } ] ], { \"b\" : { \"a\" : 3 } },"
+        "  { \"a\" : [ 4 ] } ]", nested));
+    JSONITY_ASSERT(queryPath<JsonType>(nested, "$..a") == "1,2,3,[4]");
+    JSONITY_ASSERT(queryPath<JsonType>(nested, "$..[?@.a > 1].a") == "2,3");
+    JSONITY_ASSERT(queryPath<JsonType>(nested, "$..*").size() > 0);
+    JSONITY_ASSERT(queryPath<JsonType>(nested, "$[0][1][0].a") == "2");
+    JSONITY_ASSERT(queryPath<JsonType>(nested,
+        "$[?@[0] == 4 || @.a[0] == 4].a") == "[4]");
+
+    // Limits and early termination.
+    Path prices("$..price");
+    std::vector<const Value*> results;
+    JSONITY_ASSERT(prices.find(v, results, 2) == 2);
+    JSONITY_ASSERT(results.size() == 2);
+    JSONITY_ASSERT(prices.find(v, results, 0) == 0);
+    JSONITY_ASSERT(results.size() == 2);
+    JSONITY_ASSERT(prices.findFirst(v) == results[0]);
+    JSONITY_ASSERT(Path("$.none").findFirst(v) == NULL);
+
+    Value* limit = Path("$.limit").findFirst(v);
+    JSONITY_ASSERT(limit == &v["limit"]);
+
+    // Matches are references.
+    std::vector<Value*> writable;
+    JSONITY_ASSERT(Path("$..book[*].price").find(v, writable) == 4);
+    for (size_t index = 0; index < writable.size(); ++index)
+    {
+        *writable[index] = 1;
+    }
+    JSONITY_ASSERT(queryPath<JsonType>(v, "$..price").size() ==
+        std::string("1,1,1,1,399").size());
+
+    // A shared value is detached by the non-const overloads only.
+    Value shared(nested);
+    shared.makeShared();
+    Value copy(shared);
+    *Path("$[0][0].a").findFirst(copy) = 5;
+    JSONITY_ASSERT(queryPath<JsonType>(shared, "$[0][0].a") == "1");
+    JSONITY_ASSERT(queryPath<JsonType>(copy, "$[0][0].a") == "5");
+    const Value& constShared = shared;
+    JSONITY_ASSERT(Path("$[0][0].a").findFirst(constShared) ==
+        typename JsonType::Pointer("/0/0/a").get(constShared));
+}
+
+template<typename JsonType>
+struct PathCounter
+{
+    explicit PathCounter(size_t& count, size_t stop)
+        : count_(count), stop_(stop)
+    {
+    }
+
+    bool operator()(const typename JsonType::Value&)
+    {
+        return (++count_ < stop_);
+    }
+
+    size_t& count_;
+    size_t stop_;
+};
+
+void test39()
+{
+    testPath<Json>();
+    testPath<sortedJson>();
+    testPath<hashJson>();
+    testPath<orderedJson>();
+    testPath<shapeJson>();
+
+    Json::Value v;
+    JSONITY_ASSERT(Json::decode(storeJson, v));
+
+    size_t count = 0;
+    JSONITY_ASSERT(Json::Path("$..*").visit(v,
+        PathCounter<Json>(count, 3)) == 3);
+    JSONITY_ASSERT(count == 3);
+
+    count = 0;
+    JSONITY_ASSERT(Json::Path("$..*").visit(v,
+        PathCounter<Json>(count, 1000)) == count);
+    JSONITY_ASSERT(count == 28);
+
+    // Syntax errors, the position is the offset in the expression.
+    struct
+    {
+        const char* expr;
+        uint32_t pos;
+    } errors[] =
+    {
+        { "", 0 },
+        { "store", 0 },
+        { "$.", 2 },
+        { "$..", 3 },
+        { "$.store[", 8 },
+        { "$.store['book'", 14 },
+        { "$.store['book", 13 },
+        { "$[1.5]", 5 },
+        { "$[a]", 2 },
+        { "$[?@.a <]", 8 },
+        { "$[?@.a == 1 &&]", 14 },
+        { "$[?@..a == 1]", 10 },
+        { "$[?@.* == 1]", 9 },
+        { "$[?(@.a == 1]", 12 },
+        { "$[?'a']", 6 },
+        { "$.a b", 4 },
+        { "$['\\x']", 4 },
+    };
+
+    for (size_t index = 0; index < sizeof(errors) / sizeof(errors[0]);
+        ++index)
+    {
+        Json::Error error;
+        Json::Path path(errors[index].expr, &error);
+        JSONITY_ASSERT(!path.isValid());
+        JSONITY_ASSERT(!error.isEmpty());
+        JSONITY_ASSERT(error.getCursor().getPos() == errors[index].pos);
+        JSONITY_ASSERT(path.findFirst(v) == NULL);
+    }
+
+    Json::Path root;
+    JSONITY_ASSERT(root.isValid() && (root.findFirst(v) == &v));
+    JSONITY_ASSERT(Json::Path(" $ ").findFirst(v) == &v);
+
+    std::vector<const Json::Value*> results;
+    JSONITY_ASSERT(Json::Path("$.store.book[?1 == 1.0]").find(
+        static_cast<const Json::Value&>(v), results) == 4);
+    JSONITY_ASSERT(Json::Path("$['store']['bicycle'][\"color\"]")
+        .findFirst(v)->getString() == "red");
+
+    Json::Value escaped;
+    JSONITY_ASSERT(Json::decode(
+        "{ \"a'b\" : 1, \"\\u00e9\" : 2, \"\\u00e9t\\u00e9\" : 3 }", escaped));
+    JSONITY_ASSERT(Json::Path("$['a\\'b']").findFirst(escaped)->getNumber()
+        == 1);
+    JSONITY_ASSERT(Json::Path("$['\\u00e9']").findFirst(escaped)->getNumber()
+        == 2);
+    JSONITY_ASSERT(Json::Path("$.\xc3\xa9t\xc3\xa9").findFirst(escaped)
+        ->getNumber() == 3);
+
+#ifdef JSONITY_SUPPORT_CXX_11
+    std::vector<std::string> titles;
+    Json::Path("$.store.book[?@.price > 10].title").visit(v,
+        [&titles](const Json::Value& title)
+        {
+            titles.push_back(title.getCString());
+            return true;
+        });
+    JSONITY_ASSERT(titles.size() == 2);
+    JSONITY_ASSERT(titles[0] == "Sword of Honour");
+#endif
+}
+
+// Counts every value, skips "skip" members and stops at "stop".
+struct WalkCounter
+{
+    explicit WalkCounter(size_t& count)
+        : count_(count)
+    {
+    }
+
+    int32_t operator()(const Json::String* name, const Json::Value&)
+    {
+        ++count_;
+        if ((name != NULL) && (*name == "skip"))
+        {
+            return Json::Value::WalkPrune;
+        }
+        else if ((name != NULL) && (*name == "stop"))
+        {
+            return Json::Value::WalkStop;
+        }
+        return Json::Value::WalkContinue;
+    }
+
+    size_t& count_;
+};
+
+struct PathSum
+{
+    explicit PathSum(int64_t& sum)
+        : sum_(sum)
+    {
+    }
+
+    bool operator()(const Json::Value& value)
+    {
+        sum_ += value.getNumber();
+        return true;
+    }
+
+    int64_t& sum_;
+};
+
+void test40()
+{
+    Json::Value v;
+    JSONITY_ASSERT(Json::decode(
+        "{ \"a\" : [ [ { \"error\" : 1 } ], [ [ { \"error\" : 2 } ] ] ],"
+        "  \"b\" : { \"error\" : { \"error\" : 3 } },"
+        "  \"c\" : [ 1, 2, 3 ], \"error\" : 4 }", v));
+
+    // Arrays of arrays are searched, a match is not searched further.
+    std::vector<Json::Value> copies;
+    JSONITY_ASSERT(v.findRecursive("error", copies) == 4);
+
+    std::vector<const Json::Value*> found;
+    const Json::Value& cv = v;
+    JSONITY_ASSERT(cv.findRecursive("error", found) == 4);
+    JSONITY_ASSERT(found[0]->getNumber() == 1);
+    JSONITY_ASSERT(found[1]->getNumber() == 2);
+    JSONITY_ASSERT(found[2]->isObject());
+    JSONITY_ASSERT(found[3] == cv.get("error"));
+    for (size_t index = 0; index < found.size(); ++index)
+    {
+        JSONITY_ASSERT(Json::equal(*found[index], copies[index]));
+    }
+
+    found.clear();
+    JSONITY_ASSERT(cv.findRecursive("error", found, 2) == 2);
+    JSONITY_ASSERT(found.size() == 2);
+    JSONITY_ASSERT(cv.findRecursive("error", found, 0) == 0);
+    JSONITY_ASSERT(cv.findRecursive("none", found) == 0);
+    JSONITY_ASSERT(found.size() == 2);
+    JSONITY_ASSERT(cv.findFirstRecursive("error") == found[0]);
+    JSONITY_ASSERT(cv.findFirstRecursive("none") == NULL);
+    JSONITY_ASSERT(cv.get("c")->findFirstRecursive("error") == NULL);
+
+    // Writable matches, shared values are detached first.
+    Json::Value shared(v);
+    shared.makeShared();
+    Json::Value copy(shared);
+    std::vector<Json::Value*> writable;
+    JSONITY_ASSERT(copy.findRecursive("error", writable) == 4);
+    for (size_t index = 0; index < writable.size(); ++index)
+    {
+        *writable[index] = 0;
+    }
+    JSONITY_ASSERT(Json::equal(copy,
+        "{ \"a\" : [ [ { \"error\" : 0 } ], [ [ { \"error\" : 0 } ] ] ],"
+        "  \"b\" : { \"error\" : 0 }, \"c\" : [ 1, 2, 3 ], \"error\" : 0 }"));
+    JSONITY_ASSERT(Json::equal(shared, v));
+
+    *copy.findFirstRecursive("error") = 5;
+    JSONITY_ASSERT(Json::Pointer("/a/0/0/error").get(copy)->getNumber() == 5);
+
+    // Packed arrays are not unpacked.
+    Json::Value packed;
+    Json::DecodeStyle style;
+    style.setPackNumberArrays(true);
+    JSONITY_ASSERT(Json::decode("{ \"a\" : [ 1, 2, 3 ], \"b\" : 1 }",
+        packed, style));
+    JSONITY_ASSERT(packed["a"].isPacked());
+    JSONITY_ASSERT(packed.findFirstRecursive("b") == &packed["b"]);
+    JSONITY_ASSERT(packed["a"].isPacked());
+
+    // Nor by const reads, which see the elements all the same.
+    const Json::Value& cpacked = packed;
+    const Json::Value& ca = *cpacked.get("a");
+    size_t walked = 0;
+    JSONITY_ASSERT(cpacked.walk(WalkCounter(walked)) && (walked == 6));
+
+    Json::Value unpacked;
+    JSONITY_ASSERT(Json::decode("[ 3, 2, 1 ]", unpacked));
+    JSONITY_ASSERT(ca.compare(unpacked) == 0);
+    JSONITY_ASSERT(ca.compare(unpacked, false) < 0);
+    JSONITY_ASSERT(unpacked.compare(ca) == 0);
+    JSONITY_ASSERT(ca.hash() == unpacked.hash());
+    JSONITY_ASSERT(Json::equal(ca, "[ 1, 2, 3 ]"));
+    JSONITY_ASSERT(Json::equal(ca, unpacked));
+
+    std::vector<const Json::Value*> results;
+    JSONITY_ASSERT(Json::Path("$.a[1]").find(cpacked, results) == 0);
+    JSONITY_ASSERT(Json::Path("$[?@[1] == 2]").find(cpacked, results) == 1);
+    JSONITY_ASSERT(results[0] == &ca);
+    int64_t total = 0;
+    JSONITY_ASSERT(Json::Path("$.a[?@ > 1]").visit(cpacked,
+        PathSum(total)) == 2);
+    JSONITY_ASSERT(total == 5);
+    JSONITY_ASSERT(Json::Pointer("/a/1").get(cpacked) == NULL);
+    JSONITY_ASSERT(ca.tryGet(1) == NULL);
+    JSONITY_ASSERT(ca.tryGetArray() == NULL);
+
+    // Copied lookups find the elements.
+    Json::Value element;
+    JSONITY_ASSERT(Json::Pointer("/a/1").get(cpacked, element) &&
+        (element == 2));
+    JSONITY_ASSERT(!Json::Pointer("/a/3").get(cpacked, element));
+    JSONITY_ASSERT(!Json::Pointer("/a/1/x").get(cpacked, element));
+    JSONITY_ASSERT(Json::Pointer("/b").get(cpacked, element) &&
+        (element == 1));
+    copies.clear();
+    JSONITY_ASSERT(Json::Path("$.a[1]").find(cpacked, copies) == 1);
+    JSONITY_ASSERT(Json::Path("$.a[?@ > 1]").find(cpacked, copies, 1) == 1);
+    JSONITY_ASSERT((copies.size() == 2) && (copies[0] == 2) &&
+        (copies[1] == 2));
+    JSONITY_ASSERT(Json::Path("$.a[-1]").findFirst(cpacked, element) &&
+        (element == 3));
+    JSONITY_ASSERT(!Json::Path("$.a[3]").findFirst(cpacked, element));
+    JSONITY_ASSERT(Json::Path("$.b").findFirst(cpacked, element) &&
+        (element == 1));
+
+    bool exception = false;
+    try
+    {
+        ca.getArray();
+    }
+    catch (const Json::TypeMismatchException&)
+    {
+        exception = true;
+    }
+    JSONITY_ASSERT(exception);
+    JSONITY_ASSERT(ca.isPacked() && (ca.getNumbers()[2] == 3));
+
+    // Visitors
+    Json::Value tree;
+    JSONITY_ASSERT(Json::decode(
+        "{ \"a\" : [ 1, [ 2, 3 ] ], \"skip\" : { \"x\" : [ 1, 2 ] },"
+        "  \"z\" : { \"stop\" : 1, \"y\" : 2 } }", tree));
+
+    size_t count = 0;
+    JSONITY_ASSERT(!tree.walk(WalkCounter(count)));
+    JSONITY_ASSERT(count == 9);
+
+    count = 0;
+    JSONITY_ASSERT(tree["a"].walk(WalkCounter(count)));
+    JSONITY_ASSERT(count == 5);
+
+#ifdef JSONITY_SUPPORT_CXX_11
+    int64_t sum = 0;
+    tree.walk([&sum](const Json::String*, Json::Value& value)
+    {
+        if (value.isNumber())
+        {
+            sum += value.getNumber();
+            value = 0;
+        }
+        return Json::Value::WalkContinue;
+    });
+    JSONITY_ASSERT(sum == 12);
+    JSONITY_ASSERT(tree["z"]["y"].getNumber() == 0);
+#endif
+}
+
+// Index lookups must match a findRecursive() scan, which does not
+// search inside matches, so compare names that do not nest.
+static void checkIndex(const Json::Index& index, const char* name)
+{
+    std::vector<const Json::Value*> indexed;
+    std::vector<const Json::Value*> scanned;
+    index.find(name, indexed);
+    index.getRoot().findRecursive(name, scanned);
+
+    JSONITY_ASSERT(indexed.size() == scanned.size());
+    std::sort(indexed.begin(), indexed.end());
+    std::sort(scanned.begin(), scanned.end());
+    JSONITY_ASSERT(indexed == scanned);
+}
+
+// A tracked index must match one built from scratch.
+static void checkRebuilt(const Json::Index& index, Json::Value& root)
+{
+    Json::Index rebuilt(root, true);
+    JSONITY_ASSERT(index.getSize() == rebuilt.getSize());
+
+    const char* names[] = { "k", "m", "p" };
+    for (size_t pos = 0; pos < sizeof(names) / sizeof(names[0]); ++pos)
+    {
+        std::vector<Json::String> paths;
+        std::vector<Json::String> expected;
+        index.findPaths(names[pos], paths);
+        rebuilt.findPaths(names[pos], expected);
+        JSONITY_ASSERT(paths == expected);
+
+        for (int32_t n = 0; n < 10; ++n)
+        {
+            paths.clear();
+            expected.clear();
+            index.findPaths(names[pos], Json::Value(n), paths);
+            rebuilt.findPaths(names[pos], Json::Value(n), expected);
+            JSONITY_ASSERT(paths == expected);
+        }
+    }
+}
+
+void test41()
+{
+    Json::Value v;
+    JSONITY_ASSERT(Json::decode(
+        "{ \"users\" : [ { \"id\" : 1, \"role\" : \"admin\" },"
+        "                { \"id\" : 2, \"role\" : \"user\" },"
+        "                { \"id\" : 3.0, \"role\" : \"user\","
+        "                  \"groups\" : [ [ { \"id\" : 4 } ] ] } ],"
+        "  \"config\" : { \"role\" : \"user\", \"a/b\" : { \"id\" : 1 } } }",
+        v));
+
+    Json::Index index(v, true);
+    JSONITY_ASSERT(index.getSize() == 13);
+
+    std::vector<Json::String> paths;
+    JSONITY_ASSERT(index.findPaths("id", paths) == 5);
+    JSONITY_ASSERT(paths[0] == "/config/a~1b/id");
+    JSONITY_ASSERT(paths[1] == "/users/0/id");
+    JSONITY_ASSERT(paths[4] == "/users/2/id");
+
+    std::vector<const Json::Value*> found;
+    JSONITY_ASSERT(index.find("role", Json::Value("user"), found) == 3);
+    JSONITY_ASSERT(found[0] == Json::Pointer("/config/role").get(
+        index.getRoot()));
+    found.clear();
+    JSONITY_ASSERT(index.find("id", Json::Value(3), found) == 1);
+    JSONITY_ASSERT(found[0]->isReal());
+    found.clear();
+    JSONITY_ASSERT(index.find("id", Json::Value(1.0), found) == 2);
+    found.clear();
+    JSONITY_ASSERT(index.find("role", Json::Value(1), found) == 0);
+    JSONITY_ASSERT(index.find("none", found) == 0);
+    JSONITY_ASSERT(index.find("groups", Json::Array(), found) == 0);
+    JSONITY_ASSERT(found.empty());
+
+    checkIndex(index, "id");
+    checkIndex(index, "role");
+
+    // Tracked changes
+    Json::Value user;
+    JSONITY_ASSERT(Json::decode("{ \"id\" : 5, \"role\" : \"admin\" }", user));
+    JSONITY_ASSERT(index.add("/users/0", user));
+    JSONITY_ASSERT(index.getSize() == 15);
+    paths.clear();
+    JSONITY_ASSERT(index.findPaths("role", Json::Value("admin"), paths) == 2);
+    JSONITY_ASSERT(paths[0] == "/users/0/role");
+    JSONITY_ASSERT(paths[1] == "/users/1/role");
+    checkIndex(index, "id");
+
+    JSONITY_ASSERT(index.add("/config/role", "admin"));
+    JSONITY_ASSERT(index.find("role", Json::Value("admin"), found) == 3);
+    JSONITY_ASSERT(index.remove("/users/3"));
+    JSONITY_ASSERT(index.getSize() == 11);
+    JSONITY_ASSERT(!index.remove("/users/3"));
+    JSONITY_ASSERT(!index.add("/none/x", 1));
+    checkIndex(index, "id");
+    checkIndex(index, "role");
+
+    Json::Value patch;
+    JSONITY_ASSERT(Json::decode(
+        "[ { \"op\" : \"move\", \"from\" : \"/config/a~1b\","
+        "    \"path\" : \"/users/0/moved\" },"
+        "  { \"op\" : \"replace\", \"path\" : \"/users/1/id\", \"value\" : 9 },"
+        "  { \"op\" : \"test\", \"path\" : \"/users/1/id\", \"value\" : 9 },"
+        "  { \"op\" : \"copy\", \"from\" : \"/users/1\", \"path\" : \"/c\" } ]",
+        patch));
+    JSONITY_ASSERT(index.applyPatch(patch));
+    paths.clear();
+    JSONITY_ASSERT(index.findPaths("id", Json::Value(9), paths) == 2);
+    JSONITY_ASSERT(paths[0] == "/c/id");
+    JSONITY_ASSERT(paths[1] == "/users/1/id");
+    paths.clear();
+    JSONITY_ASSERT(index.findPaths("moved", paths) == 1);
+    JSONITY_ASSERT(index.findPaths("a/b", paths) == 0);
+
+    // A failed patch changes neither the value nor the index.
+    size_t size = index.getSize();
+    Json::Error error;
+    JSONITY_ASSERT(Json::decode(
+        "[ { \"op\" : \"remove\", \"path\" : \"/c\" },"
+        "  { \"op\" : \"remove\", \"path\" : \"/c\" } ]", patch));
+    JSONITY_ASSERT(!index.applyPatch(patch, &error));
+    JSONITY_ASSERT(error.getCursor().getPos() == 1);
+    JSONITY_ASSERT(index.getSize() == size);
+
+    {
+        // Only the later elements of an array are renumbered.
+        Json::Value list;
+        JSONITY_ASSERT(Json::decode(
+            "{ \"l\" : [ { \"k\" : 0 }, { \"k\" : 1, \"m\" : { \"k\" : 2 } },"
+            "            3, [ { \"k\" : 3 } ], { \"k\" : 4 } ],"
+            "  \"o\" : { \"k\" : 5, \"p\" : { \"k\" : 6 } } }", list));
+        Json::Index tracked(list, true);
+
+        Json::Value member;
+        JSONITY_ASSERT(Json::decode("{ \"k\" : 7, \"m\" : 8 }", member));
+        JSONITY_ASSERT(tracked.add("/l/1", member));
+        checkRebuilt(tracked, list);
+        JSONITY_ASSERT(tracked.add("/l/-", member));
+        checkRebuilt(tracked, list);
+        JSONITY_ASSERT(tracked.remove("/l/0"));
+        checkRebuilt(tracked, list);
+        JSONITY_ASSERT(tracked.add("/l/1/m/k", 9));
+        checkRebuilt(tracked, list);
+
+        Json::Value ops;
+        JSONITY_ASSERT(Json::decode(
+            "[ { \"op\" : \"move\", \"from\" : \"/l/0\","
+            "    \"path\" : \"/l/3\" },"
+            "  { \"op\" : \"move\", \"from\" : \"/l/4\","
+            "    \"path\" : \"/l/0\" },"
+            "  { \"op\" : \"move\", \"from\" : \"/o/p\", \"path\" : \"/o\" },"
+            "  { \"op\" : \"copy\", \"from\" : \"/o\", \"path\" : \"/l/1\" },"
+            "  { \"op\" : \"replace\", \"path\" : \"/l/2\", \"value\" : 1 },"
+            "  { \"op\" : \"remove\", \"path\" : \"/l/1\" } ]", ops));
+        JSONITY_ASSERT(tracked.applyPatch(ops));
+        checkRebuilt(tracked, list);
+
+        Json::Value before = list;
+        JSONITY_ASSERT(Json::decode(
+            "[ { \"op\" : \"add\", \"path\" : \"/l/0\","
+            "    \"value\" : { \"k\" : 1 } },"
+            "  { \"op\" : \"move\", \"from\" : \"/l/1\","
+            "    \"path\" : \"/l/-\" },"
+            "  { \"op\" : \"remove\", \"path\" : \"/o\" },"
+            "  { \"op\" : \"remove\", \"path\" : \"/none\" } ]", ops));
+        JSONITY_ASSERT(!tracked.applyPatch(ops));
+        JSONITY_ASSERT(Json::equal(list, before, false));
+        checkRebuilt(tracked, list);
+    }
+
+    JSONITY_ASSERT(Json::decode(
+        "[ { \"op\" : \"replace\", \"path\" : \"\","
+        "    \"value\" : [ { \"x\" : 1 } ] } ]", patch));
+    JSONITY_ASSERT(index.applyPatch(patch));
+    JSONITY_ASSERT(index.getSize() == 1);
+    JSONITY_ASSERT(index.find("id", found) == 0);
+
+    // Untracked changes need build().
+    (*Json::Pointer("/0").get(v))["y"] = 2;
+    paths.clear();
+    JSONITY_ASSERT(index.findPaths("y", paths) == 0);
+    index.build();
+    JSONITY_ASSERT(index.findPaths("y", paths) == 1);
+
+    // Names only
+    Json::Index names(v);
+    JSONITY_ASSERT(names.find("x", Json::Value(1), found) == 0);
+    JSONITY_ASSERT(names.findPaths("x", paths) == 1);
+}
+
+void test42()
+{
+    Json::Value v;
+    JSONITY_ASSERT(Json::decode(
+        "[ { \"id\" : 1, \"name\" : \"a\", \"meta\" : { \"code\" : \"x\" } },"
+        "  { \"id\" : 2, \"name\" : \"b\", \"meta\" : { \"code\" : \"y\" } },"
+        "  { \"name\" : \"no id\" }, 3, null,"
+        "  { \"id\" : 1.0, \"name\" : \"c\", \"meta\" : { \"code\" : \"x\" } },"
+        "  { \"id\" : \"1\", \"name\" : \"d\", \"meta\" : [] } ]", v));
+
+    Json::FieldIndex ids(v, "id");
+    JSONITY_ASSERT(ids.getSize() == 4);
+    JSONITY_ASSERT(ids.findIndex(1) == 0);
+    JSONITY_ASSERT(ids.findIndex(1.0) == 0);
+    JSONITY_ASSERT(ids.findIndex(2) == 1);
+    JSONITY_ASSERT(ids.findIndex("1") == 6);
+    JSONITY_ASSERT(ids.findIndex(3) == Json::FieldIndex::npos);
+    JSONITY_ASSERT(ids.find(Json::Value()) == NULL);
+    JSONITY_ASSERT(*ids.find(2)->get("name") == "b");
+
+    std::vector<const Json::Value*> found;
+    JSONITY_ASSERT(ids.find(1, found) == 2);
+    JSONITY_ASSERT(*found[0]->get("name") == "a");
+    JSONITY_ASSERT(*found[1]->get("name") == "c");
+    JSONITY_ASSERT(!ids.isStale());
+
+    Json::FieldIndex codes(v, Json::Pointer("/meta/code"));
+    JSONITY_ASSERT(codes.getSize() == 3);
+    found.clear();
+    JSONITY_ASSERT(codes.find("x", found) == 2);
+    JSONITY_ASSERT(codes.findIndex("y") == 1);
+    JSONITY_ASSERT(codes.findIndex("z") == Json::FieldIndex::npos);
+
+    // Many records, all found, some keys repeated.
+    Json::Array arr(20000);
+    for (size_t index = 0; index < arr.size(); ++index)
+    {
+        arr[index]["id"] = static_cast<int64_t>(index % 15000);
+    }
+    Json::Value records;
+    records = arr;
+
+    Json::FieldIndex recordIds(records, "id");
+    JSONITY_ASSERT(recordIds.getSize() == 20000);
+    for (int64_t id = 0; id < 15000; ++id)
+    {
+        JSONITY_ASSERT(recordIds.findIndex(id) == static_cast<size_t>(id));
+        found.clear();
+        JSONITY_ASSERT(recordIds.find(id, found) == ((id < 5000) ? 2 : 1));
+    }
+    JSONITY_ASSERT(recordIds.findIndex(15000) == Json::FieldIndex::npos);
+
+    records.getArray().push_back(Json::Value());
+    JSONITY_ASSERT(recordIds.isStale());
+
+    Json::Value empty = Json::Array();
+    Json::FieldIndex none(empty, "id");
+    JSONITY_ASSERT((none.getSize() == 0) && (none.find(1) == NULL));
+
+    // A packed array is indexed by its elements.
+    Json::Value numbers;
+    Json::DecodeStyle style;
+    style.setPackNumberArrays(true);
+    JSONITY_ASSERT(Json::decode("[ 5, 7, 5 ]", numbers, style));
+    Json::FieldIndex noMembers(numbers, "id");
+    JSONITY_ASSERT(noMembers.getSize() == 0);
+    Json::FieldIndex elements(numbers, Json::Pointer(""));
+    JSONITY_ASSERT(elements.getSize() == 3);
+    JSONITY_ASSERT(elements.findIndex(7.0) == 1);
+    JSONITY_ASSERT(*elements.find(7) == 7);
+    found.clear();
+    JSONITY_ASSERT(elements.find(5, found) == 2);
+    JSONITY_ASSERT(!elements.isStale() && numbers.isPacked());
+    numbers.getArray();
+    JSONITY_ASSERT(elements.isStale());
+
+    bool thrown = false;
+    try
+    {
+        Json::FieldIndex notArray(*Json::Pointer("/0").get(v), "id");
+    }
+    catch (const Json::TypeMismatchException&)
+    {
+        thrown = true;
+    }
+    JSONITY_ASSERT(thrown);
+}
+
 void example1_1()
 {
     std::string jsonStr =
@@ -1796,6 +4253,31 @@ int main(int, char**) {
     test15();
     test16();
     test17();
+    test18();
+    test19();
+    test20();
+    test21();
+    test22();
+    test23();
+    test24();
+    test25();
+    test26();
+    test27();
+    test28();
+    test29();
+    test30();
+    test31();
+    test32();
+    test33();
+    test34();
+    test35();
+    test36();
+    test37();
+    test38();
+    test39();
+    test40();
+    test41();
+    test42();
 
 #ifdef _JSONITY_TEST_
     test_unicode();